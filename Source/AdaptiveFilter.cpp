@@ -0,0 +1,369 @@
+// Copyright (c) 2021 Nicholas Corgan
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "ArrayFireBlock.hpp"
+#include "FFTPlanCache.hpp"
+#include "Utility.hpp"
+
+#include <Pothos/Exception.hpp>
+#include <Pothos/Framework.hpp>
+#include <Pothos/Object.hpp>
+
+#include <arrayfire.h>
+
+#include <algorithm>
+#include <complex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//
+// Misc
+//
+
+enum class AdaptiveAlgorithm
+{
+    LMS,
+    NLMS
+};
+
+static const std::unordered_map<std::string, AdaptiveAlgorithm> AdaptiveAlgorithmEnumMap =
+{
+    {"LMS",  AdaptiveAlgorithm::LMS},
+    {"NLMS", AdaptiveAlgorithm::NLMS},
+};
+
+// Keeps the NLMS step finite for silent bins.
+static constexpr double NLMSRegularization = 1e-10;
+
+//
+// Block class
+//
+
+/*
+ * Constrained frequency-domain block LMS (overlap-save), with a block size
+ * equal to the number of taps M. For each block of M samples:
+ *
+ *   U = FFT([previous reference block, reference block])
+ *   y = last M samples of IFFT(U W)
+ *   e = primary block - y
+ *   E = FFT([0, e])
+ *   W += mu FFT([first M samples of IFFT(conj(U) E / P), 0])
+ *
+ * where W holds the 2M-point spectrum of the taps. For NLMS, P is a running
+ * average of each bin's power, and for LMS, P is 1. Each block's update
+ * depends on the previous block's weights, so blocks are processed in
+ * order, but everything stays on the device and the whole buffer's error
+ * signal is downloaded at once.
+ */
+template <typename T, typename Real>
+class AdaptiveFilterBlock: public ArrayFireBlock
+{
+    public:
+        using Type = T;
+        using ComplexType = std::complex<Real>;
+        using Class = AdaptiveFilterBlock<T, Real>;
+
+        AdaptiveFilterBlock(
+            const std::string& device,
+            size_t numTaps,
+            AdaptiveAlgorithm algorithm
+        ):
+            ArrayFireBlock(device),
+            _afDType(Pothos::Object(Pothos::DType(typeid(Type))).convert<af::dtype>()),
+            _afComplexDType(Pothos::Object(Pothos::DType(typeid(ComplexType))).convert<af::dtype>()),
+            _afRealDType(Pothos::Object(Pothos::DType(typeid(Real))).convert<af::dtype>()),
+            _numTaps(numTaps),
+            _algorithm(algorithm),
+            _stepSize((AdaptiveAlgorithm::NLMS == algorithm) ? 0.1 : 0.001),
+            _smoothing(0.9)
+        {
+            if(0 == _numTaps)
+            {
+                throw Pothos::InvalidArgumentException("The number of taps must be non-zero.");
+            }
+
+            static const Pothos::DType dtype(typeid(Type));
+
+            this->setupInput("primary", dtype, _domain);
+            this->setupInput("reference", dtype, _domain);
+            this->setupOutput(0, dtype, _domain);
+
+            this->input("primary")->setReserve(_numTaps);
+            this->input("reference")->setReserve(_numTaps);
+
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, numTaps));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, stepSize));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, setStepSize));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, smoothing));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, setSmoothing));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, weights));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, resetState));
+
+            this->registerProbe("stepSize");
+            this->registerProbe("smoothing");
+            this->registerProbe("weights");
+
+            this->resetState();
+        }
+
+        virtual ~AdaptiveFilterBlock() = default;
+
+        size_t numTaps() const
+        {
+            return _numTaps;
+        }
+
+        double stepSize() const
+        {
+            return _stepSize;
+        }
+
+        void setStepSize(double stepSize)
+        {
+            if(stepSize <= 0.0)
+            {
+                throw Pothos::RangeException("Step size must be positive.");
+            }
+
+            _stepSize = stepSize;
+        }
+
+        double smoothing() const
+        {
+            return _smoothing;
+        }
+
+        void setSmoothing(double smoothing)
+        {
+            if((smoothing < 0.0) || (smoothing >= 1.0))
+            {
+                throw Pothos::RangeException("Smoothing must be in the range [0,1).");
+            }
+
+            _smoothing = smoothing;
+        }
+
+        // The current time-domain taps
+        std::vector<Type> weights()
+        {
+            this->configArrayFire();
+
+            recordFFTPlanUse(_afBackend, _afDevice, _afComplexDType, _afComplexDType, _afWeights.elements(), 1);
+            auto afWeights = af::ifft(_afWeights)(af::seq(0.0, static_cast<double>(_numTaps - 1)));
+            if(!IsComplex<Type>::value)
+            {
+                afWeights = af::real(afWeights);
+            }
+
+            return afArrayToStdVector(afWeights.as(_afDType)).convert<std::vector<Type>>();
+        }
+
+        void resetState() override
+        {
+            this->configArrayFire();
+
+            const dim_t fftLength = static_cast<dim_t>(2 * _numTaps);
+
+            _afWeights = af::constant(0, fftLength, _afComplexDType);
+            _afPower = af::constant(0, fftLength, _afRealDType);
+            _afPrevReference = af::constant(0, static_cast<dim_t>(_numTaps), _afDType);
+        }
+
+        void work() override
+        {
+            WorkTimer workTimer(this);
+
+            const auto& workInfo = this->workInfo();
+            const size_t numBlocks = std::min(workInfo.minInElements, workInfo.minOutElements) / _numTaps;
+            if(0 == numBlocks) return;
+
+            this->configArrayFire();
+
+            const size_t elems = numBlocks * _numTaps;
+            auto afPrimary = this->getInputElementsAsAfArray("primary", elems);
+            auto afReference = this->getInputElementsAsAfArray("reference", elems);
+
+            this->produceFromAfArray(0, _adapt(afPrimary, afReference));
+        }
+
+    protected:
+
+        void prewarmKernels() override
+        {
+            this->resetState();
+
+            // Blocks are processed one at a time, so one block compiles
+            // every kernel.
+            auto afPrewarm = af::constant(0, static_cast<dim_t>(_numTaps), _afDType);
+            _adapt(afPrewarm, afPrewarm).eval();
+        }
+
+    private:
+        af::dtype _afDType;
+        af::dtype _afComplexDType;
+        af::dtype _afRealDType;
+
+        size_t _numTaps;
+        AdaptiveAlgorithm _algorithm;
+        double _stepSize;
+        double _smoothing;
+
+        // The 2M-point spectrum of the taps
+        af::array _afWeights;
+
+        // The running average of each reference bin's power, for NLMS
+        af::array _afPower;
+
+        af::array _afPrevReference;
+
+        // Returns the error signal.
+        af::array _adapt(
+            const af::array& afPrimary,
+            const af::array& afReference)
+        {
+            const dim_t numTaps = static_cast<dim_t>(_numTaps);
+            const dim_t fftLength = 2 * numTaps;
+            const dim_t numBlocks = afPrimary.elements() / numTaps;
+
+            const auto afZeros = af::constant(0, numTaps, _afComplexDType);
+            const auto upperHalf = af::seq(static_cast<double>(numTaps), static_cast<double>(fftLength - 1));
+            const auto lowerHalf = af::seq(0.0, static_cast<double>(numTaps - 1));
+
+            // Every transform below uses the same plan.
+            recordFFTPlanUse(_afBackend, _afDevice, _afComplexDType, _afComplexDType, fftLength, 1);
+
+            af::array afErrors = af::constant(0, numBlocks * numTaps, _afDType);
+            for(dim_t block = 0; block < numBlocks; ++block)
+            {
+                const auto blockSeq = af::seq(
+                                          static_cast<double>(block * numTaps),
+                                          static_cast<double>(((block + 1) * numTaps) - 1));
+
+                af::array afReferenceBlock = afReference(blockSeq);
+                auto afReferenceSpectrum = af::fft(af::join(0, _afPrevReference, afReferenceBlock).as(_afComplexDType));
+                _afPrevReference = afReferenceBlock;
+
+                auto afEstimate = af::ifft(afReferenceSpectrum * _afWeights)(upperHalf);
+                if(!IsComplex<Type>::value)
+                {
+                    afEstimate = af::real(afEstimate);
+                }
+
+                af::array afError = (afPrimary(blockSeq) - afEstimate.as(_afDType)).eval();
+                afErrors(blockSeq) = afError;
+
+                auto afGradientSpectrum = af::conjg(afReferenceSpectrum) * af::fft(af::join(0, afZeros, afError.as(_afComplexDType)));
+                if(AdaptiveAlgorithm::NLMS == _algorithm)
+                {
+                    _afPower = ((_smoothing * _afPower) + ((1.0 - _smoothing) * af::pow(af::abs(afReferenceSpectrum), 2))).eval();
+                    afGradientSpectrum = afGradientSpectrum / (_afPower + NLMSRegularization);
+                }
+
+                // Constrain the update to M taps.
+                auto afGradient = af::ifft(afGradientSpectrum)(lowerHalf);
+                _afWeights = (_afWeights + (_stepSize * af::fft(af::join(0, afGradient, afZeros)))).eval();
+            }
+
+            return afErrors;
+        }
+};
+
+//
+// Factory
+//
+
+static Pothos::Block* makeAdaptiveFilter(
+    const std::string& device,
+    const Pothos::DType& dtype,
+    size_t numTaps,
+    const std::string& algorithmName)
+{
+    if(1 != dtype.dimension())
+    {
+        throw Pothos::InvalidArgumentException(
+                  "This block does not support multi-dimensional types.",
+                  dtype.toString());
+    }
+
+    const auto algorithm = getValForKey(AdaptiveAlgorithmEnumMap, algorithmName);
+
+    #define ifTypeDeclareFactory(T, Real) \
+        if(Pothos::DType::fromDType(dtype, 1) == Pothos::DType(typeid(T))) \
+            return new AdaptiveFilterBlock<T, Real>(device, numTaps, algorithm);
+
+    ifTypeDeclareFactory(float, float)
+    ifTypeDeclareFactory(double, double)
+    ifTypeDeclareFactory(std::complex<float>, float)
+    ifTypeDeclareFactory(std::complex<double>, double)
+    #undef ifTypeDeclareFactory
+
+    throw Pothos::InvalidArgumentException(
+              "Unsupported type.",
+              dtype.name());
+}
+
+//
+// Block registration
+//
+
+/*
+ * |PothosDoc Adaptive Filter (GPU)
+ *
+ * An adaptive FIR filter using constrained frequency-domain block LMS. The
+ * filter is applied to the <b>reference</b> input to estimate the
+ * <b>primary</b> input, and the estimation error is output. This is the
+ * structure used for interference and echo cancellation, where the
+ * reference is correlated with the interference on the primary input, and
+ * for system identification.
+ *
+ * The taps are adapted once per block of <b>numTaps</b> samples, with the
+ * filtering and update done with <b>2*numTaps</b>-point FFTs on the device.
+ * With <b>NLMS</b>, each frequency bin's step is normalized by a running
+ * average of the reference's power in that bin, which makes convergence
+ * much less sensitive to the input level. The current taps are available
+ * with <b>"weights"</b>, and <b>"resetState"</b> clears them.
+ *
+ * |category /GPU/Signal
+ * |keywords array adaptive filter lms nlms fblms cancellation equalizer
+ * |factory /gpu/signal/adaptive_filter(device,dtype,numTaps,algorithm)
+ * |setter setStepSize(stepSize)
+ * |setter setSmoothing(smoothing)
+ *
+ * |param device[Device] Device to use for processing.
+ * |default "Auto"
+ *
+ * |param dtype[Data Type] The input and output data type.
+ * |widget DTypeChooser(float=1,cfloat=1)
+ * |default "complex_float32"
+ * |preview disable
+ *
+ * |param numTaps[Num Taps] The filter length, and the number of samples
+ * per adaptation block.
+ * |widget SpinBox(minimum=1)
+ * |default 64
+ * |preview enable
+ *
+ * |param algorithm[Algorithm]
+ * |widget ComboBox(editable=false)
+ * |option [LMS] "LMS"
+ * |option [NLMS] "NLMS"
+ * |default "NLMS"
+ * |preview enable
+ *
+ * |param stepSize[Step Size] The adaptation step size <b>mu</b>. For
+ * <b>NLMS</b>, this should be in the range (0,1). For <b>LMS</b>, this
+ * must be small relative to the reference's power.
+ * |widget DoubleSpinBox(minimum=0)
+ * |default 0.1
+ * |preview enable
+ *
+ * |param smoothing[Smoothing] For <b>NLMS</b>, the forgetting factor of
+ * each bin's running power average, in the range [0,1).
+ * |widget DoubleSpinBox(minimum=0,maximum=1)
+ * |default 0.9
+ * |preview disable
+ */
+static Pothos::BlockRegistry registerAdaptiveFilter(
+    "/gpu/signal/adaptive_filter",
+    Pothos::Callable(&makeAdaptiveFilter));
@@ -5,6 +5,7 @@
 #include "BufferConversions.hpp"
 #include "DeviceCache.hpp"
 #include "SharedBufferAllocator.hpp"
+#include "Tracing.hpp"
 #include "Utility.hpp"
 
 #include <nlohmann/json.hpp>
@@ -19,6 +20,7 @@
 #include <arrayfire.h>
 
 #include <algorithm>
+#include <chrono>
 #include <string>
 
 #ifdef POTHOSGPU_LEGACY_BUFFER_MANAGER
@@ -49,7 +51,17 @@ static void checkVersion()
 
 ArrayFireBlock::ArrayFireBlock(const std::string& device):
     Pothos::Block(),
-    _afDeviceName(device)
+    _afDeviceName(device),
+    _hostMemoryConfig(defaultHostMemoryConfig()),
+    _hostSlabTracker(makeHostSlabTracker()),
+    _prewarm(false),
+    _prewarmElements(0),
+    _latencyStats(BlockLatencyStats::make()),
+    _currentPhaseNs(),
+    _currentElements(0),
+    _currentBytes(0),
+    _workTimerDepth(0),
+    _traceSourceId(0)
 {
     checkVersion();
 
@@ -96,6 +108,21 @@ ArrayFireBlock::ArrayFireBlock(const std::string& device):
     this->registerCall(this, POTHOS_FCN_TUPLE(ArrayFireBlock, backend));
     this->registerCall(this, POTHOS_FCN_TUPLE(ArrayFireBlock, device));
     this->registerCall(this, POTHOS_FCN_TUPLE(ArrayFireBlock, overlay));
+    this->registerCall(this, POTHOS_FCN_TUPLE(ArrayFireBlock, hostMemoryMode));
+    this->registerCall(this, POTHOS_FCN_TUPLE(ArrayFireBlock, setHostMemoryMode));
+    this->registerCall(this, POTHOS_FCN_TUPLE(ArrayFireBlock, hugePageMode));
+    this->registerCall(this, POTHOS_FCN_TUPLE(ArrayFireBlock, setHugePageMode));
+    this->registerCall(this, POTHOS_FCN_TUPLE(ArrayFireBlock, numaNode));
+    this->registerCall(this, POTHOS_FCN_TUPLE(ArrayFireBlock, setNUMANode));
+    this->registerCall(this, POTHOS_FCN_TUPLE(ArrayFireBlock, prewarm));
+    this->registerCall(this, POTHOS_FCN_TUPLE(ArrayFireBlock, setPrewarm));
+    this->registerCall(this, POTHOS_FCN_TUPLE(ArrayFireBlock, prewarmElements));
+    this->registerCall(this, POTHOS_FCN_TUPLE(ArrayFireBlock, setPrewarmElements));
+    this->registerCall(this, POTHOS_FCN_TUPLE(ArrayFireBlock, latencyStats));
+    this->registerCall(this, POTHOS_FCN_TUPLE(ArrayFireBlock, latencyPercentile));
+    this->registerCall(this, POTHOS_FCN_TUPLE(ArrayFireBlock, resetLatencyStats));
+
+    this->registerProbe("latencyStats");
 }
 
 ArrayFireBlock::~ArrayFireBlock()
@@ -113,7 +140,10 @@ Pothos::BufferManager::Sptr ArrayFireBlock::getInputBufferManager(
         bufferManager = makePinnedBufferManager(_afBackend);
 #else
         bufferManager = Pothos::BufferManager::make("generic");
-        bufferManager->setAllocateFunction(getSharedBufferAllocator(_afBackend));
+        bufferManager->setAllocateFunction(getSharedBufferAllocator(
+                                               _afBackend,
+                                               _hostMemoryConfig,
+                                               _hostSlabTracker));
 #endif
         return bufferManager;
     }
@@ -132,7 +162,10 @@ Pothos::BufferManager::Sptr ArrayFireBlock::getOutputBufferManager(
         bufferManager = makePinnedBufferManager(_afBackend);
 #else
         bufferManager = Pothos::BufferManager::make("generic");
-        bufferManager->setAllocateFunction(getSharedBufferAllocator(_afBackend));
+        bufferManager->setAllocateFunction(getSharedBufferAllocator(
+                                               _afBackend,
+                                               _hostMemoryConfig,
+                                               _hostSlabTracker));
 #endif
         return bufferManager;
     }
@@ -142,6 +175,43 @@ Pothos::BufferManager::Sptr ArrayFireBlock::getOutputBufferManager(
 void ArrayFireBlock::activate()
 {
     this->configArrayFire();
+
+    // The name isn't set until after construction.
+    const auto blockName = Poco::format("%s (%s)", this->getName(), this->uid());
+    _latencyStats->setName(blockName);
+    _traceSourceId = registerTraceSource(blockName, _afDeviceName);
+
+    // This is called from the thread that will call work(), so now we
+    // know where any unplaced NUMA slabs should go.
+    moveHostSlabsToCurrentNUMANode(_hostSlabTracker);
+
+    if(_prewarm)
+    {
+        // A failure here will happen again in work(), where it can be
+        // properly reported, so just log it.
+        try
+        {
+            this->prewarmKernels();
+            af::sync();
+        }
+        catch(const std::exception& ex)
+        {
+            static auto& logger = Poco::Logger::get("PothosGPU");
+            poco_warning_f2(
+                logger,
+                "%s: failed to prewarm kernels: %s",
+                this->getName(),
+                std::string(ex.what()));
+        }
+    }
+
+    this->resetState();
+}
+
+void ArrayFireBlock::deactivate()
+{
+    // The last block to deactivate writes the trace file.
+    releaseTraceSource(_traceSourceId);
 }
 
 std::string ArrayFireBlock::backend() const
@@ -186,6 +256,208 @@ std::string ArrayFireBlock::overlay() const
     return topObj.dump();
 }
 
+//
+// Host memory configuration
+//
+
+std::string ArrayFireBlock::hostMemoryMode() const
+{
+    return (HostMemoryMode::NUMA == _hostMemoryConfig.mode) ? "NUMA" : "Pinned";
+}
+
+void ArrayFireBlock::setHostMemoryMode(const std::string& mode)
+{
+    if("Pinned" == mode)    _hostMemoryConfig.mode = HostMemoryMode::Pinned;
+    else if("NUMA" == mode) _hostMemoryConfig.mode = HostMemoryMode::NUMA;
+    else throw Pothos::InvalidArgumentException("Invalid host memory mode", mode);
+}
+
+std::string ArrayFireBlock::hugePageMode() const
+{
+    switch(_hostMemoryConfig.hugePages)
+    {
+        case HugePageMode::Transparent:
+            return "Transparent";
+
+        case HugePageMode::Explicit:
+            return "Explicit";
+
+        default:
+            return "None";
+    }
+}
+
+void ArrayFireBlock::setHugePageMode(const std::string& mode)
+{
+    if("None" == mode)             _hostMemoryConfig.hugePages = HugePageMode::None;
+    else if("Transparent" == mode) _hostMemoryConfig.hugePages = HugePageMode::Transparent;
+    else if("Explicit" == mode)    _hostMemoryConfig.hugePages = HugePageMode::Explicit;
+    else throw Pothos::InvalidArgumentException("Invalid huge page mode", mode);
+}
+
+int ArrayFireBlock::numaNode() const
+{
+    return _hostMemoryConfig.numaNode;
+}
+
+// A negative node means the node of the thread that calls work().
+void ArrayFireBlock::setNUMANode(int node)
+{
+    const int numNodes = getNumNUMANodes();
+    if(node >= numNodes)
+    {
+        throw Pothos::RangeException(
+                  "Invalid NUMA node",
+                  Poco::format(
+                      "%d (valid nodes: [0,%d), or negative for the current node)",
+                      node,
+                      numNodes));
+    }
+
+    _hostMemoryConfig.numaNode = node;
+}
+
+//
+// Kernel prewarming
+//
+
+bool ArrayFireBlock::prewarm() const
+{
+    return _prewarm;
+}
+
+void ArrayFireBlock::setPrewarm(bool prewarm)
+{
+    _prewarm = prewarm;
+}
+
+size_t ArrayFireBlock::prewarmElements() const
+{
+    return _prewarmElements;
+}
+
+void ArrayFireBlock::setPrewarmElements(size_t numElements)
+{
+    _prewarmElements = numElements;
+}
+
+void ArrayFireBlock::prewarmKernels()
+{
+}
+
+void ArrayFireBlock::resetState()
+{
+}
+
+dim_t ArrayFireBlock::getPrewarmElements(const Pothos::DType& dtype) const
+{
+    if(_prewarmElements > 0)
+    {
+        return static_cast<dim_t>(_prewarmElements);
+    }
+
+    static const size_t defaultBufferSize = Pothos::BufferManagerArgs().bufferSize;
+
+    return static_cast<dim_t>(std::max<size_t>(1, defaultBufferSize / dtype.size()));
+}
+
+//
+// Latency statistics
+//
+
+std::string ArrayFireBlock::latencyStats() const
+{
+    return _latencyStats->toJSONString();
+}
+
+double ArrayFireBlock::latencyPercentile(
+    const std::string& phase,
+    double percentile) const
+{
+    static constexpr double nsPerUs = 1e3;
+
+    return _latencyStats->histogram(stringToLatencyPhase(phase)).percentile(percentile) / nsPerUs;
+}
+
+void ArrayFireBlock::resetLatencyStats()
+{
+    _latencyStats->reset();
+}
+
+ArrayFireBlock::WorkTimer::WorkTimer(ArrayFireBlock* block):
+    _block(block),
+    _start(LatencyClock::now())
+{
+    if(0 == _block->_workTimerDepth++)
+    {
+        _block->_currentPhaseNs.fill(0);
+        _block->_currentElements = 0;
+        _block->_currentBytes = 0;
+    }
+}
+
+ArrayFireBlock::WorkTimer::~WorkTimer()
+{
+    if(0 != --_block->_workTimerDepth)
+    {
+        return;
+    }
+
+    const auto elapsed = LatencyClock::now() - _start;
+    const auto& phaseNs = _block->_currentPhaseNs;
+
+    // Don't let calls that returned early (no elements, waiting on taps,
+    // etc) skew the histograms.
+    const bool didWork = std::any_of(
+                             phaseNs.begin()+1,
+                             phaseNs.end(),
+                             [](uint64_t ns){return (ns > 0);});
+    if(!didWork)
+    {
+        return;
+    }
+
+    _block->_latencyStats->histogram(LatencyPhase::Work).record(
+        static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+    recordTraceSpan(
+        _block->_traceSourceId,
+        LatencyPhase::Work,
+        _start,
+        _start + elapsed,
+        _block->_currentElements,
+        _block->_currentBytes);
+
+    // Only record phases this call went through, so blocks without inputs
+    // or outputs don't skew the histograms.
+    for(size_t phaseIndex = 1; phaseIndex < NumLatencyPhases; ++phaseIndex)
+    {
+        if(phaseNs[phaseIndex] > 0)
+        {
+            _block->_latencyStats->histogram(static_cast<LatencyPhase>(phaseIndex)).record(phaseNs[phaseIndex]);
+        }
+    }
+}
+
+void ArrayFireBlock::_addPhaseTime(
+    LatencyPhase phase,
+    const LatencyClock::time_point& start,
+    uint64_t elements,
+    uint64_t bytes)
+{
+    const auto end = LatencyClock::now();
+    _currentPhaseNs[static_cast<size_t>(phase)] +=
+        static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+
+    // Compute happens on data already counted by the other phases.
+    if(LatencyPhase::Compute != phase)
+    {
+        _currentElements += elements;
+        _currentBytes += bytes;
+    }
+
+    recordTraceSpan(_traceSourceId, phase, start, end, elements, bytes);
+}
+
 //
 // Input port API
 //
@@ -204,6 +476,20 @@ af::array ArrayFireBlock::getInputPortAsAfArray(
     return _getInputPortAsAfArray(portName, truncateToMinLength);
 }
 
+af::array ArrayFireBlock::getInputElementsAsAfArray(
+    size_t portNum,
+    size_t numElements)
+{
+    return _getInputElementsAsAfArray(portNum, numElements);
+}
+
+af::array ArrayFireBlock::getInputElementsAsAfArray(
+    const std::string& portName,
+    size_t numElements)
+{
+    return _getInputElementsAsAfArray(portName, numElements);
+}
+
 //
 // Output port API
 //
@@ -271,8 +557,38 @@ af::array ArrayFireBlock::_getInputPortAsAfArray(
         bufferChunk.length = minLength * bufferChunk.dtype.size();
     }
 
+    const auto start = LatencyClock::now();
+    auto afArray = Pothos::Object(bufferChunk).convert<af::array>();
+    _addPhaseTime(LatencyPhase::Upload, start, bufferChunk.elements(), bufferChunk.length);
+
     this->input(portId)->consume(minLength);
-    return Pothos::Object(bufferChunk).convert<af::array>();
+    return afArray;
+}
+
+template <typename PortIdType>
+af::array ArrayFireBlock::_getInputElementsAsAfArray(
+    const PortIdType& portId,
+    size_t numElements)
+{
+    auto bufferChunk = this->input(portId)->buffer();
+    if(numElements > bufferChunk.elements())
+    {
+        throw Pothos::AssertionViolationException(
+                  "Attempted to read more elements than are available.",
+                  Poco::format(
+                      "Requested: %s elements, BufferChunk: %s elements",
+                      Poco::NumberFormatter::format(numElements),
+                      Poco::NumberFormatter::format(bufferChunk.elements())));
+    }
+
+    bufferChunk.length = numElements * bufferChunk.dtype.size();
+
+    const auto start = LatencyClock::now();
+    auto afArray = Pothos::Object(bufferChunk).convert<af::array>();
+    _addPhaseTime(LatencyPhase::Upload, start, bufferChunk.elements(), bufferChunk.length);
+
+    this->input(portId)->consume(numElements);
+    return afArray;
 }
 
 template <typename PortIdType, typename AfArrayType>
@@ -281,13 +597,17 @@ void ArrayFireBlock::_produceFromAfArray(
     const AfArrayType& afArray)
 {
     auto* outputPort = this->output(portId);
-    if(outputPort->elements() < static_cast<size_t>(afArray.elements()))
+
+    // Multi-dimensional types are stored flattened in the af::array.
+    const size_t dtypeDims = outputPort->dtype().dimension();
+    const size_t numElements = static_cast<size_t>(afArray.elements()) / dtypeDims;
+    if(outputPort->elements() < numElements)
     {
         throw Pothos::AssertionViolationException(
                   "Attempted to output an af::array larger than the provided buffer.",
                   Poco::format(
                       "af::array: %s elements, BufferChunk: %s elements",
-                      Poco::NumberFormatter::format(afArray.elements()),
+                      Poco::NumberFormatter::format(numElements),
                       Poco::NumberFormatter::format(outputPort->elements())));
     }
     else if(afArray.elements() == 0)
@@ -297,8 +617,18 @@ void ArrayFireBlock::_produceFromAfArray(
                 "Port: "+Pothos::Object(portId).convert<std::string>());
     }
 
+    // Only launch the kernels here. A device-wide sync would wait on every
+    // other block sharing the device, so waiting for this array's results
+    // is left to the copy, which only waits on this array.
+    auto start = LatencyClock::now();
+    afArray.eval();
+    _addPhaseTime(LatencyPhase::Compute, start, afArray.elements(), afArray.bytes());
+
+    start = LatencyClock::now();
     afArray.host(outputPort->buffer());
-    outputPort->produce(afArray.elements());
+    _addPhaseTime(LatencyPhase::Download, start, afArray.elements(), afArray.bytes());
+
+    outputPort->produce(numElements);
 }
 
 template <typename PortIdType, typename AfArrayType>
@@ -312,5 +642,15 @@ void ArrayFireBlock::_postAfArray(
                 "Attempted to output an empty af::array,",
                 "Port: "+Pothos::Object(portId).convert<std::string>());
     }
-    this->output(portId)->postBuffer(Pothos::Object(afArray).convert<Pothos::BufferChunk>());
+
+    // See _produceFromAfArray().
+    auto start = LatencyClock::now();
+    afArray.eval();
+    _addPhaseTime(LatencyPhase::Compute, start, afArray.elements(), afArray.bytes());
+
+    start = LatencyClock::now();
+    auto bufferChunk = Pothos::Object(afArray).convert<Pothos::BufferChunk>();
+    _addPhaseTime(LatencyPhase::Download, start, afArray.elements(), afArray.bytes());
+
+    this->output(portId)->postBuffer(std::move(bufferChunk));
 }
@@ -1,12 +1,17 @@
-// Copyright (c) 2019-2020 Nicholas Corgan
+// Copyright (c) 2019-2021 Nicholas Corgan
 // SPDX-License-Identifier: BSD-3-Clause
 
 #pragma once
 
+#include "LatencyHistogram.hpp"
+#include "SharedBufferAllocator.hpp"
+
 #include <Pothos/Framework.hpp>
 
 #include <arrayfire.h>
 
+#include <array>
+#include <cstdint>
 #include <string>
 
 class ArrayFireBlock: public Pothos::Block
@@ -29,12 +34,81 @@ class ArrayFireBlock: public Pothos::Block
 
         void activate() override;
 
+        void deactivate() override;
+
         std::string backend() const;
 
         std::string device() const;
 
         virtual std::string overlay() const;
 
+        //
+        // Host memory configuration
+        //
+
+        std::string hostMemoryMode() const;
+
+        void setHostMemoryMode(const std::string& mode);
+
+        std::string hugePageMode() const;
+
+        void setHugePageMode(const std::string& mode);
+
+        int numaNode() const;
+
+        void setNUMANode(int node);
+
+        //
+        // Kernel prewarming
+        //
+
+        bool prewarm() const;
+
+        void setPrewarm(bool prewarm);
+
+        size_t prewarmElements() const;
+
+        void setPrewarmElements(size_t numElements);
+
+        // Called from activate() if prewarming is enabled. Subclasses should
+        // run their processing once on a dummy array so ArrayFire compiles
+        // the kernels before the first work() call.
+        virtual void prewarmKernels();
+
+        // Called from activate(), after any prewarming, so stateful blocks
+        // start each activation clean, even if prewarming went through
+        // their state.
+        virtual void resetState();
+
+        // If prewarmElements is 0, this is derived from the default buffer
+        // size and the given port's type.
+        dim_t getPrewarmElements(const Pothos::DType& dtype) const;
+
+        //
+        // Latency statistics
+        //
+
+        std::string latencyStats() const;
+
+        double latencyPercentile(
+            const std::string& phase,
+            double percentile) const;
+
+        void resetLatencyStats();
+
+        // Create one of these at the top of work(). Nested timers (e.g. a
+        // subclass calling its parent's work()) only record once.
+        class WorkTimer
+        {
+            public:
+                explicit WorkTimer(ArrayFireBlock* block);
+                ~WorkTimer();
+
+            private:
+                ArrayFireBlock* _block;
+                LatencyClock::time_point _start;
+        };
+
         //
         // Input port API
         //
@@ -47,6 +121,17 @@ class ArrayFireBlock: public Pothos::Block
             const std::string& portName,
             bool truncateToMinLength = true);
 
+        // For blocks whose output rate differs from their input rate, so
+        // the number of elements consumed is not simply the minimum of all
+        // ports.
+        af::array getInputElementsAsAfArray(
+            size_t portNum,
+            size_t numElements);
+
+        af::array getInputElementsAsAfArray(
+            const std::string& portName,
+            size_t numElements);
+
         //
         // Output port API
         //
@@ -82,13 +167,38 @@ class ArrayFireBlock: public Pothos::Block
         std::string _afDeviceName;
         std::string _domain;
 
+        HostMemoryConfig _hostMemoryConfig;
+        HostSlabTrackerSPtr _hostSlabTracker;
+
+        bool _prewarm;
+        size_t _prewarmElements;
+
+        BlockLatencyStats::SPtr _latencyStats;
+
     private:
 
+        std::array<uint64_t, NumLatencyPhases> _currentPhaseNs;
+        uint64_t _currentElements;
+        uint64_t _currentBytes;
+        size_t _workTimerDepth;
+        uint32_t _traceSourceId;
+
+        void _addPhaseTime(
+            LatencyPhase phase,
+            const LatencyClock::time_point& start,
+            uint64_t elements,
+            uint64_t bytes);
+
         template <typename PortIdType>
         af::array _getInputPortAsAfArray(
             const PortIdType& portId,
             bool truncateToMinLength);
 
+        template <typename PortIdType>
+        af::array _getInputElementsAsAfArray(
+            const PortIdType& portId,
+            size_t numElements);
+
         template <typename PortIdType, typename AfArrayType>
         void _produceFromAfArray(
             const PortIdType& portId,
@@ -0,0 +1,148 @@
+// Copyright (c) 2021 Nicholas Corgan
+// SPDX-License-Identifier: BSD-3-Clause
+
+#pragma once
+
+#include <Pothos/Exception.hpp>
+
+#include <arrayfire.h>
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+/*
+ * The range of equal-width bins whose counts are kept on the device. The
+ * range starts out spanning the first samples. When later samples fall
+ * outside of it, adjacent pairs of bins are merged and the freed half is
+ * added on the side the samples went past, doubling the range until they
+ * fit. The counts so far stay exact at the coarser resolution.
+ */
+class AutoRangeBins
+{
+    public:
+        AutoRangeBins(size_t numBins):
+            _numBins(numBins),
+            _minValue(0.0),
+            _maxValue(0.0),
+            _hasRange(false)
+        {
+            if(0 == numBins)
+            {
+                throw Pothos::InvalidArgumentException("The number of bins must be non-zero.");
+            }
+        }
+
+        // A fixed range works with any number of bins, but growing the
+        // range merges bins in pairs.
+        void validateAutoRange() const
+        {
+            if((_numBins < 2) || (0 != (_numBins % 2)))
+            {
+                throw Pothos::InvalidArgumentException(
+                          "Auto-ranged bins must be even and at least 2.",
+                          std::to_string(_numBins));
+            }
+        }
+
+        inline size_t numBins() const
+        {
+            return _numBins;
+        }
+
+        inline bool hasRange() const
+        {
+            return _hasRange;
+        }
+
+        inline double minValue() const
+        {
+            return _minValue;
+        }
+
+        inline double maxValue() const
+        {
+            return _maxValue;
+        }
+
+        inline double binWidth() const
+        {
+            return _hasRange ? ((_maxValue - _minValue) / static_cast<double>(_numBins)) : 0.0;
+        }
+
+        // The next samples set the range.
+        inline void reset()
+        {
+            _hasRange = false;
+        }
+
+        inline void setRange(
+            double minValue,
+            double maxValue)
+        {
+            _minValue = minValue;
+            _maxValue = maxValue;
+            _hasRange = true;
+        }
+
+        // Grows the range until it includes [minValue, maxValue], merging
+        // the counts to match. Only valid if validateAutoRange() passes.
+        void expand(
+            double minValue,
+            double maxValue,
+            af::array& afCounts)
+        {
+            if(!std::isfinite(minValue) || !std::isfinite(maxValue))
+            {
+                throw Pothos::RangeException("Auto-ranged bins only support finite values.");
+            }
+
+            if(!_hasRange)
+            {
+                this->setRange(
+                    minValue,
+                    (maxValue > minValue) ? maxValue
+                                          : (minValue + std::max(std::abs(minValue), 1.0)));
+                return;
+            }
+
+            const dim_t halfNumBins = static_cast<dim_t>(_numBins / 2);
+            while(minValue < _minValue)
+            {
+                _minValue -= (_maxValue - _minValue);
+                afCounts = af::join(0, af::constant(0, halfNumBins, afCounts.type()), _mergeBinPairs(afCounts));
+            }
+            while(maxValue > _maxValue)
+            {
+                _maxValue += (_maxValue - _minValue);
+                afCounts = af::join(0, _mergeBinPairs(afCounts), af::constant(0, halfNumBins, afCounts.type()));
+            }
+        }
+
+        // Gets both extremes in one copy.
+        static void getExtremes(
+            const af::array& afInput,
+            double& minValue,
+            double& maxValue)
+        {
+            auto afFlatInput = af::flat(afInput).as(::f64);
+
+            double extremes[2];
+            af::join(0, af::min(afFlatInput), af::max(afFlatInput)).host(extremes);
+            minValue = extremes[0];
+            maxValue = extremes[1];
+        }
+
+    private:
+        size_t _numBins;
+        double _minValue;
+        double _maxValue;
+        bool _hasRange;
+
+        af::array _mergeBinPairs(const af::array& afCounts) const
+        {
+            const dim_t halfNumBins = static_cast<dim_t>(_numBins / 2);
+
+            return af::flat(af::sum(af::moddims(afCounts, 2, halfNumBins), 0)).as(afCounts.type());
+        }
+};
@@ -0,0 +1,297 @@
+// Copyright (c) 2021 Nicholas Corgan
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "ArrayFireBlock.hpp"
+#include "StagedCoeffs.hpp"
+#include "Utility.hpp"
+
+#include <Pothos/Exception.hpp>
+#include <Pothos/Framework.hpp>
+#include <Pothos/Object.hpp>
+
+#include <Poco/Format.h>
+#include <Poco/NumberFormatter.h>
+
+#include <arrayfire.h>
+
+#include <complex>
+#include <string>
+#include <vector>
+
+//
+// Block class
+//
+
+/*
+ * The inputs are gathered into the columns of one matrix, so every beam
+ * comes out of a single matrix multiply by the transposed weight matrix,
+ * with one column per beam. New weights are uploaded in the background
+ * and swapped in at the start of the first buffer after the upload
+ * finishes, so no buffer mixes old and new weights.
+ */
+template <typename T>
+class BeamformerBlock: public ArrayFireBlock
+{
+    public:
+        using Type = T;
+        using Class = BeamformerBlock<T>;
+
+        BeamformerBlock(
+            const std::string& device,
+            size_t numInputs,
+            size_t numBeams
+        ):
+            ArrayFireBlock(device),
+            _afDType(Pothos::Object(Pothos::DType(typeid(Type))).convert<af::dtype>()),
+            _numInputs(numInputs),
+            _numBeams(numBeams),
+            _stagedWeights(_afBackend, _afDevice)
+        {
+            if(0 == _numInputs)
+            {
+                throw Pothos::InvalidArgumentException("The number of inputs must be non-zero.");
+            }
+            if(0 == _numBeams)
+            {
+                throw Pothos::InvalidArgumentException("The number of beams must be non-zero.");
+            }
+
+            static const Pothos::DType dtype(typeid(Type));
+            for(size_t input = 0; input < _numInputs; ++input)
+            {
+                this->setupInput(input, dtype, _domain);
+            }
+            for(size_t beam = 0; beam < _numBeams; ++beam)
+            {
+                this->setupOutput(beam, dtype, _domain);
+            }
+
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, numInputs));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, numBeams));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, weights));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, setWeights));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, uploadingWeights));
+
+            this->registerProbe("weights");
+
+            // Until weights are set, every beam is the mean of the inputs.
+            this->setWeights(std::vector<std::vector<Type>>(
+                                 _numBeams,
+                                 std::vector<Type>(_numInputs, Type(1.0 / double(_numInputs)))));
+        }
+
+        virtual ~BeamformerBlock() = default;
+
+        void activate() override
+        {
+            // Prewarming should use the weights set before activation, so
+            // wait for any upload still in progress.
+            this->_applyStagedWeights(true);
+
+            ArrayFireBlock::activate();
+        }
+
+        size_t numInputs() const
+        {
+            return _numInputs;
+        }
+
+        size_t numBeams() const
+        {
+            return _numBeams;
+        }
+
+        // One row per beam
+        std::vector<std::vector<Type>> weights() const
+        {
+            return _weights;
+        }
+
+        void setWeights(const std::vector<std::vector<Type>>& weights)
+        {
+            if(weights.size() != _numBeams)
+            {
+                throw Pothos::InvalidArgumentException(
+                          Poco::format(
+                              "Expected %s weight rows, got %s.",
+                              Poco::NumberFormatter::format(_numBeams),
+                              Poco::NumberFormatter::format(weights.size())));
+            }
+            for(const auto& beamWeights: weights)
+            {
+                if(beamWeights.size() != _numInputs)
+                {
+                    throw Pothos::InvalidArgumentException(
+                              Poco::format(
+                                  "Expected %s weights per beam, got %s.",
+                                  Poco::NumberFormatter::format(_numInputs),
+                                  Poco::NumberFormatter::format(beamWeights.size())));
+                }
+            }
+
+            // Column-major, one column per beam
+            std::vector<Type> weightMatrix;
+            weightMatrix.reserve(_numInputs * _numBeams);
+            for(const auto& beamWeights: weights)
+            {
+                weightMatrix.insert(weightMatrix.end(), beamWeights.begin(), beamWeights.end());
+            }
+
+            _weights = weights;
+            _stagedWeights.stage([this, weightMatrix]()
+                                 {
+                                     this->configArrayFire();
+                                     return af::moddims(
+                                                Pothos::Object(weightMatrix).convert<af::array>(),
+                                                static_cast<dim_t>(_numInputs),
+                                                static_cast<dim_t>(_numBeams));
+                                 });
+        }
+
+        bool uploadingWeights() const
+        {
+            return _stagedWeights.isUploading();
+        }
+
+        void work() override
+        {
+            WorkTimer workTimer(this);
+
+            this->_applyStagedWeights(false);
+
+            const size_t elems = this->workInfo().minElements;
+            if(0 == elems) return;
+
+            this->configArrayFire();
+
+            af::array afInputs(
+                static_cast<dim_t>(elems),
+                static_cast<dim_t>(_numInputs),
+                _afDType);
+            for(size_t input = 0; input < _numInputs; ++input)
+            {
+                afInputs(af::span, static_cast<dim_t>(input)) = this->getInputElementsAsAfArray(input, elems);
+            }
+
+            auto afBeams = af::matmul(afInputs, _afWeightMatrix);
+            for(size_t beam = 0; beam < _numBeams; ++beam)
+            {
+                this->produceFromAfArray(beam, afBeams(af::span, static_cast<dim_t>(beam)));
+            }
+        }
+
+    protected:
+
+        void prewarmKernels() override
+        {
+            const auto& dtype = this->input(0)->dtype();
+
+            af::matmul(
+                af::constant(
+                    0,
+                    static_cast<dim_t>(this->getPrewarmElements(dtype)),
+                    static_cast<dim_t>(_numInputs),
+                    _afDType),
+                _afWeightMatrix).eval();
+        }
+
+    private:
+        af::dtype _afDType;
+        size_t _numInputs;
+        size_t _numBeams;
+
+        std::vector<std::vector<Type>> _weights;
+        StagedCoeffs<af::array> _stagedWeights;
+        af::array _afWeightMatrix;
+
+        void _applyStagedWeights(bool isActivating)
+        {
+            af::array afWeightMatrix;
+            if(_stagedWeights.take(afWeightMatrix, isActivating)) _afWeightMatrix = afWeightMatrix;
+        }
+};
+
+//
+// Factory
+//
+
+static Pothos::Block* makeBeamformer(
+    const std::string& device,
+    const Pothos::DType& dtype,
+    size_t numInputs,
+    size_t numBeams)
+{
+    if(1 != dtype.dimension())
+    {
+        throw Pothos::InvalidArgumentException(
+                  "This block does not support multi-dimensional types.",
+                  dtype.toString());
+    }
+
+    #define ifTypeDeclareFactory(T) \
+        if(Pothos::DType::fromDType(dtype, 1) == Pothos::DType(typeid(T))) \
+            return new BeamformerBlock<T>(device, numInputs, numBeams);
+
+    ifTypeDeclareFactory(std::complex<float>)
+    ifTypeDeclareFactory(std::complex<double>)
+    #undef ifTypeDeclareFactory
+
+    throw Pothos::InvalidArgumentException(
+              "Unsupported type.",
+              dtype.name());
+}
+
+//
+// Block registration
+//
+
+/*
+ * |PothosDoc Beamformer (GPU)
+ *
+ * Forms <b>numBeams</b> beams from <b>numInputs</b> synchronized inputs.
+ * Given the <b>numBeams x numInputs</b> weight matrix <b>W</b>, each output
+ * sample vector is <b>y = W x</b>, where <b>x</b> holds one sample from
+ * each input. The weights aren't conjugated, so for conventional
+ * beamforming, each row should be the conjugate of its steering vector.
+ *
+ * All beams are computed with one matrix multiply per buffer. Beam <b>m</b>
+ * comes out of output port <b>m</b>.
+ *
+ * Weights set with <b>"setWeights"</b>, as one row per beam, are uploaded
+ * in the background and swapped in at the start of the first buffer after
+ * the upload finishes. <b>"uploadingWeights"</b> returns whether an upload
+ * is still in progress. Until weights are set, every beam is the mean of
+ * the inputs.
+ *
+ * |category /GPU/Array Operations
+ * |keywords array beamforming beamformer steering weights phased antenna matrix
+ * |factory /gpu/array/beamformer(device,dtype,numInputs,numBeams)
+ * |setter setWeights(weights)
+ *
+ * |param device[Device] Device to use for processing.
+ * |default "Auto"
+ *
+ * |param dtype[Data Type] The input and output data type.
+ * |widget DTypeChooser(cfloat=1)
+ * |default "complex_float32"
+ * |preview disable
+ *
+ * |param numInputs[Inputs] The number of input channels.
+ * |widget SpinBox(minimum=1)
+ * |default 4
+ * |preview enable
+ *
+ * |param numBeams[Beams] The number of output beams.
+ * |widget SpinBox(minimum=1)
+ * |default 1
+ * |preview enable
+ *
+ * |param weights[Weights] The weight matrix, as a list with one list of
+ * <b>numInputs</b> weights per beam.
+ * |widget LineEdit()
+ * |default [[0.25, 0.25, 0.25, 0.25]]
+ * |preview enable
+ */
+static Pothos::BlockRegistry registerBeamformer(
+    "/gpu/array/beamformer",
+    Pothos::Callable(&makeBeamformer));
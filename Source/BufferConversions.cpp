@@ -1,4 +1,4 @@
-// Copyright (c) 2019-2020 Nicholas Corgan
+// Copyright (c) 2019-2021 Nicholas Corgan
 // SPDX-License-Identifier: BSD-3-Clause
 
 #include "BufferConversions.hpp"
@@ -37,10 +37,12 @@ Pothos::BufferChunk afArrayTypeToBufferChunk(const AfArrayType& afArray)
     return bufferChunk;
 }
 
+// Multi-dimensional types are flattened, so each element's values are
+// consecutive.
 static af::array bufferChunkToAfArray(const Pothos::BufferChunk& bufferChunk)
 {
     af::array ret(
-        bufferChunk.elements(),
+        static_cast<dim_t>(bufferChunk.length / bufferChunk.dtype.elemSize()),
         Pothos::Object(bufferChunk.dtype).convert<af::dtype>());
     ret.write<unsigned char>(
         reinterpret_cast<const unsigned char*>(bufferChunk.address),
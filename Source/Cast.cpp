@@ -56,6 +56,8 @@ class CastBlock: public OneToOneBlock
 
         void work() override
         {
+            WorkTimer workTimer(this);
+
             const size_t elems = this->workInfo().minElements;
             if(0 == elems)
             {
@@ -0,0 +1,427 @@
+// Copyright (c) 2021 Nicholas Corgan
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "ArrayFireBlock.hpp"
+#include "FFTPlanCache.hpp"
+#include "StagedCoeffs.hpp"
+#include "Utility.hpp"
+
+#include <Pothos/Exception.hpp>
+#include <Pothos/Framework.hpp>
+#include <Pothos/Object.hpp>
+
+#include <Poco/Format.h>
+#include <Poco/NumberFormatter.h>
+
+#include <arrayfire.h>
+
+#include <algorithm>
+#include <complex>
+#include <numeric>
+#include <string>
+#include <vector>
+
+//
+// Block class
+//
+
+/*
+ * Channel k is the prototype filter h[n] modulated to k/N of the sample
+ * rate, decimated by N:
+ *
+ *   y_k[f] = sum_n h[n] x[fN + N-1 - n] e^(j2pi kn/N)
+ *
+ * Splitting n into r + pN, the exponential only depends on r, so each frame
+ * is the polyphase sum v[r] = sum_p h[r+pN] x[fN + N-1 - r - pN] followed by
+ * an unnormalized N-point inverse DFT. Each buffer gathers the (N x P)
+ * window of every frame at once, so the filter bank and FFT are each a
+ * single batched operation.
+ *
+ * New taps are staged and swapped in at the next buffer boundary. If the
+ * phase length changed, the history is reset along with them.
+ */
+template <typename In, typename Real>
+class ChannelizerBlock: public ArrayFireBlock
+{
+    public:
+        using InType = In;
+        using OutType = std::complex<Real>;
+        using Class = ChannelizerBlock<In, Real>;
+
+        // The prototype filter is always real.
+        using TapType = Real;
+
+        ChannelizerBlock(
+            const std::string& device,
+            size_t numChannels,
+            const std::vector<size_t>& channels
+        ):
+            ArrayFireBlock(device),
+            _afInputDType(Pothos::Object(Pothos::DType(typeid(InType))).convert<af::dtype>()),
+            _afOutputDType(Pothos::Object(Pothos::DType(typeid(OutType))).convert<af::dtype>()),
+            _numChannels(numChannels),
+            _channels(channels),
+            _taps({TapType(1.0)}),
+            _waitTaps(false),
+            _waitTapsArmed(false),
+            _stagedTaps(_afBackend, _afDevice),
+            _phaseLength(0)
+        {
+            if(0 == _numChannels)
+            {
+                throw Pothos::InvalidArgumentException("The number of channels must be non-zero.");
+            }
+
+            if(_channels.empty())
+            {
+                _channels.resize(_numChannels);
+                std::iota(_channels.begin(), _channels.end(), 0);
+            }
+            for(size_t channel: _channels)
+            {
+                if(channel >= _numChannels)
+                {
+                    throw Pothos::InvalidArgumentException(
+                              Poco::format(
+                                  "Invalid channel %s. Channels must be in the range [0,%s).",
+                                  Poco::NumberFormatter::format(channel),
+                                  Poco::NumberFormatter::format(_numChannels)));
+                }
+            }
+
+            static const Pothos::DType inDType(typeid(InType));
+            static const Pothos::DType outDType(typeid(OutType));
+
+            this->setupInput(0, inDType, _domain);
+            this->input(0)->setReserve(_numChannels);
+
+            // Name the ports by channel so a subset is still unambiguous.
+            for(size_t channel: _channels)
+            {
+                this->setupOutput(std::to_string(channel), outDType, _domain);
+            }
+
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, numChannels));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, channels));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, taps));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, setTaps));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, waitTaps));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, setWaitTaps));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, uploadingTaps));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, resetState));
+
+            this->registerProbe("taps");
+
+            this->setTaps(_taps);
+        }
+
+        virtual ~ChannelizerBlock() = default;
+
+        void activate() override
+        {
+            // Prewarming needs taps.
+            this->_applyStagedTaps(true);
+
+            ArrayFireBlock::activate();
+
+            _waitTapsArmed = _waitTaps;
+        }
+
+        size_t numChannels() const
+        {
+            return _numChannels;
+        }
+
+        std::vector<size_t> channels() const
+        {
+            return _channels;
+        }
+
+        std::vector<TapType> taps() const
+        {
+            return _taps;
+        }
+
+        void setTaps(const std::vector<TapType>& taps)
+        {
+            if(taps.empty())
+            {
+                throw Pothos::InvalidArgumentException("Taps cannot be empty.");
+            }
+
+            const size_t phaseLength = (taps.size() + _numChannels - 1) / _numChannels;
+
+            // h[r+pN] is already column-major for an (N x P) matrix.
+            auto paddedTaps = taps;
+            paddedTaps.resize(phaseLength * _numChannels, TapType(0));
+
+            _taps = taps;
+            _stagedTaps.stage([this, paddedTaps, phaseLength]()
+                              {
+                                  this->configArrayFire();
+                                  return af::moddims(
+                                             Pothos::Object(paddedTaps).convert<af::array>(),
+                                             static_cast<dim_t>(_numChannels),
+                                             static_cast<dim_t>(phaseLength)).as(_afInputDType);
+                              });
+        }
+
+        bool waitTaps() const
+        {
+            return _waitTaps;
+        }
+
+        void setWaitTaps(bool waitTaps)
+        {
+            _waitTaps = waitTaps;
+        }
+
+        bool uploadingTaps() const
+        {
+            return _stagedTaps.isUploading();
+        }
+
+        void resetState() override
+        {
+            if(_phaseLength > 1)
+            {
+                this->configArrayFire();
+
+                _afHistory = af::constant(
+                                 0,
+                                 static_cast<dim_t>((_phaseLength - 1) * _numChannels),
+                                 _afInputDType);
+            }
+        }
+
+        void work() override
+        {
+            WorkTimer workTimer(this);
+
+            // If specified, don't do anything until taps are explicitly set
+            // and uploaded.
+            const bool hasNewTaps = this->_applyStagedTaps(false);
+            if(_waitTapsArmed && !hasNewTaps) return;
+            _waitTapsArmed = false;
+
+            const auto& workInfo = this->workInfo();
+            const size_t numFrames = std::min(
+                                         workInfo.minInElements / _numChannels,
+                                         workInfo.minOutElements);
+            if(0 == numFrames) return;
+
+            this->configArrayFire();
+
+            auto afInput = this->getInputElementsAsAfArray(0, numFrames * _numChannels);
+            auto afOutput = _channelize(afInput);
+
+            // Only download the channels we were asked for.
+            for(size_t portIndex = 0; portIndex < _channels.size(); ++portIndex)
+            {
+                this->produceFromAfArray(
+                    std::to_string(_channels[portIndex]),
+                    af::flat(afOutput.row(static_cast<int>(_channels[portIndex]))));
+            }
+        }
+
+    protected:
+
+        void prewarmKernels() override
+        {
+            const auto& dtype = this->input(0)->dtype();
+            const dim_t numFrames = std::max<dim_t>(
+                                        1,
+                                        this->getPrewarmElements(dtype) / static_cast<dim_t>(_numChannels));
+
+            this->resetState();
+            _channelize(af::constant(
+                            0,
+                            numFrames * static_cast<dim_t>(_numChannels),
+                            _afInputDType)).eval();
+        }
+
+    private:
+        af::dtype _afInputDType;
+        af::dtype _afOutputDType;
+
+        size_t _numChannels;
+        std::vector<size_t> _channels;
+
+        std::vector<TapType> _taps;
+        bool _waitTaps;
+        bool _waitTapsArmed;
+
+        StagedCoeffs<af::array> _stagedTaps;
+        size_t _phaseLength;
+        af::array _afTapMatrix;
+        af::array _afWindowIndices;
+
+        // The last (P-1)N inputs, oldest first
+        af::array _afHistory;
+
+        // On activation, waits for any upload in progress.
+        bool _applyStagedTaps(bool isActivating)
+        {
+            af::array afTapMatrix;
+            if(!_stagedTaps.take(afTapMatrix, isActivating)) return false;
+
+            _afTapMatrix = afTapMatrix;
+
+            // The history no longer lines up with the taps.
+            const size_t phaseLength = static_cast<size_t>(_afTapMatrix.dims(1));
+            if(phaseLength != _phaseLength)
+            {
+                _phaseLength = phaseLength;
+
+                this->configArrayFire();
+
+                const dim_t numChannelsDim = static_cast<dim_t>(_numChannels);
+                const dim_t phaseLengthDim = static_cast<dim_t>(_phaseLength);
+
+                // The window of the first frame, relative to the start of
+                // the history
+                _afWindowIndices = static_cast<long long>((_phaseLength * _numChannels) - 1)
+                                 - af::range(af::dim4(numChannelsDim, phaseLengthDim), 0, ::s64)
+                                 - (af::range(af::dim4(numChannelsDim, phaseLengthDim), 1, ::s64) * static_cast<long long>(_numChannels));
+
+                this->resetState();
+            }
+
+            return true;
+        }
+
+        // Returns one row per channel, one column per frame.
+        af::array _channelize(const af::array& afInput)
+        {
+            const dim_t numChannels = static_cast<dim_t>(_numChannels);
+            const dim_t phaseLength = static_cast<dim_t>(_phaseLength);
+            const dim_t numFrames = afInput.elements() / numChannels;
+            const dim_t historyLength = (phaseLength - 1) * numChannels;
+
+            auto afExtended = (historyLength > 0) ? af::join(0, _afHistory, afInput)
+                                                  : afInput;
+
+            auto afFrameOffsets = af::range(af::dim4(1, 1, numFrames), 2, ::s64) * static_cast<long long>(_numChannels);
+            auto afIndices = af::tile(_afWindowIndices, 1, 1, static_cast<unsigned>(numFrames))
+                           + af::tile(afFrameOffsets, static_cast<unsigned>(numChannels), static_cast<unsigned>(phaseLength));
+
+            auto afWindows = af::moddims(
+                                 afExtended(af::flat(afIndices)),
+                                 numChannels,
+                                 phaseLength,
+                                 numFrames);
+            auto afPolyphaseSums = af::moddims(
+                                       af::sum(afWindows * af::tile(_afTapMatrix, 1, 1, static_cast<unsigned>(numFrames)), 1),
+                                       numChannels,
+                                       numFrames);
+
+            if(historyLength > 0)
+            {
+                const dim_t extendedLength = afExtended.elements();
+                _afHistory = afExtended(af::seq(
+                                            static_cast<double>(extendedLength - historyLength),
+                                            static_cast<double>(extendedLength - 1))).copy();
+            }
+
+            // Unnormalized, to match a bank of individual filters
+            recordFFTPlanUse(_afBackend, _afDevice, _afOutputDType, _afOutputDType, numChannels, numFrames);
+            return af::ifft(afPolyphaseSums.as(_afOutputDType), 1.0);
+        }
+};
+
+//
+// Factory
+//
+
+static Pothos::Block* makeChannelizer(
+    const std::string& device,
+    const Pothos::DType& dtype,
+    size_t numChannels,
+    const std::vector<size_t>& channels)
+{
+    if(1 != dtype.dimension())
+    {
+        throw Pothos::InvalidArgumentException(
+                  "This block does not support multi-dimensional types.",
+                  dtype.toString());
+    }
+
+    #define ifTypeDeclareFactory(T, Real) \
+        if(Pothos::DType::fromDType(dtype, 1) == Pothos::DType(typeid(T))) \
+            return new ChannelizerBlock<T, Real>(device, numChannels, channels);
+
+    ifTypeDeclareFactory(float, float)
+    ifTypeDeclareFactory(double, double)
+    ifTypeDeclareFactory(std::complex<float>, float)
+    ifTypeDeclareFactory(std::complex<double>, double)
+    #undef ifTypeDeclareFactory
+
+    throw Pothos::InvalidArgumentException(
+              "Unsupported type.",
+              dtype.name());
+}
+
+//
+// Block registration
+//
+
+/*
+ * |PothosDoc Polyphase Channelizer (GPU)
+ *
+ * Splits the input stream into <b>N</b> evenly spaced channels using a
+ * polyphase filter bank followed by a batched FFT. Channel <b>k</b> is
+ * centered at <b>k/N</b> of the input sample rate, and each channel's output
+ * is decimated by <b>N</b>.
+ *
+ * The prototype filter taps are given at the input sample rate, and should
+ * typically be a lowpass filter with a cutoff of <b>1/(2N)</b> of the sample
+ * rate. The filter state is carried across buffers, and <b>"resetState"</b>
+ * clears it. New taps are uploaded in the background and take effect at the
+ * start of the first buffer after the upload finishes.
+ *
+ * By default, there is one output port per channel. If <b>channels</b> is
+ * given, only those channels have output ports, and only those channels
+ * are copied back from the device. Output ports are named by their channel
+ * index.
+ *
+ * |category /GPU/Signal
+ * |keywords array tap taps fir fft polyphase channelizer filterbank pfb
+ * |factory /gpu/signal/channelizer(device,dtype,numChannels,channels)
+ * |setter setTaps(taps)
+ * |setter setWaitTaps(waitTaps)
+ *
+ * |param device[Device] Device to use for processing.
+ * |default "Auto"
+ *
+ * |param dtype[Data Type] The input's data type. Outputs are complex with
+ * the same precision.
+ * |widget DTypeChooser(float=1,cfloat=1)
+ * |default "complex_float32"
+ * |preview disable
+ *
+ * |param numChannels[Num Channels] The number of channels <b>N</b>, and
+ * the size of each FFT.
+ * |widget SpinBox(minimum=1)
+ * |default 8
+ * |preview enable
+ *
+ * |param channels[Channels] The channels to output. If empty, all channels
+ * are output.
+ * |widget LineEdit()
+ * |default []
+ * |preview enable
+ *
+ * |param taps[Taps] The prototype filter taps.
+ * |widget LineEdit()
+ * |default [1.0]
+ * |preview enable
+ *
+ * |param waitTaps[Wait Taps] Wait for the taps to be set before allowing operation.
+ * Use this mode when taps are set exclusively at runtime by the setTaps() slot.
+ * |widget ToggleSwitch(on="True", off="False")
+ * |default false
+ * |preview disable
+ */
+static Pothos::BlockRegistry registerChannelizer(
+    "/gpu/signal/channelizer",
+    Pothos::Callable(&makeChannelizer));
@@ -115,6 +115,8 @@ const Pothos::DType Clamp<T>::dtype = Pothos::DType(typeid(T));
 template <typename T>
 void Clamp<T>::work()
 {
+    WorkTimer workTimer(this);
+
     const auto elems = this->workInfo().minElements;
     if(0 == elems)
     {
@@ -134,6 +136,8 @@ void Clamp<T>::work()
 template <>
 void Clamp<double>::work()
 {
+    WorkTimer workTimer(this);
+
     const auto elems = this->workInfo().minElements;
     if(0 == elems)
     {
@@ -51,6 +51,8 @@ class CombineComplex: public ArrayFireBlock
 
         void work() override
         {
+            WorkTimer workTimer(this);
+
             const size_t elems = this->workInfo().minAllElements;
             if(0 == elems)
             {
@@ -95,6 +97,8 @@ class SplitComplex: public ArrayFireBlock
 
         void work() override
         {
+            WorkTimer workTimer(this);
+
             const size_t elems = this->workInfo().minAllElements;
             if(0 == elems)
             {
@@ -138,6 +142,8 @@ class PolarToComplex: public ArrayFireBlock
 
         void work() override
         {
+            WorkTimer workTimer(this);
+
             const size_t elems = this->workInfo().minAllElements;
             if(0 == elems)
             {
@@ -182,6 +188,8 @@ class ComplexToPolar: public ArrayFireBlock
 
         void work() override
         {
+            WorkTimer workTimer(this);
+
             const size_t elems = this->workInfo().minAllElements;
             if(0 == elems)
             {
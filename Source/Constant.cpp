@@ -44,6 +44,8 @@ class Constant: public ArrayFireBlock
 
         void work() override
         {
+            WorkTimer workTimer(this);
+
             const auto elems = this->workInfo().minElements;
             if(0 == elems)
             {
@@ -1,7 +1,10 @@
-// Copyright (c) 2019-2020 Nicholas Corgan
+// Copyright (c) 2019-2021 Nicholas Corgan
 // SPDX-License-Identifier: BSD-3-Clause
 
+#include "ArrayFireBlock.hpp"
+#include "FFTPlanCache.hpp"
 #include "OneToOneBlock.hpp"
+#include "StagedCoeffs.hpp"
 #include "Utility.hpp"
 
 #include <Pothos/Exception.hpp>
@@ -10,6 +13,8 @@
 
 #include <arrayfire.h>
 
+#include <algorithm>
+#include <complex>
 #include <string>
 #include <vector>
 
@@ -23,6 +28,11 @@ using FFTConvolveFuncPtr = af::array(*)(
 // Block classes
 //
 
+/*
+ * New taps are staged and swapped in at the next buffer boundary. If a
+ * crossfade length is set, the outputs of the old and new taps are blended
+ * over that many samples after the swap.
+ */
 template <typename T>
 class ConvolveBaseBlock: public OneToOneBlock
 {
@@ -44,7 +54,9 @@ class ConvolveBaseBlock: public OneToOneBlock
             _taps({T(1.0)}),
             _convMode(::AF_CONV_DEFAULT),
             _waitTaps(false),
-            _waitTapsArmed(false)
+            _waitTapsArmed(false),
+            _dtypeDim(dtypeDim),
+            _stagedTaps(_afBackend, _afDevice)
         {
             this->registerCall(this, POTHOS_FCN_TUPLE(Class, taps));
             this->registerCall(this, POTHOS_FCN_TUPLE(Class, setTaps));
@@ -52,6 +64,9 @@ class ConvolveBaseBlock: public OneToOneBlock
             this->registerCall(this, POTHOS_FCN_TUPLE(Class, setMode));
             this->registerCall(this, POTHOS_FCN_TUPLE(Class, waitTaps));
             this->registerCall(this, POTHOS_FCN_TUPLE(Class, setWaitTaps));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, uploadingTaps));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, crossfadeLength));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, setCrossfadeLength));
 
             this->registerProbe("taps");
             this->registerProbe("mode");
@@ -67,6 +82,9 @@ class ConvolveBaseBlock: public OneToOneBlock
 
         void activate() override
         {
+            // Prewarming needs taps, and there's nothing to fade from yet.
+            this->_applyStagedTaps(true);
+
             ArrayFireBlock::activate();
 
             _waitTapsArmed = _waitTaps;
@@ -85,8 +103,11 @@ class ConvolveBaseBlock: public OneToOneBlock
             }
 
             _taps = taps;
-            _func.bind(Pothos::Object(_taps).convert<af::array>(), 1);
-            _waitTapsArmed = false; // We have taps
+            _stagedTaps.stage([this, taps]()
+                              {
+                                  this->configArrayFire();
+                                  return Pothos::Object(taps).convert<af::array>();
+                              });
         }
 
         std::string mode() const
@@ -112,12 +133,51 @@ class ConvolveBaseBlock: public OneToOneBlock
             _waitTaps = waitTaps;
         }
 
+        bool uploadingTaps() const
+        {
+            return _stagedTaps.isUploading();
+        }
+
+        size_t crossfadeLength() const
+        {
+            return _crossfader.length();
+        }
+
+        void setCrossfadeLength(size_t crossfadeLength)
+        {
+            _crossfader.setLength(crossfadeLength);
+        }
+
         void work() override
         {
-            // If specified, don't do anything until taps are explicitly set.
-            if(_waitTapsArmed) return;
+            WorkTimer workTimer(this);
+
+            // If specified, don't do anything until taps are explicitly set
+            // and uploaded.
+            const bool hasNewTaps = this->_applyStagedTaps(false);
+            if(_waitTapsArmed && !hasNewTaps) return;
+            _waitTapsArmed = false;
 
-            OneToOneBlock::work();
+            if(!_crossfader.active())
+            {
+                OneToOneBlock::work();
+                return;
+            }
+
+            if(0 == this->workInfo().minElements) return;
+
+            this->configArrayFire();
+
+            auto afInput = this->getInputPortAsAfArray(0);
+
+            _func.bind(_afPrevTaps, 1);
+            auto afOldOutput = _func.call(afInput).extract<af::array>();
+            _func.bind(_afTaps, 1);
+            auto afNewOutput = _func.call(afInput).extract<af::array>();
+
+            this->produceFromAfArray(
+                0,
+                _crossfader.apply(afOldOutput, afNewOutput, _dtypeDim).as(_afOutputDType));
         }
 
     private:
@@ -125,6 +185,30 @@ class ConvolveBaseBlock: public OneToOneBlock
         af::convMode _convMode;
         bool _waitTaps;
         bool _waitTapsArmed;
+        size_t _dtypeDim;
+
+        StagedCoeffs<af::array> _stagedTaps;
+        af::array _afTaps;
+        af::array _afPrevTaps;
+        Crossfader _crossfader;
+
+        // On activation, waits for any upload in progress.
+        bool _applyStagedTaps(bool isActivating)
+        {
+            af::array afTaps;
+            if(!_stagedTaps.take(afTaps, isActivating)) return false;
+
+            if(!isActivating && (_afTaps.elements() > 0) && (_crossfader.length() > 0))
+            {
+                _afPrevTaps = _afTaps;
+                _crossfader.start();
+            }
+
+            _afTaps = afTaps;
+            _func.bind(_afTaps, 1);
+
+            return true;
+        }
 };
 
 template <typename T>
@@ -172,6 +256,307 @@ class ConvolveBlock: public ConvolveBaseBlock<T>
 template <typename T>
 using FFTConvolveBlock = ConvolveBaseBlock<T>;
 
+/*
+ * Uniformly partitioned overlap-save convolution. The taps are split into P
+ * partitions of B taps, each stored as a 2B-point spectrum. Each block of B
+ * inputs is transformed along with the B inputs before it, and the spectra
+ * of the last P blocks form a frequency-domain delay line, so output block
+ * k is the last B samples of:
+ *
+ *   IFFT(sum_p H_p X_(k-p))
+ *
+ * Every block in a buffer is transformed in one batched FFT, and the delay
+ * line is gathered into a (2B x P) window per block, so a buffer is one
+ * forward FFT, one multiply-accumulate, and one inverse FFT regardless of
+ * how many blocks it holds.
+ *
+ * New taps, along with their partition spectra, are staged and swapped in
+ * at the next buffer boundary. If the number of partitions changed, the
+ * delay line is reset along with them.
+ */
+template <typename T, typename Real>
+class PartitionedConvolveBlock: public ArrayFireBlock
+{
+    public:
+        using Type = T;
+        using ComplexType = std::complex<Real>;
+        using Class = PartitionedConvolveBlock<T, Real>;
+        using TapType = typename Tap<T>::Type;
+
+        PartitionedConvolveBlock(
+            const std::string& device,
+            size_t blockSize
+        ):
+            ArrayFireBlock(device),
+            _afDType(Pothos::Object(Pothos::DType(typeid(Type))).convert<af::dtype>()),
+            _afComplexDType(Pothos::Object(Pothos::DType(typeid(ComplexType))).convert<af::dtype>()),
+            _blockSize(blockSize),
+            _taps({TapType(1.0)}),
+            _waitTaps(false),
+            _waitTapsArmed(false),
+            _stagedTaps(_afBackend, _afDevice),
+            _numPartitions(0)
+        {
+            if(0 == _blockSize)
+            {
+                throw Pothos::InvalidArgumentException("Block size must be non-zero.");
+            }
+
+            static const Pothos::DType dtype(typeid(Type));
+
+            this->setupInput(0, dtype, _domain);
+            this->setupOutput(0, dtype, _domain);
+            this->input(0)->setReserve(_blockSize);
+
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, blockSize));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, numPartitions));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, taps));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, setTaps));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, waitTaps));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, setWaitTaps));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, uploadingTaps));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, resetState));
+
+            this->registerProbe("taps");
+
+            this->setTaps(_taps);
+        }
+
+        virtual ~PartitionedConvolveBlock() = default;
+
+        void activate() override
+        {
+            // Prewarming needs taps.
+            this->_applyStagedTaps(true);
+
+            ArrayFireBlock::activate();
+
+            _waitTapsArmed = _waitTaps;
+        }
+
+        size_t blockSize() const
+        {
+            return _blockSize;
+        }
+
+        // For the current taps, which may still be uploading
+        size_t numPartitions() const
+        {
+            return (_taps.size() + _blockSize - 1) / _blockSize;
+        }
+
+        std::vector<TapType> taps() const
+        {
+            return _taps;
+        }
+
+        void setTaps(const std::vector<TapType>& taps)
+        {
+            if(taps.empty())
+            {
+                throw Pothos::InvalidArgumentException("Taps cannot be empty.");
+            }
+
+            _taps = taps;
+
+            const size_t numPartitions = this->numPartitions();
+
+            // h[b+pB] is already column-major for a (B x P) matrix.
+            auto paddedTaps = taps;
+            paddedTaps.resize(numPartitions * _blockSize, TapType(0));
+
+            // The partition spectra are computed along with the upload.
+            _stagedTaps.stage([this, paddedTaps, numPartitions]()
+                              {
+                                  this->configArrayFire();
+
+                                  recordFFTPlanUse(
+                                      _afBackend,
+                                      _afDevice,
+                                      _afComplexDType,
+                                      _afComplexDType,
+                                      static_cast<dim_t>(2 * _blockSize),
+                                      static_cast<dim_t>(numPartitions));
+                                  return af::fft(
+                                             af::moddims(
+                                                 Pothos::Object(paddedTaps).convert<af::array>(),
+                                                 static_cast<dim_t>(_blockSize),
+                                                 static_cast<dim_t>(numPartitions)).as(_afComplexDType),
+                                             static_cast<dim_t>(2 * _blockSize));
+                              });
+        }
+
+        bool waitTaps() const
+        {
+            return _waitTaps;
+        }
+
+        void setWaitTaps(bool waitTaps)
+        {
+            _waitTaps = waitTaps;
+        }
+
+        bool uploadingTaps() const
+        {
+            return _stagedTaps.isUploading();
+        }
+
+        void resetState() override
+        {
+            this->configArrayFire();
+
+            _afHistory = af::constant(0, static_cast<dim_t>(_blockSize), _afDType);
+            if(_numPartitions > 1)
+            {
+                _afDelayLine = af::constant(
+                                   0,
+                                   static_cast<dim_t>(2 * _blockSize),
+                                   static_cast<dim_t>(_numPartitions - 1),
+                                   _afComplexDType);
+            }
+        }
+
+        void work() override
+        {
+            WorkTimer workTimer(this);
+
+            // If specified, don't do anything until taps are explicitly set
+            // and uploaded.
+            const bool hasNewTaps = this->_applyStagedTaps(false);
+            if(_waitTapsArmed && !hasNewTaps) return;
+            _waitTapsArmed = false;
+
+            const auto& workInfo = this->workInfo();
+            const size_t numBlocks = std::min(workInfo.minInElements, workInfo.minOutElements) / _blockSize;
+            if(0 == numBlocks) return;
+
+            this->configArrayFire();
+
+            auto afInput = this->getInputElementsAsAfArray(0, numBlocks * _blockSize);
+            this->produceFromAfArray(0, _convolve(afInput));
+        }
+
+    protected:
+
+        void prewarmKernels() override
+        {
+            const auto& dtype = this->input(0)->dtype();
+            const dim_t numBlocks = std::max<dim_t>(
+                                        1,
+                                        this->getPrewarmElements(dtype) / static_cast<dim_t>(_blockSize));
+
+            this->resetState();
+            _convolve(af::constant(
+                          0,
+                          numBlocks * static_cast<dim_t>(_blockSize),
+                          _afDType)).eval();
+        }
+
+    private:
+        af::dtype _afDType;
+        af::dtype _afComplexDType;
+
+        size_t _blockSize;
+
+        std::vector<TapType> _taps;
+        bool _waitTaps;
+        bool _waitTapsArmed;
+
+        StagedCoeffs<af::array> _stagedTaps;
+
+        // For the taps in use
+        size_t _numPartitions;
+
+        // One 2B-point spectrum per partition
+        af::array _afPartitionSpectra;
+
+        // The last B inputs
+        af::array _afHistory;
+
+        // The spectra of the last (P-1) blocks, oldest first
+        af::array _afDelayLine;
+
+        // On activation, waits for any upload in progress.
+        bool _applyStagedTaps(bool isActivating)
+        {
+            af::array afPartitionSpectra;
+            if(!_stagedTaps.take(afPartitionSpectra, isActivating)) return false;
+
+            _afPartitionSpectra = afPartitionSpectra;
+
+            // The delay line no longer lines up with the taps.
+            const size_t numPartitions = static_cast<size_t>(_afPartitionSpectra.dims(1));
+            if(numPartitions != _numPartitions)
+            {
+                _numPartitions = numPartitions;
+                this->resetState();
+            }
+
+            return true;
+        }
+
+        af::array _convolve(const af::array& afInput)
+        {
+            const dim_t blockSize = static_cast<dim_t>(_blockSize);
+            const dim_t fftLength = 2 * blockSize;
+            const dim_t numPartitions = static_cast<dim_t>(_numPartitions);
+            const dim_t numBlocks = afInput.elements() / blockSize;
+
+            auto afExtended = af::join(0, _afHistory, afInput);
+
+            // Each block, along with the block before it
+            auto afWindowIndices = af::tile(af::range(af::dim4(fftLength), 0, ::s64), 1, static_cast<unsigned>(numBlocks))
+                                 + (af::tile(af::range(af::dim4(1, numBlocks), 1, ::s64), static_cast<unsigned>(fftLength))
+                                    * static_cast<long long>(_blockSize));
+            recordFFTPlanUse(_afBackend, _afDevice, _afComplexDType, _afComplexDType, fftLength, numBlocks);
+            auto afSpectra = af::fft(
+                                 af::moddims(
+                                     afExtended(af::flat(afWindowIndices)),
+                                     fftLength,
+                                     numBlocks).as(_afComplexDType));
+            if(numPartitions > 1)
+            {
+                afSpectra = af::join(1, _afDelayLine, afSpectra);
+            }
+
+            // Block k needs the spectra of blocks k through (k-P+1), which
+            // are columns (P-1+k) through k of the extended delay line.
+            auto afSpectrumIndices = af::tile(af::range(af::dim4(1, numBlocks), 1, ::s64), static_cast<unsigned>(numPartitions))
+                                   + static_cast<long long>(numPartitions - 1)
+                                   - af::tile(af::range(af::dim4(numPartitions), 0, ::s64), 1, static_cast<unsigned>(numBlocks));
+            auto afDelayedSpectra = af::moddims(
+                                        afSpectra(af::span, af::flat(afSpectrumIndices)),
+                                        fftLength,
+                                        numPartitions,
+                                        numBlocks);
+            auto afOutputSpectra = af::moddims(
+                                       af::sum(afDelayedSpectra * af::tile(_afPartitionSpectra, 1, 1, static_cast<unsigned>(numBlocks)), 1),
+                                       fftLength,
+                                       numBlocks);
+
+            // The first half of each block's output wraps around, so it's discarded.
+            auto afOutput = af::flat(af::ifft(afOutputSpectra)(
+                                         af::seq(static_cast<double>(blockSize), static_cast<double>(fftLength - 1)),
+                                         af::span));
+
+            const dim_t extendedLength = afExtended.elements();
+            _afHistory = afExtended(af::seq(
+                                        static_cast<double>(extendedLength - blockSize),
+                                        static_cast<double>(extendedLength - 1))).copy();
+            if(numPartitions > 1)
+            {
+                const dim_t numSpectra = afSpectra.dims(1);
+                _afDelayLine = afSpectra(
+                                   af::span,
+                                   af::seq(
+                                       static_cast<double>(numSpectra - numPartitions + 1),
+                                       static_cast<double>(numSpectra - 1))).copy();
+            }
+
+            return IsComplex<Type>::value ? afOutput : af::real(afOutput).as(_afDType);
+        }
+};
+
 //
 // Factories
 //
@@ -230,6 +615,33 @@ static Pothos::Block* makeFFTConvolve(
               dtype.name());
 }
 
+static Pothos::Block* makePartitionedConvolve(
+    const std::string& device,
+    const Pothos::DType& dtype,
+    size_t blockSize)
+{
+    if(1 != dtype.dimension())
+    {
+        throw Pothos::InvalidArgumentException(
+                  "This block does not support multi-dimensional types.",
+                  dtype.toString());
+    }
+
+    #define ifTypeDeclareFactory(T, Real) \
+        if(Pothos::DType::fromDType(dtype, 1) == Pothos::DType(typeid(T))) \
+            return new PartitionedConvolveBlock<T, Real>(device, blockSize);
+
+    ifTypeDeclareFactory(float, float)
+    ifTypeDeclareFactory(double, double)
+    ifTypeDeclareFactory(std::complex<float>, float)
+    ifTypeDeclareFactory(std::complex<double>, double)
+    #undef ifTypeDeclareFactory
+
+    throw Pothos::InvalidArgumentException(
+              "Unsupported type.",
+              dtype.name());
+}
+
 //
 // Block registries
 //
@@ -241,6 +653,10 @@ static Pothos::Block* makeFFTConvolve(
  * taps. The taps can be set at runtime by connecting the output of a FIR Designer
  * block to <b>"setTaps"</b>.
  *
+ * New taps are uploaded in the background and take effect at the start of
+ * the first buffer after the upload finishes. They can optionally be
+ * crossfaded in to avoid discontinuities in the output.
+ *
  * |category /GPU/Signal
  * |keywords array tap taps convolution
  * |factory /gpu/signal/convolve(device,dtype)
@@ -248,6 +664,7 @@ static Pothos::Block* makeFFTConvolve(
  * |setter setMode(mode)
  * |setter setDomain(domain)
  * |setter setWaitTaps(waitTaps)
+ * |setter setCrossfadeLength(crossfadeLength)
  *
  * |param device[Device] Device to use for processing.
  * |default "Auto"
@@ -291,6 +708,13 @@ static Pothos::Block* makeFFTConvolve(
  * |widget ToggleSwitch(on="True", off="False")
  * |default false
  * |preview disable
+ *
+ * |param crossfadeLength[Crossfade Length] When the taps change, blend
+ * from the old taps' output to the new taps' output over this many samples.
+ * If zero, the new taps take effect immediately.
+ * |widget SpinBox(minimum=0)
+ * |default 0
+ * |preview disable
  */
 static Pothos::BlockRegistry registerConvolve(
     "/gpu/signal/convolve",
@@ -303,12 +727,17 @@ static Pothos::BlockRegistry registerConvolve(
  * taps using an FFT. The taps can be set at runtime by connecting the output of a FIR Designer
  * block to <b>"setTaps"</b>.
  *
+ * New taps are uploaded in the background and take effect at the start of
+ * the first buffer after the upload finishes. They can optionally be
+ * crossfaded in to avoid discontinuities in the output.
+ *
  * |category /GPU/Signal
  * |keywords array tap taps convolution
  * |factory /gpu/signal/fftconvolve(device,dtype)
  * |setter setTaps(taps)
  * |setter setMode(mode)
  * |setter setWaitTaps(waitTaps)
+ * |setter setCrossfadeLength(crossfadeLength)
  *
  * |param device[Device] Device to use for processing.
  * |default "Auto"
@@ -339,7 +768,69 @@ static Pothos::BlockRegistry registerConvolve(
  * |widget ToggleSwitch(on="True", off="False")
  * |default false
  * |preview disable
+ *
+ * |param crossfadeLength[Crossfade Length] When the taps change, blend
+ * from the old taps' output to the new taps' output over this many samples.
+ * If zero, the new taps take effect immediately.
+ * |widget SpinBox(minimum=0)
+ * |default 0
+ * |preview disable
  */
 static Pothos::BlockRegistry registerFFTConvolve(
     "/gpu/signal/fftconvolve",
     Pothos::Callable(&makeFFTConvolve));
+
+/*
+ * |PothosDoc Partitioned Convolve (GPU)
+ *
+ * Convolves the input stream with user-provided filter taps using uniformly
+ * partitioned overlap-save convolution, intended for very long impulse
+ * responses.
+ *
+ * The taps are split into partitions of <b>blockSize</b> taps, and the
+ * spectra of past input blocks are kept in a frequency-domain delay line on
+ * the device. Output is produced in blocks of <b>blockSize</b> samples, so
+ * latency depends on the block size rather than the number of taps, while
+ * the cost per sample is that of a <b>2*blockSize</b>-point FFT plus one
+ * complex multiply-accumulate per partition per bin.
+ *
+ * Unlike <b>/gpu/signal/convolve</b>, the filter state is carried across
+ * buffers, so the output is the continuous convolution of the input stream.
+ * <b>"resetState"</b> clears it. New taps are uploaded in the background
+ * and take effect at the start of the first buffer after the upload
+ * finishes.
+ *
+ * |category /GPU/Signal
+ * |keywords array tap taps convolution fft partitioned overlap save fdl reverb
+ * |factory /gpu/signal/partitioned_convolve(device,dtype,blockSize)
+ * |setter setTaps(taps)
+ * |setter setWaitTaps(waitTaps)
+ *
+ * |param device[Device] Device to use for processing.
+ * |default "Auto"
+ *
+ * |param dtype[Data Type] The output's data type.
+ * |widget DTypeChooser(float=1,cfloat=1)
+ * |default "complex_float32"
+ * |preview disable
+ *
+ * |param blockSize[Block Size] The number of samples per block, and the
+ * number of taps per partition.
+ * |widget SpinBox(minimum=1)
+ * |default 1024
+ * |preview enable
+ *
+ * |param taps[Taps] The filter taps used in convolution.
+ * |widget LineEdit()
+ * |default [1.0]
+ * |preview enable
+ *
+ * |param waitTaps[Wait Taps] Wait for the taps to be set before allowing operation.
+ * Use this mode when taps are set exclusively at runtime by the setTaps() slot.
+ * |widget ToggleSwitch(on="True", off="False")
+ * |default false
+ * |preview disable
+ */
+static Pothos::BlockRegistry registerPartitionedConvolve(
+    "/gpu/signal/partitioned_convolve",
+    Pothos::Callable(&makePartitionedConvolve));
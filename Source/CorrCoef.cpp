@@ -41,6 +41,8 @@ class CorrCoefBlock: public ArrayFireBlock
 
         void work() override
         {
+            WorkTimer workTimer(this);
+
             const auto elems = this->workInfo().minAllElements;
             if(0 == elems)
             {
@@ -1,4 +1,4 @@
-// Copyright (c) 2020 Nicholas Corgan
+// Copyright (c) 2020-2021 Nicholas Corgan
 // SPDX-License-Identifier: BSD-3-Clause
 
 #include "ArrayFireBlock.hpp"
@@ -10,6 +10,10 @@
 
 #include <arrayfire.h>
 
+#include <algorithm>
+#include <complex>
+#include <vector>
+
 class CovarianceBlock: public ArrayFireBlock
 {
     public:
@@ -50,6 +54,8 @@ class CovarianceBlock: public ArrayFireBlock
 
         void work() override
         {
+            WorkTimer workTimer(this);
+
             const auto elems = this->workInfo().minAllElements;
             if(0 == elems)
             {
@@ -106,6 +112,258 @@ class CovarianceBlock: public ArrayFireBlock
 #endif
 };
 
+/*
+ * The channels are gathered into the columns of one matrix A, whose rows
+ * are snapshots, so each buffer's contribution to the covariance matrix
+ * is the single product A^H A. That's the transpose of X X^H for X = A^T,
+ * which the emitted matrix is, and it's summed on the device until enough
+ * snapshots have gone in. Buffers are split where an estimate completes.
+ *
+ * The covariance matrix is Hermitian and positive semidefinite, so its
+ * SVD is its eigendecomposition, and af::svd is used since ArrayFire has
+ * no eigensolver.
+ */
+template <typename T, typename Real>
+class CovarianceMatrixBlock: public ArrayFireBlock
+{
+    public:
+        using Type = T;
+        using Class = CovarianceMatrixBlock<T, Real>;
+
+        CovarianceMatrixBlock(
+            const std::string& device,
+            size_t numChannels,
+            size_t numSnapshots
+        ):
+            ArrayFireBlock(device),
+            _afDType(Pothos::Object(Pothos::DType(typeid(Type))).convert<af::dtype>()),
+            _numChannels(numChannels),
+            _numSnapshots(0),
+            _eigenDecomposition(false),
+            _numPending(0)
+        {
+            if(_numChannels < 2)
+            {
+                throw Pothos::InvalidArgumentException(
+                          "The number of channels must be at least 2.",
+                          std::to_string(numChannels));
+            }
+
+            static const Pothos::DType dtype(typeid(Type));
+            for(size_t chan = 0; chan < _numChannels; ++chan)
+            {
+                this->setupInput(chan, dtype, _domain);
+            }
+            this->setupOutput(0);
+
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, numChannels));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, numSnapshots));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, setNumSnapshots));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, eigenDecomposition));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, setEigenDecomposition));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, lastMatrix));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, lastEigenvalues));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, resetState));
+
+            this->registerProbe("lastMatrix");
+            this->registerProbe("lastEigenvalues");
+
+            this->setNumSnapshots(numSnapshots);
+            this->resetState();
+        }
+
+        virtual ~CovarianceMatrixBlock() = default;
+
+        size_t numChannels() const
+        {
+            return _numChannels;
+        }
+
+        size_t numSnapshots() const
+        {
+            return _numSnapshots;
+        }
+
+        // Takes effect with the next estimate.
+        void setNumSnapshots(size_t numSnapshots)
+        {
+            if(0 == numSnapshots)
+            {
+                throw Pothos::RangeException("The number of snapshots must be non-zero.");
+            }
+
+            _numSnapshots = numSnapshots;
+        }
+
+        bool eigenDecomposition() const
+        {
+            return _eigenDecomposition;
+        }
+
+        void setEigenDecomposition(bool eigenDecomposition)
+        {
+            if(eigenDecomposition && !af::isLAPACKAvailable())
+            {
+                throw Pothos::NotImplementedException(
+                          "Eigendecomposition requires ArrayFire to be built with LAPACK support.");
+            }
+
+            _eigenDecomposition = eigenDecomposition;
+        }
+
+        // Column-major, empty until the first estimate
+        std::vector<Type> lastMatrix() const
+        {
+            if(_afLastMatrix.isempty()) return std::vector<Type>();
+
+            this->configArrayFire();
+
+            return afArrayToStdVector(_afLastMatrix).template convert<std::vector<Type>>();
+        }
+
+        // Descending, empty unless eigendecomposition is enabled
+        std::vector<Real> lastEigenvalues() const
+        {
+            return _lastEigenvalues;
+        }
+
+        void resetState() override
+        {
+            this->configArrayFire();
+
+            const dim_t numChans = static_cast<dim_t>(_numChannels);
+            _afSum = af::constant(0, numChans, numChans, _afDType);
+            _numPending = 0;
+        }
+
+        void work() override
+        {
+            WorkTimer workTimer(this);
+
+            const size_t elems = this->workInfo().minInElements;
+            if(0 == elems)
+            {
+                return;
+            }
+
+            this->configArrayFire();
+
+            af::array afSnapshots(
+                static_cast<dim_t>(elems),
+                static_cast<dim_t>(_numChannels),
+                _afDType);
+            for(size_t chan = 0; chan < _numChannels; ++chan)
+            {
+                afSnapshots(af::span, static_cast<dim_t>(chan)) = this->getInputElementsAsAfArray(chan, elems);
+            }
+
+            size_t offset = 0;
+            while(offset < elems)
+            {
+                const size_t segmentLength = std::min(_numSnapshots - _numPending, elems - offset);
+                _accumulate(afSnapshots.rows(
+                                static_cast<int>(offset),
+                                static_cast<int>(offset + segmentLength - 1)));
+
+                offset += segmentLength;
+                _numPending += segmentLength;
+
+                if(_numPending >= _numSnapshots) _emit();
+            }
+        }
+
+    protected:
+
+        void prewarmKernels() override
+        {
+            const auto& dtype = this->input(0)->dtype();
+            const dim_t numSnapshots = static_cast<dim_t>(this->getPrewarmElements(dtype));
+
+            this->resetState();
+            _accumulate(af::constant(1, numSnapshots, static_cast<dim_t>(_numChannels), _afDType));
+            _afSum.eval();
+
+            if(_eigenDecomposition)
+            {
+                af::array afU, afS, afVt;
+                af::svd(afU, afS, afVt, af::identity(_afSum.dims(), _afDType));
+                afU.eval();
+            }
+        }
+
+    private:
+        af::dtype _afDType;
+        size_t _numChannels;
+        size_t _numSnapshots;
+        bool _eigenDecomposition;
+
+        af::array _afSum;
+        size_t _numPending;
+
+        af::array _afLastMatrix;
+        std::vector<Real> _lastEigenvalues;
+
+        void _accumulate(const af::array& afSnapshots)
+        {
+            _afSum += af::matmul(afSnapshots, afSnapshots, AF_MAT_CTRANS, AF_MAT_NONE);
+        }
+
+        void _emit()
+        {
+            _afLastMatrix = af::transpose(_afSum) / static_cast<double>(_numPending);
+
+            Pothos::Packet packet;
+            packet.payload = Pothos::Object(_afLastMatrix).convert<Pothos::BufferChunk>();
+            packet.metadata["numChannels"] = Pothos::Object(_numChannels);
+            packet.metadata["numSnapshots"] = Pothos::Object(_numPending);
+
+            if(_eigenDecomposition)
+            {
+                af::array afEigenvectors, afEigenvalues, afVt;
+                af::svd(afEigenvectors, afEigenvalues, afVt, _afLastMatrix);
+
+                _lastEigenvalues = afArrayToStdVector(afEigenvalues).convert<std::vector<Real>>();
+                packet.metadata["eigenvalues"] = Pothos::Object(_lastEigenvalues);
+                packet.metadata["eigenvectors"] = Pothos::Object(afEigenvectors).convert<Pothos::BufferChunk>();
+            }
+            else _lastEigenvalues.clear();
+
+            this->output(0)->postMessage(std::move(packet));
+
+            const dim_t numChans = static_cast<dim_t>(_numChannels);
+            _afSum = af::constant(0, numChans, numChans, _afDType);
+            _numPending = 0;
+        }
+};
+
+static Pothos::Block* makeCovarianceMatrix(
+    const std::string& device,
+    const Pothos::DType& dtype,
+    size_t numChannels,
+    size_t numSnapshots)
+{
+    if(1 != dtype.dimension())
+    {
+        throw Pothos::InvalidArgumentException(
+                  "This block does not support multi-dimensional types.",
+                  dtype.toString());
+    }
+
+    #define ifTypeDeclareFactory(T, Real) \
+        if(Pothos::DType::fromDType(dtype, 1) == Pothos::DType(typeid(T))) \
+            return new CovarianceMatrixBlock<T, Real>(device, numChannels, numSnapshots);
+
+    ifTypeDeclareFactory(float, float)
+    ifTypeDeclareFactory(double, double)
+    ifTypeDeclareFactory(std::complex<float>, float)
+    ifTypeDeclareFactory(std::complex<double>, double)
+    #undef ifTypeDeclareFactory
+
+    throw Pothos::InvalidArgumentException(
+              "Unsupported type.",
+              dtype.name());
+}
+
 
 //
 // Block registries
@@ -137,3 +395,55 @@ class CovarianceBlock: public ArrayFireBlock
 static Pothos::BlockRegistry registerStatisticsCorrCoef(
     "/gpu/statistics/cov",
     Pothos::Callable(&CovarianceBlock::make));
+
+/*
+ * |PothosDoc Covariance Matrix (GPU)
+ *
+ * Estimates the spatial covariance matrix <b>R = X X<sup>H</sup> / K</b>
+ * of <b>numChannels</b> synchronized input channels, where each column of
+ * <b>X</b> is one snapshot (a sample from every channel) and <b>K</b> is
+ * <b>numSnapshots</b>. The inputs are assumed to be zero-mean. Each buffer
+ * is one matrix product on the device.
+ *
+ * Every <b>numSnapshots</b> snapshots, the estimate is posted as a packet,
+ * whose payload is the column-major <b>numChannels x numChannels</b>
+ * matrix. Its metadata holds <b>"numChannels"</b> and
+ * <b>"numSnapshots"</b>.
+ *
+ * With eigendecomposition enabled, the metadata also holds
+ * <b>"eigenvalues"</b>, in descending order, and <b>"eigenvectors"</b>,
+ * a column-major matrix whose columns are the matching eigenvectors,
+ * for subspace methods like MUSIC.
+ *
+ * |category /GPU/Statistics
+ * |keywords statistics stats covariance matrix spatial array beamforming music eigen subspace
+ * |factory /gpu/statistics/covariance_matrix(device,dtype,numChannels,numSnapshots)
+ * |setter setEigenDecomposition(eigenDecomposition)
+ *
+ * |param device[Device] Device to use for processing.
+ * |default "Auto"
+ *
+ * |param dtype[Data Type] The input data type.
+ * |widget DTypeChooser(float=1,cfloat=1)
+ * |default "complex_float32"
+ * |preview disable
+ *
+ * |param numChannels[Channels] The number of input channels.
+ * |widget SpinBox(minimum=2)
+ * |default 4
+ * |preview enable
+ *
+ * |param numSnapshots[Snapshots] The number of snapshots averaged per estimate.
+ * |widget SpinBox(minimum=1)
+ * |default 1024
+ * |preview enable
+ *
+ * |param eigenDecomposition[Eigendecomposition] Whether to also post the eigenvalues and eigenvectors.
+ * This requires ArrayFire to be built with LAPACK support.
+ * |widget ToggleSwitch(on="True",off="False")
+ * |default false
+ * |preview enable
+ */
+static Pothos::BlockRegistry registerStatisticsCovarianceMatrix(
+    "/gpu/statistics/covariance_matrix",
+    Pothos::Callable(&makeCovarianceMatrix));
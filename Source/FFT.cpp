@@ -1,22 +1,27 @@
-// Copyright (c) 2019-2020 Nicholas Corgan
+// Copyright (c) 2019-2021 Nicholas Corgan
 // SPDX-License-Identifier: BSD-3-Clause
 
 #include "ArrayFireBlock.hpp"
 #include "BufferConversions.hpp"
+#include "FFTPlanCache.hpp"
 #include "Utility.hpp"
 
 #include <Pothos/Callable.hpp>
 #include <Pothos/Framework.hpp>
 #include <Pothos/Object.hpp>
 
+#include <Poco/Format.h>
 #include <Poco/Logger.h>
+#include <Poco/NumberFormatter.h>
 
 #include <arrayfire.h>
 
 #include <cmath>
 #include <functional>
+#include <limits>
 #include <string>
 #include <typeinfo>
+#include <unordered_map>
 
 //
 // Misc
@@ -29,6 +34,22 @@ static inline bool isPowerOfTwo(size_t num)
 
 static const std::string fftBlockPath = "/gpu/signal/fft";
 
+enum class FFTOutputMode
+{
+    Complex,
+    Magnitude,
+    Power,
+    Decibels
+};
+
+static const std::unordered_map<std::string, FFTOutputMode> FFTOutputModeEnumMap =
+{
+    {"complex",   FFTOutputMode::Complex},
+    {"magnitude", FFTOutputMode::Magnitude},
+    {"power",     FFTOutputMode::Power},
+    {"dB",        FFTOutputMode::Decibels},
+};
+
 //
 // Block classes
 //
@@ -56,7 +77,11 @@ class FFTBlock: public ArrayFireBlock
             _func(func),
             _enforceNumBins(enforceNumBins),
             _numBins(numBins),
-            _norm(0.0) // Set with class setter
+            _norm(0.0), // Set with class setter
+            _nchans(dtypeDims),
+            _outputMode(FFTOutputMode::Complex),
+            _fftShift(false),
+            _planCacheMisses(0)
         {
             if(_enforceNumBins && !isPowerOfTwo(numBins))
             {
@@ -78,16 +103,12 @@ class FFTBlock: public ArrayFireBlock
             }
 
             static const Pothos::DType inDType(typeid(InType));
-            static const Pothos::DType outDType(typeid(OutType));
 
             this->setupInput(
                 0,
                 Pothos::DType::fromDType(inDType, dtypeDims),
                 _domain);
-            this->setupOutput(
-                0,
-                Pothos::DType::fromDType(outDType, dtypeDims),
-                _domain);
+            this->_setupOutputPort();
             if(_enforceNumBins)
             {
                 this->input(0)->setReserve(_numBins);
@@ -100,10 +121,43 @@ class FFTBlock: public ArrayFireBlock
 
             this->registerCall(this, POTHOS_FCN_TUPLE(Class, normalizationFactor));
             this->registerCall(this, POTHOS_FCN_TUPLE(Class, setNormalizationFactor));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, outputMode));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, setOutputMode));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, fftShift));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, setFFTShift));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, planCacheMisses));
+
+            this->registerProbe("planCacheMisses");
         }
 
         virtual ~FFTBlock() = default;
 
+        void activate() override
+        {
+            ArrayFireBlock::activate();
+
+            // Creating a plan can take much longer than using it, so do it
+            // now rather than in the first work() call. The inverse FFT's
+            // size depends on its input, so there's nothing to build ahead
+            // of time.
+            if(_enforceNumBins)
+            {
+                static const Pothos::DType inDType(typeid(InType));
+
+                this->configArrayFire();
+                _transform(af::constant(
+                               0,
+                               static_cast<dim_t>(_numBins * _nchans),
+                               Pothos::Object(inDType).convert<af::dtype>())).eval();
+                af::sync();
+            }
+        }
+
+        unsigned long long planCacheMisses() const
+        {
+            return _planCacheMisses;
+        }
+
         double normalizationFactor() const
         {
             return _norm;
@@ -116,6 +170,50 @@ class FFTBlock: public ArrayFireBlock
             this->emitSignal("normalizationFactorChanged", _norm);
         }
 
+        std::string outputMode() const
+        {
+            return getKeyForVal(FFTOutputModeEnumMap, _outputMode);
+        }
+
+        // The real output modes and shifting only make sense for a full
+        // forward spectrum.
+        void setOutputMode(const std::string& outputModeName)
+        {
+            const auto outputMode = getValForKey(FFTOutputModeEnumMap, outputModeName);
+            if((FFTOutputMode::Complex != outputMode) && (!_enforceNumBins || !IsComplex<OutType>::value))
+            {
+                throw Pothos::InvalidArgumentException(
+                          "Output mode "+outputModeName+" requires a forward FFT with a complex output.");
+            }
+
+            // Switching between complex and real outputs changes the output
+            // port's type, which can't happen once connected.
+            const bool isComplexOutput = (FFTOutputMode::Complex == outputMode);
+            if((isComplexOutput != (FFTOutputMode::Complex == _outputMode)) && this->isActive())
+            {
+                throw Pothos::InvalidArgumentException(
+                          "Cannot switch between complex and real outputs while active.");
+            }
+
+            _outputMode = outputMode;
+            this->_setupOutputPort();
+        }
+
+        bool fftShift() const
+        {
+            return _fftShift;
+        }
+
+        void setFFTShift(bool fftShift)
+        {
+            if(fftShift && (!_enforceNumBins || !IsComplex<InType>::value || !IsComplex<OutType>::value))
+            {
+                throw Pothos::InvalidArgumentException("FFT shifting requires a forward complex-to-complex FFT.");
+            }
+
+            _fftShift = fftShift;
+        }
+
         af::array getInputPort0ForFFT()
         {
             const auto elems = _enforceNumBins ? _numBins : this->workInfo().minElements;
@@ -129,6 +227,8 @@ class FFTBlock: public ArrayFireBlock
 
         void work() override
         {
+            WorkTimer workTimer(this);
+
             auto elems = this->workInfo().minElements;
             if(0 == elems)
             {
@@ -136,16 +236,103 @@ class FFTBlock: public ArrayFireBlock
             }
 
             auto afInput = this->getInputPort0ForFFT();
-            auto afOutput = _func(afInput, this->_norm);
+            auto afOutput = _transform(afInput);
             this->produceFromAfArray(0, afOutput);
         }
 
+    protected:
+
+        void prewarmKernels() override
+        {
+            const auto& dtype = this->input(0)->dtype();
+            const auto elems = _enforceNumBins ? static_cast<dim_t>(_numBins)
+                                               : this->getPrewarmElements(dtype);
+
+            auto afInput = af::constant(
+                               1,
+                               elems * static_cast<dim_t>(_nchans),
+                               Pothos::Object(dtype).convert<af::dtype>());
+            _transform(afInput).eval();
+        }
+
     private:
         FFTFunc _func;
         bool _enforceNumBins;
         size_t _numBins;
         double _norm;
         size_t _nchans;
+
+        FFTOutputMode _outputMode;
+        bool _fftShift;
+
+        unsigned long long _planCacheMisses;
+
+        // All modes other than complex output float32.
+        void _setupOutputPort()
+        {
+            static const Pothos::DType outDType(typeid(OutType));
+            static const Pothos::DType realOutDType(typeid(float));
+
+            this->setupOutput(
+                0,
+                Pothos::DType::fromDType(
+                    (FFTOutputMode::Complex == _outputMode) ? outDType : realOutDType,
+                    _nchans),
+                _domain);
+        }
+
+        // These are all element-wise, so ArrayFire's JIT fuses them into the
+        // evaluation of the output.
+        af::array _postProcess(const af::array& afFFTOutput) const
+        {
+            af::array afOutput;
+            switch(_outputMode)
+            {
+                case FFTOutputMode::Magnitude:
+                    afOutput = af::abs(afFFTOutput).as(::f32);
+                    break;
+
+                case FFTOutputMode::Power:
+                    afOutput = af::pow(af::abs(afFFTOutput), 2).as(::f32);
+                    break;
+
+                case FFTOutputMode::Decibels:
+                    // Avoid -inf for empty bins.
+                    afOutput = 10.0 * af::log10(af::max(
+                                                    af::pow(af::abs(afFFTOutput), 2).as(::f32),
+                                                    std::numeric_limits<float>::min()));
+                    break;
+
+                default:
+                    afOutput = afFFTOutput;
+                    break;
+            }
+
+            return _fftShift ? af::shift(afOutput, static_cast<int>(afOutput.dims(0) / 2))
+                             : afOutput;
+        }
+
+        // Multi-dimensional inputs are transformed as one batch, with one
+        // column per channel.
+        af::array _transform(const af::array& afInput)
+        {
+            const dim_t numChans = static_cast<dim_t>(_nchans);
+            const dim_t numSamples = afInput.elements() / numChans;
+
+            auto afBatch = (numChans > 1) ? af::moddims(afInput, numChans, numSamples).T()
+                                          : afInput;
+
+            static const auto afInputDType = Pothos::Object(Pothos::DType(typeid(InType))).convert<af::dtype>();
+            static const auto afOutputDType = Pothos::Object(Pothos::DType(typeid(OutType))).convert<af::dtype>();
+            if(recordFFTPlanUse(_afBackend, _afDevice, afInputDType, afOutputDType, numSamples, numChans))
+            {
+                ++_planCacheMisses;
+            }
+
+            auto afOutput = _postProcess(_func(afBatch, _norm));
+
+            return (numChans > 1) ? af::flat(afOutput.T()) : afOutput;
+        }
 };
 
 //
@@ -173,7 +360,7 @@ static EnableIfBothComplex<FwdIn, FwdOut, FFTFunc> getFFTFunc(
 
     auto retLambda = [func](const af::array& arr, const double norm)
                      {
-                         return func(arr, norm, arr.elements());
+                         return func(arr, norm, arr.dims(0));
                      };
 
     return FFTFunc(retLambda);
@@ -273,10 +460,17 @@ static Pothos::Block* makeFFT(
  *
  * Calculates the FFT of the input stream, with an optional normalization factor.
  *
+ * For forward FFTs with a complex output, the block can instead output the
+ * magnitude, power, or power in dB of each bin as <b>float32</b>, computed on
+ * the device as part of the FFT. Complex-to-complex forward FFTs can also
+ * shift the zero-frequency bin to the center of each FFT.
+ *
  * |category /GPU/Signal
- * |keywords array signal fft ifft fourier
+ * |keywords array signal fft ifft fourier magnitude power db decibel shift
  * |factory /gpu/signal/fft(device,inputDType,outputDType,numBins,norm,inverse)
  * |setter setNormalizationFactor(norm)
+ * |setter setOutputMode(outputMode)
+ * |setter setFFTShift(fftShift)
  *
  * |param device[Device] Device to use for processing.
  * |default "Auto"
@@ -322,6 +516,23 @@ static Pothos::Block* makeFFT(
  * |widget ToggleSwitch(on="True",off="False")
  * |preview enable
  * |default false
+ *
+ * |param outputMode[Output Mode] What to output for each bin. All modes
+ * other than <b>Complex</b> output <b>float32</b>, regardless of the output
+ * data type, so this can only switch between complex and real outputs while
+ * the block is inactive.
+ * |widget ComboBox(editable=false)
+ * |option [Complex] "complex"
+ * |option [Magnitude] "magnitude"
+ * |option [Power] "power"
+ * |option [Power (dB)] "dB"
+ * |default "complex"
+ * |preview enable
+ *
+ * |param fftShift[FFT Shift?] Move the zero-frequency bin to the center.
+ * |widget ToggleSwitch(on="True",off="False")
+ * |preview enable
+ * |default false
  */
 static Pothos::BlockRegistry registerFFT(
     fftBlockPath,
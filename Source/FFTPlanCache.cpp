@@ -0,0 +1,120 @@
+// Copyright (c) 2021 Nicholas Corgan
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "DeviceCache.hpp"
+#include "FFTPlanCache.hpp"
+
+#include <Pothos/Exception.hpp>
+
+#include <Poco/Format.h>
+#include <Poco/NumberFormatter.h>
+
+#include <algorithm>
+#include <list>
+#include <map>
+#include <mutex>
+#include <utility>
+
+using DeviceKey = std::pair<af::Backend, int>;
+
+static std::mutex& getFFTPlanCacheMutex()
+{
+    static std::mutex fftPlanCacheMutex;
+    return fftPlanCacheMutex;
+}
+
+static size_t& getFFTPlanCacheSizeRef()
+{
+    static size_t fftPlanCacheSize = DefaultFFTPlanCacheSize;
+    return fftPlanCacheSize;
+}
+
+// Most recently used first
+static std::map<DeviceKey, std::list<std::string>>& getFFTPlanCaches()
+{
+    static std::map<DeviceKey, std::list<std::string>> fftPlanCaches;
+    return fftPlanCaches;
+}
+
+size_t getFFTPlanCacheSize()
+{
+    std::lock_guard<std::mutex> lock(getFFTPlanCacheMutex());
+    return getFFTPlanCacheSizeRef();
+}
+
+void setFFTPlanCacheSize(size_t cacheSize)
+{
+    if(0 == cacheSize)
+    {
+        throw Pothos::InvalidArgumentException("The FFT plan cache size must be non-zero.");
+    }
+
+    std::lock_guard<std::mutex> lock(getFFTPlanCacheMutex());
+
+    // Each device has its own cache.
+    const auto activeBackend = af::getActiveBackend();
+    for(const auto& entry: getDeviceCache())
+    {
+        af::setBackend(entry.afBackendEnum);
+
+        const int activeDevice = af::getDevice();
+        af::setDevice(entry.afDeviceIndex);
+        af::setFFTPlanCacheSize(cacheSize);
+        af::setDevice(activeDevice);
+    }
+    af::setBackend(activeBackend);
+
+    getFFTPlanCacheSizeRef() = cacheSize;
+    for(auto& cachePair: getFFTPlanCaches())
+    {
+        if(cachePair.second.size() > cacheSize)
+        {
+            cachePair.second.resize(cacheSize);
+        }
+    }
+}
+
+bool recordFFTPlanUse(
+    af::Backend backend,
+    int device,
+    const std::string& planKey)
+{
+    std::lock_guard<std::mutex> lock(getFFTPlanCacheMutex());
+    auto& cache = getFFTPlanCaches()[DeviceKey(backend, device)];
+
+    auto iter = std::find(cache.begin(), cache.end(), planKey);
+    const bool miss = (cache.end() == iter);
+    if(miss)
+    {
+        cache.emplace_front(planKey);
+        if(cache.size() > getFFTPlanCacheSizeRef())
+        {
+            cache.pop_back();
+        }
+    }
+    else
+    {
+        cache.splice(cache.begin(), cache, iter);
+    }
+
+    return miss;
+}
+
+bool recordFFTPlanUse(
+    af::Backend backend,
+    int device,
+    af::dtype inputDType,
+    af::dtype outputDType,
+    dim_t length,
+    dim_t batchSize)
+{
+    return recordFFTPlanUse(
+               backend,
+               device,
+               Poco::format(
+                   "%d->%d %s %s",
+                   static_cast<int>(inputDType),
+                   static_cast<int>(outputDType),
+                   Poco::NumberFormatter::format(static_cast<long long>(length)),
+                   Poco::NumberFormatter::format(static_cast<long long>(batchSize))));
+}
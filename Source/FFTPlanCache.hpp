@@ -0,0 +1,42 @@
+// Copyright (c) 2021 Nicholas Corgan
+// SPDX-License-Identifier: BSD-3-Clause
+
+#pragma once
+
+#include <arrayfire.h>
+
+#include <string>
+
+//
+// ArrayFire keeps a per-device LRU cache of FFT plans but doesn't report
+// whether a transform found its plan there. These functions control the
+// cache size and mirror its bookkeeping, so blocks can report how often
+// their plans would have been created. Every block that calls an FFT
+// records its plans here, so plans evicted by other blocks on the same
+// device count as misses. The transforms inside af::fftConvolve1 are
+// padded internally and aren't recorded.
+//
+
+// ArrayFire's default
+static constexpr size_t DefaultFFTPlanCacheSize = 5;
+
+size_t getFFTPlanCacheSize();
+
+// Applies to every device on every available backend.
+void setFFTPlanCacheSize(size_t cacheSize);
+
+// Returns true if the plan was not in the given device's cache.
+bool recordFFTPlanUse(
+    af::Backend backend,
+    int device,
+    const std::string& planKey);
+
+// For a batch of 1-D transforms along the first dimension. Forward and
+// inverse complex transforms share a plan.
+bool recordFFTPlanUse(
+    af::Backend backend,
+    int device,
+    af::dtype inputDType,
+    af::dtype outputDType,
+    dim_t length,
+    dim_t batchSize);
@@ -138,7 +138,7 @@ class FileSinkBlock: public ArrayFireBlock
             this->registerCall(this, POTHOS_FCN_TUPLE(FileSinkBlock, append));
         }
 
-        void deactivate()
+        void deactivate() override
         {
             this->configArrayFire();
 
@@ -177,6 +177,8 @@ class FileSinkBlock: public ArrayFireBlock
                 afArray,
                 _filepath.c_str(),
                 _append);
+
+            ArrayFireBlock::deactivate();
         }
 
         std::string filepath() const
@@ -196,6 +198,8 @@ class FileSinkBlock: public ArrayFireBlock
 
         void work()
         {
+            WorkTimer workTimer(this);
+
             const auto elems = this->workInfo().minInElements;
             if(0 == elems)
             {
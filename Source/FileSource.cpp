@@ -146,6 +146,8 @@ class FileSourceBlock: public ArrayFireBlock
 
         void work() override
         {
+            WorkTimer workTimer(this);
+
             const size_t elems = this->workInfo().minElements;
             if((0 == elems) || (!_repeat && (_pos >= _rowSize)))
             {
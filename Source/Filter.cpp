@@ -1,7 +1,8 @@
-// Copyright (c) 2019-2020 Nicholas Corgan
+// Copyright (c) 2019-2021 Nicholas Corgan
 // SPDX-License-Identifier: BSD-3-Clause
 
 #include "OneToOneBlock.hpp"
+#include "StagedCoeffs.hpp"
 #include "Utility.hpp"
 
 #include <Pothos/Exception.hpp>
@@ -13,12 +14,19 @@
 
 #include <arrayfire.h>
 
+#include <algorithm>
+#include <string>
 #include <vector>
 
 //
 // Block classes
 //
 
+/*
+ * New taps are staged and swapped in at the next buffer boundary. If a
+ * crossfade length is set, the outputs of the old and new taps are blended
+ * over that many samples after the swap.
+ */
 template <typename T>
 class FIRBlock: public OneToOneBlock
 {
@@ -40,17 +48,28 @@ class FIRBlock: public OneToOneBlock
                 Pothos::DType::fromDType(Class::dtype, dtypeDims)),
             _taps({T(1.0)}),
             _waitTaps(false),
-            _waitTapsArmed(false)
+            _waitTapsArmed(false),
+            _dtypeDims(dtypeDims),
+            _stagedTaps(_afBackend, _afDevice)
         {
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, taps));
             this->registerCall(this, POTHOS_FCN_TUPLE(Class, setTaps));
             this->registerCall(this, POTHOS_FCN_TUPLE(Class, waitTaps));
             this->registerCall(this, POTHOS_FCN_TUPLE(Class, setWaitTaps));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, uploadingTaps));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, crossfadeLength));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, setCrossfadeLength));
+
+            this->setTaps(_taps);
         }
 
         virtual ~FIRBlock() = default;
 
         void activate() override
         {
+            // Prewarming needs taps, and there's nothing to fade from yet.
+            this->_applyStagedTaps(true);
+
             ArrayFireBlock::activate();
 
             _waitTapsArmed = _waitTaps;
@@ -69,8 +88,11 @@ class FIRBlock: public OneToOneBlock
             }
 
             _taps = taps;
-            _func.bind(Pothos::Object(_taps).convert<af::array>(), 0);
-            _waitTapsArmed = false; // We have taps
+            _stagedTaps.stage([this, taps]()
+                              {
+                                  this->configArrayFire();
+                                  return Pothos::Object(taps).convert<af::array>();
+                              });
         }
 
         bool waitTaps() const
@@ -83,23 +105,99 @@ class FIRBlock: public OneToOneBlock
             _waitTaps = waitTaps;
         }
 
+        bool uploadingTaps() const
+        {
+            return _stagedTaps.isUploading();
+        }
+
+        size_t crossfadeLength() const
+        {
+            return _crossfader.length();
+        }
+
+        void setCrossfadeLength(size_t crossfadeLength)
+        {
+            _crossfader.setLength(crossfadeLength);
+        }
+
         void work() override
         {
-            // If specified, don't do anything until taps are explicitly set.
-            if(_waitTapsArmed) return;
+            WorkTimer workTimer(this);
+
+            // If specified, don't do anything until taps are explicitly set
+            // and uploaded.
+            const bool hasNewTaps = this->_applyStagedTaps(false);
+            if(_waitTapsArmed && !hasNewTaps) return;
+            _waitTapsArmed = false;
+
+            if(!_crossfader.active())
+            {
+                OneToOneBlock::work();
+                return;
+            }
+
+            if(0 == this->workInfo().minElements) return;
+
+            this->configArrayFire();
 
-            OneToOneBlock::work();
+            auto afInput = this->getInputPortAsAfArray(0);
+            this->produceFromAfArray(
+                0,
+                _crossfader.apply(
+                    af::fir(_afPrevTaps, afInput),
+                    af::fir(_afTaps, afInput),
+                    _dtypeDims));
         }
 
     private:
         std::vector<TapType> _taps;
         bool _waitTaps;
         bool _waitTapsArmed;
+        size_t _dtypeDims;
+
+        StagedCoeffs<af::array> _stagedTaps;
+        af::array _afTaps;
+        af::array _afPrevTaps;
+        Crossfader _crossfader;
+
+        // On activation, waits for any upload in progress.
+        bool _applyStagedTaps(bool isActivating)
+        {
+            af::array afTaps;
+            if(!_stagedTaps.take(afTaps, isActivating)) return false;
+
+            if(!isActivating && (_afTaps.elements() > 0) && (_crossfader.length() > 0))
+            {
+                _afPrevTaps = _afTaps;
+                _crossfader.start();
+            }
+
+            _afTaps = afTaps;
+            _func.bind(_afTaps, 0);
+
+            return true;
+        }
 };
 
 template <typename T>
 const Pothos::DType FIRBlock<T>::dtype(typeid(T));
 
+/*
+ * af::iir has no notion of initial conditions, so each buffer is filtered as
+ * the sum of its zero-state response and the response to the state left
+ * over from previous buffers. In transposed direct form II, the latter is
+ * the feedback-only filter applied to the previous state, so each buffer is
+ * filtered in a single af::iir call:
+ *
+ *   y = iir([1], a, fir(b, x) + z)
+ *
+ * where z is computed from the last N-1 inputs and outputs. Multi-channel
+ * inputs are filtered as one column per channel, which af::fir and af::iir
+ * both batch.
+ *
+ * New coefficients, along with their state matrices, are staged and swapped
+ * in at the next buffer boundary.
+ */
 template <typename T>
 class IIRBlock: public OneToOneBlock
 {
@@ -126,19 +224,33 @@ class IIRBlock: public OneToOneBlock
             _feedForwardCoeffs({0.0676, 0.135, 0.0676}),
             _feedbackCoeffs({1, -1.142, 0.412}),
             _waitTaps(false),
-            _waitTapsArmed(false)
+            _waitTapsArmed(false),
+            _dtypeDims(dtypeDims),
+            _afDType(Pothos::Object(Class::dtype).convert<af::dtype>()),
+            _stagedCoeffs(_afBackend, _afDevice),
+            _stateLength(0)
         {
             this->registerCall(this, POTHOS_FCN_TUPLE(Class, waitTaps));
             this->registerCall(this, POTHOS_FCN_TUPLE(Class, setWaitTaps));
             this->registerCall(this, POTHOS_FCN_TUPLE(Class, setFeedForwardCoeffs));
             this->registerCall(this, POTHOS_FCN_TUPLE(Class, setFeedbackCoeffs));
             this->registerCall(this, POTHOS_FCN_TUPLE(Class, setTapsFromCommsIIRDesigner));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, uploadingTaps));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, resetState));
+
+            this->configArrayFire();
+            _afUnit = af::constant(1, 1, _afDType);
+
+            _updateCoeffs();
         }
 
         virtual ~IIRBlock() = default;
 
         void activate() override
         {
+            // Prewarming needs coefficients.
+            this->_applyStagedCoeffs(true);
+
             ArrayFireBlock::activate();
 
             _waitTapsArmed = _waitTaps;
@@ -146,47 +258,25 @@ class IIRBlock: public OneToOneBlock
 
         void setFeedForwardCoeffs(const std::vector<TapType>& feedForwardCoeffs)
         {
-            if(feedForwardCoeffs.empty())
-            {
-                throw Pothos::InvalidArgumentException("Coefficients cannot be empty.");
-            }
-            else if(feedForwardCoeffs.size() > MaxFFCoeffLength)
-            {
-                throw Pothos::InvalidArgumentException(
-                          Poco::format(
-                              "In ArrayFire %s, af::iir only accepts feed-forward "
-                              "coefficients up to length %s",
-                              std::string(AF_VERSION),
-                              Poco::NumberFormatter::format(MaxFFCoeffLength)));
-            }
+            _validateFeedForwardCoeffs(feedForwardCoeffs);
 
             _feedForwardCoeffs = feedForwardCoeffs;
-            _func.bind(Pothos::Object(_feedForwardCoeffs).convert<af::array>(), 0);
-            _disarmWaitTapsIfCoeffsPopulated();
+            _updateCoeffs();
         }
 
         void setFeedbackCoeffs(const std::vector<TapType>& feedbackCoeffs)
         {
-            if(feedbackCoeffs.empty())
-            {
-                throw Pothos::InvalidArgumentException("Coefficients cannot be empty.");
-            }
-            else if(feedbackCoeffs.size() != _feedForwardCoeffs.size())
-            {
-                throw Pothos::InvalidArgumentException(
-                          "Feed-forward and feedback coefficients "
-                          "must be the same size.");
-            }
+            _validateFeedbackCoeffs(feedbackCoeffs, _feedForwardCoeffs.size());
 
             _feedbackCoeffs = feedbackCoeffs;
-            _func.bind(Pothos::Object(_feedbackCoeffs).convert<af::array>(), 1);
-            _disarmWaitTapsIfCoeffsPopulated();
+            _updateCoeffs();
         }
 
         /*
          * /comms/iir_designer emits a single tap vector that contains both the
          * feed-forward and feedback taps in a flattened array. This is restricted
-         * to the taps being the same length.
+         * to the taps being the same length. Both sets are staged as one
+         * update, so no buffer is filtered with only one of them changed.
          */
         void setTapsFromCommsIIRDesigner(const std::vector<TapType>& taps)
         {
@@ -210,8 +300,12 @@ class IIRBlock: public OneToOneBlock
                 feedbackCoeffs.begin(),
                 feedbackCoeffs.begin() + (feedbackCoeffs.size()/2));
 
-            this->setFeedForwardCoeffs(feedForwardCoeffs);
-            this->setFeedbackCoeffs(feedbackCoeffs);
+            _validateFeedForwardCoeffs(feedForwardCoeffs);
+            _validateFeedbackCoeffs(feedbackCoeffs, feedForwardCoeffs.size());
+
+            _feedForwardCoeffs = feedForwardCoeffs;
+            _feedbackCoeffs = feedbackCoeffs;
+            _updateCoeffs();
         }
 
         bool waitTaps() const
@@ -224,12 +318,55 @@ class IIRBlock: public OneToOneBlock
             _waitTaps = waitTaps;
         }
 
+        bool uploadingTaps() const
+        {
+            return _stagedCoeffs.isUploading();
+        }
+
+        void resetState() override
+        {
+            if(_stateLength > 0)
+            {
+                this->configArrayFire();
+
+                _afInputHistory = af::constant(
+                                      0,
+                                      static_cast<dim_t>(_stateLength),
+                                      static_cast<dim_t>(_dtypeDims),
+                                      _afDType);
+                _afOutputHistory = _afInputHistory.copy();
+            }
+        }
+
         void work() override
         {
-            // If specified, don't do anything until taps are explicitly set.
-            if(_waitTapsArmed) return;
+            WorkTimer workTimer(this);
+
+            // If specified, don't do anything until taps are explicitly set
+            // and uploaded.
+            const bool hasNewCoeffs = this->_applyStagedCoeffs(false);
+            if(_waitTapsArmed && !hasNewCoeffs) return;
+            _waitTapsArmed = false;
+
+            if(0 == this->workInfo().minElements) return;
+
+            this->configArrayFire();
+
+            auto afInput = this->getInputPortAsAfArray(0);
+            this->produceFromAfArray(0, _filter(afInput));
+        }
+
+    protected:
+
+        void prewarmKernels() override
+        {
+            const auto& dtype = this->input(0)->dtype();
 
-            OneToOneBlock::work();
+            this->resetState();
+            _filter(af::constant(
+                        1,
+                        this->getPrewarmElements(dtype) * static_cast<dim_t>(_dtypeDims),
+                        _afDType)).eval();
         }
 
     private:
@@ -238,15 +375,466 @@ class IIRBlock: public OneToOneBlock
         bool _waitTaps;
         bool _waitTapsArmed;
 
-        inline void _disarmWaitTapsIfCoeffsPopulated()
+        size_t _dtypeDims;
+        af::dtype _afDType;
+
+        struct Coeffs
         {
-            _waitTapsArmed = _feedForwardCoeffs.empty() || _feedbackCoeffs.empty();
+            af::array afFeedForward;
+            af::array afFeedback;
+            af::array afFeedForwardStateMatrix;
+            af::array afFeedbackStateMatrix;
+            size_t stateLength;
+        };
+        StagedCoeffs<Coeffs> _stagedCoeffs;
+
+        // Normalized by the first feedback coefficient
+        af::array _afFeedForward;
+        af::array _afFeedback;
+        af::array _afUnit;
+
+        // Maps the input and output history (newest first) to the state
+        size_t _stateLength;
+        af::array _afFeedForwardStateMatrix;
+        af::array _afFeedbackStateMatrix;
+
+        // One column per channel
+        af::array _afInputHistory;
+        af::array _afOutputHistory;
+
+        static void _validateFeedForwardCoeffs(const std::vector<TapType>& feedForwardCoeffs)
+        {
+            if(feedForwardCoeffs.empty())
+            {
+                throw Pothos::InvalidArgumentException("Coefficients cannot be empty.");
+            }
+            else if(feedForwardCoeffs.size() > MaxFFCoeffLength)
+            {
+                throw Pothos::InvalidArgumentException(
+                          Poco::format(
+                              "In ArrayFire %s, af::iir only accepts feed-forward "
+                              "coefficients up to length %s",
+                              std::string(AF_VERSION),
+                              Poco::NumberFormatter::format(MaxFFCoeffLength)));
+            }
+        }
+
+        static void _validateFeedbackCoeffs(
+            const std::vector<TapType>& feedbackCoeffs,
+            size_t feedForwardLength)
+        {
+            if(feedbackCoeffs.empty())
+            {
+                throw Pothos::InvalidArgumentException("Coefficients cannot be empty.");
+            }
+            else if(feedbackCoeffs.size() != feedForwardLength)
+            {
+                throw Pothos::InvalidArgumentException(
+                          "Feed-forward and feedback coefficients "
+                          "must be the same size.");
+            }
+            else if(TapType(0) == feedbackCoeffs[0])
+            {
+                throw Pothos::InvalidArgumentException(
+                          "The first feedback coefficient cannot be zero.");
+            }
+        }
+
+        // The matrices are built here, and only the upload is left to the
+        // worker thread.
+        void _updateCoeffs()
+        {
+            // The coefficients are only temporarily mismatched while they're
+            // being set individually, so pad to keep the state valid.
+            const size_t order = std::max(_feedForwardCoeffs.size(), _feedbackCoeffs.size());
+            std::vector<TapType> feedForwardCoeffs(order, TapType(0));
+            std::vector<TapType> feedbackCoeffs(order, TapType(0));
+
+            const TapType a0 = _feedbackCoeffs[0];
+            std::transform(
+                _feedForwardCoeffs.begin(),
+                _feedForwardCoeffs.end(),
+                feedForwardCoeffs.begin(),
+                [&a0](const TapType& coeff){return coeff / a0;});
+            std::transform(
+                _feedbackCoeffs.begin(),
+                _feedbackCoeffs.end(),
+                feedbackCoeffs.begin(),
+                [&a0](const TapType& coeff){return coeff / a0;});
+
+            const size_t stateLength = order - 1;
+            std::vector<TapType> feedForwardStateMatrix(stateLength * stateLength, TapType(0));
+            std::vector<TapType> feedbackStateMatrix(stateLength * stateLength, TapType(0));
+            for(size_t col = 0; col < stateLength; ++col)
+            {
+                for(size_t row = 0; (row + col + 1) < order; ++row)
+                {
+                    // Column-major
+                    feedForwardStateMatrix[(col * stateLength) + row] = feedForwardCoeffs[row + col + 1];
+                    feedbackStateMatrix[(col * stateLength) + row] = feedbackCoeffs[row + col + 1];
+                }
+            }
+
+            _stagedCoeffs.stage([this,
+                                 feedForwardCoeffs,
+                                 feedbackCoeffs,
+                                 feedForwardStateMatrix,
+                                 feedbackStateMatrix,
+                                 stateLength]()
+            {
+                this->configArrayFire();
+
+                Coeffs coeffs;
+                coeffs.afFeedForward = Pothos::Object(feedForwardCoeffs).convert<af::array>();
+                coeffs.afFeedback = Pothos::Object(feedbackCoeffs).convert<af::array>();
+                coeffs.stateLength = stateLength;
+
+                if(stateLength > 0)
+                {
+                    const auto stateDim = static_cast<dim_t>(stateLength);
+
+                    coeffs.afFeedForwardStateMatrix = af::moddims(
+                                                          Pothos::Object(feedForwardStateMatrix).convert<af::array>(),
+                                                          stateDim,
+                                                          stateDim);
+                    coeffs.afFeedbackStateMatrix = af::moddims(
+                                                       Pothos::Object(feedbackStateMatrix).convert<af::array>(),
+                                                       stateDim,
+                                                       stateDim);
+                }
+
+                return coeffs;
+            });
+        }
+
+        // On activation, waits for any upload in progress.
+        bool _applyStagedCoeffs(bool isActivating)
+        {
+            Coeffs coeffs;
+            if(!_stagedCoeffs.take(coeffs, isActivating)) return false;
+
+            _afFeedForward = coeffs.afFeedForward;
+            _afFeedback = coeffs.afFeedback;
+            _afFeedForwardStateMatrix = coeffs.afFeedForwardStateMatrix;
+            _afFeedbackStateMatrix = coeffs.afFeedbackStateMatrix;
+
+            // The state after a buffer only depends on the last N-1 inputs
+            // and outputs, so keep the existing history unless the order
+            // changed.
+            if(coeffs.stateLength != _stateLength)
+            {
+                _stateLength = coeffs.stateLength;
+                this->resetState();
+            }
+
+            return true;
+        }
+
+        af::array _updateHistory(
+            const af::array& afHistory,
+            const af::array& afNewest) const
+        {
+            const dim_t stateLength = static_cast<dim_t>(_stateLength);
+            const dim_t numSamples = afNewest.dims(0);
+
+            auto afFlipped = af::flip(afNewest, 0);
+            if(numSamples >= stateLength)
+            {
+                return afFlipped(af::seq(0, static_cast<double>(stateLength-1)), af::span).copy();
+            }
+
+            return af::join(
+                       0,
+                       afFlipped,
+                       afHistory(af::seq(0, static_cast<double>(stateLength-numSamples-1)), af::span));
+        }
+
+        af::array _filter(const af::array& afInput)
+        {
+            const dim_t numChans = static_cast<dim_t>(_dtypeDims);
+            const dim_t numSamples = afInput.elements() / numChans;
+
+            // The input is interleaved, so move each channel into a column.
+            auto afChannels = (numChans > 1) ? af::moddims(afInput, numChans, numSamples).T()
+                                             : afInput;
+
+            auto afExcitation = af::fir(_afFeedForward, afChannels);
+            if(_stateLength > 0)
+            {
+                af::array afState = af::matmul(_afFeedForwardStateMatrix, _afInputHistory)
+                                  - af::matmul(_afFeedbackStateMatrix, _afOutputHistory);
+                if(numSamples < afState.dims(0))
+                {
+                    afState = afState(af::seq(0, static_cast<double>(numSamples-1)), af::span);
+                }
+
+                afExcitation(af::seq(0, static_cast<double>(afState.dims(0)-1)), af::span) += afState;
+            }
+
+            auto afOutput = af::iir(_afUnit, _afFeedback, afExcitation);
+            if(_stateLength > 0)
+            {
+                _afInputHistory = _updateHistory(_afInputHistory, afChannels);
+                _afOutputHistory = _updateHistory(_afOutputHistory, afOutput);
+            }
+
+            return (numChans > 1) ? af::flat(afOutput.T()) : afOutput;
         }
 };
 
 template <typename T>
 const Pothos::DType IIRBlock<T>::dtype(typeid(T));
 
+/*
+ * All filters are applied to the same input, so the taps are stored as one
+ * zero-padded column per filter, and each buffer is filtered with a single
+ * batched af::convolve1 call (one signal, many filters). The last K-1 inputs
+ * are prepended to each buffer, so only the fully overlapping part of the
+ * expanded convolution is output.
+ *
+ * New taps are staged and swapped in at the next buffer boundary. If their
+ * length changed, the history is reset along with them.
+ */
+template <typename T>
+class FIRBankBlock: public ArrayFireBlock
+{
+    public:
+        using Type = T;
+        using Class = FIRBankBlock<T>;
+        using TapType = typename Tap<T>::Type;
+
+        static const Pothos::DType dtype;
+
+        FIRBankBlock(
+            const std::string& device,
+            size_t numFilters
+        ):
+            ArrayFireBlock(device),
+            _afDType(Pothos::Object(Class::dtype).convert<af::dtype>()),
+            _numFilters(numFilters),
+            _waitTaps(false),
+            _waitTapsArmed(false),
+            _stagedTaps(_afBackend, _afDevice),
+            _historyLength(0)
+        {
+            if(0 == _numFilters)
+            {
+                throw Pothos::InvalidArgumentException("The number of filters must be non-zero.");
+            }
+
+            this->setupInput(0, Class::dtype, _domain);
+            for(size_t filter = 0; filter < _numFilters; ++filter)
+            {
+                this->setupOutput(std::to_string(filter), Class::dtype, _domain);
+            }
+
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, numFilters));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, taps));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, setTaps));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, waitTaps));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, setWaitTaps));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, uploadingTaps));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, resetState));
+
+            this->registerProbe("taps");
+
+            // Default to passthrough.
+            this->setTaps(std::vector<std::vector<TapType>>(_numFilters, {TapType(1.0)}));
+        }
+
+        virtual ~FIRBankBlock() = default;
+
+        void activate() override
+        {
+            // Prewarming needs taps.
+            this->_applyStagedTaps(true);
+
+            ArrayFireBlock::activate();
+
+            _waitTapsArmed = _waitTaps;
+        }
+
+        size_t numFilters() const
+        {
+            return _numFilters;
+        }
+
+        std::vector<std::vector<TapType>> taps() const
+        {
+            return _taps;
+        }
+
+        void setTaps(const std::vector<std::vector<TapType>>& taps)
+        {
+            if(taps.size() != _numFilters)
+            {
+                throw Pothos::InvalidArgumentException(
+                          Poco::format(
+                              "Expected %s tap sets, got %s.",
+                              Poco::NumberFormatter::format(_numFilters),
+                              Poco::NumberFormatter::format(taps.size())));
+            }
+
+            size_t numTaps = 0;
+            for(const auto& filterTaps: taps)
+            {
+                if(filterTaps.empty())
+                {
+                    throw Pothos::InvalidArgumentException("Taps cannot be empty.");
+                }
+
+                numTaps = std::max(numTaps, filterTaps.size());
+            }
+
+            // Column-major, one column per filter
+            std::vector<TapType> tapMatrix(numTaps * _numFilters, TapType(0));
+            for(size_t filter = 0; filter < _numFilters; ++filter)
+            {
+                std::copy(
+                    taps[filter].begin(),
+                    taps[filter].end(),
+                    tapMatrix.begin() + (filter * numTaps));
+            }
+
+            _taps = taps;
+            _stagedTaps.stage([this, tapMatrix, numTaps]()
+                              {
+                                  this->configArrayFire();
+                                  return af::moddims(
+                                             Pothos::Object(tapMatrix).convert<af::array>(),
+                                             static_cast<dim_t>(numTaps),
+                                             static_cast<dim_t>(_numFilters));
+                              });
+        }
+
+        bool waitTaps() const
+        {
+            return _waitTaps;
+        }
+
+        void setWaitTaps(bool waitTaps)
+        {
+            _waitTaps = waitTaps;
+        }
+
+        bool uploadingTaps() const
+        {
+            return _stagedTaps.isUploading();
+        }
+
+        void resetState() override
+        {
+            if(_historyLength > 0)
+            {
+                this->configArrayFire();
+
+                _afHistory = af::constant(0, static_cast<dim_t>(_historyLength), _afDType);
+            }
+        }
+
+        void work() override
+        {
+            WorkTimer workTimer(this);
+
+            // If specified, don't do anything until taps are explicitly set
+            // and uploaded.
+            const bool hasNewTaps = this->_applyStagedTaps(false);
+            if(_waitTapsArmed && !hasNewTaps) return;
+            _waitTapsArmed = false;
+
+            const auto& workInfo = this->workInfo();
+            const size_t elems = std::min(workInfo.minInElements, workInfo.minOutElements);
+            if(0 == elems) return;
+
+            this->configArrayFire();
+
+            auto afInput = this->getInputElementsAsAfArray(0, elems);
+            auto afOutput = _filter(afInput);
+
+            for(size_t filter = 0; filter < _numFilters; ++filter)
+            {
+                this->produceFromAfArray(
+                    std::to_string(filter),
+                    afOutput.col(static_cast<int>(filter)));
+            }
+        }
+
+    protected:
+
+        void prewarmKernels() override
+        {
+            const auto& dtype = this->input(0)->dtype();
+
+            this->resetState();
+            _filter(af::constant(
+                        1,
+                        this->getPrewarmElements(dtype),
+                        _afDType)).eval();
+        }
+
+    private:
+        af::dtype _afDType;
+        size_t _numFilters;
+
+        std::vector<std::vector<TapType>> _taps;
+        bool _waitTaps;
+        bool _waitTapsArmed;
+
+        StagedCoeffs<af::array> _stagedTaps;
+        af::array _afTapMatrix;
+
+        // The last K-1 inputs, oldest first
+        size_t _historyLength;
+        af::array _afHistory;
+
+        // On activation, waits for any upload in progress.
+        bool _applyStagedTaps(bool isActivating)
+        {
+            af::array afTapMatrix;
+            if(!_stagedTaps.take(afTapMatrix, isActivating)) return false;
+
+            _afTapMatrix = afTapMatrix;
+
+            // The history no longer lines up with the taps.
+            const size_t historyLength = static_cast<size_t>(_afTapMatrix.dims(0)) - 1;
+            if(historyLength != _historyLength)
+            {
+                _historyLength = historyLength;
+                this->resetState();
+            }
+
+            return true;
+        }
+
+        // Returns one column per filter.
+        af::array _filter(const af::array& afInput)
+        {
+            const dim_t historyLength = static_cast<dim_t>(_historyLength);
+            const dim_t numSamples = afInput.elements();
+
+            auto afExtended = (historyLength > 0) ? af::join(0, _afHistory, afInput)
+                                                  : afInput;
+            auto afOutput = af::convolve1(afExtended, _afTapMatrix, ::AF_CONV_EXPAND)(
+                                af::seq(
+                                    static_cast<double>(historyLength),
+                                    static_cast<double>(historyLength + numSamples - 1)),
+                                af::span);
+
+            if(historyLength > 0)
+            {
+                const dim_t extendedLength = afExtended.elements();
+                _afHistory = afExtended(af::seq(
+                                            static_cast<double>(extendedLength - historyLength),
+                                            static_cast<double>(extendedLength - 1))).copy();
+            }
+
+            return afOutput;
+        }
+};
+
+template <typename T>
+const Pothos::DType FIRBankBlock<T>::dtype(typeid(T));
+
 //
 // Factories
 //
@@ -289,6 +877,33 @@ static Pothos::Block* makeIIR(
               dtype.name());
 }
 
+static Pothos::Block* makeFIRBank(
+    const std::string& device,
+    const Pothos::DType& dtype,
+    size_t numFilters)
+{
+    if(1 != dtype.dimension())
+    {
+        throw Pothos::InvalidArgumentException(
+                  "This block does not support multi-dimensional types.",
+                  dtype.toString());
+    }
+
+    #define ifTypeDeclareFactory(T) \
+        if(Pothos::DType::fromDType(dtype, 1) == Pothos::DType(typeid(T))) \
+            return new FIRBankBlock<T>(device,numFilters);
+
+    ifTypeDeclareFactory(float)
+    ifTypeDeclareFactory(double)
+    ifTypeDeclareFactory(std::complex<float>)
+    ifTypeDeclareFactory(std::complex<double>)
+    #undef ifTypeDeclareFactory
+
+    throw Pothos::InvalidArgumentException(
+              "Unsupported type.",
+              dtype.name());
+}
+
 //
 // Block registries
 //
@@ -300,11 +915,16 @@ static Pothos::Block* makeIIR(
  * taps. The taps can be set at runtime by connecting the output of a FIR Designer
  * block to <b>"setTaps"</b>.
  *
+ * New taps are uploaded in the background and take effect at the start of
+ * the first buffer after the upload finishes. They can optionally be
+ * crossfaded in to avoid discontinuities in the output.
+ *
  * |category /GPU/Signal
  * |keywords array tap taps fir
  * |factory /gpu/signal/fir_filter(device,dtype)
  * |setter setTaps(taps)
  * |setter setWaitTaps(waitTaps)
+ * |setter setCrossfadeLength(crossfadeLength)
  *
  * |param device[Device] Device to use for processing.
  * |default "Auto"
@@ -324,6 +944,13 @@ static Pothos::Block* makeIIR(
  * |widget ToggleSwitch(on="True", off="False")
  * |default false
  * |preview disable
+ *
+ * |param crossfadeLength[Crossfade Length] When the taps change, blend
+ * from the old taps' output to the new taps' output over this many samples.
+ * If zero, the new taps take effect immediately.
+ * |widget SpinBox(minimum=0)
+ * |default 0
+ * |preview disable
  */
 static Pothos::BlockRegistry registerFIR(
     "/gpu/signal/fir_filter",
@@ -340,6 +967,14 @@ static Pothos::BlockRegistry registerFIR(
  * can be connected to <b>setTapsFromCommsIIRDesigner</b> to set both sets of
  * coefficients simultaneously.
  *
+ * The filter state is carried across buffers, so the output is the same as if
+ * the whole stream were filtered at once. New coefficients are uploaded in the
+ * background and take effect at the start of the first buffer after the
+ * upload finishes. Changing the coefficients keeps the state unless
+ * the filter order changes, and <b>"resetState"</b> clears it.
+ * For multi-dimensional types, each dimension is filtered as an independent
+ * channel.
+ *
  * |category /GPU/Signal
  * |keywords array tap taps iir
  * |factory /gpu/signal/iir_filter(device,dtype)
@@ -381,3 +1016,51 @@ static Pothos::BlockRegistry registerFIR(
 static Pothos::BlockRegistry registerIIR(
     "/gpu/signal/iir_filter",
     Pothos::Callable(&makeIIR));
+
+/*
+ * |PothosDoc FIR Filter Bank (GPU)
+ *
+ * Applies multiple FIR filters to the same input stream. The input is only
+ * copied to the device once, and all filters are applied with a single
+ * batched <b>af::convolve1</b> call.
+ *
+ * There is one output port per filter, named by the filter's index. The taps
+ * are given as a list with one list of taps per filter, and filters with
+ * fewer taps are zero-padded. The filter state is carried across buffers,
+ * and <b>"resetState"</b> clears it. New taps are uploaded in the background
+ * and take effect at the start of the first buffer after the upload
+ * finishes.
+ *
+ * |category /GPU/Signal
+ * |keywords array tap taps fir filterbank subband
+ * |factory /gpu/signal/fir_bank(device,dtype,numFilters)
+ * |setter setTaps(taps)
+ * |setter setWaitTaps(waitTaps)
+ *
+ * |param device[Device] Device to use for processing.
+ * |default "Auto"
+ *
+ * |param dtype[Data Type] The output's data type.
+ * |widget DTypeChooser(float=1,cfloat=1)
+ * |default "complex_float32"
+ * |preview disable
+ *
+ * |param numFilters[Num Filters] The number of filters, and output ports.
+ * |widget SpinBox(minimum=1)
+ * |default 2
+ * |preview enable
+ *
+ * |param taps[Taps] One list of taps per filter.
+ * |widget LineEdit()
+ * |default [[1.0], [1.0]]
+ * |preview enable
+ *
+ * |param waitTaps[Wait Taps] Wait for the taps to be set before allowing operation.
+ * Use this mode when taps are set exclusively at runtime by the setTaps() slot.
+ * |widget ToggleSwitch(on="True", off="False")
+ * |default false
+ * |preview disable
+ */
+static Pothos::BlockRegistry registerFIRBank(
+    "/gpu/signal/fir_bank",
+    Pothos::Callable(&makeFIRBank));
@@ -0,0 +1,510 @@
+// Copyright (c) 2021 Nicholas Corgan
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "ArrayFireBlock.hpp"
+#include "AutoRangeBins.hpp"
+#include "Utility.hpp"
+
+#include <Pothos/Exception.hpp>
+#include <Pothos/Framework.hpp>
+#include <Pothos/Object.hpp>
+
+#include <arrayfire.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//
+// Misc
+//
+
+enum class HistogramRangeMode
+{
+    Auto,
+    Fixed
+};
+
+static const std::unordered_map<std::string, HistogramRangeMode> HistogramRangeModeEnumMap =
+{
+    {"auto",  HistogramRangeMode::Auto},
+    {"fixed", HistogramRangeMode::Fixed},
+};
+
+enum class HistogramOutputMode
+{
+    Accumulated,
+    Delta
+};
+
+static const std::unordered_map<std::string, HistogramOutputMode> HistogramOutputModeEnumMap =
+{
+    {"accumulated", HistogramOutputMode::Accumulated},
+    {"delta",       HistogramOutputMode::Delta},
+};
+
+//
+// Block class
+//
+
+/*
+ * Each buffer is binned with af::histogram, split wherever an emission is
+ * due, and added to 64-bit counts on the device. The counts are copied back
+ * once per emission.
+ *
+ * In the auto-ranged mode, the range grows as described in
+ * AutoRangeBins.hpp, so no counts are lost. The range has to be known on
+ * the host to bin each segment, so the extremes of every segment in a
+ * buffer are copied back together, in one small download per buffer.
+ */
+class HistogramBlock: public ArrayFireBlock
+{
+    public:
+
+        static Pothos::Block* make(
+            const std::string& device,
+            const Pothos::DType& dtype,
+            size_t numBins,
+            size_t emitInterval)
+        {
+            validateDType(dtype, DTypeSupport({true,true,true,false}));
+
+            return new HistogramBlock(device, dtype, numBins, emitInterval);
+        }
+
+        HistogramBlock(
+            const std::string& device,
+            const Pothos::DType& dtype,
+            size_t numBins,
+            size_t emitInterval
+        ):
+            ArrayFireBlock(device),
+            _afDType(Pothos::Object(dtype).convert<af::dtype>()),
+            _numBins(numBins),
+            _emitInterval(0),
+            _rangeMode(HistogramRangeMode::Auto),
+            _outputMode(HistogramOutputMode::Accumulated),
+            _fixedMinValue(-1.0),
+            _fixedMaxValue(1.0),
+            _bins(numBins),
+            _numPending(0),
+            _numTotal(0)
+        {
+            this->setupInput(0, dtype, _domain);
+            this->setupOutput(0);
+
+            this->registerCall(this, POTHOS_FCN_TUPLE(HistogramBlock, numBins));
+            this->registerCall(this, POTHOS_FCN_TUPLE(HistogramBlock, emitInterval));
+            this->registerCall(this, POTHOS_FCN_TUPLE(HistogramBlock, setEmitInterval));
+            this->registerCall(this, POTHOS_FCN_TUPLE(HistogramBlock, rangeMode));
+            this->registerCall(this, POTHOS_FCN_TUPLE(HistogramBlock, setRangeMode));
+            this->registerCall(this, POTHOS_FCN_TUPLE(HistogramBlock, minValue));
+            this->registerCall(this, POTHOS_FCN_TUPLE(HistogramBlock, maxValue));
+            this->registerCall(this, POTHOS_FCN_TUPLE(HistogramBlock, setRange));
+            this->registerCall(this, POTHOS_FCN_TUPLE(HistogramBlock, outputMode));
+            this->registerCall(this, POTHOS_FCN_TUPLE(HistogramBlock, setOutputMode));
+            this->registerCall(this, POTHOS_FCN_TUPLE(HistogramBlock, counts));
+            this->registerCall(this, POTHOS_FCN_TUPLE(HistogramBlock, resetState));
+
+            this->registerProbe("rangeMode");
+            this->registerProbe("outputMode");
+            this->registerProbe("counts");
+
+            this->setEmitInterval(emitInterval);
+            this->resetState();
+        }
+
+        virtual ~HistogramBlock() = default;
+
+        void activate() override
+        {
+            // The range mode can be set after construction, so this is the
+            // first point where the number of bins is known to be used.
+            if(HistogramRangeMode::Auto == _rangeMode)
+            {
+                _bins.validateAutoRange();
+            }
+
+            ArrayFireBlock::activate();
+        }
+
+        size_t numBins() const
+        {
+            return _numBins;
+        }
+
+        size_t emitInterval() const
+        {
+            return _emitInterval;
+        }
+
+        // Takes effect with the next emission.
+        void setEmitInterval(size_t emitInterval)
+        {
+            if(0 == emitInterval)
+            {
+                throw Pothos::RangeException("Emit interval must be non-zero.");
+            }
+
+            _emitInterval = emitInterval;
+        }
+
+        std::string rangeMode() const
+        {
+            return getKeyForVal(HistogramRangeModeEnumMap, _rangeMode);
+        }
+
+        void setRangeMode(const std::string& rangeMode)
+        {
+            const auto newRangeMode = getValForKey(HistogramRangeModeEnumMap, rangeMode);
+            if(HistogramRangeMode::Auto == newRangeMode)
+            {
+                _bins.validateAutoRange();
+            }
+
+            _rangeMode = newRangeMode;
+            this->resetState();
+        }
+
+        // The current range of the bins
+        double minValue() const
+        {
+            return _bins.minValue();
+        }
+
+        double maxValue() const
+        {
+            return _bins.maxValue();
+        }
+
+        void setRange(
+            double minValue,
+            double maxValue)
+        {
+            if(!(minValue < maxValue))
+            {
+                throw Pothos::RangeException("The minimum value must be less than the maximum value.");
+            }
+
+            _fixedMinValue = minValue;
+            _fixedMaxValue = maxValue;
+            this->resetState();
+        }
+
+        std::string outputMode() const
+        {
+            return getKeyForVal(HistogramOutputModeEnumMap, _outputMode);
+        }
+
+        void setOutputMode(const std::string& outputMode)
+        {
+            _outputMode = getValForKey(HistogramOutputModeEnumMap, outputMode);
+            this->resetState();
+        }
+
+        // The counts that would be emitted now
+        std::vector<unsigned long long> counts() const
+        {
+            this->configArrayFire();
+
+            std::vector<unsigned long long> counts(_numBins);
+            _afCounts.host(counts.data());
+
+            return counts;
+        }
+
+        void resetState() override
+        {
+            this->configArrayFire();
+
+            _afCounts = af::constant(0, static_cast<dim_t>(_numBins), ::u64);
+            _numPending = 0;
+            _numTotal = 0;
+            if(HistogramRangeMode::Fixed == _rangeMode)
+            {
+                _bins.setRange(_fixedMinValue, _fixedMaxValue);
+            }
+            else
+            {
+                _bins.reset();
+            }
+        }
+
+        void work() override
+        {
+            WorkTimer workTimer(this);
+
+            const size_t elems = this->workInfo().minInElements;
+            if(0 == elems)
+            {
+                return;
+            }
+
+            this->configArrayFire();
+
+            auto afInput = af::flat(this->getInputElementsAsAfArray(0, elems));
+
+            // Split wherever an emission is due.
+            std::vector<size_t> segmentLengths;
+            for(size_t offset = 0, numPending = _numPending; offset < elems;)
+            {
+                const size_t segmentLength = std::min(_emitInterval - numPending, elems - offset);
+                segmentLengths.emplace_back(segmentLength);
+
+                offset += segmentLength;
+                numPending = (numPending + segmentLength) % _emitInterval;
+            }
+
+            std::vector<double> extremes;
+            if(HistogramRangeMode::Auto == _rangeMode)
+            {
+                extremes = _getSegmentExtremes(afInput, segmentLengths);
+            }
+
+            size_t offset = 0;
+            for(size_t segment = 0; segment < segmentLengths.size(); ++segment)
+            {
+                const size_t segmentLength = segmentLengths[segment];
+                if(!extremes.empty())
+                {
+                    _bins.expand(
+                        extremes[segment],
+                        extremes[segmentLengths.size() + segment],
+                        _afCounts);
+                }
+
+                _accumulate(afInput(af::seq(
+                                static_cast<double>(offset),
+                                static_cast<double>(offset + segmentLength - 1))));
+
+                offset += segmentLength;
+                _numPending += segmentLength;
+                _numTotal += segmentLength;
+
+                if(_numPending >= _emitInterval) _emit();
+            }
+        }
+
+    protected:
+
+        void prewarmKernels() override
+        {
+            const auto& dtype = this->input(0)->dtype();
+
+            const auto afInput = af::range(
+                                     af::dim4(static_cast<dim_t>(this->getPrewarmElements(dtype))),
+                                     0,
+                                     _afDType);
+
+            this->resetState();
+            if(HistogramRangeMode::Auto == _rangeMode)
+            {
+                const auto extremes = _getSegmentExtremes(afInput, {static_cast<size_t>(afInput.elements())});
+                _bins.expand(extremes[0], extremes[1], _afCounts);
+            }
+            _accumulate(afInput);
+            _afCounts.eval();
+        }
+
+    private:
+        af::dtype _afDType;
+        size_t _numBins;
+        size_t _emitInterval;
+
+        HistogramRangeMode _rangeMode;
+        HistogramOutputMode _outputMode;
+
+        double _fixedMinValue;
+        double _fixedMaxValue;
+
+        AutoRangeBins _bins;
+
+        af::array _afCounts;
+
+        // Samples since the last emission, and since the last reset
+        size_t _numPending;
+        unsigned long long _numTotal;
+
+        /*
+         * Returns every segment's minimum, followed by every segment's
+         * maximum, from one copy. Only the first and last segments can be
+         * partial, so the rest are reduced as the columns of one matrix.
+         */
+        std::vector<double> _getSegmentExtremes(
+            const af::array& afInput,
+            const std::vector<size_t>& segmentLengths) const
+        {
+            const size_t numSegments = segmentLengths.size();
+            const auto afFlatInput = afInput.as(::f64);
+
+            const auto segment = [&afFlatInput](size_t first, size_t length) -> af::array
+            {
+                return afFlatInput(af::seq(
+                           static_cast<double>(first),
+                           static_cast<double>(first + length - 1)));
+            };
+            const auto append = [](af::array& afAll, const af::array& afNew)
+            {
+                afAll = afAll.isempty() ? afNew : af::join(0, afAll, afNew);
+            };
+
+            af::array afMins;
+            af::array afMaxs;
+            size_t offset = 0;
+            size_t index = 0;
+
+            // The first segment may only finish the previous emission.
+            if((numSegments > 1) && (segmentLengths[0] != _emitInterval))
+            {
+                const auto afFirst = segment(0, segmentLengths[0]);
+                append(afMins, af::min(afFirst));
+                append(afMaxs, af::max(afFirst));
+
+                offset += segmentLengths[0];
+                ++index;
+            }
+
+            size_t numFull = 0;
+            while(((index + numFull) < numSegments) && (segmentLengths[index + numFull] == _emitInterval))
+            {
+                ++numFull;
+            }
+            if(numFull > 0)
+            {
+                const auto afFull = af::moddims(
+                                        segment(offset, numFull * _emitInterval),
+                                        static_cast<dim_t>(_emitInterval),
+                                        static_cast<dim_t>(numFull));
+                append(afMins, af::flat(af::min(afFull, 0)));
+                append(afMaxs, af::flat(af::max(afFull, 0)));
+
+                offset += numFull * _emitInterval;
+                index += numFull;
+            }
+
+            if(index < numSegments)
+            {
+                const auto afLast = segment(offset, segmentLengths[index]);
+                append(afMins, af::min(afLast));
+                append(afMaxs, af::max(afLast));
+            }
+
+            std::vector<double> extremes(2 * numSegments);
+            af::join(0, afMins, afMaxs).host(extremes.data());
+
+            return extremes;
+        }
+
+        // In the fixed mode, out-of-range values are counted in the
+        // nearest bin, as af::histogram clamps them.
+        void _accumulate(const af::array& afInput)
+        {
+            _afCounts += af::histogram(
+                             afInput,
+                             static_cast<unsigned>(_numBins),
+                             _bins.minValue(),
+                             _bins.maxValue()).as(::u64);
+        }
+
+        void _emit()
+        {
+            Pothos::Packet packet;
+            packet.payload = Pothos::Object(_afCounts).convert<Pothos::BufferChunk>();
+            packet.metadata["minValue"] = Pothos::Object(_bins.minValue());
+            packet.metadata["maxValue"] = Pothos::Object(_bins.maxValue());
+            packet.metadata["numSamples"] = Pothos::Object(static_cast<unsigned long long>(_numPending));
+            packet.metadata["totalSamples"] = Pothos::Object(_numTotal);
+
+            this->output(0)->postMessage(std::move(packet));
+
+            if(HistogramOutputMode::Delta == _outputMode)
+            {
+                _afCounts = af::constant(0, static_cast<dim_t>(_numBins), ::u64);
+            }
+            _numPending = 0;
+        }
+};
+
+//
+// Block registration
+//
+
+/*
+ * |PothosDoc Histogram (GPU)
+ *
+ * Bins every input on the device and emits the counts as a packet every
+ * <b>emitInterval</b> samples. The payload holds the <b>uint64</b> counts,
+ * and the metadata holds the bins' range (<b>"minValue"</b> and
+ * <b>"maxValue"</b>), the number of samples since the last packet
+ * (<b>"numSamples"</b>), and the number since the last reset
+ * (<b>"totalSamples"</b>). The counts are only copied back from the
+ * device once per packet. In the auto range mode, each input buffer's
+ * extremes are also copied back, in one small download, to check whether
+ * the range has to grow.
+ *
+ * |category /GPU/Statistics
+ * |keywords statistics stats histogram bins distribution counts
+ * |factory /gpu/statistics/histogram(device,dtype,numBins,emitInterval)
+ * |setter setRangeMode(rangeMode)
+ * |setter setRange(minValue,maxValue)
+ * |setter setOutputMode(outputMode)
+ *
+ * |param device[Device] Device to use for processing.
+ * |default "Auto"
+ *
+ * |param dtype[Data Type] The input's data type.
+ * |widget DTypeChooser(int=1,uint=1,float=1,dim=1)
+ * |default "float32"
+ * |preview disable
+ *
+ * |param numBins[Bins] The number of bins. In the auto range mode, this must
+ * be even.
+ * |widget SpinBox(minimum=1)
+ * |default 256
+ * |preview enable
+ *
+ * |param emitInterval[Emit Interval] The number of samples per packet.
+ * |widget SpinBox(minimum=1)
+ * |default 1000000
+ * |preview enable
+ *
+ * |param rangeMode[Range Mode] How the bins' range is chosen.
+ * <ul>
+ * <li><b>Auto:</b> the range starts out spanning the first samples and
+ * doubles whenever a sample falls outside of it</li>
+ * <li><b>Fixed:</b> the range is <b>[minValue, maxValue]</b>, and values
+ * outside of it are counted in the nearest bin</li>
+ * </ul>
+ * |widget ComboBox(editable=false)
+ * |option [Auto] "auto"
+ * |option [Fixed] "fixed"
+ * |default "auto"
+ * |preview enable
+ *
+ * |param minValue[Min Value] In the fixed mode, the lower edge of the first bin.
+ * |widget DoubleSpinBox()
+ * |default -1.0
+ * |preview disable
+ *
+ * |param maxValue[Max Value] In the fixed mode, the upper edge of the last bin.
+ * |widget DoubleSpinBox()
+ * |default 1.0
+ * |preview disable
+ *
+ * |param outputMode[Output Mode] What each packet counts.
+ * <ul>
+ * <li><b>Accumulated:</b> every sample since activation or <b>"resetState"</b></li>
+ * <li><b>Delta:</b> only the samples since the last packet</li>
+ * </ul>
+ * |widget ComboBox(editable=false)
+ * |option [Accumulated] "accumulated"
+ * |option [Delta] "delta"
+ * |default "accumulated"
+ * |preview enable
+ */
+static Pothos::BlockRegistry registerHistogram(
+    "/gpu/statistics/histogram",
+    Pothos::Callable(&HistogramBlock::make));
@@ -0,0 +1,319 @@
+// Copyright (c) 2021 Nicholas Corgan
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "LatencyHistogram.hpp"
+#include "Utility.hpp"
+
+#include <Pothos/Exception.hpp>
+
+#include <json.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <unordered_map>
+
+using json = nlohmann::json;
+
+//
+// Phases
+//
+
+static const std::unordered_map<std::string, LatencyPhase> LatencyPhaseEnumMap =
+{
+    {"work",     LatencyPhase::Work},
+    {"upload",   LatencyPhase::Upload},
+    {"compute",  LatencyPhase::Compute},
+    {"download", LatencyPhase::Download},
+};
+
+std::string latencyPhaseToString(LatencyPhase phase)
+{
+    switch(phase)
+    {
+        case LatencyPhase::Work:
+            return "work";
+
+        case LatencyPhase::Upload:
+            return "upload";
+
+        case LatencyPhase::Compute:
+            return "compute";
+
+        case LatencyPhase::Download:
+            return "download";
+
+        default:
+            throw Pothos::AssertionViolationException("Invalid latency phase");
+    }
+}
+
+LatencyPhase stringToLatencyPhase(const std::string& phase)
+{
+    return getValForKey(LatencyPhaseEnumMap, phase);
+}
+
+//
+// LatencyHistogram
+//
+
+static inline size_t mostSignificantBit(uint64_t value)
+{
+#if defined(__GNUG__) || defined(__clang__)
+    return 63 - static_cast<size_t>(__builtin_clzll(value));
+#else
+    size_t msb = 0;
+    while(value >>= 1) ++msb;
+    return msb;
+#endif
+}
+
+LatencyHistogram::LatencyHistogram()
+{
+    this->reset();
+}
+
+size_t LatencyHistogram::bucketIndex(uint64_t nanoseconds)
+{
+    if(nanoseconds < NumLinearBuckets)
+    {
+        return static_cast<size_t>(nanoseconds);
+    }
+
+    const size_t msb = mostSignificantBit(nanoseconds);
+    const size_t shift = msb - SubBucketBits;
+    const size_t subBucket = static_cast<size_t>(nanoseconds >> shift) & (NumSubBuckets - 1);
+
+    return NumLinearBuckets + ((msb - SubBucketBits - 1) * NumSubBuckets) + subBucket;
+}
+
+uint64_t LatencyHistogram::bucketLowerBound(size_t index)
+{
+    if(index < NumLinearBuckets)
+    {
+        return index;
+    }
+
+    const size_t offset = index - NumLinearBuckets;
+    const size_t msb = (offset / NumSubBuckets) + SubBucketBits + 1;
+    const uint64_t subBucket = offset % NumSubBuckets;
+
+    return (NumSubBuckets + subBucket) << (msb - SubBucketBits);
+}
+
+uint64_t LatencyHistogram::bucketUpperBound(size_t index)
+{
+    if(index < NumLinearBuckets)
+    {
+        return index;
+    }
+    else if(index == (NumBuckets - 1))
+    {
+        return std::numeric_limits<uint64_t>::max();
+    }
+
+    return bucketLowerBound(index + 1) - 1;
+}
+
+void LatencyHistogram::record(uint64_t nanoseconds)
+{
+    _buckets[bucketIndex(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+    _count.fetch_add(1, std::memory_order_relaxed);
+    _sum.fetch_add(nanoseconds, std::memory_order_relaxed);
+
+    auto currentMin = _min.load(std::memory_order_relaxed);
+    while((nanoseconds < currentMin) &&
+          !_min.compare_exchange_weak(currentMin, nanoseconds, std::memory_order_relaxed)) {}
+
+    auto currentMax = _max.load(std::memory_order_relaxed);
+    while((nanoseconds > currentMax) &&
+          !_max.compare_exchange_weak(currentMax, nanoseconds, std::memory_order_relaxed)) {}
+}
+
+void LatencyHistogram::reset()
+{
+    for(auto& bucket: _buckets)
+    {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+
+    _count.store(0, std::memory_order_relaxed);
+    _sum.store(0, std::memory_order_relaxed);
+    _min.store(std::numeric_limits<uint64_t>::max(), std::memory_order_relaxed);
+    _max.store(0, std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::count() const
+{
+    return _count.load(std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::minimum() const
+{
+    return (0 == this->count()) ? 0 : _min.load(std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::maximum() const
+{
+    return _max.load(std::memory_order_relaxed);
+}
+
+double LatencyHistogram::mean() const
+{
+    const auto count = this->count();
+
+    return (0 == count) ? 0.0
+                        : (static_cast<double>(_sum.load(std::memory_order_relaxed)) / count);
+}
+
+double LatencyHistogram::percentile(double pct) const
+{
+    if((pct < 0.0) || (pct > 100.0))
+    {
+        throw Pothos::RangeException(
+                  "Percentile must be in the range [0,100]",
+                  std::to_string(pct));
+    }
+
+    // Take a local copy so the total matches the buckets we walk.
+    std::array<uint64_t, NumBuckets> buckets;
+    uint64_t total = 0;
+    for(size_t i = 0; i < NumBuckets; ++i)
+    {
+        buckets[i] = _buckets[i].load(std::memory_order_relaxed);
+        total += buckets[i];
+    }
+    if(0 == total)
+    {
+        return 0.0;
+    }
+
+    const auto rank = std::max<uint64_t>(
+                          1,
+                          static_cast<uint64_t>(std::ceil((pct / 100.0) * total)));
+
+    uint64_t cumulative = 0;
+    for(size_t i = 0; i < NumBuckets; ++i)
+    {
+        cumulative += buckets[i];
+        if(cumulative >= rank)
+        {
+            const double lower = static_cast<double>(bucketLowerBound(i));
+            const double upper = static_cast<double>(bucketUpperBound(i));
+            const double midpoint = lower + ((upper - lower) / 2.0);
+
+            // The extremes are tracked exactly, so don't report past them.
+            return std::min(
+                       std::max(midpoint, static_cast<double>(this->minimum())),
+                       static_cast<double>(this->maximum()));
+        }
+    }
+
+    return static_cast<double>(this->maximum());
+}
+
+//
+// BlockLatencyStats
+//
+
+static std::mutex& getRegistryMutex()
+{
+    static std::mutex registryMutex;
+    return registryMutex;
+}
+
+static std::vector<std::weak_ptr<BlockLatencyStats>>& getRegistry()
+{
+    static std::vector<std::weak_ptr<BlockLatencyStats>> registry;
+    return registry;
+}
+
+BlockLatencyStats::SPtr BlockLatencyStats::make()
+{
+    // The constructor is private, so we can't use std::make_shared.
+    SPtr stats(new BlockLatencyStats);
+
+    std::lock_guard<std::mutex> lock(getRegistryMutex());
+    auto& registry = getRegistry();
+    registry.erase(
+        std::remove_if(
+            registry.begin(),
+            registry.end(),
+            [](const std::weak_ptr<BlockLatencyStats>& entry){return entry.expired();}),
+        registry.end());
+    registry.emplace_back(stats);
+
+    return stats;
+}
+
+std::string BlockLatencyStats::name() const
+{
+    std::lock_guard<std::mutex> lock(_nameMutex);
+    return _name;
+}
+
+void BlockLatencyStats::setName(const std::string& name)
+{
+    std::lock_guard<std::mutex> lock(_nameMutex);
+    _name = name;
+}
+
+LatencyHistogram& BlockLatencyStats::histogram(LatencyPhase phase)
+{
+    return _histograms[static_cast<size_t>(phase)];
+}
+
+const LatencyHistogram& BlockLatencyStats::histogram(LatencyPhase phase) const
+{
+    return _histograms[static_cast<size_t>(phase)];
+}
+
+void BlockLatencyStats::reset()
+{
+    for(auto& histogram: _histograms)
+    {
+        histogram.reset();
+    }
+}
+
+std::string BlockLatencyStats::toJSONString() const
+{
+    static constexpr double nsPerUs = 1e3;
+
+    json topObj;
+    topObj["name"] = this->name();
+
+    auto& phasesObj = topObj["phases"];
+    for(size_t phaseIndex = 0; phaseIndex < NumLatencyPhases; ++phaseIndex)
+    {
+        const auto phase = static_cast<LatencyPhase>(phaseIndex);
+        const auto& histogram = this->histogram(phase);
+
+        json phaseObj;
+        phaseObj["count"] = histogram.count();
+        phaseObj["minUs"] = histogram.minimum() / nsPerUs;
+        phaseObj["maxUs"] = histogram.maximum() / nsPerUs;
+        phaseObj["meanUs"] = histogram.mean() / nsPerUs;
+        phaseObj["p50Us"] = histogram.percentile(50.0) / nsPerUs;
+        phaseObj["p99Us"] = histogram.percentile(99.0) / nsPerUs;
+        phaseObj["p999Us"] = histogram.percentile(99.9) / nsPerUs;
+
+        phasesObj[latencyPhaseToString(phase)] = phaseObj;
+    }
+
+    return topObj.dump();
+}
+
+std::vector<BlockLatencyStats::SPtr> getLiveBlockLatencyStats()
+{
+    std::vector<BlockLatencyStats::SPtr> ret;
+
+    std::lock_guard<std::mutex> lock(getRegistryMutex());
+    for(const auto& entry: getRegistry())
+    {
+        auto stats = entry.lock();
+        if(stats) ret.emplace_back(std::move(stats));
+    }
+
+    return ret;
+}
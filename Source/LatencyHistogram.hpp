@@ -0,0 +1,126 @@
+// Copyright (c) 2021 Nicholas Corgan
+// SPDX-License-Identifier: BSD-3-Clause
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+//
+// Phases of ArrayFireBlock::work()
+//
+
+enum class LatencyPhase
+{
+    // work() end to end
+    Work = 0,
+
+    // Input BufferChunk -> af::array
+    Upload,
+
+    // Evaluating output arrays: JIT compilation and kernel launches, without
+    // waiting for them to finish
+    Compute,
+
+    // af::array -> output buffer, including waiting for the array's kernels
+    Download,
+
+    NumPhases
+};
+
+static constexpr size_t NumLatencyPhases = static_cast<size_t>(LatencyPhase::NumPhases);
+
+std::string latencyPhaseToString(LatencyPhase phase);
+
+LatencyPhase stringToLatencyPhase(const std::string& phase);
+
+using LatencyClock = std::chrono::steady_clock;
+
+//
+// Lock-free log-linear histogram of nanosecond latencies. Each power of two
+// is split into 8 linear sub-buckets, so values are bucketed with at most
+// 12.5% error.
+//
+
+class LatencyHistogram
+{
+    public:
+        static constexpr size_t SubBucketBits = 3;
+        static constexpr size_t NumSubBuckets = (1 << SubBucketBits);
+        static constexpr size_t NumLinearBuckets = (NumSubBuckets << 1);
+        static constexpr size_t NumBuckets = NumLinearBuckets + ((64 - SubBucketBits - 1) * NumSubBuckets);
+
+        LatencyHistogram();
+
+        void record(uint64_t nanoseconds);
+
+        void reset();
+
+        uint64_t count() const;
+
+        uint64_t minimum() const;
+
+        uint64_t maximum() const;
+
+        double mean() const;
+
+        // Returns the approximate latency in nanoseconds at the given
+        // percentile, in the range [0,100].
+        double percentile(double pct) const;
+
+        static size_t bucketIndex(uint64_t nanoseconds);
+
+        static uint64_t bucketLowerBound(size_t index);
+
+        static uint64_t bucketUpperBound(size_t index);
+
+    private:
+        std::array<std::atomic<uint64_t>, NumBuckets> _buckets;
+        std::atomic<uint64_t> _count;
+        std::atomic<uint64_t> _sum;
+        std::atomic<uint64_t> _min;
+        std::atomic<uint64_t> _max;
+};
+
+//
+// All histograms for a single block. Live instances are tracked globally
+// so they can be dumped without access to the block itself.
+//
+
+class BlockLatencyStats
+{
+    public:
+        using SPtr = std::shared_ptr<BlockLatencyStats>;
+
+        static SPtr make();
+
+        std::string name() const;
+
+        void setName(const std::string& name);
+
+        LatencyHistogram& histogram(LatencyPhase phase);
+
+        const LatencyHistogram& histogram(LatencyPhase phase) const;
+
+        void reset();
+
+        // JSON object with count/min/max/mean/p50/p99/p999 per phase, in
+        // microseconds.
+        std::string toJSONString() const;
+
+    private:
+        BlockLatencyStats() = default;
+
+        mutable std::mutex _nameMutex;
+        std::string _name;
+
+        std::array<LatencyHistogram, NumLatencyPhases> _histograms;
+};
+
+std::vector<BlockLatencyStats::SPtr> getLiveBlockLatencyStats();
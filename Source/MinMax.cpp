@@ -45,6 +45,8 @@ class MinMax: public ArrayFireBlock
 
         void work() override
         {
+            WorkTimer workTimer(this);
+
             const size_t elems = this->workInfo().minElements;
             if(0 == elems)
             {
@@ -0,0 +1,164 @@
+// Copyright (c) 2021 Nicholas Corgan
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "DeviceCache.hpp"
+#include "FFTPlanCache.hpp"
+#include "Tracing.hpp"
+#include "Utility.hpp"
+
+#include <Pothos/Exception.hpp>
+#include <Pothos/Plugin.hpp>
+
+#include <Poco/Environment.h>
+#include <Poco/File.h>
+#include <Poco/Logger.h>
+#include <Poco/NumberParser.h>
+
+#include <arrayfire.h>
+
+#include <cstring>
+#include <string>
+
+static Poco::Logger& getLogger()
+{
+    auto& logger = Poco::Logger::get("PothosGPU");
+    return logger;
+}
+
+//
+// Kernel cache
+//
+
+static const std::string KernelCacheDirEnvVar = "POTHOSGPU_KERNEL_CACHE_DIR";
+
+static std::string getKernelCacheDirectory()
+{
+#if AF_API_VERSION >= 38
+    // The cache directory is global, so any backend will give us the same value.
+    size_t length = 0;
+    af_get_kernel_cache_directory(&length, nullptr);
+
+    std::string ret(length, '\0');
+    if(length > 0)
+    {
+        af_get_kernel_cache_directory(&length, &ret[0]);
+        ret.resize(strlen(ret.c_str()));
+    }
+
+    return ret;
+#else
+    throw Pothos::NotImplementedException("Setting the kernel cache directory is only available with ArrayFire 3.8+.");
+#endif
+}
+
+static void setKernelCacheDirectory(const std::string& directory)
+{
+#if AF_API_VERSION >= 38
+    Poco::File(directory).createDirectories();
+
+    // Only the JIT backends use the kernel cache, but each one has its
+    // own copy of this setting.
+    const auto activeBackend = af::getActiveBackend();
+    for(auto backend: getAvailableBackends())
+    {
+        af::setBackend(backend);
+
+        // Override the environment variable, since this is an explicit call.
+        const auto err = af_set_kernel_cache_directory(directory.c_str(), 1);
+        if(AF_SUCCESS != err)
+        {
+            af::setBackend(activeBackend);
+            throw Pothos::RuntimeException(
+                      "Failed to set kernel cache directory",
+                      directory);
+        }
+    }
+    af::setBackend(activeBackend);
+#else
+    (void)directory;
+    throw Pothos::NotImplementedException("Setting the kernel cache directory is only available with ArrayFire 3.8+.");
+#endif
+}
+
+//
+// FFT plan cache
+//
+
+static const std::string FFTPlanCacheSizeEnvVar = "POTHOSGPU_FFT_PLAN_CACHE_SIZE";
+
+//
+// Tracing
+//
+
+static const std::string TraceFileEnvVar = "POTHOSGPU_TRACE_FILE";
+
+pothos_static_block(registerGPUModuleConfig)
+{
+    Pothos::PluginRegistry::addCall(
+        "/gpu/config/kernel_cache_dir", &getKernelCacheDirectory);
+    Pothos::PluginRegistry::addCall(
+        "/gpu/config/set_kernel_cache_dir", &setKernelCacheDirectory);
+
+    Pothos::PluginRegistry::addCall(
+        "/gpu/config/fft_plan_cache_size", &getFFTPlanCacheSize);
+    Pothos::PluginRegistry::addCall(
+        "/gpu/config/set_fft_plan_cache_size", &setFFTPlanCacheSize);
+
+    Pothos::PluginRegistry::addCall(
+        "/gpu/config/tracing_enabled", &isTracingEnabled);
+    Pothos::PluginRegistry::addCall(
+        "/gpu/config/set_tracing_enabled", &setTracingEnabled);
+    Pothos::PluginRegistry::addCall(
+        "/gpu/config/trace_file", &traceFilepath);
+    Pothos::PluginRegistry::addCall(
+        "/gpu/config/set_trace_file", &setTraceFilepath);
+    Pothos::PluginRegistry::addCall(
+        "/gpu/config/dump_trace", &dumpChromeTrace);
+    Pothos::PluginRegistry::addCall(
+        "/gpu/config/write_trace", &writeChromeTrace);
+    Pothos::PluginRegistry::addCall(
+        "/gpu/config/clear_trace", &clearTrace);
+
+    // Allow setting this without code changes, as it needs to be set before
+    // any block is activated to be useful.
+    if(Poco::Environment::has(KernelCacheDirEnvVar))
+    {
+        const auto directory = Poco::Environment::get(KernelCacheDirEnvVar);
+        try
+        {
+            setKernelCacheDirectory(directory);
+        }
+        catch(const Pothos::Exception& ex)
+        {
+            poco_error_f2(
+                getLogger(),
+                "Could not set kernel cache directory to %s: %s",
+                directory,
+                ex.displayText());
+        }
+    }
+
+    if(Poco::Environment::has(FFTPlanCacheSizeEnvVar))
+    {
+        const auto cacheSize = Poco::Environment::get(FFTPlanCacheSizeEnvVar);
+        try
+        {
+            setFFTPlanCacheSize(static_cast<size_t>(Poco::NumberParser::parseUnsigned64(cacheSize)));
+        }
+        catch(const Poco::Exception& ex)
+        {
+            poco_error_f2(
+                getLogger(),
+                "Could not set FFT plan cache size to %s: %s",
+                cacheSize,
+                ex.displayText());
+        }
+    }
+
+    // Setting a trace file implies tracing should be enabled.
+    if(Poco::Environment::has(TraceFileEnvVar))
+    {
+        setTraceFilepath(Poco::Environment::get(TraceFileEnvVar));
+        setTracingEnabled(true);
+    }
+}
@@ -1,7 +1,8 @@
-// Copyright (c) 2019 Nicholas Corgan
+// Copyright (c) 2019,2021 Nicholas Corgan
 // SPDX-License-Identifier: BSD-3-Clause
 
 #include "DeviceCache.hpp"
+#include "LatencyHistogram.hpp"
 #include "Utility.hpp"
 
 #include <Pothos/Plugin.hpp>
@@ -71,8 +72,23 @@ static std::string enumerateArrayFireDevices()
     return devs;
 }
 
+// Not cached, since this is a snapshot of the blocks alive at the time
+// of the call.
+static std::string dumpLatencyStats()
+{
+    json topObject(json::array());
+    for(const auto& stats: getLiveBlockLatencyStats())
+    {
+        topObject.push_back(json::parse(stats->toJSONString()));
+    }
+
+    return topObject.dump();
+}
+
 pothos_static_block(registerGPUInfo)
 {
     Pothos::PluginRegistry::addCall(
         "/devices/gpu/info", &enumerateArrayFireDevices);
+    Pothos::PluginRegistry::addCall(
+        "/devices/gpu/latency_stats", &dumpLatencyStats);
 }
@@ -0,0 +1,340 @@
+// Copyright (c) 2021 Nicholas Corgan
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "ArrayFireBlock.hpp"
+#include "Utility.hpp"
+
+#include <Pothos/Exception.hpp>
+#include <Pothos/Framework.hpp>
+#include <Pothos/Object.hpp>
+
+#include <arrayfire.h>
+
+#include <algorithm>
+#include <complex>
+#include <string>
+
+//
+// Misc
+//
+
+enum class MovingStat
+{
+    Mean,
+    RMS,
+    Variance
+};
+
+//
+// Block class
+//
+
+/*
+ * Each output is a sum over the last W inputs, which is the difference of
+ * two entries of a prefix sum (af::accum) over the buffer with the last W-1
+ * inputs prepended. The prefix sum restarts with every buffer, so rounding
+ * error doesn't build up over the stream, and the cost per buffer is
+ * proportional to the buffer size plus W rather than their product.
+ *
+ * The prefix sums grow much larger than any one window's sum, and the
+ * variance is the difference of two close sums, so in single precision,
+ * both would cancel away most of the result. They're taken in double
+ * precision, which the device cache requires of every device, and only the
+ * outputs are converted back.
+ *
+ * Until W inputs have been seen, outputs are over every input so far.
+ */
+template <typename T, typename Real>
+class MovingStatsBlock: public ArrayFireBlock
+{
+    public:
+        using InType = T;
+        using Class = MovingStatsBlock<T, Real>;
+
+        MovingStatsBlock(
+            const std::string& device,
+            MovingStat stat,
+            size_t windowSize
+        ):
+            ArrayFireBlock(device),
+            _afDType(Pothos::Object(Pothos::DType(typeid(InType))).convert<af::dtype>()),
+            _afRealDType(Pothos::Object(Pothos::DType(typeid(Real))).convert<af::dtype>()),
+            _stat(stat),
+            _windowSize(windowSize),
+            _numSeen(0)
+        {
+            if(0 == _windowSize)
+            {
+                throw Pothos::InvalidArgumentException("Window size must be non-zero.");
+            }
+
+            static const Pothos::DType inDType(typeid(InType));
+            static const Pothos::DType realDType(typeid(Real));
+
+            // The mean keeps complex inputs complex, but the others are
+            // always real.
+            this->setupInput(0, inDType, _domain);
+            this->setupOutput(
+                0,
+                (MovingStat::Mean == _stat) ? inDType : realDType,
+                _domain);
+
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, windowSize));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, resetState));
+
+            this->resetState();
+        }
+
+        virtual ~MovingStatsBlock() = default;
+
+        size_t windowSize() const
+        {
+            return _windowSize;
+        }
+
+        void resetState() override
+        {
+            if(_windowSize > 1)
+            {
+                this->configArrayFire();
+
+                _afHistory = af::constant(0, static_cast<dim_t>(_windowSize - 1), _afDType);
+            }
+            _numSeen = 0;
+        }
+
+        void work() override
+        {
+            WorkTimer workTimer(this);
+
+            const size_t elems = this->workInfo().minElements;
+            if(0 == elems) return;
+
+            this->configArrayFire();
+
+            auto afInput = this->getInputPortAsAfArray(0);
+            this->produceFromAfArray(0, _compute(afInput));
+        }
+
+    protected:
+
+        void prewarmKernels() override
+        {
+            const auto& dtype = this->input(0)->dtype();
+
+            this->resetState();
+            _compute(af::constant(
+                         0,
+                         this->getPrewarmElements(dtype),
+                         _afDType)).eval();
+        }
+
+    private:
+        af::dtype _afDType;
+        af::dtype _afRealDType;
+
+        MovingStat _stat;
+        size_t _windowSize;
+
+        // The last W-1 inputs, oldest first
+        af::array _afHistory;
+
+        // Capped at W
+        size_t _numSeen;
+
+        // Each output's sum over its window
+        af::array _windowSums(
+            const af::array& afExtended,
+            dim_t numOutputs) const
+        {
+            auto afPrefixSums = af::join(
+                                    0,
+                                    af::constant(0, 1, afExtended.type()),
+                                    af::accum(afExtended));
+
+            return afPrefixSums(af::seq(static_cast<double>(_windowSize), static_cast<double>(_windowSize + numOutputs - 1)))
+                 - afPrefixSums(af::seq(0.0, static_cast<double>(numOutputs - 1)));
+        }
+
+        af::array _compute(const af::array& afInput)
+        {
+            const dim_t numInputs = afInput.elements();
+            const dim_t historyLength = static_cast<dim_t>(_windowSize - 1);
+
+            auto afExtended = (historyLength > 0) ? af::join(0, _afHistory, afInput)
+                                                  : afInput;
+
+            const auto afWideExtended = afExtended.as(afExtended.iscomplex() ? ::c64 : ::f64);
+
+            // The number of inputs actually in each window
+            auto afCounts = af::min(
+                                af::range(af::dim4(numInputs), 0, ::f64) + static_cast<double>(_numSeen + 1),
+                                static_cast<double>(_windowSize));
+
+            af::array afOutput;
+            if(MovingStat::Mean == _stat)
+            {
+                afOutput = (_windowSums(afWideExtended, numInputs) / afCounts).as(_afDType);
+            }
+            else
+            {
+                auto afMeanSquares = _windowSums(af::pow(af::abs(afWideExtended), 2), numInputs) / afCounts;
+                if(MovingStat::RMS == _stat)
+                {
+                    afOutput = af::sqrt(af::max(afMeanSquares, 0.0)).as(_afRealDType);
+                }
+                else
+                {
+                    auto afMeans = _windowSums(afWideExtended, numInputs) / afCounts;
+
+                    // Rounding can make this slightly negative.
+                    afOutput = af::max(afMeanSquares - af::pow(af::abs(afMeans), 2), 0.0).as(_afRealDType);
+                }
+            }
+
+            if(historyLength > 0)
+            {
+                const dim_t extendedLength = afExtended.elements();
+                _afHistory = afExtended(af::seq(
+                                            static_cast<double>(extendedLength - historyLength),
+                                            static_cast<double>(extendedLength - 1))).copy();
+            }
+            _numSeen = std::min(_windowSize, _numSeen + static_cast<size_t>(numInputs));
+
+            return afOutput;
+        }
+};
+
+//
+// Factory
+//
+
+static Pothos::Block* makeMovingStats(
+    const std::string& device,
+    const Pothos::DType& dtype,
+    size_t windowSize,
+    MovingStat stat)
+{
+    if(1 != dtype.dimension())
+    {
+        throw Pothos::InvalidArgumentException(
+                  "This block does not support multi-dimensional types.",
+                  dtype.toString());
+    }
+
+    #define ifTypeDeclareFactory(T, Real) \
+        if(Pothos::DType::fromDType(dtype, 1) == Pothos::DType(typeid(T))) \
+            return new MovingStatsBlock<T, Real>(device, stat, windowSize);
+
+    ifTypeDeclareFactory(float, float)
+    ifTypeDeclareFactory(double, double)
+    ifTypeDeclareFactory(std::complex<float>, float)
+    ifTypeDeclareFactory(std::complex<double>, double)
+    #undef ifTypeDeclareFactory
+
+    throw Pothos::InvalidArgumentException(
+              "Unsupported type.",
+              dtype.name());
+}
+
+//
+// Block registration
+//
+
+/*
+ * |PothosDoc Moving Mean (GPU)
+ *
+ * Outputs the mean of the last <b>windowSize</b> inputs for every input,
+ * using a prefix sum on the device, so the cost per sample doesn't depend
+ * on the window size. The window is carried across buffers, and
+ * <b>"resetState"</b> clears it. Until the window fills, each output is
+ * the mean of every input so far.
+ *
+ * |category /GPU/Statistics
+ * |keywords statistics stats moving sliding running average mean boxcar
+ * |factory /gpu/statistics/moving_mean(device,dtype,windowSize)
+ *
+ * |param device[Device] Device to use for processing.
+ * |default "Auto"
+ *
+ * |param dtype[Data Type] The input and output data type.
+ * |widget DTypeChooser(float=1,cfloat=1)
+ * |default "float32"
+ * |preview disable
+ *
+ * |param windowSize[Window Size] The number of inputs per output.
+ * |widget SpinBox(minimum=1)
+ * |default 1024
+ * |preview enable
+ */
+static Pothos::BlockRegistry registerMovingMean(
+    "/gpu/statistics/moving_mean",
+    Pothos::Callable(&makeMovingStats).bind(MovingStat::Mean, 3));
+
+/*
+ * |PothosDoc Moving RMS (GPU)
+ *
+ * Outputs the root mean square of the last <b>windowSize</b> inputs for
+ * every input, as used for AGC and squelch. Complex inputs use their
+ * magnitude, and the output is always real.
+ *
+ * This uses a prefix sum on the device, so the cost per sample doesn't
+ * depend on the window size. The window is carried across buffers, and
+ * <b>"resetState"</b> clears it. Until the window fills, each output is
+ * over every input so far.
+ *
+ * |category /GPU/Statistics
+ * |keywords statistics stats moving sliding running root mean square power agc squelch
+ * |factory /gpu/statistics/moving_rms(device,dtype,windowSize)
+ *
+ * |param device[Device] Device to use for processing.
+ * |default "Auto"
+ *
+ * |param dtype[Data Type] The input data type. The output is real with the
+ * same precision.
+ * |widget DTypeChooser(float=1,cfloat=1)
+ * |default "complex_float32"
+ * |preview disable
+ *
+ * |param windowSize[Window Size] The number of inputs per output.
+ * |widget SpinBox(minimum=1)
+ * |default 1024
+ * |preview enable
+ */
+static Pothos::BlockRegistry registerMovingRMS(
+    "/gpu/statistics/moving_rms",
+    Pothos::Callable(&makeMovingStats).bind(MovingStat::RMS, 3));
+
+/*
+ * |PothosDoc Moving Variance (GPU)
+ *
+ * Outputs the population variance of the last <b>windowSize</b> inputs for
+ * every input. For complex inputs, this is the mean squared magnitude of
+ * each input's deviation from the mean, and the output is always real.
+ *
+ * This uses prefix sums of the inputs and their squares on the device, so
+ * the cost per sample doesn't depend on the window size. The window is
+ * carried across buffers, and <b>"resetState"</b> clears it. Until the
+ * window fills, each output is over every input so far.
+ *
+ * |category /GPU/Statistics
+ * |keywords statistics stats moving sliding running variance
+ * |factory /gpu/statistics/moving_var(device,dtype,windowSize)
+ *
+ * |param device[Device] Device to use for processing.
+ * |default "Auto"
+ *
+ * |param dtype[Data Type] The input data type. The output is real with the
+ * same precision.
+ * |widget DTypeChooser(float=1,cfloat=1)
+ * |default "float32"
+ * |preview disable
+ *
+ * |param windowSize[Window Size] The number of inputs per output.
+ * |widget SpinBox(minimum=1)
+ * |default 1024
+ * |preview enable
+ */
+static Pothos::BlockRegistry registerMovingVar(
+    "/gpu/statistics/moving_var",
+    Pothos::Callable(&makeMovingStats).bind(MovingStat::Variance, 3));
@@ -102,6 +102,8 @@ NToOneBlock::~NToOneBlock() {}
 
 void NToOneBlock::work()
 {
+    WorkTimer workTimer(this);
+
     const size_t elems = this->workInfo().minAllElements;
 
     if(0 == elems)
@@ -121,3 +123,19 @@ void NToOneBlock::work()
     if(_postBuffer) this->postAfArray(0, outputAfArray);
     else            this->produceFromAfArray(0, outputAfArray);
 }
+
+void NToOneBlock::prewarmKernels()
+{
+    const auto& dtype = this->input(0)->dtype();
+    auto afInput = af::constant(
+                       1,
+                       this->getPrewarmElements(dtype),
+                       Pothos::Object(dtype).convert<af::dtype>());
+
+    auto outputAfArray = afInput;
+    for(size_t chan = 1; chan < _nchans; ++chan)
+    {
+        outputAfArray = _func.call(outputAfArray, afInput).template extract<af::array>();
+    }
+    outputAfArray.eval();
+}
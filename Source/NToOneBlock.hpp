@@ -58,6 +58,10 @@ class NToOneBlock: public ArrayFireBlock
 
         void work() override;
 
+    protected:
+
+        void prewarmKernels() override;
+
     private:
         Pothos::Callable _func;
         size_t _nchans;
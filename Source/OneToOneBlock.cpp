@@ -122,6 +122,8 @@ OneToOneBlock::~OneToOneBlock() {}
 // Default behavior, can be overridden
 void OneToOneBlock::work()
 {
+    WorkTimer workTimer(this);
+
     // The thread may have changed since the block was created, so make sure
     // the backend and device still match.
     af::setBackend(_afBackend);
@@ -143,3 +145,19 @@ void OneToOneBlock::work()
 
     this->produceFromAfArray(0, afOutput);
 }
+
+void OneToOneBlock::prewarmKernels()
+{
+    const auto& dtype = this->input(0)->dtype();
+    auto afInput = af::constant(
+                       1,
+                       this->getPrewarmElements(dtype),
+                       Pothos::Object(dtype).convert<af::dtype>());
+
+    auto afOutput = _func.call(afInput).extract<af::array>();
+    if(afOutput.type() != _afOutputDType)
+    {
+        afOutput = afOutput.as(_afOutputDType);
+    }
+    afOutput.eval();
+}
@@ -66,6 +66,8 @@ class OneToOneBlock: public ArrayFireBlock
 
     protected:
 
+        void prewarmKernels() override;
+
         Pothos::Callable _func;
 
         // We need to store this since ArrayFire may change the output type.
@@ -0,0 +1,431 @@
+// Copyright (c) 2021 Nicholas Corgan
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "ArrayFireBlock.hpp"
+#include "FFTPlanCache.hpp"
+#include "Utility.hpp"
+
+#include <Pothos/Exception.hpp>
+#include <Pothos/Framework.hpp>
+#include <Pothos/Object.hpp>
+
+#include <Poco/Format.h>
+#include <Poco/NumberFormatter.h>
+
+#include <arrayfire.h>
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <numeric>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//
+// Windows
+//
+
+// Periodic generalized cosine windows, since the frames are used for DFTs
+static const std::unordered_map<std::string, std::vector<double>> WindowCoeffs =
+{
+    {"rectangular",    {1.0}},
+    {"hann",           {0.5, 0.5}},
+    {"hamming",        {0.54, 0.46}},
+    {"blackman",       {0.42, 0.5, 0.08}},
+    {"blackmanharris", {0.35875, 0.48829, 0.14128, 0.01168}},
+    {"flattop",        {0.21557895, 0.41663158, 0.277263158, 0.083578947, 0.006947368}},
+};
+
+static std::vector<double> getWindow(
+    const std::string& windowType,
+    size_t length)
+{
+    const auto& coeffs = getValForKey(WindowCoeffs, windowType);
+
+    std::vector<double> window(length, 0.0);
+    for(size_t n = 0; n < length; ++n)
+    {
+        double sign = 1.0;
+        for(size_t k = 0; k < coeffs.size(); ++k)
+        {
+            window[n] += sign * coeffs[k] * std::cos(2.0 * M_PI * double(k * n) / double(length));
+            sign = -sign;
+        }
+    }
+
+    return window;
+}
+
+//
+// Block class
+//
+
+/*
+ * Incoming samples are appended to whatever didn't fill a frame last time,
+ * and every complete frame is gathered into one column of a matrix, so the
+ * windowing, FFT, and |X|^2 are each a single batched operation per buffer.
+ * Power is accumulated on the device, and only complete averages are copied
+ * back.
+ */
+template <typename In, typename Real>
+class PSDBlock: public ArrayFireBlock
+{
+    public:
+        using InType = In;
+        using OutType = Real;
+        using Class = PSDBlock<In, Real>;
+
+        PSDBlock(
+            const std::string& device,
+            size_t frameSize,
+            size_t hop,
+            const std::string& windowType,
+            size_t averageCount
+        ):
+            ArrayFireBlock(device),
+            _afInputDType(Pothos::Object(Pothos::DType(typeid(InType))).convert<af::dtype>()),
+            _afComplexDType(Pothos::Object(Pothos::DType(typeid(std::complex<Real>))).convert<af::dtype>()),
+            _afOutputDType(Pothos::Object(Pothos::DType(typeid(OutType))).convert<af::dtype>()),
+            _frameSize(frameSize),
+            _hop(hop),
+            _averageCount(0), // Set with class setter
+            _numAccumulated(0)
+        {
+            if(0 == _frameSize)
+            {
+                throw Pothos::InvalidArgumentException("Frame size must be non-zero.");
+            }
+            if((0 == _hop) || (_hop > _frameSize))
+            {
+                throw Pothos::InvalidArgumentException(
+                          Poco::format(
+                              "Hop must be in the range [1,%s].",
+                              Poco::NumberFormatter::format(_frameSize)),
+                          Poco::NumberFormatter::format(_hop));
+            }
+
+            static const Pothos::DType inDType(typeid(InType));
+            static const Pothos::DType outDType(typeid(OutType));
+
+            this->setupInput(0, inDType, _domain);
+            this->setupOutput(0, outDType, _domain);
+
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, frameSize));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, hop));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, window));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, setWindow));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, averageCount));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, setAverageCount));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, resetState));
+
+            this->registerProbe("window");
+            this->registerProbe("averageCount");
+
+            this->setWindow(windowType);
+            this->setAverageCount(averageCount);
+        }
+
+        virtual ~PSDBlock() = default;
+
+        size_t frameSize() const
+        {
+            return _frameSize;
+        }
+
+        size_t hop() const
+        {
+            return _hop;
+        }
+
+        std::string window() const
+        {
+            return _windowType;
+        }
+
+        void setWindow(const std::string& windowType)
+        {
+            const auto window = getWindow(windowType, _frameSize);
+
+            this->configArrayFire();
+
+            // Normalize so the output doesn't depend on the window's power.
+            const double windowPower = std::inner_product(
+                                           window.begin(),
+                                           window.end(),
+                                           window.begin(),
+                                           0.0);
+
+            _windowType = windowType;
+            _afWindow = Pothos::Object(window).convert<af::array>().as(_afOutputDType);
+            _powerScale = 1.0 / windowPower;
+        }
+
+        size_t averageCount() const
+        {
+            return _averageCount;
+        }
+
+        void setAverageCount(size_t averageCount)
+        {
+            if(0 == averageCount)
+            {
+                throw Pothos::InvalidArgumentException("Average count must be non-zero.");
+            }
+
+            _averageCount = averageCount;
+
+            // Don't mix averages of different lengths.
+            _resetAccumulator();
+        }
+
+        void resetState() override
+        {
+            this->configArrayFire();
+
+            _afPending = af::array();
+            _resetAccumulator();
+        }
+
+        void work() override
+        {
+            WorkTimer workTimer(this);
+
+            const auto& workInfo = this->workInfo();
+
+            // Only consume enough input to fill the spectra we have room for.
+            const size_t maxSpectra = workInfo.minOutElements / _frameSize;
+            const size_t maxFrames = ((maxSpectra + 1) * _averageCount) - _numAccumulated - 1;
+            if(0 == maxFrames) return;
+
+            const size_t numPending = static_cast<size_t>(_afPending.elements());
+            const size_t maxExtendedLength = ((maxFrames - 1) * _hop) + _frameSize;
+            const size_t numInputs = std::min(
+                                         workInfo.minInElements,
+                                         maxExtendedLength - std::min(numPending, maxExtendedLength));
+            if(0 == numInputs) return;
+
+            this->configArrayFire();
+
+            auto afInput = this->getInputElementsAsAfArray(0, numInputs);
+            auto afSpectra = _estimate(afInput);
+            if(afSpectra.elements() > 0)
+            {
+                this->produceFromAfArray(0, afSpectra);
+            }
+        }
+
+    protected:
+
+        void prewarmKernels() override
+        {
+            this->resetState();
+            _estimate(af::constant(0, static_cast<dim_t>(_frameSize), _afInputDType)).eval();
+        }
+
+    private:
+        af::dtype _afInputDType;
+        af::dtype _afComplexDType;
+        af::dtype _afOutputDType;
+
+        size_t _frameSize;
+        size_t _hop;
+
+        std::string _windowType;
+        af::array _afWindow;
+        double _powerScale;
+
+        size_t _averageCount;
+
+        // Samples that didn't complete a frame, including overlap
+        af::array _afPending;
+
+        af::array _afAccumulator;
+        size_t _numAccumulated;
+
+        void _resetAccumulator()
+        {
+            this->configArrayFire();
+
+            _afAccumulator = af::constant(0, static_cast<dim_t>(_frameSize), _afOutputDType);
+            _numAccumulated = 0;
+        }
+
+        // Returns all spectra completed by this input, back-to-back.
+        af::array _estimate(const af::array& afInput)
+        {
+            const dim_t frameSize = static_cast<dim_t>(_frameSize);
+            const dim_t hop = static_cast<dim_t>(_hop);
+
+            auto afExtended = (_afPending.elements() > 0) ? af::join(0, _afPending, afInput)
+                                                          : afInput;
+            const dim_t extendedLength = afExtended.elements();
+            const dim_t numFrames = (extendedLength >= frameSize) ? (((extendedLength - frameSize) / hop) + 1)
+                                                                  : 0;
+
+            af::array afSpectra;
+            if(numFrames > 0)
+            {
+                auto afIndices = af::tile(af::range(af::dim4(frameSize), 0, ::s64), 1, static_cast<unsigned>(numFrames))
+                               + (af::range(af::dim4(frameSize, numFrames), 1, ::s64) * static_cast<long long>(hop));
+                auto afFrames = af::moddims(afExtended(af::flat(afIndices)), frameSize, numFrames);
+
+                auto afWindowed = afFrames.as(_afComplexDType) * af::tile(_afWindow, 1, static_cast<unsigned>(numFrames));
+                recordFFTPlanUse(_afBackend, _afDevice, _afComplexDType, _afComplexDType, frameSize, numFrames);
+                auto afPower = af::pow(af::abs(af::fft(afWindowed)), 2.0).as(_afOutputDType);
+                afPower.eval();
+
+                // The first frames finish the average in progress. Every
+                // complete average after that is reduced in one sum, with
+                // each average's frames along the second dimension and the
+                // averages along the third, and the rest carry over.
+                const auto powerFrames = [&afPower](dim_t first, dim_t count)
+                {
+                    return afPower(af::span, af::seq(static_cast<double>(first), static_cast<double>(first + count - 1)));
+                };
+
+                const dim_t averageCount = static_cast<dim_t>(_averageCount);
+                const dim_t numToFinish = std::min<dim_t>(numFrames, averageCount - static_cast<dim_t>(_numAccumulated));
+                _afAccumulator += af::sum(powerFrames(0, numToFinish), 1);
+                _numAccumulated += static_cast<size_t>(numToFinish);
+
+                if(_numAccumulated == _averageCount)
+                {
+                    const dim_t numRemaining = numFrames - numToFinish;
+                    const dim_t numFullAverages = numRemaining / averageCount;
+                    const dim_t numLeftover = numRemaining % averageCount;
+
+                    afSpectra = _afAccumulator;
+                    if(numFullAverages > 0)
+                    {
+                        auto afFullAverages = af::sum(
+                                                  af::moddims(
+                                                      powerFrames(numToFinish, numFullAverages * averageCount),
+                                                      frameSize,
+                                                      averageCount,
+                                                      numFullAverages),
+                                                  1);
+                        afSpectra = af::join(0, afSpectra, af::flat(afFullAverages));
+                    }
+                    afSpectra *= (_powerScale / static_cast<double>(_averageCount));
+
+                    _resetAccumulator();
+                    if(numLeftover > 0)
+                    {
+                        _afAccumulator += af::sum(powerFrames(numFrames - numLeftover, numLeftover), 1);
+                        _numAccumulated = static_cast<size_t>(numLeftover);
+                    }
+                }
+            }
+
+            const dim_t numConsumed = numFrames * hop;
+            _afPending = (numConsumed < extendedLength)
+                       ? afExtended(af::seq(static_cast<double>(numConsumed), static_cast<double>(extendedLength - 1))).copy()
+                       : af::array();
+
+            return afSpectra;
+        }
+};
+
+//
+// Factory
+//
+
+static Pothos::Block* makePSD(
+    const std::string& device,
+    const Pothos::DType& dtype,
+    size_t frameSize,
+    size_t hop,
+    const std::string& windowType,
+    size_t averageCount)
+{
+    if(1 != dtype.dimension())
+    {
+        throw Pothos::InvalidArgumentException(
+                  "This block does not support multi-dimensional types.",
+                  dtype.toString());
+    }
+
+    #define ifTypeDeclareFactory(T, Real) \
+        if(Pothos::DType::fromDType(dtype, 1) == Pothos::DType(typeid(T))) \
+            return new PSDBlock<T, Real>(device, frameSize, hop, windowType, averageCount);
+
+    ifTypeDeclareFactory(float, float)
+    ifTypeDeclareFactory(double, double)
+    ifTypeDeclareFactory(std::complex<float>, float)
+    ifTypeDeclareFactory(std::complex<double>, double)
+    #undef ifTypeDeclareFactory
+
+    throw Pothos::InvalidArgumentException(
+              "Unsupported type.",
+              dtype.name());
+}
+
+//
+// Block registration
+//
+
+/*
+ * |PothosDoc Power Spectral Density (GPU)
+ *
+ * Estimates the power spectrum of the input stream using Welch's method.
+ * The input is split into overlapping frames of <b>frameSize</b> samples,
+ * starting every <b>hop</b> samples. Each frame is windowed and transformed,
+ * and the squared magnitudes of <b>averageCount</b> frames are averaged into
+ * a single spectrum.
+ *
+ * Each output spectrum is <b>frameSize</b> bins in FFT order, normalized by the
+ * window's power, so a spectrum is output every <b>averageCount</b> frames.
+ *
+ * |category /GPU/Signal
+ * |keywords array signal fft psd spectrum welch periodogram power average
+ * |factory /gpu/signal/psd(device,dtype,frameSize,hop,window,averageCount)
+ * |setter setWindow(window)
+ * |setter setAverageCount(averageCount)
+ *
+ * |param device[Device] Device to use for processing.
+ * |default "Auto"
+ *
+ * |param dtype[Data Type] The input's data type. Outputs are real with the
+ * same precision.
+ * |widget DTypeChooser(float=1,cfloat=1)
+ * |default "complex_float32"
+ * |preview disable
+ *
+ * |param frameSize[Frame Size] The number of samples per frame, and the
+ * number of bins per spectrum.
+ * |default 1024
+ * |option 256
+ * |option 512
+ * |option 1024
+ * |option 2048
+ * |option 4096
+ * |option 8192
+ * |widget ComboBox(editable=true)
+ * |preview enable
+ *
+ * |param hop[Hop] The number of samples between the start of each frame.
+ * Half the frame size gives the typical 50% overlap.
+ * |widget SpinBox(minimum=1)
+ * |default 512
+ * |preview enable
+ *
+ * |param window[Window]
+ * |widget ComboBox(editable=false)
+ * |option [Rectangular] "rectangular"
+ * |option [Hann] "hann"
+ * |option [Hamming] "hamming"
+ * |option [Blackman] "blackman"
+ * |option [Blackman-Harris] "blackmanharris"
+ * |option [Flat Top] "flattop"
+ * |default "hann"
+ * |preview enable
+ *
+ * |param averageCount[Average Count] The number of frames averaged into each spectrum.
+ * |widget SpinBox(minimum=1)
+ * |default 16
+ * |preview enable
+ */
+static Pothos::BlockRegistry registerPSD(
+    "/gpu/signal/psd",
+    Pothos::Callable(&makePSD));
@@ -0,0 +1,406 @@
+// Copyright (c) 2021 Nicholas Corgan
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "ArrayFireBlock.hpp"
+#include "AutoRangeBins.hpp"
+#include "Utility.hpp"
+
+#include <Pothos/Exception.hpp>
+#include <Pothos/Framework.hpp>
+#include <Pothos/Object.hpp>
+
+#include <arrayfire.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//
+// Misc
+//
+
+enum class SketchMode
+{
+    Cumulative,
+    Exponential
+};
+
+static const std::unordered_map<std::string, SketchMode> SketchModeEnumMap =
+{
+    {"cumulative",  SketchMode::Cumulative},
+    {"exponential", SketchMode::Exponential},
+};
+
+static constexpr size_t NumMADIterations = 64;
+
+//
+// Block class
+//
+
+/*
+ * The sketch is a histogram of equal-width bins kept on the device. Each
+ * buffer is binned with af::histogram and added to the running counts, so
+ * the per-buffer cost is one pass over the input instead of a sort.
+ *
+ * The bins start out spanning the first buffer and grow as described in
+ * AutoRangeBins.hpp, so the accuracy of any quantile is within one bin
+ * width of the range seen so far.
+ *
+ * Queries copy the counts back and invert the CDF, interpolating linearly
+ * within each bin.
+ */
+class QuantileSketchBlock: public ArrayFireBlock
+{
+    public:
+
+        static Pothos::Block* make(
+            const std::string& device,
+            const Pothos::DType& dtype,
+            size_t numBins)
+        {
+            validateDType(dtype, DTypeSupport({true,true,true,false}));
+
+            return new QuantileSketchBlock(device, dtype, numBins);
+        }
+
+        QuantileSketchBlock(
+            const std::string& device,
+            const Pothos::DType& dtype,
+            size_t numBins
+        ):
+            ArrayFireBlock(device),
+            _afDType(Pothos::Object(dtype).convert<af::dtype>()),
+            _numBins(numBins),
+            _mode(SketchMode::Cumulative),
+            _alpha(0.01),
+            _bins(numBins)
+        {
+            // The range is always grown to fit the samples.
+            _bins.validateAutoRange();
+
+            this->setupInput(0, dtype, _domain);
+            this->setupOutput(0, dtype, _domain);
+
+            this->registerCall(this, POTHOS_FCN_TUPLE(QuantileSketchBlock, numBins));
+            this->registerCall(this, POTHOS_FCN_TUPLE(QuantileSketchBlock, mode));
+            this->registerCall(this, POTHOS_FCN_TUPLE(QuantileSketchBlock, setMode));
+            this->registerCall(this, POTHOS_FCN_TUPLE(QuantileSketchBlock, alpha));
+            this->registerCall(this, POTHOS_FCN_TUPLE(QuantileSketchBlock, setAlpha));
+            this->registerCall(this, POTHOS_FCN_TUPLE(QuantileSketchBlock, quantile));
+            this->registerCall(this, POTHOS_FCN_TUPLE(QuantileSketchBlock, quantiles));
+            this->registerCall(this, POTHOS_FCN_TUPLE(QuantileSketchBlock, median));
+            this->registerCall(this, POTHOS_FCN_TUPLE(QuantileSketchBlock, medAbsDev));
+            this->registerCall(this, POTHOS_FCN_TUPLE(QuantileSketchBlock, count));
+            this->registerCall(this, POTHOS_FCN_TUPLE(QuantileSketchBlock, binWidth));
+            this->registerCall(this, POTHOS_FCN_TUPLE(QuantileSketchBlock, resetState));
+
+            this->registerProbe("mode");
+            this->registerProbe("median");
+            this->registerProbe("medAbsDev");
+            this->registerProbe("count");
+
+            this->resetState();
+        }
+
+        virtual ~QuantileSketchBlock() = default;
+
+        size_t numBins() const
+        {
+            return _numBins;
+        }
+
+        std::string mode() const
+        {
+            return getKeyForVal(SketchModeEnumMap, _mode);
+        }
+
+        void setMode(const std::string& mode)
+        {
+            _mode = getValForKey(SketchModeEnumMap, mode);
+            this->resetState();
+        }
+
+        double alpha() const
+        {
+            return _alpha;
+        }
+
+        void setAlpha(double alpha)
+        {
+            if((alpha <= 0.0) || (alpha > 1.0))
+            {
+                throw Pothos::RangeException("Alpha must be in the range (0,1].");
+            }
+
+            _alpha = alpha;
+        }
+
+        // NaN if nothing has been sketched.
+        double quantile(double q) const
+        {
+            if((q < 0.0) || (q > 1.0))
+            {
+                throw Pothos::RangeException(
+                          "Quantiles must be in the range [0,1].",
+                          std::to_string(q));
+            }
+
+            if(0.0 == _totalWeight) return std::numeric_limits<double>::quiet_NaN();
+
+            return _quantile(_getCounts(), q);
+        }
+
+        std::vector<double> quantiles(const std::vector<double>& qs) const
+        {
+            for(double q: qs)
+            {
+                if((q < 0.0) || (q > 1.0))
+                {
+                    throw Pothos::RangeException(
+                              "Quantiles must be in the range [0,1].",
+                              std::to_string(q));
+                }
+            }
+
+            if(0.0 == _totalWeight)
+            {
+                return std::vector<double>(qs.size(), std::numeric_limits<double>::quiet_NaN());
+            }
+
+            // Only copy the counts back once.
+            const auto counts = _getCounts();
+
+            std::vector<double> values;
+            values.reserve(qs.size());
+            for(double q: qs) values.emplace_back(_quantile(counts, q));
+
+            return values;
+        }
+
+        double median() const
+        {
+            return this->quantile(0.5);
+        }
+
+        // The MAD is the half-width of the interval around the median that
+        // holds half of the weight, which is found by bisection on the CDF.
+        double medAbsDev() const
+        {
+            if(0.0 == _totalWeight) return std::numeric_limits<double>::quiet_NaN();
+
+            const auto counts = _getCounts();
+            const double median = _quantile(counts, 0.5);
+            const double halfWeight = _totalWeight / 2.0;
+
+            double lower = 0.0;
+            double upper = std::max(median - _bins.minValue(), _bins.maxValue() - median);
+            for(size_t i = 0; i < NumMADIterations; ++i)
+            {
+                const double mid = (lower + upper) / 2.0;
+                const double weight = _cdf(counts, median + mid) - _cdf(counts, median - mid);
+
+                if(weight < halfWeight) lower = mid;
+                else                    upper = mid;
+            }
+
+            return (lower + upper) / 2.0;
+        }
+
+        // The number of samples (or, in the exponential mode, the total
+        // weight) in the sketch
+        double count() const
+        {
+            return _totalWeight;
+        }
+
+        // The current resolution, which grows as the range does
+        double binWidth() const
+        {
+            return _bins.binWidth();
+        }
+
+        void resetState() override
+        {
+            this->configArrayFire();
+
+            _afCounts = af::constant(0.0, static_cast<dim_t>(_numBins), ::f64);
+            _totalWeight = 0.0;
+            _bins.reset();
+        }
+
+        void work() override
+        {
+            WorkTimer workTimer(this);
+
+            const size_t elems = this->workInfo().minAllElements;
+            if(0 == elems)
+            {
+                return;
+            }
+
+            this->configArrayFire();
+
+            auto afInput = this->getInputPortAsAfArray(0);
+            _update(afInput);
+
+            this->produceFromAfArray(0, afInput);
+        }
+
+    protected:
+
+        void prewarmKernels() override
+        {
+            const auto& dtype = this->input(0)->dtype();
+
+            this->resetState();
+            _update(af::range(
+                        af::dim4(static_cast<dim_t>(this->getPrewarmElements(dtype))),
+                        0,
+                        _afDType));
+            _afCounts.eval();
+        }
+
+    private:
+        af::dtype _afDType;
+        size_t _numBins;
+
+        SketchMode _mode;
+        double _alpha;
+
+        af::array _afCounts;
+        double _totalWeight;
+        AutoRangeBins _bins;
+
+        std::vector<double> _getCounts() const
+        {
+            this->configArrayFire();
+
+            std::vector<double> counts(_numBins);
+            _afCounts.host(counts.data());
+
+            return counts;
+        }
+
+        void _update(const af::array& afInput)
+        {
+            const double numInputs = static_cast<double>(afInput.elements());
+
+            double minValue = 0.0;
+            double maxValue = 0.0;
+            AutoRangeBins::getExtremes(afInput, minValue, maxValue);
+            _bins.expand(minValue, maxValue, _afCounts);
+
+            // Every sample in the buffer shares the decay of the newest.
+            if(SketchMode::Exponential == _mode)
+            {
+                const double decay = std::pow(1.0 - _alpha, numInputs);
+                _afCounts *= decay;
+                _totalWeight *= decay;
+            }
+
+            _afCounts += af::histogram(
+                             af::flat(afInput),
+                             static_cast<unsigned>(_numBins),
+                             _bins.minValue(),
+                             _bins.maxValue()).as(::f64);
+            _totalWeight += numInputs;
+        }
+
+        double _cdf(
+            const std::vector<double>& counts,
+            double value) const
+        {
+            const double position = (value - _bins.minValue()) / _bins.binWidth();
+            if(position <= 0.0) return 0.0;
+            if(position >= static_cast<double>(_numBins)) return _totalWeight;
+
+            const size_t bin = static_cast<size_t>(position);
+            double weight = 0.0;
+            for(size_t i = 0; i < bin; ++i) weight += counts[i];
+
+            return weight + (counts[bin] * (position - static_cast<double>(bin)));
+        }
+
+        double _quantile(
+            const std::vector<double>& counts,
+            double q) const
+        {
+            const double target = q * _totalWeight;
+
+            double weight = 0.0;
+            for(size_t bin = 0; bin < _numBins; ++bin)
+            {
+                if((counts[bin] > 0.0) && ((weight + counts[bin]) >= target))
+                {
+                    const double fraction = (target - weight) / counts[bin];
+                    return _bins.minValue() + (_bins.binWidth() * (static_cast<double>(bin) + fraction));
+                }
+
+                weight += counts[bin];
+            }
+
+            return _bins.maxValue();
+        }
+};
+
+//
+// Block registration
+//
+
+/*
+ * |PothosDoc Quantile Sketch (GPU)
+ *
+ * Keeps a histogram of every input on the device, which can be queried
+ * for quantiles, the median, and the median absolute deviation over the
+ * whole stream without sorting. Inputs are passed through unchanged.
+ *
+ * The bins start out spanning the first buffer, and their width doubles
+ * whenever a later input falls outside of them, so results are accurate
+ * to within one bin width (see <b>"binWidth"</b>).
+ *
+ * In the exponential mode, older samples decay by <b>(1-alpha)</b> per
+ * newer sample, giving a decaying window of about <b>1/alpha</b> samples.
+ * The decay is applied per buffer, so samples in the same buffer share a
+ * weight.
+ *
+ * |category /GPU/Statistics
+ * |keywords statistics stats quantile percentile median mad histogram sketch
+ * |factory /gpu/statistics/quantile_sketch(device,dtype,numBins)
+ * |setter setMode(mode)
+ * |setter setAlpha(alpha)
+ *
+ * |param device[Device] Device to use for processing.
+ * |default "Auto"
+ *
+ * |param dtype[Data Type] The output's data type.
+ * |widget DTypeChooser(int=1,uint=1,float=1,dim=1)
+ * |default "float64"
+ * |preview disable
+ *
+ * |param numBins[Bins] The number of histogram bins, which must be even.
+ * |widget SpinBox(minimum=2,step=2)
+ * |default 4096
+ * |preview enable
+ *
+ * |param mode[Mode] Which samples the sketch covers.
+ * <ul>
+ * <li><b>Cumulative:</b> every sample since activation or <b>"resetState"</b></li>
+ * <li><b>Exponential:</b> every sample, exponentially weighted by <b>alpha</b></li>
+ * </ul>
+ * |widget ComboBox(editable=false)
+ * |option [Cumulative] "cumulative"
+ * |option [Exponential] "exponential"
+ * |default "cumulative"
+ * |preview enable
+ *
+ * |param alpha[Alpha] In the exponential mode, the weight of each new sample.
+ * |widget DoubleSpinBox(minimum=0,maximum=1,step=0.001,decimals=4)
+ * |default 0.01
+ * |preview disable
+ */
+static Pothos::BlockRegistry registerQuantileSketch(
+    "/gpu/statistics/quantile_sketch",
+    Pothos::Callable(&QuantileSketchBlock::make));
@@ -124,6 +124,8 @@ class RandomBlock: public ArrayFireBlock
 
         void work() override
         {
+            WorkTimer workTimer(this);
+
             const auto elems = this->workInfo().minElements;
             if(0 == elems)
             {
@@ -79,6 +79,8 @@ af::array ReducedBlock::getNumberedInputPortsAs2DAfArray()
 
 void ReducedBlock::work()
 {
+    WorkTimer workTimer(this);
+
     const size_t elems = this->workInfo().minAllElements;
 
     if(0 == elems)
@@ -98,3 +100,15 @@ void ReducedBlock::work()
 
     this->produceFromAfArray(0, afOutput);
 }
+
+void ReducedBlock::prewarmKernels()
+{
+    const auto& dtype = this->input(0)->dtype();
+    auto afInput = af::constant(
+                       1,
+                       static_cast<dim_t>(_nchans),
+                       this->getPrewarmElements(dtype),
+                       Pothos::Object(dtype).convert<af::dtype>());
+
+    _func(afInput, -1).as(_afOutputDType).eval();
+}
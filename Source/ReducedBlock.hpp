@@ -30,6 +30,10 @@ class ReducedBlock: public ArrayFireBlock
 
         void work() override;
 
+    protected:
+
+        void prewarmKernels() override;
+
     private:
         ReducedFunc _func;
         af::dtype _afOutputDType;
@@ -1,4 +1,4 @@
-// Copyright (c) 2020 Nicholas Corgan
+// Copyright (c) 2020-2021 Nicholas Corgan
 // SPDX-License-Identifier: BSD-3-Clause
 
 #include "ArrayFireBlock.hpp"
@@ -10,8 +10,14 @@
 
 #include <arrayfire.h>
 
+#include <algorithm>
+#include <cmath>
 #include <cstdint>
+#include <numeric>
+#include <string>
+#include <type_traits>
 #include <typeinfo>
+#include <vector>
 
 //
 // Utility code
@@ -23,14 +29,16 @@ static inline EnableIfAnyInt<T, af::array> isEqual(const af::array& afArray, con
     return (afArray == value);
 }
 
+static constexpr double FloatEpsilon = 1e-6;
+
+// The special cases depend only on the value, so they're checked on the
+// host, leaving one comparison on the device.
 template <typename T>
 static inline EnableIfFloat<T, af::array> isEqual(const af::array& afArray, const T& value)
 {
-    auto afValue = af::constant(value, afArray.elements(), afArray.type());
-
-    return (af::isNaN(afArray) && af::isNaN(afValue)) ||
-           ((af::isInf(afArray) && af::isInf(afValue)) && (af::sign(afArray) == af::sign(afArray))) ||
-           (af::abs(afArray - value) <= 1e-6);
+    if(std::isnan(value)) return af::isNaN(afArray);
+    else if(std::isinf(value)) return (afArray == value);
+    else return (af::abs(afArray - value) <= FloatEpsilon);
 }
 
 template <typename T>
@@ -42,6 +50,77 @@ static inline EnableIfComplex<T, af::array> isEqual(const af::array& afArray, co
            isEqual<ScalarType>(af::imag(afArray), value.imag());
 }
 
+template <typename T>
+static af::array stdVectorToAfArray(const std::vector<T>& vec)
+{
+    return af::array(
+               static_cast<dim_t>(vec.size()),
+               reinterpret_cast<const typename PothosToAF<T>::type*>(vec.data()),
+               ::afHost);
+}
+
+// Sorts the pairs by find value and drops all but the last of any pairs
+// with the same find value, so later pairs take priority.
+template <typename T>
+static void sortPairs(
+    std::vector<T>& findValues,
+    std::vector<T>& replaceValues)
+{
+    std::vector<size_t> order(findValues.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(
+        order.begin(),
+        order.end(),
+        [&findValues](size_t lhs, size_t rhs){return findValues[lhs] < findValues[rhs];});
+
+    std::vector<T> sortedFindValues;
+    std::vector<T> sortedReplaceValues;
+    for(size_t i = 0; i < order.size(); ++i)
+    {
+        const bool isLast = ((i+1) == order.size()) ||
+                            (findValues[order[i]] != findValues[order[i+1]]);
+        if(isLast)
+        {
+            sortedFindValues.emplace_back(findValues[order[i]]);
+            sortedReplaceValues.emplace_back(replaceValues[order[i]]);
+        }
+    }
+
+    findValues = std::move(sortedFindValues);
+    replaceValues = std::move(sortedReplaceValues);
+}
+
+/*
+ * For each input, the index of the last key less than or equal to it, or 0
+ * if there is none. Each step of the binary search is one lookup into the
+ * keys, so a search over K keys takes log2(K) lookups, regardless of the
+ * buffer size.
+ */
+static af::array searchSorted(
+    const af::array& afKeys,
+    const af::array& afInput)
+{
+    const unsigned numKeys = static_cast<unsigned>(afKeys.elements());
+
+    unsigned step = 1;
+    while((step * 2) < numKeys) step *= 2;
+
+    auto afIndices = af::constant(0, afInput.dims(), ::u32);
+    for(; (numKeys > 1) && (step > 0); step /= 2)
+    {
+        auto afCandidates = afIndices + step;
+        auto afInRange = (afCandidates < numKeys);
+        auto afKeyAtCandidate = af::lookup(afKeys, af::min(afCandidates, numKeys - 1));
+
+        afIndices = af::select(afInRange && (afKeyAtCandidate <= afInput), afCandidates, afIndices);
+    }
+
+    return afIndices;
+}
+
+// The largest lookup table, in elements, before falling back to a search
+static constexpr unsigned long long MaxLookupTableSize = 1ULL << 16;
+
 //
 // Interface
 //
@@ -111,6 +190,8 @@ class Replace: public ArrayFireBlock
 
         void work() override
         {
+            WorkTimer workTimer(this);
+
             if(0 == this->workInfo().minElements)
             {
                 return;
@@ -142,6 +223,297 @@ class Replace: public ArrayFireBlock
 template <typename T>
 const Pothos::DType Replace<T>::dtype(typeid(T));
 
+/*
+ * Every pair is applied in one pass over each buffer, and each input is
+ * only ever compared to the original value, so replacements don't chain.
+ *
+ * For integers whose find values span a small enough range, the
+ * replacements go into a lookup table covering that range, with every
+ * other entry mapping to itself. Otherwise, the find values are sorted,
+ * and each input is matched with a binary search. Complex values can't be
+ * sorted, so each pair is applied with a select, which ArrayFire's JIT
+ * fuses into one kernel.
+ */
+template <typename T>
+class MultiReplace: public ArrayFireBlock
+{
+    public:
+
+        using Class = MultiReplace<T>;
+        using OffsetType = typename std::conditional<std::is_signed<T>::value, long long, unsigned long long>::type;
+
+        MultiReplace(
+            const std::string& device,
+            const std::vector<T>& findValues,
+            const std::vector<T>& replaceValues,
+            size_t dtypeDims
+        ):
+            ArrayFireBlock(device),
+            _useLookupTable(false),
+            _tableStart(0),
+            _hasNaNPair(false),
+            _nanReplaceValue(0)
+        {
+            this->setupInput(
+                0,
+                Pothos::DType::fromDType(Class::dtype, dtypeDims),
+                _domain);
+            this->setupOutput(
+                0,
+                Pothos::DType::fromDType(Class::dtype, dtypeDims),
+                _domain);
+
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, findValues));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, replaceValues));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, setPairs));
+
+            this->registerProbe("findValues");
+            this->registerProbe("replaceValues");
+            this->registerSignal("pairsChanged");
+
+            this->setPairs(findValues, replaceValues);
+        }
+
+        virtual ~MultiReplace() = default;
+
+        std::vector<T> findValues() const
+        {
+            return _findValues;
+        }
+
+        std::vector<T> replaceValues() const
+        {
+            return _replaceValues;
+        }
+
+        void setPairs(
+            const std::vector<T>& findValues,
+            const std::vector<T>& replaceValues)
+        {
+            if(findValues.size() != replaceValues.size())
+            {
+                throw Pothos::InvalidArgumentException(
+                          "The find and replace values must be the same length.",
+                          std::to_string(findValues.size()) + " vs " + std::to_string(replaceValues.size()));
+            }
+
+            this->configArrayFire();
+            this->_uploadPairs(findValues, replaceValues);
+
+            _findValues = findValues;
+            _replaceValues = replaceValues;
+            this->emitSignal("pairsChanged", findValues, replaceValues);
+        }
+
+        void work() override
+        {
+            WorkTimer workTimer(this);
+
+            if(0 == this->workInfo().minElements)
+            {
+                return;
+            }
+
+            this->configArrayFire();
+
+            // af::lookup needs a vector of indices.
+            auto afArray = this->getInputPortAsAfArray(0);
+            this->produceFromAfArray(
+                0,
+                af::moddims(this->_replace(af::flat(afArray)), afArray.dims()));
+        }
+
+    protected:
+
+        void prewarmKernels() override
+        {
+            const auto& dtype = this->input(0)->dtype();
+            const auto afDType = Pothos::Object(Class::dtype).convert<af::dtype>();
+
+            this->_replace(af::constant(
+                               0,
+                               static_cast<dim_t>(this->getPrewarmElements(dtype)),
+                               afDType)).eval();
+        }
+
+    private:
+
+        static const Pothos::DType dtype;
+
+        std::vector<T> _findValues;
+        std::vector<T> _replaceValues;
+
+        // Sorted find values and their replacements, or for the lookup
+        // table, every output from the table's start onwards
+        af::array _afKeys;
+        af::array _afValues;
+
+        bool _useLookupTable;
+        T _tableStart;
+
+        // NaN never compares equal, so it's handled separately.
+        bool _hasNaNPair;
+        T _nanReplaceValue;
+
+        //
+        // Integers
+        //
+
+        template <typename U = T>
+        EnableIfAnyInt<U, void> _uploadPairs(
+            std::vector<T> findValues,
+            std::vector<T> replaceValues)
+        {
+            sortPairs(findValues, replaceValues);
+
+            _useLookupTable = false;
+            if(!findValues.empty())
+            {
+                // Unsigned arithmetic gives the right distance for signed
+                // types too.
+                const auto span = static_cast<unsigned long long>(findValues.back()) -
+                                  static_cast<unsigned long long>(findValues.front());
+                _useLookupTable = (span < MaxLookupTableSize);
+            }
+
+            if(_useLookupTable)
+            {
+                _tableStart = findValues.front();
+
+                std::vector<T> table(static_cast<size_t>(
+                    static_cast<unsigned long long>(findValues.back()) -
+                    static_cast<unsigned long long>(findValues.front()) + 1));
+                for(size_t i = 0; i < table.size(); ++i)
+                {
+                    table[i] = static_cast<T>(static_cast<OffsetType>(_tableStart) + static_cast<OffsetType>(i));
+                }
+                for(size_t i = 0; i < findValues.size(); ++i)
+                {
+                    table[static_cast<size_t>(
+                        static_cast<OffsetType>(findValues[i]) - static_cast<OffsetType>(_tableStart))] = replaceValues[i];
+                }
+
+                _afKeys = af::array();
+                _afValues = stdVectorToAfArray(table);
+            }
+            else
+            {
+                _afKeys = findValues.empty() ? af::array() : stdVectorToAfArray(findValues);
+                _afValues = replaceValues.empty() ? af::array() : stdVectorToAfArray(replaceValues);
+            }
+        }
+
+        template <typename U = T>
+        EnableIfAnyInt<U, af::array> _replace(const af::array& afInput) const
+        {
+            if(_useLookupTable)
+            {
+                // Offsets are computed in 64 bits, where out-of-range
+                // inputs can't wrap back into the table.
+                const auto afOffsetDType = std::is_signed<T>::value ? ::s64 : ::u64;
+                const auto afOffsets = afInput.as(afOffsetDType) - static_cast<OffsetType>(_tableStart);
+                const auto afInRange = (afOffsets >= OffsetType(0)) &&
+                                       (afOffsets < static_cast<OffsetType>(_afValues.elements()));
+                const auto afIndices = af::select(afInRange, afOffsets, 0.0).as(::u32);
+
+                return af::select(afInRange, af::lookup(_afValues, afIndices), afInput);
+            }
+            else if(!_afKeys.isempty())
+            {
+                const auto afIndices = searchSorted(_afKeys, afInput);
+                const auto afIsMatch = (af::lookup(_afKeys, afIndices) == afInput);
+
+                return af::select(afIsMatch, af::lookup(_afValues, afIndices), afInput);
+            }
+            else return afInput;
+        }
+
+        //
+        // Floating-point
+        //
+
+        template <typename U = T>
+        EnableIfFloat<U, void> _uploadPairs(
+            const std::vector<T>& findValues,
+            const std::vector<T>& replaceValues)
+        {
+            std::vector<T> sortedFindValues;
+            std::vector<T> sortedReplaceValues;
+
+            _hasNaNPair = false;
+            for(size_t i = 0; i < findValues.size(); ++i)
+            {
+                if(std::isnan(findValues[i]))
+                {
+                    _hasNaNPair = true;
+                    _nanReplaceValue = replaceValues[i];
+                }
+                else
+                {
+                    sortedFindValues.emplace_back(findValues[i]);
+                    sortedReplaceValues.emplace_back(replaceValues[i]);
+                }
+            }
+            sortPairs(sortedFindValues, sortedReplaceValues);
+
+            _afKeys = sortedFindValues.empty() ? af::array() : stdVectorToAfArray(sortedFindValues);
+            _afValues = sortedReplaceValues.empty() ? af::array() : stdVectorToAfArray(sortedReplaceValues);
+        }
+
+        template <typename U = T>
+        EnableIfFloat<U, af::array> _replace(const af::array& afInput) const
+        {
+            auto afOutput = afInput;
+            if(!_afKeys.isempty())
+            {
+                // Search for the key within the tolerance above each input,
+                // so inputs just under a key still find it.
+                const auto afIndices = searchSorted(_afKeys, afInput + FloatEpsilon);
+                const auto afKeys = af::lookup(_afKeys, afIndices);
+                const auto afIsMatch = (afKeys == afInput) || (af::abs(afKeys - afInput) <= FloatEpsilon);
+
+                afOutput = af::select(afIsMatch, af::lookup(_afValues, afIndices), afInput);
+            }
+            if(_hasNaNPair)
+            {
+                afOutput = af::select(af::isNaN(afInput), static_cast<double>(_nanReplaceValue), afOutput);
+            }
+
+            return afOutput;
+        }
+
+        //
+        // Complex
+        //
+
+        template <typename U = T>
+        EnableIfComplex<U, void> _uploadPairs(
+            const std::vector<T>&,
+            const std::vector<T>&)
+        {
+            // The pairs are applied straight from _findValues and
+            // _replaceValues.
+        }
+
+        template <typename U = T>
+        EnableIfComplex<U, af::array> _replace(const af::array& afInput) const
+        {
+            auto afReal = af::real(afInput);
+            auto afImag = af::imag(afInput);
+            for(size_t i = 0; i < _findValues.size(); ++i)
+            {
+                const auto afIsMatch = isEqual<T>(afInput, _findValues[i]);
+                afReal = af::select(afIsMatch, static_cast<double>(_replaceValues[i].real()), afReal);
+                afImag = af::select(afIsMatch, static_cast<double>(_replaceValues[i].imag()), afImag);
+            }
+
+            return af::complex(afReal, afImag);
+        }
+};
+
+template <typename T>
+const Pothos::DType MultiReplace<T>::dtype(typeid(T));
+
 //
 // Factory/Registration
 //
@@ -169,6 +541,7 @@ static Pothos::Block* replaceFactory(
     // ArrayFire does not support any integral complex numbers.
     ifTypeDeclareFactory(std::complex<float>)
     ifTypeDeclareFactory(std::complex<double>)
+    #undef ifTypeDeclareFactory
 
     throw Pothos::InvalidArgumentException(
               "Unsupported type",
@@ -208,3 +581,80 @@ static Pothos::Block* replaceFactory(
 static Pothos::BlockRegistry registerReplace(
     "/gpu/data/replace",
     Pothos::Callable(&replaceFactory));
+
+static Pothos::Block* multiReplaceFactory(
+    const std::string& device,
+    const Pothos::DType& dtype,
+    const Pothos::Object& findValues,
+    const Pothos::Object& replaceValues)
+{
+    #define ifTypeDeclareFactory(T) \
+        if(Pothos::DType::fromDType(dtype, 1) == Pothos::DType(typeid(T))) \
+            return new MultiReplace<T>( \
+                           device, \
+                           findValues.convert<std::vector<T>>(), \
+                           replaceValues.convert<std::vector<T>>(), \
+                           dtype.dimension());
+
+    ifTypeDeclareFactory(char)
+    ifTypeDeclareFactory(short)
+    ifTypeDeclareFactory(int)
+    ifTypeDeclareFactory(long long)
+    ifTypeDeclareFactory(unsigned char)
+    ifTypeDeclareFactory(unsigned short)
+    ifTypeDeclareFactory(unsigned)
+    ifTypeDeclareFactory(unsigned long long)
+    ifTypeDeclareFactory(float)
+    ifTypeDeclareFactory(double)
+    // ArrayFire does not support any integral complex numbers.
+    ifTypeDeclareFactory(std::complex<float>)
+    ifTypeDeclareFactory(std::complex<double>)
+    #undef ifTypeDeclareFactory
+
+    throw Pothos::InvalidArgumentException(
+              "Unsupported type",
+              dtype.name());
+}
+
+/*
+ * |PothosDoc Replace Multiple (GPU)
+ *
+ * Replaces every element equal to one of <b>findValues</b> with the
+ * matching element of <b>replaceValues</b>, applying every pair in one
+ * pass over each buffer. Each element is only compared to its original
+ * value, so replacements don't chain, and if a value is found more than
+ * once, the last pair for it wins.
+ *
+ * Floating-point values match within <b>1e-6</b>, and NaN matches NaN.
+ *
+ * For integers whose find values span up to 65536 values, the pairs are
+ * applied with a lookup table on the device. Otherwise, the find values
+ * are sorted, and each element is matched with a binary search, whose
+ * cost grows with the logarithm of the number of pairs.
+ *
+ * |category /GPU/Stream
+ * |keywords data find replace lookup table map
+ * |factory /gpu/data/replace_multiple(device,dtype,findValues,replaceValues)
+ * |setter setPairs(findValues,replaceValues)
+ *
+ * |param device[Device] Device to use for processing.
+ * |default "Auto"
+ *
+ * |param dtype[Data Type] The block data type.
+ * |widget DTypeChooser(int=1,uint=1,float=1,cfloat=1,dim=1)
+ * |default "float64"
+ * |preview disable
+ *
+ * |param findValues[Find Values] Which values to replace.
+ * |widget LineEdit()
+ * |default [0]
+ * |preview enable
+ *
+ * |param replaceValues[Replace Values] The output value for each find value.
+ * |widget LineEdit()
+ * |default [0]
+ * |preview enable
+ */
+static Pothos::BlockRegistry registerMultiReplace(
+    "/gpu/data/replace_multiple",
+    Pothos::Callable(&multiReplaceFactory));
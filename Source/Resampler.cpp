@@ -0,0 +1,436 @@
+// Copyright (c) 2021 Nicholas Corgan
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "ArrayFireBlock.hpp"
+#include "StagedCoeffs.hpp"
+#include "Utility.hpp"
+
+#include <Pothos/Exception.hpp>
+#include <Pothos/Framework.hpp>
+#include <Pothos/Object.hpp>
+
+#include <arrayfire.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+//
+// Misc
+//
+
+static size_t greatestCommonDivisor(size_t a, size_t b)
+{
+    while(0 != b)
+    {
+        const size_t remainder = a % b;
+        a = b;
+        b = remainder;
+    }
+
+    return a;
+}
+
+//
+// Block class
+//
+
+/*
+ * Conceptually, the input is zero-stuffed by L, filtered, and decimated by M.
+ * Output m only depends on the taps h[p + jL], where p = (mM mod L), applied
+ * to the inputs x[floor(mM/L) - j], so only those products are computed. The
+ * taps are stored as one column per phase, and each output gathers its
+ * phase's column and input window, making each buffer a single gather and
+ * reduction regardless of L and M.
+ *
+ * New taps are staged and swapped in at the next buffer boundary. If the
+ * phase length changed, the history is reset along with them.
+ */
+template <typename T>
+class ResamplerBlock: public ArrayFireBlock
+{
+    public:
+        using Type = T;
+        using Class = ResamplerBlock<T>;
+        using TapType = typename Tap<T>::Type;
+
+        static const Pothos::DType dtype;
+
+        ResamplerBlock(
+            const std::string& device,
+            size_t dtypeDims,
+            size_t interpolation,
+            size_t decimation
+        ):
+            ArrayFireBlock(device),
+            _dtypeDims(dtypeDims),
+            _afDType(Pothos::Object(Class::dtype).convert<af::dtype>()),
+            _interpolation(interpolation),
+            _decimation(decimation),
+            _taps({T(1.0)}),
+            _waitTaps(false),
+            _waitTapsArmed(false),
+            _stagedTaps(_afBackend, _afDevice),
+            _phaseLength(0),
+            _nextPosition(0)
+        {
+            if((0 == interpolation) || (0 == decimation))
+            {
+                throw Pothos::InvalidArgumentException("Interpolation and decimation must be non-zero.");
+            }
+
+            // There's no reason to compute more phases than necessary.
+            const size_t gcd = greatestCommonDivisor(_interpolation, _decimation);
+            _interpolation /= gcd;
+            _decimation /= gcd;
+
+            this->setupInput(
+                0,
+                Pothos::DType::fromDType(Class::dtype, dtypeDims),
+                _domain);
+            this->setupOutput(
+                0,
+                Pothos::DType::fromDType(Class::dtype, dtypeDims),
+                _domain);
+
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, taps));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, setTaps));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, interpolation));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, decimation));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, waitTaps));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, setWaitTaps));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, uploadingTaps));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, resetState));
+
+            this->registerProbe("taps");
+
+            this->setTaps(_taps);
+        }
+
+        virtual ~ResamplerBlock() = default;
+
+        void activate() override
+        {
+            // Prewarming needs taps.
+            this->_applyStagedTaps(true);
+
+            ArrayFireBlock::activate();
+
+            _waitTapsArmed = _waitTaps;
+        }
+
+        std::vector<TapType> taps() const
+        {
+            return _taps;
+        }
+
+        void setTaps(const std::vector<TapType>& taps)
+        {
+            if(taps.empty())
+            {
+                throw Pothos::InvalidArgumentException("Taps cannot be empty.");
+            }
+
+            const size_t phaseLength = (taps.size() + _interpolation - 1) / _interpolation;
+
+            // Column-major, one column per phase
+            std::vector<TapType> polyphaseTaps(phaseLength * _interpolation, TapType(0));
+            for(size_t phase = 0; phase < _interpolation; ++phase)
+            {
+                for(size_t tap = 0; tap < phaseLength; ++tap)
+                {
+                    const size_t tapIndex = phase + (tap * _interpolation);
+                    if(tapIndex < taps.size())
+                    {
+                        polyphaseTaps[(phase * phaseLength) + tap] = taps[tapIndex];
+                    }
+                }
+            }
+
+            _taps = taps;
+            _stagedTaps.stage([this, polyphaseTaps, phaseLength]()
+                              {
+                                  this->configArrayFire();
+                                  return af::moddims(
+                                             Pothos::Object(polyphaseTaps).convert<af::array>(),
+                                             static_cast<dim_t>(phaseLength),
+                                             static_cast<dim_t>(_interpolation));
+                              });
+        }
+
+        size_t interpolation() const
+        {
+            return _interpolation;
+        }
+
+        size_t decimation() const
+        {
+            return _decimation;
+        }
+
+        bool waitTaps() const
+        {
+            return _waitTaps;
+        }
+
+        void setWaitTaps(bool waitTaps)
+        {
+            _waitTaps = waitTaps;
+        }
+
+        bool uploadingTaps() const
+        {
+            return _stagedTaps.isUploading();
+        }
+
+        void resetState() override
+        {
+            this->configArrayFire();
+
+            if(_phaseLength > 1)
+            {
+                _afHistory = af::constant(
+                                 0,
+                                 static_cast<dim_t>(_phaseLength - 1),
+                                 static_cast<dim_t>(_dtypeDims),
+                                 _afDType);
+            }
+            _nextPosition = 0;
+        }
+
+        void work() override
+        {
+            WorkTimer workTimer(this);
+
+            // If specified, don't do anything until taps are explicitly set
+            // and uploaded.
+            const bool hasNewTaps = this->_applyStagedTaps(false);
+            if(_waitTapsArmed && !hasNewTaps) return;
+            _waitTapsArmed = false;
+
+            // Only consume as many inputs as we have room to output.
+            const auto& workInfo = this->workInfo();
+            const size_t maxInputs = static_cast<size_t>(
+                                         ((static_cast<uint64_t>(workInfo.minOutElements) * _decimation) + _nextPosition)
+                                         / _interpolation);
+            const size_t numInputs = std::min(workInfo.minInElements, maxInputs);
+            if(0 == numInputs) return;
+
+            this->configArrayFire();
+
+            auto afInput = this->getInputElementsAsAfArray(0, numInputs);
+            auto afOutput = _resample(afInput);
+
+            // With enough decimation, a buffer may not produce any outputs.
+            if(afOutput.elements() > 0)
+            {
+                this->produceFromAfArray(0, afOutput);
+            }
+        }
+
+    protected:
+
+        void prewarmKernels() override
+        {
+            const auto& dtype = this->input(0)->dtype();
+
+            this->resetState();
+            _resample(af::constant(
+                          0,
+                          this->getPrewarmElements(dtype) * static_cast<dim_t>(_dtypeDims),
+                          _afDType)).eval();
+        }
+
+    private:
+        size_t _dtypeDims;
+        af::dtype _afDType;
+
+        size_t _interpolation;
+        size_t _decimation;
+
+        std::vector<TapType> _taps;
+        bool _waitTaps;
+        bool _waitTapsArmed;
+
+        StagedCoeffs<af::array> _stagedTaps;
+        size_t _phaseLength;
+        af::array _afPolyphaseTaps;
+
+        // The last (phaseLength-1) inputs, oldest first, one column per channel
+        af::array _afHistory;
+
+        // The next output's position in the upsampled stream, relative to
+        // the start of the next buffer
+        uint64_t _nextPosition;
+
+        // On activation, waits for any upload in progress.
+        bool _applyStagedTaps(bool isActivating)
+        {
+            af::array afPolyphaseTaps;
+            if(!_stagedTaps.take(afPolyphaseTaps, isActivating)) return false;
+
+            _afPolyphaseTaps = afPolyphaseTaps;
+
+            // The history no longer lines up with the taps.
+            const size_t phaseLength = static_cast<size_t>(_afPolyphaseTaps.dims(0));
+            if(phaseLength != _phaseLength)
+            {
+                _phaseLength = phaseLength;
+                this->resetState();
+            }
+
+            return true;
+        }
+
+        af::array _resample(const af::array& afInput)
+        {
+            const dim_t numChans = static_cast<dim_t>(_dtypeDims);
+            const dim_t numInputs = afInput.elements() / numChans;
+            const dim_t phaseLength = static_cast<dim_t>(_phaseLength);
+            const dim_t historyLength = phaseLength - 1;
+
+            // The input is interleaved, so move each channel into a column.
+            auto afChannels = (numChans > 1) ? af::moddims(afInput, numChans, numInputs).T()
+                                             : afInput;
+            auto afExtended = (historyLength > 0) ? af::join(0, _afHistory, afChannels)
+                                                  : afChannels;
+
+            const uint64_t upsampledLength = static_cast<uint64_t>(numInputs) * _interpolation;
+            const uint64_t numOutputs = (upsampledLength > _nextPosition)
+                                      ? ((upsampledLength - _nextPosition + _decimation - 1) / _decimation)
+                                      : 0;
+
+            af::array afOutput;
+            if(numOutputs > 0)
+            {
+                const dim_t numOutputsDim = static_cast<dim_t>(numOutputs);
+
+                auto afPositions = (af::range(af::dim4(numOutputsDim), 0, ::s64) * static_cast<long long>(_decimation))
+                                 + static_cast<long long>(_nextPosition);
+                auto afInputIndices = afPositions / static_cast<long long>(_interpolation);
+                auto afPhases = afPositions - (afInputIndices * static_cast<long long>(_interpolation));
+
+                // One column per output, newest input first, offset by the
+                // history at the front of the extended input
+                auto afWindowIndices = af::tile(af::moddims(afInputIndices, 1, numOutputsDim), static_cast<unsigned>(phaseLength))
+                                     + static_cast<long long>(historyLength)
+                                     - af::tile(af::range(af::dim4(phaseLength), 0, ::s64), 1, static_cast<unsigned>(numOutputsDim));
+
+                auto afWindows = af::moddims(
+                                     afExtended(af::flat(afWindowIndices), af::span),
+                                     phaseLength,
+                                     numOutputsDim,
+                                     numChans);
+                auto afWindowTaps = af::tile(
+                                        _afPolyphaseTaps(af::span, afPhases),
+                                        1,
+                                        1,
+                                        static_cast<unsigned>(numChans));
+
+                afOutput = af::moddims(
+                               af::sum(afWindowTaps * afWindows, 0),
+                               numOutputsDim,
+                               numChans);
+                afOutput = (numChans > 1) ? af::flat(afOutput.T()) : af::flat(afOutput);
+            }
+
+            if(historyLength > 0)
+            {
+                const dim_t extendedLength = afExtended.dims(0);
+                _afHistory = afExtended(
+                                 af::seq(
+                                     static_cast<double>(extendedLength - historyLength),
+                                     static_cast<double>(extendedLength - 1)),
+                                 af::span).copy();
+            }
+            _nextPosition = _nextPosition + (numOutputs * _decimation) - upsampledLength;
+
+            return afOutput;
+        }
+};
+
+template <typename T>
+const Pothos::DType ResamplerBlock<T>::dtype(typeid(T));
+
+//
+// Factory
+//
+
+static Pothos::Block* makeResampler(
+    const std::string& device,
+    const Pothos::DType& dtype,
+    size_t interpolation,
+    size_t decimation)
+{
+    #define ifTypeDeclareFactory(T) \
+        if(Pothos::DType::fromDType(dtype, 1) == Pothos::DType(typeid(T))) \
+            return new ResamplerBlock<T>(device, dtype.dimension(), interpolation, decimation);
+
+    ifTypeDeclareFactory(float)
+    ifTypeDeclareFactory(double)
+    ifTypeDeclareFactory(std::complex<float>)
+    ifTypeDeclareFactory(std::complex<double>)
+    #undef ifTypeDeclareFactory
+
+    throw Pothos::InvalidArgumentException(
+              "Unsupported type.",
+              dtype.name());
+}
+
+//
+// Block registration
+//
+
+/*
+ * |PothosDoc Rational Resampler (GPU)
+ *
+ * Resamples the input stream by a rational factor of <b>L/M</b> using a
+ * polyphase FIR filter. This is equivalent to inserting <b>L-1</b> zeros
+ * between each input, filtering with the given taps, and keeping every
+ * <b>M</b>th output, but only the outputs that are kept are computed.
+ *
+ * The taps are applied as given, so when interpolating, a filter gain of
+ * <b>L</b> is needed to preserve the signal amplitude. The filter state is
+ * carried across buffers, and <b>"resetState"</b> clears it. New taps are
+ * uploaded in the background and take effect at the start of the first
+ * buffer after the upload finishes. For multi-dimensional types, each
+ * dimension is resampled as an independent channel.
+ *
+ * |category /GPU/Signal
+ * |keywords array tap taps fir polyphase resample interpolate decimate rational
+ * |factory /gpu/signal/resampler(device,dtype,interpolation,decimation)
+ * |setter setTaps(taps)
+ * |setter setWaitTaps(waitTaps)
+ *
+ * |param device[Device] Device to use for processing.
+ * |default "Auto"
+ *
+ * |param dtype[Data Type] The output's data type.
+ * |widget DTypeChooser(float=1,cfloat=1,dim=1)
+ * |default "complex_float64"
+ * |preview disable
+ *
+ * |param interpolation[Interpolation] The upsampling factor <b>L</b>.
+ * |widget SpinBox(minimum=1)
+ * |default 1
+ * |preview enable
+ *
+ * |param decimation[Decimation] The downsampling factor <b>M</b>.
+ * |widget SpinBox(minimum=1)
+ * |default 1
+ * |preview enable
+ *
+ * |param taps[Taps] The FIR filter taps, at the upsampled rate.
+ * |widget LineEdit()
+ * |default [1.0]
+ * |preview enable
+ *
+ * |param waitTaps[Wait Taps] Wait for the taps to be set before allowing operation.
+ * Use this mode when taps are set exclusively at runtime by the setTaps() slot.
+ * |widget ToggleSwitch(on="True", off="False")
+ * |default false
+ * |preview disable
+ */
+static Pothos::BlockRegistry registerResampler(
+    "/gpu/signal/resampler",
+    Pothos::Callable(&makeResampler));
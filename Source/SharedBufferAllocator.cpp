@@ -1,13 +1,37 @@
-// Copyright (c) 2019-2020 Nicholas Corgan
+// Copyright (c) 2019-2021 Nicholas Corgan
 // SPDX-License-Identifier: BSD-3-Clause
 
 #include "SharedBufferAllocator.hpp"
 
 #include <Pothos/Framework.hpp>
 
+#include <Poco/Format.h>
+#include <Poco/Logger.h>
+#include <Poco/NumberFormatter.h>
+
 #include <arrayfire.h>
 
+#include <algorithm>
+#include <exception>
+#include <fstream>
+#include <limits>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/mempolicy.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+static Poco::Logger& getLogger()
+{
+    auto& logger = Poco::Logger::get("PothosGPU");
+    return logger;
+}
 
 //
 // Minimal wrapper class to ensure allocation and deallocation are done
@@ -18,7 +42,7 @@ class AfPinnedMemRAII
 {
     public:
         using SPtr = std::shared_ptr<AfPinnedMemRAII>;
-        
+
         AfPinnedMemRAII(af::Backend backend, size_t allocSize):
             _backend(backend),
             _pinnedMem(nullptr)
@@ -47,6 +71,283 @@ class AfPinnedMemRAII
         void* _pinnedMem;
 };
 
+#ifdef __linux__
+
+//
+// NUMA-aware anonymous memory. mmap() returns page-aligned memory, which
+// satisfies HostMemoryAlignment.
+//
+
+static_assert(
+    (HostMemoryAlignment & (HostMemoryAlignment-1)) == 0,
+    "HostMemoryAlignment must be a power of 2");
+
+static size_t _getHugePageSize()
+{
+    static constexpr size_t defaultHugePageSize = 2 << 20;
+
+    std::ifstream meminfo("/proc/meminfo");
+    std::string key;
+    while(meminfo >> key)
+    {
+        if("Hugepagesize:" == key)
+        {
+            size_t sizeKB = 0;
+            if(meminfo >> sizeKB) return (sizeKB << 10);
+            break;
+        }
+        meminfo.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+    }
+
+    return defaultHugePageSize;
+}
+
+static size_t getHugePageSize()
+{
+    // Only do this once
+    static const size_t hugePageSize = _getHugePageSize();
+
+    return hugePageSize;
+}
+
+static inline size_t roundUp(size_t size, size_t multiple)
+{
+    return ((size + multiple - 1) / multiple) * multiple;
+}
+
+static int getCurrentNUMANode()
+{
+    unsigned cpu = 0;
+    unsigned node = 0;
+    if(0 != ::syscall(SYS_getcpu, &cpu, &node, nullptr))
+    {
+        return -1;
+    }
+
+    return static_cast<int>(node);
+}
+
+// The node mask passed to mbind() is a single unsigned long.
+static constexpr int MaxNUMANodes = sizeof(unsigned long) * 8;
+
+// The kernel lists possible nodes as ranges, e.g. "0-3" or "0,2-3", so
+// the count is one past the last number.
+static int _getNumNUMANodes()
+{
+    std::ifstream possibleNodes("/sys/devices/system/node/possible");
+    std::string nodeList;
+    if(!(possibleNodes >> nodeList)) return 1;
+
+    const auto lastNodePos = nodeList.find_last_of(",-");
+    const auto lastNode = nodeList.substr((std::string::npos == lastNodePos) ? 0 : (lastNodePos + 1));
+    try
+    {
+        return std::min(std::stoi(lastNode) + 1, MaxNUMANodes);
+    }
+    catch(const std::exception&)
+    {
+        return 1;
+    }
+}
+
+static bool bindToNUMANode(void* addr, size_t size, int node, bool movePages)
+{
+    if((node < 0) || (node >= MaxNUMANodes))
+    {
+        return false;
+    }
+
+    const unsigned long nodeMask = (1UL << node);
+    const unsigned flags = movePages ? MPOL_MF_MOVE : 0;
+
+    return (0 == ::syscall(
+                     SYS_mbind,
+                     addr,
+                     size,
+                     MPOL_BIND,
+                     &nodeMask,
+                     static_cast<unsigned long>(MaxNUMANodes),
+                     flags));
+}
+
+class NUMAMemRAII
+{
+    public:
+        using SPtr = std::shared_ptr<NUMAMemRAII>;
+
+        NUMAMemRAII(size_t allocSize, const HostMemoryConfig& config):
+            _mem(MAP_FAILED),
+            _mappedSize(0)
+        {
+            constexpr int prot = PROT_READ | PROT_WRITE;
+            constexpr int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+
+            if(HugePageMode::None != config.hugePages)
+            {
+                _mappedSize = roundUp(allocSize, getHugePageSize());
+            }
+            else
+            {
+                _mappedSize = roundUp(allocSize, static_cast<size_t>(::sysconf(_SC_PAGESIZE)));
+            }
+
+            if(HugePageMode::Explicit == config.hugePages)
+            {
+                _mem = ::mmap(nullptr, _mappedSize, prot, flags | MAP_HUGETLB, -1, 0);
+                if(MAP_FAILED == _mem)
+                {
+                    poco_warning(
+                        getLogger(),
+                        "Could not allocate explicit huge pages. Falling back "
+                        "to transparent huge pages.");
+                }
+            }
+            if(MAP_FAILED == _mem)
+            {
+                _mem = ::mmap(nullptr, _mappedSize, prot, flags, -1, 0);
+                if(MAP_FAILED == _mem)
+                {
+                    throw Pothos::OutOfMemoryException(
+                              "mmap",
+                              Poco::NumberFormatter::format(_mappedSize));
+                }
+                if(HugePageMode::None != config.hugePages)
+                {
+                    (void)::madvise(_mem, _mappedSize, MADV_HUGEPAGE);
+                }
+            }
+
+            // Binding before the first touch means no pages need to move.
+            if((config.numaNode >= 0) && !bindToNUMANode(_mem, _mappedSize, config.numaNode, false))
+            {
+                poco_warning_f1(
+                    getLogger(),
+                    "Could not bind host memory to NUMA node %d.",
+                    config.numaNode);
+            }
+        }
+
+        virtual ~NUMAMemRAII()
+        {
+            if(MAP_FAILED != _mem)
+            {
+                ::munmap(_mem, _mappedSize);
+            }
+        }
+
+        inline void* get() const
+        {
+            return _mem;
+        }
+
+        bool moveToNUMANode(int node)
+        {
+            return bindToNUMANode(_mem, _mappedSize, node, true);
+        }
+
+    private:
+        void* _mem;
+        size_t _mappedSize;
+};
+
+class HostSlabTracker
+{
+    public:
+        void add(const NUMAMemRAII::SPtr& slab)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _slabs.emplace_back(TrackedSlab{slab, -1});
+        }
+
+        // Slabs allocated since the last move are placed too, and slabs
+        // that have since been freed are dropped.
+        void moveToCurrentNUMANode()
+        {
+            const int node = getCurrentNUMANode();
+            if(node < 0) return;
+
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            _slabs.erase(
+                std::remove_if(
+                    _slabs.begin(),
+                    _slabs.end(),
+                    [](const TrackedSlab& trackedSlab){return trackedSlab.slab.expired();}),
+                _slabs.end());
+
+            for(auto& trackedSlab: _slabs)
+            {
+                if(node == trackedSlab.node) continue;
+
+                auto slab = trackedSlab.slab.lock();
+                if(!slab) continue;
+
+                if(!slab->moveToNUMANode(node))
+                {
+                    poco_warning_f1(
+                        getLogger(),
+                        "Could not move host memory to NUMA node %d.",
+                        node);
+                    break;
+                }
+                trackedSlab.node = node;
+            }
+        }
+
+    private:
+        struct TrackedSlab
+        {
+            std::weak_ptr<NUMAMemRAII> slab;
+
+            // The node the slab was last moved to, or -1 if never moved
+            int node;
+        };
+
+        std::mutex _mutex;
+        std::vector<TrackedSlab> _slabs;
+};
+
+#else
+
+class HostSlabTracker
+{
+    public:
+        void moveToCurrentNUMANode() {}
+};
+
+#endif
+
+//
+// Host memory configuration
+//
+
+HostMemoryConfig defaultHostMemoryConfig()
+{
+    return {HostMemoryMode::Pinned, HugePageMode::None, -1};
+}
+
+int getNumNUMANodes()
+{
+#ifdef __linux__
+    // Only do this once
+    static const int numNUMANodes = _getNumNUMANodes();
+
+    return numNUMANodes;
+#else
+    return 1;
+#endif
+}
+
+HostSlabTrackerSPtr makeHostSlabTracker()
+{
+    return std::make_shared<HostSlabTracker>();
+}
+
+void moveHostSlabsToCurrentNUMANode(const HostSlabTrackerSPtr& slabTracker)
+{
+    if(slabTracker) slabTracker->moveToCurrentNUMANode();
+}
+
 //
 // Transparent RAII SharedBuffer
 //
@@ -62,6 +363,36 @@ Pothos::SharedBuffer allocateSharedBuffer(af::Backend backend, size_t size)
               afPinnedMemSPtr);
 }
 
+Pothos::SharedBuffer allocateSharedBuffer(
+    af::Backend backend,
+    size_t size,
+    const HostMemoryConfig& config,
+    const HostSlabTrackerSPtr& slabTracker)
+{
+    // Device backends need page-locked memory for asynchronous transfers,
+    // which we can only get from ArrayFire.
+    if((HostMemoryMode::Pinned == config.mode) || (::AF_BACKEND_CPU != backend))
+    {
+        return allocateSharedBuffer(backend, size);
+    }
+
+#ifdef __linux__
+    auto numaMemSPtr = std::make_shared<NUMAMemRAII>(size, config);
+    if(slabTracker && (config.numaNode < 0))
+    {
+        slabTracker->add(numaMemSPtr);
+    }
+
+    return Pothos::SharedBuffer(
+              reinterpret_cast<size_t>(numaMemSPtr->get()),
+              size,
+              numaMemSPtr);
+#else
+    (void)slabTracker;
+    return allocateSharedBuffer(backend, size);
+#endif
+}
+
 BufferAllocateFcn getSharedBufferAllocator(af::Backend backend)
 {
     auto impl = [backend](const Pothos::BufferManagerArgs& args)
@@ -72,3 +403,25 @@ BufferAllocateFcn getSharedBufferAllocator(af::Backend backend)
 
     return impl;
 }
+
+BufferAllocateFcn getSharedBufferAllocator(
+    af::Backend backend,
+    const HostMemoryConfig& config,
+    const HostSlabTrackerSPtr& slabTracker)
+{
+    if((HostMemoryMode::NUMA == config.mode) && (::AF_BACKEND_CPU != backend))
+    {
+        poco_warning(
+            getLogger(),
+            "NUMA host memory is only supported for the CPU backend. "
+            "Using pinned memory.");
+    }
+
+    auto impl = [backend, config, slabTracker](const Pothos::BufferManagerArgs& args)
+    {
+        const size_t totalSize = args.bufferSize*args.numBuffers;
+        return allocateSharedBuffer(backend, totalSize, config, slabTracker);
+    };
+
+    return impl;
+}
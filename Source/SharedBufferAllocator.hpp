@@ -1,4 +1,4 @@
-// Copyright (c) 2020 Nicholas Corgan
+// Copyright (c) 2020-2021 Nicholas Corgan
 // SPDX-License-Identifier: BSD-3-Clause
 
 #pragma once
@@ -7,12 +7,80 @@
 
 #include <arrayfire.h>
 
+#include <memory>
+
 #ifdef POTHOSGPU_LEGACY_BUFFER_MANAGER
 using BufferAllocateFcn = std::function<Pothos::SharedBuffer(const Pothos::BufferManagerArgs&)>;
 #else
 using BufferAllocateFcn = Pothos::BufferManager::AllocateFcn;
 #endif
 
+//
+// Host memory configuration
+//
+
+enum class HostMemoryMode
+{
+    // Page-locked memory from af::pinned
+    Pinned,
+
+    // Anonymous memory placed on a specific NUMA node (CPU backend only)
+    NUMA
+};
+
+enum class HugePageMode
+{
+    None,
+
+    // madvise(MADV_HUGEPAGE)
+    Transparent,
+
+    // MAP_HUGETLB, falls back to transparent huge pages on failure
+    Explicit
+};
+
+struct HostMemoryConfig
+{
+    HostMemoryMode mode;
+    HugePageMode hugePages;
+
+    // If negative, slabs are left unfaulted until moveHostSlabsToCurrentNUMANode()
+    // is called from the thread that will consume them.
+    int numaNode;
+};
+
+static constexpr size_t HostMemoryAlignment = 64;
+
+HostMemoryConfig defaultHostMemoryConfig();
+
+// Valid NUMA nodes are [0, getNumNUMANodes()). Without NUMA support, this
+// is 1.
+int getNumNUMANodes();
+
+// Keeps track of slabs allocated with numaNode < 0 so they can be
+// moved once the consuming thread is known.
+class HostSlabTracker;
+using HostSlabTrackerSPtr = std::shared_ptr<HostSlabTracker>;
+
+HostSlabTrackerSPtr makeHostSlabTracker();
+
+void moveHostSlabsToCurrentNUMANode(const HostSlabTrackerSPtr& slabTracker);
+
+//
+// Allocation
+//
+
 Pothos::SharedBuffer allocateSharedBuffer(af::Backend backend, size_t size);
 
+Pothos::SharedBuffer allocateSharedBuffer(
+    af::Backend backend,
+    size_t size,
+    const HostMemoryConfig& config,
+    const HostSlabTrackerSPtr& slabTracker = nullptr);
+
 BufferAllocateFcn getSharedBufferAllocator(af::Backend backend);
+
+BufferAllocateFcn getSharedBufferAllocator(
+    af::Backend backend,
+    const HostMemoryConfig& config,
+    const HostSlabTrackerSPtr& slabTracker = nullptr);
@@ -1,4 +1,4 @@
-// Copyright (c) 2020 Nicholas Corgan
+// Copyright (c) 2020-2021 Nicholas Corgan
 // SPDX-License-Identifier: BSD-3-Clause
 
 #include "OneToOneBlock.hpp"
@@ -10,11 +10,41 @@
 
 #include <arrayfire.h>
 
+#include <string>
 #include <vector>
 
 // To disambiguate
 using SortFcn = af::array(*)(const af::array&, const unsigned, const bool);
 
+/*
+ * In the windowed modes, the input is appended to whatever didn't fill a
+ * window last time, and every complete window becomes one column of the
+ * returned matrix, so all of them are sorted with one af::sort call. The
+ * rest is kept on the device for next time. Returns an empty array if no
+ * window was completed.
+ */
+static af::array takeWindows(
+    af::array& rAfLeftover,
+    const af::array& afInput,
+    size_t windowSize)
+{
+    auto afAll = rAfLeftover.isempty() ? afInput : af::join(0, rAfLeftover, afInput);
+
+    const dim_t numAll = afAll.elements();
+    const dim_t windowLength = static_cast<dim_t>(windowSize);
+    const dim_t numWindows = numAll / windowLength;
+    const dim_t numUsed = numWindows * windowLength;
+
+    rAfLeftover = (numUsed < numAll) ? afAll(af::seq(static_cast<double>(numUsed), static_cast<double>(numAll - 1))).copy()
+                                     : af::array();
+    if(0 == numWindows) return af::array();
+
+    return af::moddims(
+               afAll(af::seq(0.0, static_cast<double>(numUsed - 1))),
+               windowLength,
+               numWindows);
+}
+
 class Sort: public OneToOneBlock
 {
     public:
@@ -40,16 +70,27 @@ class Sort: public OneToOneBlock
         {
             this->registerCall(this, POTHOS_FCN_TUPLE(Sort, isAscending));
             this->registerCall(this, POTHOS_FCN_TUPLE(Sort, setIsAscending));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Sort, windowSize));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Sort, setWindowSize));
 
             this->registerProbe("isAscending");
+            this->registerProbe("windowSize");
             this->registerSignal("isAscendingChanged");
 
             // Set here instead of class instantiation to send signal
             this->setIsAscending(true);
+            this->setWindowSize(0);
         }
 
         virtual ~Sort() {};
 
+        void activate() override
+        {
+            OneToOneBlock::activate();
+
+            _afLeftover = af::array();
+        }
+
         double isAscending() const
         {
             return _isAscending;
@@ -63,16 +104,202 @@ class Sort: public OneToOneBlock
             this->emitSignal("isAscendingChanged", isAscending);
         }
 
+        size_t windowSize() const
+        {
+            return _windowSize;
+        }
+
+        // 0 sorts each buffer as it comes in.
+        void setWindowSize(size_t windowSize)
+        {
+            _windowSize = windowSize;
+            _afLeftover = af::array();
+        }
+
+        void work() override
+        {
+            if(0 == _windowSize)
+            {
+                OneToOneBlock::work();
+                return;
+            }
+
+            WorkTimer workTimer(this);
+
+            const size_t elems = this->workInfo().minInElements;
+            if(0 == elems) return;
+
+            this->configArrayFire();
+
+            auto afWindows = takeWindows(
+                                 _afLeftover,
+                                 this->getInputElementsAsAfArray(0, elems),
+                                 _windowSize);
+            if(afWindows.isempty()) return;
+
+            // The output size depends on how many windows were completed,
+            // so post it instead of writing it into the output buffer.
+            this->postAfArray(0, af::flat(af::sort(afWindows, 0, _isAscending)));
+        }
+
     private:
         bool _isAscending;
+        size_t _windowSize;
+
+        af::array _afLeftover;
+};
+
+/*
+ * Sorts the keys and moves each value along with its key. Like Sort, this
+ * can also sort fixed-size windows, in which case the keys and values are
+ * each kept on the device until a window is complete.
+ */
+class SortByKey: public ArrayFireBlock
+{
+    public:
+        static Pothos::Block* make(
+            const std::string& device,
+            const Pothos::DType& keyDType,
+            const Pothos::DType& valueDType)
+        {
+            if((1 != keyDType.dimension()) || (1 != valueDType.dimension()))
+            {
+                throw Pothos::InvalidArgumentException("This block does not support multi-dimensional types.");
+            }
+
+            // Keys support all but complex, values support everything.
+            validateDType(keyDType, DTypeSupport({true,true,true,false}));
+            validateDType(valueDType, DTypeSupport({true,true,true,true}));
+
+            return new SortByKey(device, keyDType, valueDType);
+        }
+
+        SortByKey(
+            const std::string& device,
+            const Pothos::DType& keyDType,
+            const Pothos::DType& valueDType
+        ):
+            ArrayFireBlock(device),
+            _isAscending(true),
+            _windowSize(0)
+        {
+            this->setupInput("key", keyDType, _domain);
+            this->setupInput("value", valueDType, _domain);
+            this->setupOutput("key", keyDType, _domain);
+            this->setupOutput("value", valueDType, _domain);
+
+            this->registerCall(this, POTHOS_FCN_TUPLE(SortByKey, isAscending));
+            this->registerCall(this, POTHOS_FCN_TUPLE(SortByKey, setIsAscending));
+            this->registerCall(this, POTHOS_FCN_TUPLE(SortByKey, windowSize));
+            this->registerCall(this, POTHOS_FCN_TUPLE(SortByKey, setWindowSize));
+
+            this->registerProbe("isAscending");
+            this->registerProbe("windowSize");
+            this->registerSignal("isAscendingChanged");
+        }
+
+        virtual ~SortByKey() = default;
+
+        void activate() override
+        {
+            ArrayFireBlock::activate();
+
+            _afKeyLeftover = af::array();
+            _afValueLeftover = af::array();
+        }
+
+        bool isAscending() const
+        {
+            return _isAscending;
+        }
+
+        void setIsAscending(bool isAscending)
+        {
+            _isAscending = isAscending;
+
+            this->emitSignal("isAscendingChanged", isAscending);
+        }
+
+        size_t windowSize() const
+        {
+            return _windowSize;
+        }
+
+        // 0 sorts each buffer as it comes in.
+        void setWindowSize(size_t windowSize)
+        {
+            _windowSize = windowSize;
+            _afKeyLeftover = af::array();
+            _afValueLeftover = af::array();
+        }
+
+        void work() override
+        {
+            WorkTimer workTimer(this);
+
+            const size_t elems = this->workInfo().minInElements;
+            if(0 == elems) return;
+
+            this->configArrayFire();
+
+            auto afKeys = this->getInputElementsAsAfArray("key", elems);
+            auto afValues = this->getInputElementsAsAfArray("value", elems);
+
+            if(0 != _windowSize)
+            {
+                afKeys = takeWindows(_afKeyLeftover, afKeys, _windowSize);
+                afValues = takeWindows(_afValueLeftover, afValues, _windowSize);
+                if(afKeys.isempty()) return;
+            }
+
+            af::array afSortedKeys, afSortedValues;
+            af::sort(afSortedKeys, afSortedValues, afKeys, afValues, 0, _isAscending);
+
+            this->postAfArray("key", af::flat(afSortedKeys));
+            this->postAfArray("value", af::flat(afSortedValues));
+        }
+
+    protected:
+
+        void prewarmKernels() override
+        {
+            const auto& keyDType = this->input("key")->dtype();
+            const auto& valueDType = this->input("value")->dtype();
+            const dim_t numElements = static_cast<dim_t>(this->getPrewarmElements(keyDType));
+
+            af::array afSortedKeys, afSortedValues;
+            af::sort(
+                afSortedKeys,
+                afSortedValues,
+                af::constant(0, numElements, Pothos::Object(keyDType).convert<af::dtype>()),
+                af::constant(0, numElements, Pothos::Object(valueDType).convert<af::dtype>()),
+                0,
+                _isAscending);
+            afSortedKeys.eval();
+            afSortedValues.eval();
+        }
+
+    private:
+        bool _isAscending;
+        size_t _windowSize;
+
+        af::array _afKeyLeftover;
+        af::array _afValueLeftover;
 };
 
 /*
  * |PothosDoc Sort (GPU)
  *
+ * Sorts the input stream. By default, each buffer is sorted as it comes
+ * in, so the result depends on how the scheduler splits the stream. With a
+ * non-zero <b>windowSize</b>, the stream is instead sorted in consecutive
+ * windows of exactly that many samples, accumulated on the device across
+ * buffers, and every complete window in a buffer is sorted at once.
+ *
  * |category /GPU/Stream
  * |factory /gpu/algorithm/sort(device,dtype)
  * |setter setIsAscending(isAscending)
+ * |setter setWindowSize(windowSize)
  *
  * |param device[Device] Device to use for processing.
  * |default "Auto"
@@ -86,7 +313,56 @@ class Sort: public OneToOneBlock
  * |widget ToggleSwitch(on="True", off="False")
  * |default true
  * |preview enable
+ *
+ * |param windowSize[Window Size] The number of samples sorted together, or 0 to sort each buffer.
+ * |widget SpinBox(minimum=0)
+ * |default 0
+ * |preview enable
  */
 static Pothos::BlockRegistry registerSort(
     "/gpu/algorithm/sort",
     Pothos::Callable(&Sort::make));
+
+/*
+ * |PothosDoc Sort By Key (GPU)
+ *
+ * Sorts the <b>"key"</b> stream, and reorders the <b>"value"</b> stream
+ * the same way, so each value stays with its key. Both are sorted on the
+ * device with one <b>af::sort</b> call.
+ *
+ * By default, each buffer is sorted as it comes in. With a non-zero
+ * <b>windowSize</b>, the streams are instead sorted in consecutive windows
+ * of exactly that many samples, accumulated on the device across buffers.
+ *
+ * |category /GPU/Stream
+ * |keywords sort key value
+ * |factory /gpu/algorithm/sort_by_key(device,keyDType,valueDType)
+ * |setter setIsAscending(isAscending)
+ * |setter setWindowSize(windowSize)
+ *
+ * |param device[Device] Device to use for processing.
+ * |default "Auto"
+ *
+ * |param keyDType[Key Data Type] The key's data type.
+ * |widget DTypeChooser(int=1,uint=1,float=1)
+ * |default "float64"
+ * |preview disable
+ *
+ * |param valueDType[Value Data Type] The value's data type.
+ * |widget DTypeChooser(int=1,uint=1,float=1,cfloat=1)
+ * |default "complex_float32"
+ * |preview disable
+ *
+ * |param isAscending[Ascending?] Whether to sort by ascending or descending.
+ * |widget ToggleSwitch(on="True", off="False")
+ * |default true
+ * |preview enable
+ *
+ * |param windowSize[Window Size] The number of samples sorted together, or 0 to sort each buffer.
+ * |widget SpinBox(minimum=0)
+ * |default 0
+ * |preview enable
+ */
+static Pothos::BlockRegistry registerSortByKey(
+    "/gpu/algorithm/sort_by_key",
+    Pothos::Callable(&SortByKey::make));
@@ -0,0 +1,73 @@
+// Copyright (c) 2021 Nicholas Corgan
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "StagedCoeffs.hpp"
+
+#include <map>
+
+using DeviceKey = std::pair<af::Backend, int>;
+
+std::shared_ptr<CoeffUploader> CoeffUploader::get(
+    af::Backend backend,
+    int device)
+{
+    static std::mutex uploadersMutex;
+    static std::map<DeviceKey, std::weak_ptr<CoeffUploader>> uploaders;
+
+    std::lock_guard<std::mutex> lock(uploadersMutex);
+
+    auto& weakUploader = uploaders[DeviceKey(backend, device)];
+    auto uploader = weakUploader.lock();
+    if(!uploader)
+    {
+        uploader.reset(new CoeffUploader);
+        weakUploader = uploader;
+    }
+
+    return uploader;
+}
+
+CoeffUploader::CoeffUploader():
+    _stop(false),
+    _thread(&CoeffUploader::_run, this)
+{}
+
+// Whoever posted the remaining jobs has already cancelled them.
+CoeffUploader::~CoeffUploader()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _cond.notify_all();
+    _thread.join();
+}
+
+void CoeffUploader::post(Job job)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _jobs.emplace_back(std::move(job));
+    }
+    _cond.notify_all();
+}
+
+void CoeffUploader::_run()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    while(true)
+    {
+        _cond.wait(lock, [this]{return _stop || !_jobs.empty();});
+        if(_stop) return;
+
+        auto job = std::move(_jobs.front());
+        _jobs.pop_front();
+        lock.unlock();
+
+        job();
+
+        // The job may hold the last reference to its coefficients' state.
+        job = nullptr;
+        lock.lock();
+    }
+}
@@ -0,0 +1,246 @@
+// Copyright (c) 2021 Nicholas Corgan
+// SPDX-License-Identifier: BSD-3-Clause
+
+#pragma once
+
+#include <Poco/Format.h>
+#include <Poco/Logger.h>
+
+#include <arrayfire.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+
+/*
+ * Runs coefficient uploads for every block on one device, in the order they
+ * were posted. Uploads are rare and short, so one thread per device is
+ * plenty, and blocks don't each keep an idle thread around.
+ */
+class CoeffUploader
+{
+    public:
+        using Job = std::function<void()>;
+
+        // The uploader is shared by everything holding it, and its thread
+        // stops once the last holder releases it.
+        static std::shared_ptr<CoeffUploader> get(
+            af::Backend backend,
+            int device);
+
+        ~CoeffUploader();
+
+        void post(Job job);
+
+    private:
+        CoeffUploader();
+
+        std::mutex _mutex;
+        std::condition_variable _cond;
+        std::deque<Job> _jobs;
+        bool _stop;
+
+        // Declared last so everything it uses is constructed first.
+        std::thread _thread;
+
+        void _run();
+};
+
+/*
+ * Filter coefficients set through a slot are uploaded on the device's
+ * uploader thread, so the slot returns without waiting on the device, and the
+ * actor thread never blocks work() on a host-to-device copy. Once an upload
+ * has finished, work() swaps it in at the start of its next buffer, so no
+ * buffer is processed with a mix of old and new coefficients. If coefficients
+ * are staged faster than they can be uploaded, only the newest pending set is
+ * uploaded.
+ */
+template <typename T>
+class StagedCoeffs
+{
+    public:
+        // Runs on the uploader thread, and must configure ArrayFire for it.
+        using Upload = std::function<T()>;
+
+        StagedCoeffs(
+            af::Backend backend,
+            int device
+        ):
+            _state(std::make_shared<State>()),
+            _uploader(CoeffUploader::get(backend, device))
+        {}
+
+        // Uploads usually capture their block, so one that hasn't started
+        // is dropped, and one in progress is finished first.
+        ~StagedCoeffs()
+        {
+            std::unique_lock<std::mutex> lock(_state->mutex);
+            _state->pending = nullptr;
+            _state->cond.wait(lock, [this]{return !_state->isUploading;});
+        }
+
+        // Replaces any upload that hasn't started yet.
+        void stage(Upload upload)
+        {
+            std::lock_guard<std::mutex> lock(_state->mutex);
+            _state->pending = std::move(upload);
+
+            // A queued job uploads whatever is pending when it runs.
+            if(!_state->isQueued)
+            {
+                _state->isQueued = true;
+
+                auto state = _state;
+                _uploader->post([state](){StagedCoeffs::_runUpload(*state);});
+            }
+        }
+
+        // Whether any staged coefficients have yet to finish uploading.
+        bool isUploading() const
+        {
+            std::lock_guard<std::mutex> lock(_state->mutex);
+            return (_state->pending || _state->isUploading);
+        }
+
+        // Returns whether an upload finished since the last call. If wait is
+        // set, any staged upload is finished first.
+        bool take(T& coeffs, bool wait = false)
+        {
+            std::unique_lock<std::mutex> lock(_state->mutex);
+            if(wait)
+            {
+                _state->cond.wait(lock, [this]{return !_state->pending && !_state->isUploading;});
+            }
+            if(!_state->hasReady) return false;
+
+            coeffs = std::move(_state->ready);
+            _state->ready = T();
+            _state->hasReady = false;
+
+            return true;
+        }
+
+    private:
+        // Shared with queued jobs, which may run after this is destroyed.
+        struct State
+        {
+            std::mutex mutex;
+            std::condition_variable cond;
+            Upload pending;
+            bool isQueued = false;
+            bool isUploading = false;
+            T ready;
+            bool hasReady = false;
+        };
+
+        std::shared_ptr<State> _state;
+        std::shared_ptr<CoeffUploader> _uploader;
+
+        static void _runUpload(State& state)
+        {
+            static auto& logger = Poco::Logger::get("StagedCoeffs");
+
+            std::unique_lock<std::mutex> lock(state.mutex);
+            state.isQueued = false;
+            if(!state.pending) return;
+
+            auto upload = std::move(state.pending);
+            state.pending = nullptr;
+            state.isUploading = true;
+            lock.unlock();
+
+            // Only hand over coefficients that are already on the device. A
+            // failed upload leaves the current ones in place.
+            T coeffs;
+            bool success = false;
+            try
+            {
+                coeffs = upload();
+                af::sync();
+                success = true;
+            }
+            catch(const std::exception& ex)
+            {
+                poco_error(logger, Poco::format("Failed to upload coefficients: %s", std::string(ex.what())));
+            }
+
+            lock.lock();
+            if(success)
+            {
+                state.ready = std::move(coeffs);
+                state.hasReady = true;
+            }
+            state.isUploading = false;
+            state.cond.notify_all();
+        }
+};
+
+/*
+ * Linearly fades from the old filter's output to the new filter's output
+ * over a number of samples, which may span multiple buffers.
+ */
+class Crossfader
+{
+    public:
+        Crossfader(): _length(0), _position(0)
+        {}
+
+        inline size_t length() const
+        {
+            return _length;
+        }
+
+        // Any fade in progress is finished immediately.
+        inline void setLength(size_t length)
+        {
+            _length = length;
+            _position = length;
+        }
+
+        inline void start()
+        {
+            _position = 0;
+        }
+
+        inline bool active() const
+        {
+            return (_position < _length);
+        }
+
+        // The outputs are interleaved with the given number of channels.
+        af::array apply(
+            const af::array& afOldOutput,
+            const af::array& afNewOutput,
+            size_t numChannels)
+        {
+            // This can happen if the filter length changed in a mode whose
+            // output size depends on it.
+            if(afOldOutput.elements() != afNewOutput.elements())
+            {
+                _position = _length;
+                return afNewOutput;
+            }
+
+            const dim_t numChans = static_cast<dim_t>(numChannels);
+            const dim_t numSamples = afNewOutput.elements() / numChans;
+
+            auto afWeights = af::min(
+                                 (af::range(af::dim4(numChans, numSamples), 1, ::f32) + static_cast<float>(_position + 1))
+                                 / static_cast<float>(_length),
+                                 1.0f);
+            _position = std::min(_length, _position + static_cast<size_t>(numSamples));
+
+            return afOldOutput + ((afNewOutput - afOldOutput) * af::flat(afWeights));
+        }
+
+    private:
+        size_t _length;
+        size_t _position;
+};
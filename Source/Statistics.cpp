@@ -1,4 +1,4 @@
-// Copyright (c) 2019-2020 Nicholas Corgan
+// Copyright (c) 2019-2021 Nicholas Corgan
 // SPDX-License-Identifier: BSD-3-Clause
 
 #include "ArrayFireBlock.hpp"
@@ -9,13 +9,18 @@
 #include <Pothos/Object.hpp>
 
 #include <Poco/Format.h>
+#include <Poco/NumberFormatter.h>
 #include <Poco/String.h>
 
 #include <arrayfire.h>
 
+#include <algorithm>
+#include <cmath>
 #include <functional>
 #include <iostream>
+#include <string>
 #include <typeinfo>
+#include <unordered_map>
 #include <vector>
 
 //
@@ -95,6 +100,29 @@ static af::array afRMS(const af::array& afInput, const dim_t)
     return af::sqrt(af::sum(af::pow(afInput, 2.0)) / arrLen);
 }
 
+enum class MomentStat
+{
+    Mean,
+    Variance,
+    Stdev
+};
+
+enum class StreamingMode
+{
+    Buffer,
+    Cumulative,
+    Exponential,
+    FixedCount
+};
+
+static const std::unordered_map<std::string, StreamingMode> StreamingModeEnumMap =
+{
+    {"buffer",      StreamingMode::Buffer},
+    {"cumulative",  StreamingMode::Cumulative},
+    {"exponential", StreamingMode::Exponential},
+    {"fixed",       StreamingMode::FixedCount},
+};
+
 //
 // Class
 //
@@ -160,13 +188,15 @@ class OneArrayStatsBlock: public ArrayFireBlock
                 dtype)
         {}
 
-        double lastValue() const
+        virtual double lastValue() const
         {
             return _lastValue;
         }
 
         void work() override
         {
+            WorkTimer workTimer(this);
+
             const size_t elems = this->workInfo().minAllElements;
             if(0 == elems)
             {
@@ -195,7 +225,293 @@ class OneArrayStatsBlock: public ArrayFireBlock
         double _lastValue;
 };
 
-class StdevBlock: public OneArrayStatsBlock
+/*
+ * In the streaming modes, each buffer's count, mean, and sum of squared
+ * deviations (M2) are computed on the device and merged into the running
+ * totals with the parallel form of Welford's algorithm:
+ *
+ *   n = nA + nB
+ *   d = meanB - meanA
+ *   mean = meanA + d*nB/n
+ *   M2 = M2A + M2B + d^2*nA*nB/n
+ *
+ * The running mean and M2 stay on the device, so nothing is copied back
+ * until the value is requested. In the exponential mode, each sample's
+ * weight decays by (1-alpha) per newer sample, so the counts become sums
+ * of weights, and the previous totals are decayed before each merge. Since
+ * the weights only depend on the number of samples, the result doesn't
+ * depend on where buffers are split.
+ */
+class StreamingMomentsBlock: public OneArrayStatsBlock
+{
+    public:
+
+        static Pothos::Block* makeMean(
+            const std::string& device,
+            const Pothos::DType& dtype)
+        {
+            validateDType(dtype, DTypeSupport({true,true,true,false}));
+
+            return new StreamingMomentsBlock(
+                           device,
+                           static_cast<OneArrayStatsFuncPtr>(af::mean),
+                           dtype,
+                           MomentStat::Mean,
+                           false);
+        }
+
+        StreamingMomentsBlock(
+            const std::string& device,
+            OneArrayStatsFunction func,
+            const Pothos::DType& dtype,
+            MomentStat stat,
+            bool isBiased
+        ):
+            OneArrayStatsBlock(
+                device,
+                std::move(func),
+                dtype),
+            _stat(stat),
+            _isBiased(isBiased),
+            _mode(StreamingMode::Buffer),
+            _alpha(0.01),
+            _windowSize(1024)
+        {
+            this->registerCall(this, POTHOS_FCN_TUPLE(StreamingMomentsBlock, mode));
+            this->registerCall(this, POTHOS_FCN_TUPLE(StreamingMomentsBlock, setMode));
+            this->registerCall(this, POTHOS_FCN_TUPLE(StreamingMomentsBlock, alpha));
+            this->registerCall(this, POTHOS_FCN_TUPLE(StreamingMomentsBlock, setAlpha));
+            this->registerCall(this, POTHOS_FCN_TUPLE(StreamingMomentsBlock, windowSize));
+            this->registerCall(this, POTHOS_FCN_TUPLE(StreamingMomentsBlock, setWindowSize));
+            this->registerCall(this, POTHOS_FCN_TUPLE(StreamingMomentsBlock, count));
+            this->registerCall(this, POTHOS_FCN_TUPLE(StreamingMomentsBlock, resetState));
+
+            this->registerProbe("mode");
+            this->registerProbe("count");
+
+            this->resetState();
+        }
+
+        double lastValue() const override
+        {
+            if(StreamingMode::Buffer == _mode) return _lastValue;
+
+            const auto& moments = (StreamingMode::FixedCount == _mode) ? _published : _running;
+            if(0.0 == moments.weight) return _lastValue;
+
+            this->configArrayFire();
+
+            if(MomentStat::Mean == _stat)
+            {
+                return moments.afMean.scalar<double>();
+            }
+
+            // Exponential weights aren't sample counts, so there's no
+            // unbiased correction.
+            const bool isBiased = _isBiased || (StreamingMode::Exponential == _mode);
+            const double denom = isBiased ? moments.weight : (moments.weight - 1.0);
+            if(denom <= 0.0) return 0.0;
+
+            const double variance = moments.afM2.scalar<double>() / denom;
+
+            return (MomentStat::Stdev == _stat) ? std::sqrt(variance) : variance;
+        }
+
+        std::string mode() const
+        {
+            return getKeyForVal(StreamingModeEnumMap, _mode);
+        }
+
+        void setMode(const std::string& mode)
+        {
+            _mode = getValForKey(StreamingModeEnumMap, mode);
+            this->resetState();
+        }
+
+        double alpha() const
+        {
+            return _alpha;
+        }
+
+        void setAlpha(double alpha)
+        {
+            if((alpha <= 0.0) || (alpha > 1.0))
+            {
+                throw Pothos::RangeException("Alpha must be in the range (0,1].");
+            }
+
+            _alpha = alpha;
+        }
+
+        size_t windowSize() const
+        {
+            return _windowSize;
+        }
+
+        void setWindowSize(size_t windowSize)
+        {
+            if(0 == windowSize)
+            {
+                throw Pothos::RangeException("Window size must be non-zero.");
+            }
+
+            _windowSize = windowSize;
+            this->resetState();
+        }
+
+        // The number of samples (or, in the exponential mode, the total
+        // weight) behind the current value
+        double count() const
+        {
+            if(StreamingMode::Buffer == _mode) return 0.0;
+
+            return (StreamingMode::FixedCount == _mode) ? _published.weight : _running.weight;
+        }
+
+        void resetState() override
+        {
+            _running = Moments();
+            _published = Moments();
+            _lastValue = 0.0;
+        }
+
+        void work() override
+        {
+            if(StreamingMode::Buffer == _mode)
+            {
+                OneArrayStatsBlock::work();
+                return;
+            }
+
+            WorkTimer workTimer(this);
+
+            const size_t elems = this->workInfo().minAllElements;
+            if(0 == elems)
+            {
+                return;
+            }
+
+            this->configArrayFire();
+
+            auto afArray = this->getInputPortAsAfArray(0);
+            auto afValues = af::flat(afArray).as(::f64);
+
+            if(StreamingMode::Exponential == _mode)
+            {
+                this->_mergeExponential(afValues);
+            }
+            else if(StreamingMode::FixedCount == _mode)
+            {
+                // Publish each completed window, and start the next one
+                // with the rest of the buffer.
+                const dim_t numValues = afValues.elements();
+                dim_t offset = 0;
+                while(offset < numValues)
+                {
+                    const dim_t remaining = static_cast<dim_t>(_windowSize - static_cast<size_t>(_running.weight));
+                    const dim_t segmentLength = std::min(remaining, numValues - offset);
+
+                    this->_merge(afValues(af::seq(
+                                     static_cast<double>(offset),
+                                     static_cast<double>(offset + segmentLength - 1))));
+                    offset += segmentLength;
+
+                    if(static_cast<size_t>(_running.weight) == _windowSize)
+                    {
+                        _published = _running;
+                        _running = Moments();
+                    }
+                }
+            }
+            else
+            {
+                this->_merge(afValues);
+            }
+
+            this->produceFromAfArray(0, afArray);
+        }
+
+    protected:
+
+        MomentStat _stat;
+        bool _isBiased;
+
+    private:
+
+        struct Moments
+        {
+            Moments(): weight(0.0) {}
+
+            double weight;
+            af::array afMean;
+            af::array afM2;
+        };
+
+        StreamingMode _mode;
+        double _alpha;
+        size_t _windowSize;
+
+        Moments _running;
+        Moments _published;
+
+        void _combine(
+            double weight,
+            const af::array& afMean,
+            const af::array& afM2)
+        {
+            if(0.0 == _running.weight)
+            {
+                _running.weight = weight;
+                _running.afMean = afMean.eval();
+                _running.afM2 = afM2.eval();
+                return;
+            }
+
+            const double totalWeight = _running.weight + weight;
+            auto afDelta = afMean - _running.afMean;
+
+            _running.afMean = (_running.afMean + (afDelta * (weight / totalWeight))).eval();
+            _running.afM2 = (_running.afM2 + afM2 + (afDelta * afDelta * ((_running.weight * weight) / totalWeight))).eval();
+            _running.weight = totalWeight;
+        }
+
+        void _merge(const af::array& afValues)
+        {
+            const dim_t numValues = afValues.elements();
+
+            auto afMean = af::mean(afValues);
+            auto afM2 = af::sum(af::pow(afValues - af::tile(afMean, static_cast<unsigned>(numValues)), 2.0));
+
+            this->_combine(static_cast<double>(numValues), afMean, afM2);
+        }
+
+        void _mergeExponential(const af::array& afValues)
+        {
+            const dim_t numValues = afValues.elements();
+            const double decay = 1.0 - _alpha;
+            const double bufferDecay = std::pow(decay, static_cast<double>(numValues));
+
+            // The newest sample has a weight of 1.
+            auto afWeights = af::pow(
+                                 decay,
+                                 static_cast<double>(numValues - 1) - af::range(af::dim4(numValues), 0, ::f64));
+            const double weight = (1.0 == decay) ? static_cast<double>(numValues)
+                                                 : ((1.0 - bufferDecay) / (1.0 - decay));
+
+            auto afMean = af::sum(afWeights * afValues) / weight;
+            auto afM2 = af::sum(afWeights * af::pow(afValues - af::tile(afMean, static_cast<unsigned>(numValues)), 2.0));
+
+            if(_running.weight > 0.0)
+            {
+                _running.weight *= bufferDecay;
+                _running.afM2 = (_running.afM2 * bufferDecay).eval();
+            }
+
+            this->_combine(weight, afMean, afM2);
+        }
+};
+
+class StdevBlock: public StreamingMomentsBlock
 {
     public:
 
@@ -210,11 +526,12 @@ class StdevBlock: public OneArrayStatsBlock
             const std::string& device,
             const Pothos::DType& dtype
         ):
-            OneArrayStatsBlock(
+            StreamingMomentsBlock(
                 device,
                 getAfStdevFunction(false),
-                dtype),
-            _isBiased(false)
+                dtype,
+                MomentStat::Stdev,
+                false)
         {
             this->registerCall(this, POTHOS_FCN_TUPLE(StdevBlock, isBiased));
             this->registerCall(this, POTHOS_FCN_TUPLE(StdevBlock, setIsBiased));
@@ -235,13 +552,9 @@ class StdevBlock: public OneArrayStatsBlock
 
             this->emitSignal("isBiasedChanged", isBiased);
         }
-
-    private:
-
-        bool _isBiased;
 };
 
-class VarianceBlock: public OneArrayStatsBlock
+class VarianceBlock: public StreamingMomentsBlock
 {
     public:
 
@@ -258,11 +571,12 @@ class VarianceBlock: public OneArrayStatsBlock
             const Pothos::DType& dtype,
             bool isBiased
         ):
-            OneArrayStatsBlock(
+            StreamingMomentsBlock(
                 device,
                 getAfVarFunction(isBiased),
-                dtype),
-            _isBiased(isBiased)
+                dtype,
+                MomentStat::Variance,
+                isBiased)
         {
             this->registerCall(this, POTHOS_FCN_TUPLE(VarianceBlock, isBiased));
             this->registerCall(this, POTHOS_FCN_TUPLE(VarianceBlock, setIsBiased));
@@ -285,10 +599,6 @@ class VarianceBlock: public OneArrayStatsBlock
 
             this->emitSignal("isBiasedChanged", isBiased);
         }
-
-    private:
-
-        bool _isBiased;
 };
 
 //
@@ -302,9 +612,16 @@ class VarianceBlock: public OneArrayStatsBlock
  * arithmetic mean of the given values. The result of the last calculation
  * can be queried with the <b>lastValue</b> probe.
  *
+ * In the streaming modes, the value is accumulated across buffers on the
+ * device and only copied back when <b>lastValue</b> is queried, so it
+ * doesn't depend on buffer sizes.
+ *
  * |category /GPU/Statistics
  * |keywords statistics stats mean average
  * |factory /gpu/statistics/mean(device,dtype)
+ * |setter setMode(mode)
+ * |setter setAlpha(alpha)
+ * |setter setWindowSize(windowSize)
  *
  * |param device[Device] Device to use for processing.
  * |default "Auto"
@@ -313,12 +630,35 @@ class VarianceBlock: public OneArrayStatsBlock
  * |widget DTypeChooser(int=1,uint=1,float=1,dim=1)
  * |default "float64"
  * |preview disable
+ *
+ * |param mode[Mode] Which samples the value is calculated over.
+ * <ul>
+ * <li><b>Buffer:</b> the most recent buffer</li>
+ * <li><b>Cumulative:</b> every sample since activation or <b>"resetState"</b></li>
+ * <li><b>Exponential:</b> every sample, exponentially weighted by <b>alpha</b></li>
+ * <li><b>Fixed:</b> the most recent complete window of <b>windowSize</b> samples</li>
+ * </ul>
+ * |widget ComboBox(editable=false)
+ * |option [Buffer] "buffer"
+ * |option [Cumulative] "cumulative"
+ * |option [Exponential] "exponential"
+ * |option [Fixed] "fixed"
+ * |default "buffer"
+ * |preview enable
+ *
+ * |param alpha[Alpha] In the exponential mode, the weight of each new sample.
+ * |widget DoubleSpinBox(minimum=0,maximum=1,step=0.001,decimals=4)
+ * |default 0.01
+ * |preview disable
+ *
+ * |param windowSize[Window Size] In the fixed mode, the number of samples per value.
+ * |widget SpinBox(minimum=1)
+ * |default 1024
+ * |preview disable
  */
 static Pothos::BlockRegistry registerMean(
     "/gpu/statistics/mean",
-    Pothos::Callable(&OneArrayStatsBlock::makeFromFuncPtr)
-        .bind<OneArrayStatsFuncPtr>(&af::mean, 1)
-        .bind<DTypeSupport>(DTypeSupport({true,true,true,false}), 2));
+    Pothos::Callable(&StreamingMomentsBlock::makeMean));
 
 /*
  * |PothosDoc Median (GPU)
@@ -327,6 +667,8 @@ static Pothos::BlockRegistry registerMean(
  * median of the given values. The result of the last calculation
  * can be queried with the <b>lastValue</b> probe.
  *
+ * For the median over the whole stream, see <b>/gpu/statistics/quantile_sketch</b>.
+ *
  * |category /GPU/Statistics
  * |keywords statistics stats
  * |factory /gpu/statistics/median(device,dtype)
@@ -377,10 +719,17 @@ static Pothos::BlockRegistry registerRMS(
  * median of the given values. The result of the last calculation
  * can be queried with the <b>lastValue</b> probe.
  *
+ * In the streaming modes, the value is accumulated across buffers on the
+ * device and only copied back when <b>lastValue</b> is queried, so it
+ * doesn't depend on buffer sizes.
+ *
  * |category /GPU/Statistics
  * |keywords statistics stats root mean square
  * |factory /gpu/statistics/var(device,dtype,isBiased)
  * |setter setIsBiased(isBiased)
+ * |setter setMode(mode)
+ * |setter setAlpha(alpha)
+ * |setter setWindowSize(windowSize)
  *
  * |param device[Device] Device to use for processing.
  * |default "Auto"
@@ -393,6 +742,31 @@ static Pothos::BlockRegistry registerRMS(
  * |param isBiased[Is Biased?] Whether or not the input values contain sample bias.
  * |widget ToggleSwitch(on="True", off="False")
  * |default False
+ *
+ * |param mode[Mode] Which samples the value is calculated over.
+ * <ul>
+ * <li><b>Buffer:</b> the most recent buffer</li>
+ * <li><b>Cumulative:</b> every sample since activation or <b>"resetState"</b></li>
+ * <li><b>Exponential:</b> every sample, exponentially weighted by <b>alpha</b></li>
+ * <li><b>Fixed:</b> the most recent complete window of <b>windowSize</b> samples</li>
+ * </ul>
+ * |widget ComboBox(editable=false)
+ * |option [Buffer] "buffer"
+ * |option [Cumulative] "cumulative"
+ * |option [Exponential] "exponential"
+ * |option [Fixed] "fixed"
+ * |default "buffer"
+ * |preview enable
+ *
+ * |param alpha[Alpha] In the exponential mode, the weight of each new sample.
+ * |widget DoubleSpinBox(minimum=0,maximum=1,step=0.001,decimals=4)
+ * |default 0.01
+ * |preview disable
+ *
+ * |param windowSize[Window Size] In the fixed mode, the number of samples per value.
+ * |widget SpinBox(minimum=1)
+ * |default 1024
+ * |preview disable
  */
 static Pothos::BlockRegistry registerVar(
     "/gpu/statistics/var",
@@ -405,10 +779,17 @@ static Pothos::BlockRegistry registerVar(
  * standard deviation of the given values. The result of the last calculation
  * can be queried with the <b>lastValue</b> probe.
  *
+ * In the streaming modes, the value is accumulated across buffers on the
+ * device and only copied back when <b>lastValue</b> is queried, so it
+ * doesn't depend on buffer sizes.
+ *
  * |category /GPU/Statistics
  * |keywords statistics stats stddev
  * |factory /gpu/statistics/stdev(device,dtype)
  * |setter setIsBiased(isBiased)
+ * |setter setMode(mode)
+ * |setter setAlpha(alpha)
+ * |setter setWindowSize(windowSize)
  *
  * |param device[Device] Device to use for processing.
  * |default "Auto"
@@ -422,6 +803,31 @@ static Pothos::BlockRegistry registerVar(
  * Only available with ArrayFire 3.8+.
  * |widget ToggleSwitch(on="True", off="False")
  * |default False
+ *
+ * |param mode[Mode] Which samples the value is calculated over.
+ * <ul>
+ * <li><b>Buffer:</b> the most recent buffer</li>
+ * <li><b>Cumulative:</b> every sample since activation or <b>"resetState"</b></li>
+ * <li><b>Exponential:</b> every sample, exponentially weighted by <b>alpha</b></li>
+ * <li><b>Fixed:</b> the most recent complete window of <b>windowSize</b> samples</li>
+ * </ul>
+ * |widget ComboBox(editable=false)
+ * |option [Buffer] "buffer"
+ * |option [Cumulative] "cumulative"
+ * |option [Exponential] "exponential"
+ * |option [Fixed] "fixed"
+ * |default "buffer"
+ * |preview enable
+ *
+ * |param alpha[Alpha] In the exponential mode, the weight of each new sample.
+ * |widget DoubleSpinBox(minimum=0,maximum=1,step=0.001,decimals=4)
+ * |default 0.01
+ * |preview disable
+ *
+ * |param windowSize[Window Size] In the fixed mode, the number of samples per value.
+ * |widget SpinBox(minimum=1)
+ * |default 1024
+ * |preview disable
  */
 static Pothos::BlockRegistry registerStdev(
     "/gpu/statistics/stdev",
@@ -434,6 +840,9 @@ static Pothos::BlockRegistry registerStdev(
  * The result of the last calculation can be queried with the
  * <b>lastValue</b> probe.
  *
+ * For the median absolute deviation over the whole stream, see
+ * <b>/gpu/statistics/quantile_sketch</b>.
+ *
  * |category /GPU/Statistics
  * |keywords statistics stats mad
  * |factory /gpu/statistics/medabsdev(device,dtype)
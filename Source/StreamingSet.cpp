@@ -0,0 +1,399 @@
+// Copyright (c) 2021 Nicholas Corgan
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "ArrayFireBlock.hpp"
+#include "Utility.hpp"
+
+#include <Pothos/Exception.hpp>
+#include <Pothos/Framework.hpp>
+#include <Pothos/Object.hpp>
+
+#include <arrayfire.h>
+
+#include <string>
+#include <vector>
+
+//
+// Block class
+//
+
+/*
+ * The set of values seen so far is kept sorted on the device, along with
+ * the sample count as of the last buffer each value was seen in. Each
+ * buffer's unique values are appended to the set and sorted together with
+ * it, so any value already in the set ends up next to its copy. Values
+ * without a copy that came from the buffer are the newly-seen ones, and
+ * dropping the second of each pair gives the merged set.
+ *
+ * When the set is capped, the values seen least recently are evicted
+ * first, so a value that goes unseen long enough is reported again the
+ * next time it comes up.
+ */
+class StreamingSetBlock: public ArrayFireBlock
+{
+    public:
+
+        static Pothos::Block* make(
+            const std::string& device,
+            const Pothos::DType& dtype,
+            size_t numInputs)
+        {
+            validateDType(dtype, DTypeSupport({true,true,true,false}));
+
+            return new StreamingSetBlock(device, dtype, numInputs);
+        }
+
+        StreamingSetBlock(
+            const std::string& device,
+            const Pothos::DType& dtype,
+            size_t numInputs
+        ):
+            ArrayFireBlock(device),
+            _afDType(Pothos::Object(dtype).convert<af::dtype>()),
+            _numInputs(numInputs),
+            _capacity(0),
+            _maxAge(0),
+            _numTotal(0)
+        {
+            if(0 == _numInputs)
+            {
+                throw Pothos::InvalidArgumentException("The number of inputs must be non-zero.");
+            }
+
+            for(size_t input = 0; input < _numInputs; ++input)
+            {
+                this->setupInput(input, dtype, _domain);
+            }
+            this->setupOutput(0, dtype, _domain);
+
+            this->registerCall(this, POTHOS_FCN_TUPLE(StreamingSetBlock, capacity));
+            this->registerCall(this, POTHOS_FCN_TUPLE(StreamingSetBlock, setCapacity));
+            this->registerCall(this, POTHOS_FCN_TUPLE(StreamingSetBlock, maxAge));
+            this->registerCall(this, POTHOS_FCN_TUPLE(StreamingSetBlock, setMaxAge));
+            this->registerCall(this, POTHOS_FCN_TUPLE(StreamingSetBlock, size));
+            this->registerCall(this, POTHOS_FCN_TUPLE(StreamingSetBlock, values));
+            this->registerCall(this, POTHOS_FCN_TUPLE(StreamingSetBlock, resetState));
+
+            this->registerProbe("size");
+            this->registerProbe("values");
+
+            this->resetState();
+        }
+
+        virtual ~StreamingSetBlock() = default;
+
+        size_t capacity() const
+        {
+            return _capacity;
+        }
+
+        // Zero means unlimited. Takes effect with the next buffer.
+        void setCapacity(size_t capacity)
+        {
+            _capacity = capacity;
+        }
+
+        unsigned long long maxAge() const
+        {
+            return _maxAge;
+        }
+
+        // Zero means values never age out. Takes effect with the next buffer.
+        void setMaxAge(unsigned long long maxAge)
+        {
+            _maxAge = maxAge;
+        }
+
+        size_t size() const
+        {
+            return static_cast<size_t>(_afSet.elements());
+        }
+
+        // The current set, in ascending order
+        Pothos::Object values() const
+        {
+            this->configArrayFire();
+
+            return afArrayToStdVector(_afSet);
+        }
+
+        void resetState() override
+        {
+            this->configArrayFire();
+
+            _afSet = af::array(0, _afDType);
+            _afLastSeen = af::array(0, ::u64);
+            _numTotal = 0;
+        }
+
+        void work() override
+        {
+            WorkTimer workTimer(this);
+
+            this->configArrayFire();
+
+            // Each port is drained independently, since nothing needs to
+            // line up between them.
+            af::array afInput;
+            for(size_t input = 0; input < _numInputs; ++input)
+            {
+                if(0 == this->input(input)->elements()) continue;
+
+                auto afPortInput = af::flat(this->getInputElementsAsAfArray(
+                                                input,
+                                                this->input(input)->elements()));
+                afInput = afInput.isempty() ? afPortInput : af::join(0, afInput, afPortInput);
+            }
+            if(afInput.isempty()) return;
+
+            _numTotal += static_cast<unsigned long long>(afInput.elements());
+
+            auto afNewValues = this->_merge(afInput);
+            this->_ageOut();
+            this->_evict();
+
+            if(!afNewValues.isempty()) this->postAfArray(0, afNewValues);
+        }
+
+    protected:
+
+        void prewarmKernels() override
+        {
+            const auto& dtype = this->input(0)->dtype();
+            const auto afInput = af::range(
+                                     af::dim4(static_cast<dim_t>(this->getPrewarmElements(dtype))),
+                                     0,
+                                     _afDType);
+
+            // Go through the merge twice so the set isn't empty the second time.
+            this->resetState();
+            this->_merge(afInput).eval();
+            this->_merge(afInput).eval();
+            _afSet.eval();
+            _afLastSeen.eval();
+        }
+
+    private:
+        af::dtype _afDType;
+        size_t _numInputs;
+
+        size_t _capacity;
+        unsigned long long _maxAge;
+
+        // Sorted ascending, with the matching sample counts
+        af::array _afSet;
+        af::array _afLastSeen;
+
+        unsigned long long _numTotal;
+
+        // Returns the values not already in the set, in ascending order.
+        af::array _merge(const af::array& afInput)
+        {
+            const auto afCandidates = af::setUnique(afInput, false);
+            const dim_t numSet = _afSet.elements();
+            const dim_t numCandidates = afCandidates.elements();
+            const dim_t numValues = numSet + numCandidates;
+
+            const auto afCandidatesSeen = af::constant(_numTotal, numCandidates, ::u64);
+            const auto afCandidateFlags = af::constant(1, numCandidates, ::b8);
+
+            af::array afValues, afLastSeen, afIsCandidate;
+            if(0 == numSet)
+            {
+                afValues = afCandidates;
+                afLastSeen = afCandidatesSeen;
+                afIsCandidate = afCandidateFlags;
+            }
+            else
+            {
+                afValues = af::join(0, _afSet, afCandidates);
+                afLastSeen = af::join(0, _afLastSeen, afCandidatesSeen);
+                afIsCandidate = af::join(0, af::constant(0, numSet, ::b8), afCandidateFlags);
+            }
+
+            af::array afSortedValues, afOrder;
+            af::sort(
+                afSortedValues,
+                afOrder,
+                afValues,
+                af::range(af::dim4(numValues), 0, ::u32));
+
+            // Neither the set nor the candidates have duplicates, so equal
+            // values come in adjacent pairs, one from each.
+            auto afSameAsNext = af::constant(0, numValues, ::b8);
+            if(numValues > 1)
+            {
+                const auto afHead = af::seq(0, static_cast<double>(numValues - 2));
+                const auto afTail = af::seq(1, static_cast<double>(numValues - 1));
+                afSameAsNext(afHead) = (afSortedValues(afHead) == afSortedValues(afTail));
+            }
+
+            // The last element is never the same as its next, so the wrap
+            // leaves the first element false.
+            const auto afSameAsPrev = af::shift(afSameAsNext, 1);
+
+            const auto afIsNew = afIsCandidate(afOrder) && !(afSameAsNext || afSameAsPrev);
+
+            // Keep the first of each pair, with the newer sample count.
+            const auto afKeepIndices = af::where(!afSameAsPrev);
+            _afSet = afSortedValues(afKeepIndices).copy();
+            _afLastSeen = af::select(
+                              afSameAsNext,
+                              af::constant(_numTotal, numValues, ::u64),
+                              afLastSeen(afOrder))(afKeepIndices).copy();
+
+            const auto afNewIndices = af::where(afIsNew);
+
+            return afNewIndices.isempty() ? af::array(0, _afDType)
+                                          : afSortedValues(afNewIndices).copy();
+        }
+
+        void _ageOut()
+        {
+            if((0 == _maxAge) || (_numTotal <= _maxAge) || _afSet.isempty()) return;
+
+            const auto afOldest = af::constant(_numTotal - _maxAge, _afLastSeen.elements(), ::u64);
+            const auto afFreshIndices = af::where(_afLastSeen >= afOldest);
+            if(afFreshIndices.elements() == _afSet.elements()) return;
+
+            if(afFreshIndices.isempty())
+            {
+                _afSet = af::array(0, _afDType);
+                _afLastSeen = af::array(0, ::u64);
+            }
+            else
+            {
+                _afSet = _afSet(afFreshIndices).copy();
+                _afLastSeen = _afLastSeen(afFreshIndices).copy();
+            }
+        }
+
+        // Ties between values last seen in the same buffer are broken
+        // arbitrarily.
+        void _evict()
+        {
+            if((0 == _capacity) || (static_cast<size_t>(_afSet.elements()) <= _capacity)) return;
+
+            af::array afSortedLastSeen, afRecentIndices;
+            af::sort(
+                afSortedLastSeen,
+                afRecentIndices,
+                _afLastSeen,
+                af::range(af::dim4(_afLastSeen.elements()), 0, ::u32),
+                0,
+                false);
+
+            // Put the survivors back in the set's order.
+            const auto afKeepIndices = af::sort(afRecentIndices(af::seq(0, static_cast<double>(_capacity - 1))));
+            _afSet = _afSet(afKeepIndices).copy();
+            _afLastSeen = _afLastSeen(afKeepIndices).copy();
+        }
+};
+
+//
+// Factories
+//
+
+static Pothos::Block* makeStreamingSetUnique(
+    const std::string& device,
+    const Pothos::DType& dtype)
+{
+    return StreamingSetBlock::make(device, dtype, 1);
+}
+
+//
+// Block registration
+//
+
+/*
+ * |PothosDoc Streaming Set Unique (GPU)
+ *
+ * Keeps the set of distinct values seen over the whole stream on the
+ * device and outputs only the values that aren't already in it. Unlike
+ * <b>/gpu/algorithm/set_unique</b>, which only removes duplicates within
+ * a buffer, each value is output once until it leaves the set. The new
+ * values from each buffer are output in ascending order.
+ *
+ * The set can be capped to a maximum size, in which case the values seen
+ * least recently are evicted first, and values can be aged out once they
+ * haven't been seen in a given number of samples. An evicted value is
+ * output again the next time it's seen. Ages are tracked per buffer.
+ *
+ * |category /GPU/Algorithm
+ * |keywords unique distinct set dedup deduplicate stream lru
+ * |factory /gpu/algorithm/streaming_set_unique(device,dtype)
+ * |setter setCapacity(capacity)
+ * |setter setMaxAge(maxAge)
+ *
+ * |param device[Device] Device to use for processing.
+ * |default "Auto"
+ *
+ * |param dtype[Data Type] The input and output data type.
+ * |widget DTypeChooser(int=1,uint=1,float=1,dim=1)
+ * |default "int32"
+ * |preview disable
+ *
+ * |param capacity[Capacity] The maximum number of values in the set, or 0 for no limit.
+ * |widget SpinBox(minimum=0)
+ * |default 0
+ * |preview enable
+ *
+ * |param maxAge[Max Age] How many samples a value can go unseen before it's
+ * removed from the set, or 0 to never remove it.
+ * |widget SpinBox(minimum=0)
+ * |default 0
+ * |preview enable
+ */
+static Pothos::BlockRegistry registerStreamingSetUnique(
+    "/gpu/algorithm/streaming_set_unique",
+    Pothos::Callable(&makeStreamingSetUnique));
+
+/*
+ * |PothosDoc Streaming Set Union (GPU)
+ *
+ * Keeps the set of distinct values seen across all inputs over the whole
+ * stream on the device and outputs only the values that aren't already in
+ * it. Unlike <b>/gpu/algorithm/set_union</b>, which only merges the
+ * buffers given to one work call, each value is output once until it
+ * leaves the set. The inputs don't need to be synchronized, and the new
+ * values from each work call are output in ascending order.
+ *
+ * The set can be capped to a maximum size, in which case the values seen
+ * least recently are evicted first, and values can be aged out once they
+ * haven't been seen in a given number of samples. An evicted value is
+ * output again the next time it's seen. Ages are tracked per work call,
+ * counting samples from all inputs.
+ *
+ * |category /GPU/Algorithm
+ * |keywords union distinct set dedup deduplicate stream lru
+ * |factory /gpu/algorithm/streaming_set_union(device,dtype,numInputs)
+ * |setter setCapacity(capacity)
+ * |setter setMaxAge(maxAge)
+ *
+ * |param device[Device] Device to use for processing.
+ * |default "Auto"
+ *
+ * |param dtype[Data Type] The input and output data type.
+ * |widget DTypeChooser(int=1,uint=1,float=1,dim=1)
+ * |default "int32"
+ * |preview disable
+ *
+ * |param numInputs[Num Inputs] The number of inputs.
+ * |widget SpinBox(minimum=2)
+ * |default 2
+ * |preview disable
+ *
+ * |param capacity[Capacity] The maximum number of values in the set, or 0 for no limit.
+ * |widget SpinBox(minimum=0)
+ * |default 0
+ * |preview enable
+ *
+ * |param maxAge[Max Age] How many samples a value can go unseen before it's
+ * removed from the set, or 0 to never remove it.
+ * |widget SpinBox(minimum=0)
+ * |default 0
+ * |preview enable
+ */
+static Pothos::BlockRegistry registerStreamingSetUnion(
+    "/gpu/algorithm/streaming_set_union",
+    Pothos::Callable(&StreamingSetBlock::make));
@@ -1,4 +1,4 @@
-// Copyright (c) 2019-2020 Nicholas Corgan
+// Copyright (c) 2019-2021 Nicholas Corgan
 // SPDX-License-Identifier: BSD-3-Clause
 
 #include "ArrayFireBlock.hpp"
@@ -13,11 +13,39 @@
 
 #include <arrayfire.h>
 
+#include <algorithm>
 #include <functional>
 #include <iostream>
+#include <string>
 #include <typeinfo>
+#include <unordered_map>
 #include <vector>
 
+enum class TopKMode
+{
+    Buffer,
+    Cumulative,
+    Window
+};
+
+static const std::unordered_map<std::string, TopKMode> TopKModeEnumMap =
+{
+    {"buffer",     TopKMode::Buffer},
+    {"cumulative", TopKMode::Cumulative},
+    {"window",     TopKMode::Window},
+};
+
+/*
+ * In the streaming modes, buffers are split wherever an emission is due,
+ * so what's emitted only depends on the samples, not on how they were
+ * buffered. Sample indices count from activation or the last reset.
+ *
+ * In the cumulative mode, the running top K values and their indices stay
+ * on the device, and each segment's own top K is merged into them with one
+ * more af::topk over at most 2K candidates. In the window mode, the last
+ * windowSize samples are kept on the device instead, and af::topk runs over
+ * them at each emission.
+ */
 class TopK: public ArrayFireBlock
 {
     public:
@@ -36,10 +64,16 @@ class TopK: public ArrayFireBlock
              const std::string& dtype)
         : ArrayFireBlock(device),
           _k(1),
-          _topKFunction(::AF_TOPK_DEFAULT)
+          _topKFunction(::AF_TOPK_DEFAULT),
+          _mode(TopKMode::Buffer),
+          _windowSize(1024),
+          _emitInterval(1024),
+          _numPending(0),
+          _numTotal(0)
         {
             this->setupInput(0, dtype, _domain);
             this->setupOutput(0, dtype, _domain);
+            this->setupOutput("topk");
 
             this->registerProbe("lastValue");
 
@@ -48,12 +82,24 @@ class TopK: public ArrayFireBlock
             this->registerCall(this, POTHOS_FCN_TUPLE(TopK, order));
             this->registerCall(this, POTHOS_FCN_TUPLE(TopK, setOrder));
             this->registerCall(this, POTHOS_FCN_TUPLE(TopK, lastValue));
+            this->registerCall(this, POTHOS_FCN_TUPLE(TopK, lastIndices));
+            this->registerCall(this, POTHOS_FCN_TUPLE(TopK, mode));
+            this->registerCall(this, POTHOS_FCN_TUPLE(TopK, setMode));
+            this->registerCall(this, POTHOS_FCN_TUPLE(TopK, windowSize));
+            this->registerCall(this, POTHOS_FCN_TUPLE(TopK, setWindowSize));
+            this->registerCall(this, POTHOS_FCN_TUPLE(TopK, emitInterval));
+            this->registerCall(this, POTHOS_FCN_TUPLE(TopK, setEmitInterval));
+            this->registerCall(this, POTHOS_FCN_TUPLE(TopK, resetState));
 
             this->registerProbe("K");
             this->registerProbe("order");
+            this->registerProbe("lastIndices");
+            this->registerProbe("mode");
 
             this->registerSignal("KChanged");
             this->registerSignal("orderChanged");
+
+            this->resetState();
         }
 
         size_t K() const
@@ -89,21 +135,105 @@ class TopK: public ArrayFireBlock
             return _lastValue;
         }
 
+        // In the streaming modes, the indices of the last emitted values
+        std::vector<unsigned long long> lastIndices() const
+        {
+            return _lastIndices;
+        }
+
+        std::string mode() const
+        {
+            return getKeyForVal(TopKModeEnumMap, _mode);
+        }
+
+        void setMode(const std::string& mode)
+        {
+            _mode = getValForKey(TopKModeEnumMap, mode);
+            this->resetState();
+        }
+
+        size_t windowSize() const
+        {
+            return _windowSize;
+        }
+
+        void setWindowSize(size_t windowSize)
+        {
+            if(0 == windowSize)
+            {
+                throw Pothos::RangeException("Window size must be non-zero.");
+            }
+
+            _windowSize = windowSize;
+            this->resetState();
+        }
+
+        size_t emitInterval() const
+        {
+            return _emitInterval;
+        }
+
+        // Takes effect with the next emission.
+        void setEmitInterval(size_t emitInterval)
+        {
+            if(0 == emitInterval)
+            {
+                throw Pothos::RangeException("Emit interval must be non-zero.");
+            }
+
+            _emitInterval = emitInterval;
+        }
+
+        void resetState() override
+        {
+            _afValues = af::array();
+            _afIndices = af::array();
+            _afHistory = af::array();
+            _numPending = 0;
+            _numTotal = 0;
+        }
+
         void work() override
         {
+            WorkTimer workTimer(this);
+
             if(0 == this->workInfo().minElements)
             {
                 return;
             }
 
+            this->configArrayFire();
+
             auto afArray = this->getInputPortAsAfArray(0);
 
-            af::array vals, _;
-            af::topk(vals, _, afArray, _k, -1, _topKFunction);
+            if(TopKMode::Buffer == _mode)
+            {
+                af::array vals, _;
+                af::topk(vals, _, afArray, _k, -1, _topKFunction);
+
+                // Store a vector of the correct type in a Pothos
+                // object. Let callers deal with the extraction.
+                _lastValue = afArrayToStdVector(vals);
+            }
+            else
+            {
+                auto afValues = af::flat(afArray);
+                const size_t numValues = static_cast<size_t>(afValues.elements());
 
-            // Store a vector of the correct type in a Pothos
-            // object. Let callers deal with the extraction.
-            _lastValue = afArrayToStdVector(vals);
+                size_t offset = 0;
+                while(offset < numValues)
+                {
+                    const size_t segmentLength = std::min(_emitInterval - _numPending, numValues - offset);
+                    _update(afValues(af::seq(
+                                static_cast<double>(offset),
+                                static_cast<double>(offset + segmentLength - 1))));
+
+                    offset += segmentLength;
+                    _numPending += segmentLength;
+
+                    if(_numPending >= _emitInterval) _emit();
+                }
+            }
 
             this->produceFromAfArray(0, afArray);
         }
@@ -112,16 +242,131 @@ class TopK: public ArrayFireBlock
         int _k;
         af::topkFunction _topKFunction;
         Pothos::Object _lastValue;
+
+        TopKMode _mode;
+        size_t _windowSize;
+        size_t _emitInterval;
+
+        // The running top K in the cumulative mode, or the last window's
+        // in the window mode
+        af::array _afValues;
+        af::array _afIndices;
+
+        // The last windowSize samples
+        af::array _afHistory;
+
+        size_t _numPending;
+        unsigned long long _numTotal;
+
+        std::vector<unsigned long long> _lastIndices;
+
+        // The top K of the given values, along with their indices
+        void _topK(
+            const af::array& afValues,
+            const af::array& afIndices,
+            af::array& rAfTopValues,
+            af::array& rAfTopIndices) const
+        {
+            const int k = std::min(_k, static_cast<int>(afValues.elements()));
+
+            af::array afTopPositions;
+            af::topk(rAfTopValues, afTopPositions, afValues, k, -1, _topKFunction);
+            rAfTopIndices = afIndices(afTopPositions);
+        }
+
+        void _update(const af::array& afSegment)
+        {
+            const dim_t segmentLength = afSegment.elements();
+
+            if(TopKMode::Cumulative == _mode)
+            {
+                auto afSegmentIndices = af::range(af::dim4(segmentLength), 0, ::u64)
+                                      + af::constant(_numTotal, segmentLength, ::u64);
+
+                af::array afTopValues, afTopIndices;
+                _topK(afSegment, afSegmentIndices, afTopValues, afTopIndices);
+
+                if(_afValues.isempty())
+                {
+                    _afValues = afTopValues;
+                    _afIndices = afTopIndices;
+                }
+                else
+                {
+                    _topK(
+                        af::join(0, _afValues, afTopValues),
+                        af::join(0, _afIndices, afTopIndices),
+                        _afValues,
+                        _afIndices);
+                }
+                _afValues.eval();
+                _afIndices.eval();
+            }
+            else
+            {
+                auto afHistory = _afHistory.isempty() ? afSegment : af::join(0, _afHistory, afSegment);
+                const dim_t historyLength = afHistory.elements();
+                const dim_t windowSize = static_cast<dim_t>(_windowSize);
+
+                _afHistory = (historyLength > windowSize) ? afHistory(af::seq(
+                                                                static_cast<double>(historyLength - windowSize),
+                                                                static_cast<double>(historyLength - 1))).copy()
+                                                          : afHistory;
+            }
+
+            _numTotal += static_cast<unsigned long long>(segmentLength);
+        }
+
+        void _emit()
+        {
+            if(TopKMode::Window == _mode)
+            {
+                const dim_t historyLength = _afHistory.elements();
+                auto afHistoryIndices = af::range(af::dim4(historyLength), 0, ::u64)
+                                      + af::constant(_numTotal - static_cast<unsigned long long>(historyLength), historyLength, ::u64);
+
+                _topK(_afHistory, afHistoryIndices, _afValues, _afIndices);
+            }
+
+            _lastValue = afArrayToStdVector(_afValues);
+            _lastIndices.resize(static_cast<size_t>(_afIndices.elements()));
+            _afIndices.as(::u64).host(_lastIndices.data());
+
+            Pothos::Packet packet;
+            packet.payload = Pothos::Object(_afValues).convert<Pothos::BufferChunk>();
+            packet.metadata["indices"] = Pothos::Object(_lastIndices);
+            packet.metadata["totalSamples"] = Pothos::Object(_numTotal);
+            this->output("topk")->postMessage(std::move(packet));
+
+            _numPending = 0;
+        }
 };
 
 /*
  * |PothosDoc Top K (GPU)
  *
+ * Finds the <b>K</b> largest or smallest values. Inputs are passed through
+ * unchanged.
+ *
+ * In the buffer mode, each input buffer is searched separately, and the
+ * result can be queried with the <b>lastValue</b> probe.
+ *
+ * In the streaming modes, the result covers more than one buffer and is
+ * posted on the <b>"topk"</b> port every <b>emitInterval</b> samples. Each
+ * packet's payload holds the values, and its metadata holds their sample
+ * indices (<b>"indices"</b>), counted from activation or
+ * <b>"resetState"</b>, and the number of samples so far
+ * (<b>"totalSamples"</b>). The last values and indices can also be queried
+ * with the <b>lastValue</b> and <b>lastIndices</b> probes.
+ *
  * |category /GPU/Statistics
- * |keywords top min max k
+ * |keywords top min max k peak
  * |factory /gpu/statistics/topk(device,dtype)
  * |setter setK(K)
  * |setter setOrder(order)
+ * |setter setMode(mode)
+ * |setter setWindowSize(windowSize)
+ * |setter setEmitInterval(emitInterval)
  *
  * |param device[Device] Device to use for processing.
  * |default "Auto"
@@ -139,6 +384,29 @@ class TopK: public ArrayFireBlock
  * |default "Default"
  * |preview enable
  *
+ * |param mode[Mode] Which samples the values are found in.
+ * <ul>
+ * <li><b>Buffer:</b> the most recent buffer</li>
+ * <li><b>Cumulative:</b> every sample since activation or <b>"resetState"</b></li>
+ * <li><b>Window:</b> the most recent <b>windowSize</b> samples</li>
+ * </ul>
+ * |widget ComboBox(editable=false)
+ * |option [Buffer] "buffer"
+ * |option [Cumulative] "cumulative"
+ * |option [Window] "window"
+ * |default "buffer"
+ * |preview enable
+ *
+ * |param windowSize[Window Size] In the window mode, the number of samples searched.
+ * |widget SpinBox(minimum=1)
+ * |default 1024
+ * |preview disable
+ *
+ * |param emitInterval[Emit Interval] In the streaming modes, the number of samples per packet.
+ * |widget SpinBox(minimum=1)
+ * |default 1024
+ * |preview disable
+ *
  * |param dtype[Data Type] The output's data type.
  * |widget DTypeChooser(int=1,uint=1,float=1,dim=1)
  * |default "float64"
@@ -0,0 +1,364 @@
+// Copyright (c) 2021 Nicholas Corgan
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "Tracing.hpp"
+
+#include <Pothos/Exception.hpp>
+
+#include <Poco/Logger.h>
+#include <Poco/Process.h>
+
+#include <json.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using json = nlohmann::json;
+
+//
+// Global state
+//
+
+static std::atomic<bool>& getTracingEnabledFlag()
+{
+    static std::atomic<bool> tracingEnabled(false);
+    return tracingEnabled;
+}
+
+// Chrome traces are relative, so keep timestamps small.
+static const LatencyClock::time_point& getTraceEpoch()
+{
+    static const LatencyClock::time_point epoch = LatencyClock::now();
+    return epoch;
+}
+
+static inline uint64_t nsSinceEpoch(const LatencyClock::time_point& timePoint)
+{
+    return static_cast<uint64_t>(
+               std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   timePoint - getTraceEpoch()).count());
+}
+
+struct TraceSource
+{
+    std::string blockName;
+    std::string device;
+    bool active;
+};
+
+static std::mutex& getTraceSourceMutex()
+{
+    static std::mutex traceSourceMutex;
+    return traceSourceMutex;
+}
+
+static std::vector<TraceSource>& getTraceSources()
+{
+    static std::vector<TraceSource> traceSources;
+    return traceSources;
+}
+
+static size_t& getNumActiveTraceSources()
+{
+    static size_t numActiveTraceSources = 0;
+    return numActiveTraceSources;
+}
+
+static std::mutex& getTraceFilepathMutex()
+{
+    static std::mutex traceFilepathMutex;
+    return traceFilepathMutex;
+}
+
+static std::string& getTraceFilepath()
+{
+    static std::string traceFilepath;
+    return traceFilepath;
+}
+
+//
+// Per-thread rings
+//
+
+struct TraceEvent
+{
+    uint32_t sourceId;
+    LatencyPhase phase;
+    uint64_t startNs;
+    uint64_t durationNs;
+    uint64_t elements;
+    uint64_t bytes;
+};
+
+class TraceRing
+{
+    public:
+        using SPtr = std::shared_ptr<TraceRing>;
+
+        static constexpr size_t Capacity = (1 << 15);
+
+        explicit TraceRing(uint32_t tid):
+            _head(0),
+            _tail(0),
+            _tid(tid)
+        {}
+
+        // Only called by the owning thread.
+        void push(const TraceEvent& event)
+        {
+            const auto head = _head.load(std::memory_order_relaxed);
+            _events[head % Capacity] = event;
+            _head.store(head+1, std::memory_order_release);
+        }
+
+        std::vector<TraceEvent> snapshot() const
+        {
+            const auto head = _head.load(std::memory_order_acquire);
+            const auto tail = std::max<uint64_t>(
+                                  _tail.load(std::memory_order_relaxed),
+                                  (head > Capacity) ? (head - Capacity) : 0);
+
+            std::vector<TraceEvent> events;
+            events.reserve(static_cast<size_t>(head - tail));
+            for(auto index = tail; index < head; ++index)
+            {
+                events.emplace_back(_events[index % Capacity]);
+            }
+
+            return events;
+        }
+
+        void clear()
+        {
+            _tail.store(_head.load(std::memory_order_acquire), std::memory_order_relaxed);
+        }
+
+        inline uint32_t tid() const
+        {
+            return _tid;
+        }
+
+    private:
+        std::array<TraceEvent, Capacity> _events;
+        std::atomic<uint64_t> _head;
+        std::atomic<uint64_t> _tail;
+        uint32_t _tid;
+};
+
+static std::mutex& getTraceRingMutex()
+{
+    static std::mutex traceRingMutex;
+    return traceRingMutex;
+}
+
+// Rings outlive their threads so their events can still be dumped.
+static std::vector<TraceRing::SPtr>& getTraceRings()
+{
+    static std::vector<TraceRing::SPtr> traceRings;
+    return traceRings;
+}
+
+static TraceRing& getThreadTraceRing()
+{
+    thread_local TraceRing* threadTraceRing = nullptr;
+    if(nullptr == threadTraceRing)
+    {
+        std::lock_guard<std::mutex> lock(getTraceRingMutex());
+        auto& traceRings = getTraceRings();
+
+        traceRings.emplace_back(std::make_shared<TraceRing>(static_cast<uint32_t>(traceRings.size())));
+        threadTraceRing = traceRings.back().get();
+    }
+
+    return *threadTraceRing;
+}
+
+//
+// Interface
+//
+
+bool isTracingEnabled()
+{
+    return getTracingEnabledFlag().load(std::memory_order_relaxed);
+}
+
+void setTracingEnabled(bool enabled)
+{
+    // Make sure the epoch predates any events.
+    (void)getTraceEpoch();
+
+    getTracingEnabledFlag().store(enabled, std::memory_order_relaxed);
+}
+
+uint32_t registerTraceSource(
+    const std::string& blockName,
+    const std::string& device)
+{
+    std::lock_guard<std::mutex> lock(getTraceSourceMutex());
+    auto& traceSources = getTraceSources();
+
+    traceSources.emplace_back(TraceSource{blockName, device, true});
+    ++getNumActiveTraceSources();
+
+    return static_cast<uint32_t>(traceSources.size() - 1);
+}
+
+void releaseTraceSource(uint32_t sourceId)
+{
+    {
+        std::lock_guard<std::mutex> lock(getTraceSourceMutex());
+        auto& traceSources = getTraceSources();
+
+        if((sourceId >= traceSources.size()) || !traceSources[sourceId].active) return;
+        traceSources[sourceId].active = false;
+
+        // The file should contain every block's events, so only write it
+        // once the whole topology has stopped.
+        if(0 != --getNumActiveTraceSources()) return;
+    }
+
+    const auto filepath = traceFilepath();
+    if(filepath.empty()) return;
+
+    try
+    {
+        writeChromeTrace(filepath);
+    }
+    catch(const std::exception& ex)
+    {
+        static auto& logger = Poco::Logger::get("PothosGPU");
+        poco_warning_f2(
+            logger,
+            "Failed to write trace to %s: %s",
+            filepath,
+            std::string(ex.what()));
+    }
+}
+
+void recordTraceSpan(
+    uint32_t sourceId,
+    LatencyPhase phase,
+    const LatencyClock::time_point& start,
+    const LatencyClock::time_point& end,
+    uint64_t elements,
+    uint64_t bytes)
+{
+    if(!isTracingEnabled()) return;
+
+    const TraceEvent event =
+    {
+        sourceId,
+        phase,
+        nsSinceEpoch(start),
+        static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count()),
+        elements,
+        bytes
+    };
+    getThreadTraceRing().push(event);
+}
+
+std::string dumpChromeTrace()
+{
+    static constexpr double nsPerUs = 1e3;
+    const auto pid = static_cast<int64_t>(Poco::Process::id());
+
+    std::vector<TraceSource> traceSources;
+    {
+        std::lock_guard<std::mutex> lock(getTraceSourceMutex());
+        traceSources = getTraceSources();
+    }
+
+    std::vector<TraceRing::SPtr> traceRings;
+    {
+        std::lock_guard<std::mutex> lock(getTraceRingMutex());
+        traceRings = getTraceRings();
+    }
+
+    json traceEvents(json::array());
+    for(const auto& traceRing: traceRings)
+    {
+        const auto events = traceRing->snapshot();
+        if(events.empty()) continue;
+
+        json threadNameEvent;
+        threadNameEvent["name"] = "thread_name";
+        threadNameEvent["ph"] = "M";
+        threadNameEvent["pid"] = pid;
+        threadNameEvent["tid"] = traceRing->tid();
+        threadNameEvent["args"]["name"] = "PothosGPU worker " + std::to_string(traceRing->tid());
+        traceEvents.push_back(threadNameEvent);
+
+        for(const auto& event: events)
+        {
+            if(event.sourceId >= traceSources.size())
+            {
+                throw Pothos::AssertionViolationException(
+                          "Invalid trace source ID",
+                          std::to_string(event.sourceId));
+            }
+            const auto& traceSource = traceSources[event.sourceId];
+
+            json traceEvent;
+            traceEvent["name"] = traceSource.blockName + ": " + latencyPhaseToString(event.phase);
+            traceEvent["cat"] = traceSource.device;
+            traceEvent["ph"] = "X";
+            traceEvent["ts"] = event.startNs / nsPerUs;
+            traceEvent["dur"] = event.durationNs / nsPerUs;
+            traceEvent["pid"] = pid;
+            traceEvent["tid"] = traceRing->tid();
+
+            auto& args = traceEvent["args"];
+            args["block"] = traceSource.blockName;
+            args["device"] = traceSource.device;
+            args["elements"] = event.elements;
+            args["bytes"] = event.bytes;
+
+            traceEvents.push_back(traceEvent);
+        }
+    }
+
+    json topObj;
+    topObj["traceEvents"] = traceEvents;
+    topObj["displayTimeUnit"] = "ns";
+
+    return topObj.dump();
+}
+
+void writeChromeTrace(const std::string& filepath)
+{
+    std::ofstream ofile(filepath, std::ios::out | std::ios::trunc);
+    if(!ofile)
+    {
+        throw Pothos::RuntimeException("Failed to open trace file", filepath);
+    }
+
+    ofile << dumpChromeTrace();
+}
+
+void clearTrace()
+{
+    std::lock_guard<std::mutex> lock(getTraceRingMutex());
+    for(const auto& traceRing: getTraceRings())
+    {
+        traceRing->clear();
+    }
+}
+
+std::string traceFilepath()
+{
+    std::lock_guard<std::mutex> lock(getTraceFilepathMutex());
+    return getTraceFilepath();
+}
+
+void setTraceFilepath(const std::string& filepath)
+{
+    std::lock_guard<std::mutex> lock(getTraceFilepathMutex());
+    getTraceFilepath() = filepath;
+}
@@ -0,0 +1,51 @@
+// Copyright (c) 2021 Nicholas Corgan
+// SPDX-License-Identifier: BSD-3-Clause
+
+#pragma once
+
+#include "LatencyHistogram.hpp"
+
+#include <cstdint>
+#include <string>
+
+//
+// Opt-in tracing of ArrayFireBlock activity, exportable in the Chrome
+// trace-event format (chrome://tracing, Perfetto). Spans are written into
+// a fixed-size ring owned by the recording thread, so recording never locks.
+// When tracing is disabled, recording costs a single relaxed atomic load.
+//
+
+bool isTracingEnabled();
+
+void setTracingEnabled(bool enabled);
+
+// Called when a block is activated. IDs are never reused.
+uint32_t registerTraceSource(
+    const std::string& blockName,
+    const std::string& device);
+
+// Called when a block is deactivated. Once no sources are active, the trace
+// is written to the trace file, if one is set.
+void releaseTraceSource(uint32_t sourceId);
+
+void recordTraceSpan(
+    uint32_t sourceId,
+    LatencyPhase phase,
+    const LatencyClock::time_point& start,
+    const LatencyClock::time_point& end,
+    uint64_t elements,
+    uint64_t bytes);
+
+// Events still being written while this is called may be torn, so this is
+// best called while the topology is idle or tracing is disabled.
+std::string dumpChromeTrace();
+
+void writeChromeTrace(const std::string& filepath);
+
+void clearTrace();
+
+// If set, the trace is written to this file whenever the last active block
+// deactivates.
+std::string traceFilepath();
+
+void setTraceFilepath(const std::string& filepath);
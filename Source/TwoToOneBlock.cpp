@@ -99,6 +99,8 @@ TwoToOneBlock::~TwoToOneBlock() {}
 
 void TwoToOneBlock::work()
 {
+    WorkTimer workTimer(this);
+
     const size_t elems = this->workInfo().minAllElements;
     if(0 == elems)
     {
@@ -116,3 +118,14 @@ void TwoToOneBlock::work()
     auto outputAfArray = _func(inputAfArray0, inputAfArray1);
     this->produceFromAfArray(0, outputAfArray);
 }
+
+void TwoToOneBlock::prewarmKernels()
+{
+    const auto& dtype = this->input(0)->dtype();
+    auto afInput = af::constant(
+                       1,
+                       this->getPrewarmElements(dtype),
+                       Pothos::Object(dtype).convert<af::dtype>());
+
+    _func(afInput, afInput).eval();
+}
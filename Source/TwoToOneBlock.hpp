@@ -54,6 +54,10 @@ class TwoToOneBlock: public ArrayFireBlock
 
         void work() override;
 
+    protected:
+
+        void prewarmKernels() override;
+
     private:
         TwoToOneFunc _func;
         bool _allowZeroInBuffer1;
@@ -0,0 +1,376 @@
+// Copyright (c) 2021 Nicholas Corgan
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "ArrayFireBlock.hpp"
+#include "FFTPlanCache.hpp"
+#include "Utility.hpp"
+
+#include <Pothos/Exception.hpp>
+#include <Pothos/Framework.hpp>
+#include <Pothos/Object.hpp>
+
+#include <arrayfire.h>
+
+#include <algorithm>
+#include <complex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//
+// Misc
+//
+
+enum class XCorrMode
+{
+    Cross,
+    Auto
+};
+
+static const std::unordered_map<std::string, XCorrMode> XCorrModeEnumMap =
+{
+    {"cross", XCorrMode::Cross},
+    {"auto",  XCorrMode::Auto},
+};
+
+static size_t nextPowerOfTwo(size_t num)
+{
+    size_t ret = 1;
+    while(ret < num) ret <<= 1;
+
+    return ret;
+}
+
+//
+// Block class
+//
+
+/*
+ * For each frame of N samples, with L samples of history for each input:
+ *
+ *   r[l]  = sum_n x[n] conj(y[n-l])      l in [0,L]
+ *   r[-l] = sum_n x[n-l] conj(y[n])      l in [1,L]
+ *
+ * where n covers the frame, so only past samples are ever needed. Each half
+ * is a linear correlation of one input's frame against the other's
+ * history-extended frame, computed as IFFT(conj(FFT(a)) * FFT(b)) with
+ * enough zero-padding that the first L+1 lags don't wrap. Every frame in a
+ * buffer is a column of the same batched FFT. For autocorrelation, r[-l] is
+ * conj(r[l]), so only one correlation is needed.
+ */
+template <typename In, typename Real>
+class XCorrBlock: public ArrayFireBlock
+{
+    public:
+        using Type = In;
+        using ComplexType = std::complex<Real>;
+        using Class = XCorrBlock<In, Real>;
+
+        XCorrBlock(
+            const std::string& device,
+            XCorrMode mode,
+            size_t frameSize,
+            size_t maxLag
+        ):
+            ArrayFireBlock(device),
+            _afDType(Pothos::Object(Pothos::DType(typeid(Type))).convert<af::dtype>()),
+            _afComplexDType(Pothos::Object(Pothos::DType(typeid(ComplexType))).convert<af::dtype>()),
+            _mode(mode),
+            _frameSize(frameSize),
+            _maxLag(maxLag),
+            _fftLength(nextPowerOfTwo(frameSize + maxLag))
+        {
+            if(0 == _frameSize)
+            {
+                throw Pothos::InvalidArgumentException("Frame size must be non-zero.");
+            }
+
+            static const Pothos::DType dtype(typeid(Type));
+
+            const size_t numInputs = (XCorrMode::Cross == _mode) ? 2 : 1;
+            for(size_t port = 0; port < numInputs; ++port)
+            {
+                this->setupInput(port, dtype, _domain);
+                this->input(port)->setReserve(_frameSize);
+            }
+            this->setupOutput(0, dtype, _domain);
+
+            _afHistories.resize(numInputs);
+
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, frameSize));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, maxLag));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, peakLag));
+            this->registerCall(this, POTHOS_FCN_TUPLE(Class, resetState));
+
+            this->registerProbe("peakLag");
+
+            this->resetState();
+        }
+
+        virtual ~XCorrBlock() = default;
+
+        size_t frameSize() const
+        {
+            return _frameSize;
+        }
+
+        size_t maxLag() const
+        {
+            return _maxLag;
+        }
+
+        long long peakLag() const
+        {
+            if(_afPeakIndex.isempty()) return 0;
+
+            this->configArrayFire();
+
+            return static_cast<long long>(_afPeakIndex.scalar<unsigned>())
+                 - static_cast<long long>(_maxLag);
+        }
+
+        void resetState() override
+        {
+            if(_maxLag > 0)
+            {
+                this->configArrayFire();
+
+                for(auto& afHistory: _afHistories)
+                {
+                    afHistory = af::constant(0, static_cast<dim_t>(_maxLag), _afDType);
+                }
+            }
+            _afPeakIndex = af::array();
+        }
+
+        void work() override
+        {
+            WorkTimer workTimer(this);
+
+            const auto& workInfo = this->workInfo();
+            const size_t numFrames = std::min(
+                                         workInfo.minInElements / _frameSize,
+                                         workInfo.minOutElements / this->_numLags());
+            if(0 == numFrames) return;
+
+            this->configArrayFire();
+
+            std::vector<af::array> afInputs;
+            for(size_t port = 0; port < _afHistories.size(); ++port)
+            {
+                afInputs.emplace_back(this->getInputElementsAsAfArray(port, numFrames * _frameSize));
+            }
+
+            auto afOutput = _correlate(afInputs);
+
+            // The lag with the largest magnitude in the last frame, which
+            // stays on the device until it's queried
+            af::array afMax;
+            af::max(
+                afMax,
+                _afPeakIndex,
+                af::abs(afOutput(af::span, static_cast<int>(numFrames - 1))));
+
+            this->produceFromAfArray(0, af::flat(afOutput));
+        }
+
+    protected:
+
+        void prewarmKernels() override
+        {
+            const auto& dtype = this->input(0)->dtype();
+            const dim_t numFrames = std::max<dim_t>(
+                                        1,
+                                        this->getPrewarmElements(dtype) / static_cast<dim_t>(_frameSize));
+
+            this->resetState();
+
+            const std::vector<af::array> afInputs(
+                _afHistories.size(),
+                af::constant(0, numFrames * static_cast<dim_t>(_frameSize), _afDType));
+            _correlate(afInputs).eval();
+        }
+
+    private:
+        af::dtype _afDType;
+        af::dtype _afComplexDType;
+
+        XCorrMode _mode;
+        size_t _frameSize;
+        size_t _maxLag;
+        size_t _fftLength;
+
+        af::array _afPeakIndex;
+
+        // The last L samples of each input, oldest first
+        std::vector<af::array> _afHistories;
+
+        inline size_t _numLags() const
+        {
+            return (2 * _maxLag) + 1;
+        }
+
+        // conj(c[k]), where c[k] = sum_n a[n] conj(b[n+k]), for k in [0,L],
+        // one column per frame
+        af::array _correlateFrames(
+            const af::array& afFrames,
+            const af::array& afExtendedFrames)
+        {
+            const dim_t fftLength = static_cast<dim_t>(_fftLength);
+            recordFFTPlanUse(_afBackend, _afDevice, _afComplexDType, _afComplexDType, fftLength, afFrames.dims(1));
+
+            auto afProducts = af::conjg(af::fft(afFrames.as(_afComplexDType), fftLength))
+                            * af::fft(afExtendedFrames.as(_afComplexDType), fftLength);
+
+            return af::ifft(afProducts)(af::seq(0.0, static_cast<double>(_maxLag)), af::span);
+        }
+
+        // Returns one column per frame, lags -L to L.
+        af::array _correlate(const std::vector<af::array>& afInputs)
+        {
+            const dim_t frameSize = static_cast<dim_t>(_frameSize);
+            const dim_t maxLag = static_cast<dim_t>(_maxLag);
+            const dim_t numFrames = afInputs[0].elements() / frameSize;
+            const dim_t windowLength = frameSize + maxLag;
+
+            // Each frame's window, including the L samples before it
+            auto afIndices = af::tile(af::range(af::dim4(windowLength), 0, ::s64), 1, static_cast<unsigned>(numFrames))
+                           + (af::tile(af::range(af::dim4(1, numFrames), 1, ::s64), static_cast<unsigned>(windowLength))
+                              * static_cast<long long>(_frameSize));
+            auto afFlatIndices = af::flat(afIndices);
+
+            std::vector<af::array> afExtendedFrames;
+            for(size_t port = 0; port < afInputs.size(); ++port)
+            {
+                auto afExtended = (maxLag > 0) ? af::join(0, _afHistories[port], afInputs[port])
+                                               : afInputs[port];
+
+                afExtendedFrames.emplace_back(af::moddims(
+                                                  afExtended(afFlatIndices),
+                                                  windowLength,
+                                                  numFrames));
+                if(maxLag > 0)
+                {
+                    const dim_t extendedLength = afExtended.elements();
+                    _afHistories[port] = afExtended(af::seq(
+                                                        static_cast<double>(extendedLength - maxLag),
+                                                        static_cast<double>(extendedLength - 1))).copy();
+                }
+            }
+
+            const auto& afExtendedX = afExtendedFrames[0];
+            const auto& afExtendedY = afExtendedFrames.back();
+            auto frameSeq = af::seq(static_cast<double>(maxLag), static_cast<double>(windowLength - 1));
+
+            // Row k is lag L-k, so flip to get lags 0 to L.
+            auto afXY = _correlateFrames(afExtendedX(frameSeq, af::span), afExtendedY);
+            auto afOutput = af::conjg(af::flip(afXY, 0));
+
+            if(maxLag > 0)
+            {
+                // Row k is lag k-L for k in [0,L).
+                auto afYX = (XCorrMode::Auto == _mode) ? afXY
+                                                       : _correlateFrames(afExtendedY(frameSeq, af::span), afExtendedX);
+                afOutput = af::join(0, afYX(af::seq(0.0, static_cast<double>(maxLag - 1)), af::span), afOutput);
+            }
+
+            return IsComplex<Type>::value ? afOutput : af::real(afOutput).as(_afDType);
+        }
+};
+
+//
+// Factory
+//
+
+static Pothos::Block* makeXCorr(
+    const std::string& device,
+    const Pothos::DType& dtype,
+    const std::string& modeName,
+    size_t frameSize,
+    size_t maxLag)
+{
+    if(1 != dtype.dimension())
+    {
+        throw Pothos::InvalidArgumentException(
+                  "This block does not support multi-dimensional types.",
+                  dtype.toString());
+    }
+
+    const auto mode = getValForKey(XCorrModeEnumMap, modeName);
+
+    #define ifTypeDeclareFactory(T, Real) \
+        if(Pothos::DType::fromDType(dtype, 1) == Pothos::DType(typeid(T))) \
+            return new XCorrBlock<T, Real>(device, mode, frameSize, maxLag);
+
+    ifTypeDeclareFactory(float, float)
+    ifTypeDeclareFactory(double, double)
+    ifTypeDeclareFactory(std::complex<float>, float)
+    ifTypeDeclareFactory(std::complex<double>, double)
+    #undef ifTypeDeclareFactory
+
+    throw Pothos::InvalidArgumentException(
+              "Unsupported type.",
+              dtype.name());
+}
+
+//
+// Block registration
+//
+
+/*
+ * |PothosDoc Correlation (GPU)
+ *
+ * Computes the cross-correlation of two input streams, or the
+ * autocorrelation of one, over lags <b>-L</b> to <b>L</b>.
+ *
+ * For each frame of <b>N</b> samples, the block outputs the <b>2L+1</b>
+ * lags, from <b>-L</b> to <b>L</b>, where lag <b>l</b> is:
+ *
+ * <ul>
+ * <li><b>l >= 0:</b> sum x[n] conj(y[n-l])</li>
+ * <li><b>l < 0:</b> sum x[n+l] conj(y[n])</li>
+ * </ul>
+ *
+ * with <b>n</b> covering the frame, <b>x</b> being input 0, and <b>y</b>
+ * being input 1 (or input 0 for autocorrelation). If input 0 is input 1
+ * delayed by <b>D</b> samples, the peak is at lag <b>D</b>. The <b>L</b>
+ * samples before each frame are carried across buffers, and
+ * <b>"resetState"</b> clears them.
+ *
+ * Each buffer's frames are correlated with a single batched FFT on the
+ * device. The lag of the largest magnitude in the most recent frame is
+ * available with <b>"peakLag"</b>. It stays on the device and is only
+ * copied back when queried, so it doesn't stall processing.
+ *
+ * |category /GPU/Signal
+ * |keywords array signal correlation xcorr autocorrelation fft delay lag
+ * |factory /gpu/signal/xcorr(device,dtype,mode,frameSize,maxLag)
+ *
+ * |param device[Device] Device to use for processing.
+ * |default "Auto"
+ *
+ * |param dtype[Data Type] The input and output data type.
+ * |widget DTypeChooser(float=1,cfloat=1)
+ * |default "complex_float32"
+ * |preview disable
+ *
+ * |param mode[Mode] Whether to cross-correlate two inputs or autocorrelate one.
+ * |widget ComboBox(editable=false)
+ * |option [Cross-Correlation] "cross"
+ * |option [Autocorrelation] "auto"
+ * |default "cross"
+ * |preview enable
+ *
+ * |param frameSize[Frame Size] The number of samples <b>N</b> per correlation.
+ * |widget SpinBox(minimum=1)
+ * |default 1024
+ * |preview enable
+ *
+ * |param maxLag[Max Lag] The maximum lag <b>L</b>, in samples.
+ * |widget SpinBox(minimum=0)
+ * |default 64
+ * |preview enable
+ */
+static Pothos::BlockRegistry registerXCorr(
+    "/gpu/signal/xcorr",
+    Pothos::Callable(&makeXCorr));
@@ -1,4 +1,4 @@
-// Copyright (c) 2020 Nicholas Corgan
+// Copyright (c) 2020-2021 Nicholas Corgan
 // SPDX-License-Identifier: BSD-3-Clause
 
 #include "PothosBlocksReplaceImpl.hpp"
@@ -208,6 +208,59 @@ POTHOS_TEST_BLOCK("/gpu/tests", test_replace_neg_infinity)
         0.0f);
 }
 
+// Infinities of opposite signs must not match each other, so only the
+// infinity being replaced changes.
+template <typename T>
+static void testReplaceOppositeInfinities(const T& findValue)
+{
+    const auto dtype = Pothos::DType(typeid(T));
+    constexpr T Infinity = std::numeric_limits<T>::infinity();
+    constexpr T ReplaceValue = T(0);
+
+    std::cout << " * Testing " << dtype.toString() << "..." << std::endl;
+    std::cout << "   * " << findValue << " -> " << ReplaceValue << std::endl;
+
+    const std::vector<T> inputs = {-Infinity, Infinity, T(1), Infinity, -Infinity};
+    std::vector<T> expectedOutputs;
+    for(const T& input: inputs)
+    {
+        expectedOutputs.emplace_back((input == findValue) ? ReplaceValue : input);
+    }
+
+    auto source = Pothos::BlockRegistry::make("/blocks/feeder_source", dtype);
+    source.call("feedBuffer", GPUTests::stdVectorToBufferChunk(inputs));
+
+    auto replace = Pothos::BlockRegistry::make(
+                       "/gpu/data/replace",
+                       "Auto",
+                       dtype,
+                       findValue,
+                       ReplaceValue);
+
+    auto sink = Pothos::BlockRegistry::make("/blocks/collector_sink", dtype);
+
+    {
+        Pothos::Topology topology;
+        topology.connect(source, 0, replace, 0);
+        topology.connect(replace, 0, sink, 0);
+
+        topology.commit();
+        POTHOS_TEST_TRUE(topology.waitInactive(0.01));
+    }
+
+    POTHOS_TEST_EQUAL(
+        expectedOutputs,
+        GPUTests::bufferChunkToStdVector<T>(sink.call<Pothos::BufferChunk>("getBuffer")));
+}
+
+POTHOS_TEST_BLOCK("/gpu/tests", test_replace_opposite_infinities)
+{
+    testReplaceOppositeInfinities<float>(std::numeric_limits<float>::infinity());
+    testReplaceOppositeInfinities<float>(-std::numeric_limits<float>::infinity());
+    testReplaceOppositeInfinities<double>(std::numeric_limits<double>::infinity());
+    testReplaceOppositeInfinities<double>(-std::numeric_limits<double>::infinity());
+}
+
 POTHOS_TEST_BLOCK("/gpu/tests", test_replace_nan)
 {
     testReplace<float>(
@@ -227,3 +280,104 @@ POTHOS_TEST_BLOCK("/gpu/tests", test_replace_neg_nan)
         -std::numeric_limits<double>::quiet_NaN(),
         0.0f);
 }
+
+template <typename T>
+static void testReplaceMultiple(
+    const std::vector<T>& findValues,
+    const std::vector<T>& replaceValues)
+{
+    const auto dtype = Pothos::DType(typeid(T));
+    constexpr double epsilon = 1e-6;
+
+    std::cout << " * Testing " << dtype.toString() << " with "
+              << findValues.size() << " pairs..." << std::endl;
+
+    // Make sure every find value shows up.
+    std::vector<T> inputs;
+    for(size_t elem = 0; elem < BufferLen; ++elem)
+    {
+        inputs.emplace_back(getRandomValue<T>(0,100));
+    }
+    for(size_t i = 0; i < findValues.size(); ++i)
+    {
+        inputs[rand() % BufferLen] = findValues[i];
+    }
+
+    // The last matching pair wins, and replacements don't chain.
+    std::vector<T> expectedOutputs;
+    for(const T& input: inputs)
+    {
+        T output = input;
+        for(size_t i = 0; i < findValues.size(); ++i)
+        {
+            if(detail::isEqual(findValues[i], input, epsilon)) output = replaceValues[i];
+        }
+        expectedOutputs.emplace_back(output);
+    }
+
+    auto source = Pothos::BlockRegistry::make("/blocks/feeder_source", dtype);
+    source.call("feedBuffer", GPUTests::stdVectorToBufferChunk(inputs));
+
+    auto replace = Pothos::BlockRegistry::make(
+                       "/gpu/data/replace_multiple",
+                       "Auto",
+                       dtype,
+                       findValues,
+                       replaceValues);
+    POTHOS_TEST_EQUAL(findValues.size(), replace.call<std::vector<T>>("findValues").size());
+    POTHOS_TEST_EQUAL(replaceValues.size(), replace.call<std::vector<T>>("replaceValues").size());
+
+    auto sink = Pothos::BlockRegistry::make("/blocks/collector_sink", dtype);
+
+    {
+        Pothos::Topology topology;
+        topology.connect(source, 0, replace, 0);
+        topology.connect(replace, 0, sink, 0);
+
+        topology.commit();
+        POTHOS_TEST_TRUE(topology.waitInactive(0.01));
+    }
+
+    testBufferChunksEqual<T>(
+        GPUTests::stdVectorToBufferChunk(expectedOutputs),
+        sink.call<Pothos::BufferChunk>("getBuffer"),
+        epsilon);
+}
+
+POTHOS_TEST_BLOCK("/gpu/tests", test_replace_multiple)
+{
+    srand(0ULL);
+
+    // Lookup table
+    testReplaceMultiple<unsigned char>({1, 2, 3, 200}, {2, 3, 4, 0});
+    testReplaceMultiple<int>({-5, 10, 50, 10, 99}, {50, 11, -5, 12, 0});
+
+    // Sorted search, since the find values span too much for a table
+    testReplaceMultiple<long long>({7, 20, 1LL << 40, -(1LL << 40)}, {20, 7, 1, 2});
+    testReplaceMultiple<unsigned>({3, 4000000000U, 60, 61, 62}, {4000000000U, 3, 61, 62, 63});
+
+    testReplaceMultiple<float>(
+        {std::numeric_limits<float>::quiet_NaN(), 5.0f, -std::numeric_limits<float>::infinity(), 42.0f},
+        {1.0f, 6.0f, 0.0f, std::numeric_limits<float>::infinity()});
+    testReplaceMultiple<double>(
+        {std::numeric_limits<double>::infinity(), 0.0, 1.0, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0},
+        {-1.0, 1.0, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0, 8.0});
+
+    testReplaceMultiple<std::complex<float>>(
+        {{1.0f, 2.0f}, {3.0f, 4.0f}},
+        {{3.0f, 4.0f}, {5.0f, 6.0f}});
+
+    // With no pairs, everything passes through.
+    testReplaceMultiple<int>({}, {});
+    testReplaceMultiple<double>({}, {});
+
+    // The find and replace values must match up.
+    POTHOS_TEST_THROWS(
+        Pothos::BlockRegistry::make(
+            "/gpu/data/replace_multiple",
+            "Auto",
+            "float64",
+            std::vector<double>{1.0, 2.0},
+            std::vector<double>{1.0}),
+        Pothos::ProxyExceptionMessage);
+}
@@ -0,0 +1,107 @@
+// Copyright (c) 2021 Nicholas Corgan
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "TestUtility.hpp"
+
+#include <Pothos/Framework.hpp>
+#include <Pothos/Proxy.hpp>
+#include <Pothos/Testing.hpp>
+
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Identify an unknown FIR system from its input and output.
+static void testSystemIdentification(const std::string& algorithm)
+{
+    std::cout << " * Testing " << algorithm << std::endl;
+
+    static constexpr size_t NumTaps = 16;
+    static constexpr size_t NumBlocks = 2000;
+
+    std::mt19937 gen(NumTaps);
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+
+    std::vector<double> systemTaps(NumTaps);
+    for(auto& tap: systemTaps) tap = 0.5 * dist(gen);
+
+    std::vector<double> reference(NumTaps * NumBlocks);
+    for(auto& sample: reference) sample = dist(gen);
+
+    std::vector<double> primary(reference.size());
+    for(size_t n = 0; n < primary.size(); ++n)
+    {
+        for(size_t k = 0; (k < NumTaps) && (k <= n); ++k)
+        {
+            primary[n] += systemTaps[k] * reference[n - k];
+        }
+    }
+
+    auto primarySource = Pothos::BlockRegistry::make(
+                             "/blocks/feeder_source",
+                             "float64");
+    primarySource.call("feedBuffer", GPUTests::stdVectorToBufferChunk(primary));
+
+    auto referenceSource = Pothos::BlockRegistry::make(
+                               "/blocks/feeder_source",
+                               "float64");
+    referenceSource.call("feedBuffer", GPUTests::stdVectorToBufferChunk(reference));
+
+    auto adaptiveFilter = Pothos::BlockRegistry::make(
+                              "/gpu/signal/adaptive_filter",
+                              "Auto",
+                              "float64",
+                              NumTaps,
+                              algorithm);
+    POTHOS_TEST_EQUAL(NumTaps, adaptiveFilter.call<size_t>("numTaps"));
+    if("NLMS" == algorithm) adaptiveFilter.call("setStepSize", 0.5);
+    else                    adaptiveFilter.call("setStepSize", 0.01);
+
+    auto collectorSink = Pothos::BlockRegistry::make(
+                             "/blocks/collector_sink",
+                             "float64");
+
+    {
+        Pothos::Topology topology;
+        topology.connect(primarySource, 0, adaptiveFilter, "primary");
+        topology.connect(referenceSource, 0, adaptiveFilter, "reference");
+        topology.connect(adaptiveFilter, 0, collectorSink, 0);
+
+        topology.commit();
+        POTHOS_TEST_TRUE(topology.waitInactive(0.05));
+    }
+
+    const auto errors = GPUTests::bufferChunkToStdVector<double>(
+                            collectorSink.call<Pothos::BufferChunk>("getBuffer"));
+    POTHOS_TEST_EQUAL(primary.size(), errors.size());
+
+    // By the end, the error should have gone away.
+    for(size_t i = (errors.size() - NumTaps); i < errors.size(); ++i)
+    {
+        POTHOS_TEST_CLOSE(0.0, errors[i], 1e-4);
+    }
+
+    const auto weights = adaptiveFilter.call<std::vector<double>>("weights");
+    POTHOS_TEST_EQUAL(NumTaps, weights.size());
+    for(size_t i = 0; i < NumTaps; ++i)
+    {
+        POTHOS_TEST_CLOSE(systemTaps[i], weights[i], 1e-4);
+    }
+
+    // After resetting, the filter should start from scratch.
+    adaptiveFilter.call("resetState");
+    for(double weight: adaptiveFilter.call<std::vector<double>>("weights"))
+    {
+        POTHOS_TEST_EQUAL(0.0, weight);
+    }
+}
+
+POTHOS_TEST_BLOCK("/gpu/tests", test_adaptive_filter)
+{
+    GPUTests::setupTestEnv();
+
+    testSystemIdentification("LMS");
+    testSystemIdentification("NLMS");
+}
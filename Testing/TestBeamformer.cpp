@@ -0,0 +1,151 @@
+// Copyright (c) 2021 Nicholas Corgan
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "TestUtility.hpp"
+
+#include <Pothos/Framework.hpp>
+#include <Pothos/Proxy.hpp>
+#include <Pothos/Testing.hpp>
+
+#include <chrono>
+#include <complex>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using ComplexType = std::complex<double>;
+using ComplexMatrix = std::vector<std::vector<ComplexType>>;
+
+static constexpr size_t NumInputs = 3;
+static constexpr size_t NumBeams = 2;
+static constexpr size_t NumSamples = 1024;
+
+static ComplexMatrix getRandomMatrix(
+    std::mt19937& gen,
+    size_t numRows,
+    size_t numCols)
+{
+    std::normal_distribution<double> dist(0.0, 1.0);
+
+    ComplexMatrix matrix(numRows, std::vector<ComplexType>(numCols));
+    for(auto& row: matrix)
+    {
+        for(auto& value: row) value = ComplexType(dist(gen), dist(gen));
+    }
+
+    return matrix;
+}
+
+static void testBeams(
+    const ComplexMatrix& weights,
+    const ComplexMatrix& inputs,
+    const ComplexMatrix& outputs,
+    size_t outputOffset)
+{
+    for(size_t beam = 0; beam < NumBeams; ++beam)
+    {
+        for(size_t i = 0; i < NumSamples; ++i)
+        {
+            ComplexType expected(0.0, 0.0);
+            for(size_t input = 0; input < NumInputs; ++input)
+            {
+                expected += weights[beam][input] * inputs[input][i];
+            }
+
+            const auto& output = outputs[beam][outputOffset + i];
+            POTHOS_TEST_CLOSE(expected.real(), output.real(), 1e-9);
+            POTHOS_TEST_CLOSE(expected.imag(), output.imag(), 1e-9);
+        }
+    }
+}
+
+POTHOS_TEST_BLOCK("/gpu/tests", test_beamformer)
+{
+    GPUTests::setupTestEnv();
+
+    std::mt19937 gen(NumInputs);
+    const auto inputs = getRandomMatrix(gen, NumInputs, NumSamples);
+    const auto oldWeights = getRandomMatrix(gen, NumBeams, NumInputs);
+    const auto newWeights = getRandomMatrix(gen, NumBeams, NumInputs);
+
+    auto beamformer = Pothos::BlockRegistry::make(
+                          "/gpu/array/beamformer",
+                          "Auto",
+                          "complex_float64",
+                          NumInputs,
+                          NumBeams);
+    POTHOS_TEST_EQUAL(NumInputs, beamformer.call<size_t>("numInputs"));
+    POTHOS_TEST_EQUAL(NumBeams, beamformer.call<size_t>("numBeams"));
+    beamformer.call("setWeights", oldWeights);
+    POTHOS_TEST_EQUAL(oldWeights, beamformer.call<ComplexMatrix>("weights"));
+
+    // The weight matrix must be numBeams x numInputs.
+    POTHOS_TEST_THROWS(
+        beamformer.call("setWeights", getRandomMatrix(gen, NumInputs, NumBeams)),
+        Pothos::ProxyExceptionMessage);
+
+    std::vector<Pothos::Proxy> feederSources;
+    for(size_t input = 0; input < NumInputs; ++input)
+    {
+        feederSources.emplace_back(Pothos::BlockRegistry::make(
+                                       "/blocks/feeder_source",
+                                       "complex_float64"));
+    }
+
+    std::vector<Pothos::Proxy> collectorSinks;
+    for(size_t beam = 0; beam < NumBeams; ++beam)
+    {
+        collectorSinks.emplace_back(Pothos::BlockRegistry::make(
+                                        "/blocks/collector_sink",
+                                        "complex_float64"));
+    }
+
+    {
+        Pothos::Topology topology;
+        for(size_t input = 0; input < NumInputs; ++input)
+        {
+            topology.connect(feederSources[input], 0, beamformer, input);
+        }
+        for(size_t beam = 0; beam < NumBeams; ++beam)
+        {
+            topology.connect(beamformer, beam, collectorSinks[beam], 0);
+        }
+        topology.commit();
+
+        for(size_t input = 0; input < NumInputs; ++input)
+        {
+            feederSources[input].call("feedBuffer", GPUTests::stdVectorToBufferChunk(inputs[input]));
+        }
+        POTHOS_TEST_TRUE(topology.waitInactive(0.05));
+
+        // The new weights are uploaded in the background and swapped in
+        // with the first buffer after the upload finishes.
+        beamformer.call("setWeights", newWeights);
+        while(beamformer.call<bool>("uploadingWeights"))
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        for(size_t input = 0; input < NumInputs; ++input)
+        {
+            feederSources[input].call("feedBuffer", GPUTests::stdVectorToBufferChunk(inputs[input]));
+        }
+        POTHOS_TEST_TRUE(topology.waitInactive(0.05));
+    }
+
+    ComplexMatrix outputs;
+    for(const auto& collectorSink: collectorSinks)
+    {
+        outputs.emplace_back(GPUTests::bufferChunkToStdVector<ComplexType>(
+                                 collectorSink.call<Pothos::BufferChunk>("getBuffer")));
+        POTHOS_TEST_EQUAL(2*NumSamples, outputs.back().size());
+    }
+
+    std::cout << " * Testing initial weights" << std::endl;
+    testBeams(oldWeights, inputs, outputs, 0);
+
+    std::cout << " * Testing new weights" << std::endl;
+    testBeams(newWeights, inputs, outputs, NumSamples);
+}
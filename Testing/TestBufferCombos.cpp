@@ -3,6 +3,7 @@
 
 #include "TestUtility.hpp"
 #include "DeviceCache.hpp"
+#include "SharedBufferAllocator.hpp"
 #include "Utility.hpp"
 
 #include <Pothos/Exception.hpp>
@@ -16,11 +17,18 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstring>
 #include <iostream>
 #include <string>
 #include <typeinfo>
 #include <vector>
 
+#ifdef __linux__
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
 using namespace GPUTests;
 
 static constexpr long SleepTimeMs = 1000;
@@ -262,3 +270,115 @@ POTHOS_TEST_BLOCK("/gpu/tests", test_chaining_multiple_backends)
         std::cout << "Skipping test. Only one ArrayFire device available." << std::endl;
     }
 }
+
+POTHOS_TEST_BLOCK("/gpu/tests", test_numa_host_memory)
+{
+    if(getAvailableBackends().end() == std::find(
+                                           getAvailableBackends().begin(),
+                                           getAvailableBackends().end(),
+                                           ::AF_BACKEND_CPU))
+    {
+        std::cout << "Skipping test. No CPU device available." << std::endl;
+        return;
+    }
+
+    const auto device = getAnyDeviceWithBackend(::AF_BACKEND_CPU);
+    constexpr double constant = 5.0;
+    constexpr double multiplier = 2.0;
+
+    auto afConstant = Pothos::BlockRegistry::make(
+                          "/gpu/data/constant",
+                          device,
+                          "float64",
+                          constant);
+    auto afMultiply = Pothos::BlockRegistry::make(
+                          "/gpu/scalar/arithmetic",
+                          device,
+                          "Multiply",
+                          "float64",
+                          multiplier);
+
+    for(const std::string& hugePageMode: {"None", "Transparent", "Explicit"})
+    {
+        std::cout << "Testing huge page mode " << hugePageMode << "..." << std::endl;
+
+        for(const auto& block: {afConstant, afMultiply})
+        {
+            block.call("setHostMemoryMode", "NUMA");
+            block.call("setHugePageMode", hugePageMode);
+            POTHOS_TEST_EQUAL("NUMA", block.call<std::string>("hostMemoryMode"));
+            POTHOS_TEST_EQUAL(hugePageMode, block.call<std::string>("hugePageMode"));
+            POTHOS_TEST_EQUAL(-1, block.call<int>("numaNode"));
+        }
+
+        auto collectorSink = Pothos::BlockRegistry::make(
+                                 "/blocks/collector_sink",
+                                 "float64");
+
+        {
+            Pothos::Topology topology;
+            topology.connect(afConstant, 0, afMultiply, 0);
+            topology.connect(afMultiply, 0, collectorSink, 0);
+
+            topology.commit();
+            Poco::Thread::sleep(SleepTimeMs);
+        }
+
+        auto buffOut = collectorSink.call<Pothos::BufferChunk>("getBuffer");
+        POTHOS_TEST_GT(buffOut.elements(), 0);
+
+        const double* begin = buffOut;
+        const double* end = begin + buffOut.elements();
+        const double expectedValue = constant * multiplier;
+
+        POTHOS_TEST_TRUE(end == std::find_if(begin, end, [&expectedValue](double val){return val != expectedValue;}));
+    }
+
+    POTHOS_TEST_THROWS(
+        afConstant.call("setHostMemoryMode", "Invalid"),
+        Pothos::ProxyExceptionMessage);
+
+    const int numNodes = getNumNUMANodes();
+    afConstant.call("setNUMANode", numNodes-1);
+    POTHOS_TEST_EQUAL(numNodes-1, afConstant.call<int>("numaNode"));
+    POTHOS_TEST_THROWS(
+        afConstant.call("setNUMANode", numNodes),
+        Pothos::ProxyExceptionMessage);
+}
+
+#ifdef __linux__
+
+POTHOS_TEST_BLOCK("/gpu/tests", test_numa_placement)
+{
+    const size_t pageSize = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    constexpr size_t numPages = 16;
+
+    for(int node = 0; node < getNumNUMANodes(); ++node)
+    {
+        std::cout << "Testing NUMA node " << node << "..." << std::endl;
+
+        const HostMemoryConfig config = {HostMemoryMode::NUMA, HugePageMode::None, node};
+        auto sharedBuffer = allocateSharedBuffer(::AF_BACKEND_CPU, numPages*pageSize, config);
+
+        // Pages are placed when they're first touched.
+        auto* mem = reinterpret_cast<char*>(sharedBuffer.getAddress());
+        std::memset(mem, 0, sharedBuffer.getLength());
+
+        for(size_t page = 0; page < numPages; ++page)
+        {
+            int pageNode = -1;
+            POTHOS_TEST_EQUAL(
+                0,
+                ::syscall(
+                    SYS_get_mempolicy,
+                    &pageNode,
+                    nullptr,
+                    0UL,
+                    mem + (page*pageSize),
+                    static_cast<unsigned long>(MPOL_F_NODE | MPOL_F_ADDR)));
+            POTHOS_TEST_EQUAL(node, pageNode);
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,130 @@
+// Copyright (c) 2021 Nicholas Corgan
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "TestUtility.hpp"
+
+#include <Pothos/Framework.hpp>
+#include <Pothos/Proxy.hpp>
+#include <Pothos/Testing.hpp>
+
+#include <cmath>
+#include <complex>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using Complex = std::complex<double>;
+
+// Each channel as an individual modulated filter, decimated
+static std::vector<Complex> referenceChannel(
+    const std::vector<double>& taps,
+    const std::vector<Complex>& inputs,
+    size_t numChannels,
+    size_t channel)
+{
+    const size_t numFrames = inputs.size() / numChannels;
+    std::vector<Complex> outputs(numFrames);
+
+    for(size_t frame = 0; frame < numFrames; ++frame)
+    {
+        const size_t index = (frame * numChannels) + numChannels - 1;
+        for(size_t n = 0; (n < taps.size()) && (n <= index); ++n)
+        {
+            const double phase = 2.0 * M_PI * double(channel * n) / double(numChannels);
+            outputs[frame] += taps[n] * inputs[index - n] * std::polar(1.0, phase);
+        }
+    }
+
+    return outputs;
+}
+
+static void testChannelizer(const std::vector<size_t>& channels)
+{
+    static constexpr size_t NumChannels = 4;
+    static constexpr size_t NumFrames = 300;
+
+    const Pothos::DType dtype("complex_float64");
+
+    const auto taps = GPUTests::linspace<double>(0.1, 1.0, 10);
+
+    const auto inputs = GPUTests::toComplexVector(
+                            GPUTests::linspace<double>(-10.0, 10.0, NumChannels * NumFrames * 2));
+
+    auto feederSource = Pothos::BlockRegistry::make(
+                            "/blocks/feeder_source",
+                            dtype);
+    feederSource.call("feedBuffer", GPUTests::stdVectorToBufferChunk(inputs));
+
+    auto channelizer = Pothos::BlockRegistry::make(
+                           "/gpu/signal/channelizer",
+                           "Auto",
+                           dtype,
+                           NumChannels,
+                           channels);
+    channelizer.call("setTaps", taps);
+
+    auto outputChannels = channelizer.call<std::vector<size_t>>("channels");
+    if(channels.empty())
+    {
+        POTHOS_TEST_EQUAL(NumChannels, outputChannels.size());
+    }
+    else
+    {
+        POTHOS_TEST_EQUAL(channels, outputChannels);
+    }
+
+    std::vector<Pothos::Proxy> collectorSinks;
+    for(size_t i = 0; i < outputChannels.size(); ++i)
+    {
+        collectorSinks.emplace_back(Pothos::BlockRegistry::make(
+                                        "/blocks/collector_sink",
+                                        "complex_float64"));
+    }
+
+    {
+        Pothos::Topology topology;
+        topology.connect(feederSource, 0, channelizer, 0);
+        for(size_t i = 0; i < outputChannels.size(); ++i)
+        {
+            topology.connect(channelizer, std::to_string(outputChannels[i]), collectorSinks[i], 0);
+        }
+
+        topology.commit();
+        POTHOS_TEST_TRUE(topology.waitInactive(0.05));
+    }
+
+    for(size_t i = 0; i < outputChannels.size(); ++i)
+    {
+        std::cout << " * Testing channel " << outputChannels[i] << std::endl;
+
+        const auto expected = referenceChannel(taps, inputs, NumChannels, outputChannels[i]);
+        const auto output = GPUTests::bufferChunkToStdVector<Complex>(
+                                collectorSinks[i].call<Pothos::BufferChunk>("getBuffer"));
+        POTHOS_TEST_EQUAL(expected.size(), output.size());
+        for(size_t frame = 0; frame < expected.size(); ++frame)
+        {
+            POTHOS_TEST_CLOSE(expected[frame].real(), output[frame].real(), 1e-6);
+            POTHOS_TEST_CLOSE(expected[frame].imag(), output[frame].imag(), 1e-6);
+        }
+    }
+}
+
+POTHOS_TEST_BLOCK("/gpu/tests", test_channelizer)
+{
+    GPUTests::setupTestEnv();
+
+    std::cout << "Testing all channels" << std::endl;
+    testChannelizer({});
+
+    std::cout << "Testing channel subset" << std::endl;
+    testChannelizer({1, 3});
+
+    POTHOS_TEST_THROWS(
+        Pothos::BlockRegistry::make(
+            "/gpu/signal/channelizer",
+            "Auto",
+            "complex_float32",
+            4,
+            std::vector<size_t>{4}),
+        Pothos::ProxyExceptionMessage);
+}
@@ -0,0 +1,185 @@
+// Copyright (c) 2021 Nicholas Corgan
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "TestUtility.hpp"
+
+#include <Pothos/Framework.hpp>
+#include <Pothos/Proxy.hpp>
+#include <Pothos/Testing.hpp>
+
+#include <arrayfire.h>
+
+#include <complex>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using ComplexType = std::complex<double>;
+
+static constexpr size_t NumChannels = 3;
+static constexpr size_t NumSnapshots = 1000;
+static constexpr size_t NumSamples = 2500;
+
+// Column-major
+static std::vector<ComplexType> getExpectedMatrix(
+    const std::vector<std::vector<ComplexType>>& channels,
+    size_t start)
+{
+    std::vector<ComplexType> matrix(NumChannels * NumChannels);
+    for(size_t col = 0; col < NumChannels; ++col)
+    {
+        for(size_t row = 0; row < NumChannels; ++row)
+        {
+            for(size_t i = start; i < (start + NumSnapshots); ++i)
+            {
+                matrix[(col * NumChannels) + row] += channels[row][i] * std::conj(channels[col][i]);
+            }
+            matrix[(col * NumChannels) + row] /= double(NumSnapshots);
+        }
+    }
+
+    return matrix;
+}
+
+static std::vector<ComplexType> bufferChunkToMatrix(const Pothos::BufferChunk& bufferChunk)
+{
+    POTHOS_TEST_EQUAL(NumChannels * NumChannels, bufferChunk.elements());
+
+    const auto* begin = bufferChunk.as<const ComplexType*>();
+    return std::vector<ComplexType>(begin, begin + (NumChannels * NumChannels));
+}
+
+static void testCovarianceMatrix(bool eigenDecomposition)
+{
+    std::cout << " * Testing with eigendecomposition "
+              << (eigenDecomposition ? "enabled" : "disabled") << std::endl;
+
+    std::mt19937 gen(NumChannels);
+    std::normal_distribution<double> dist(0.0, 1.0);
+
+    // Correlate the channels so the matrix isn't just diagonal.
+    std::vector<std::vector<ComplexType>> channels(NumChannels, std::vector<ComplexType>(NumSamples));
+    for(size_t i = 0; i < NumSamples; ++i)
+    {
+        const ComplexType common(dist(gen), dist(gen));
+        for(size_t chan = 0; chan < NumChannels; ++chan)
+        {
+            channels[chan][i] = (double(chan) * common) + ComplexType(dist(gen), dist(gen));
+        }
+    }
+
+    auto covarianceMatrix = Pothos::BlockRegistry::make(
+                                "/gpu/statistics/covariance_matrix",
+                                "Auto",
+                                "complex_float64",
+                                NumChannels,
+                                NumSnapshots);
+    covarianceMatrix.call("setEigenDecomposition", eigenDecomposition);
+    POTHOS_TEST_EQUAL(NumChannels, covarianceMatrix.call<size_t>("numChannels"));
+    POTHOS_TEST_EQUAL(NumSnapshots, covarianceMatrix.call<size_t>("numSnapshots"));
+
+    auto collectorSink = Pothos::BlockRegistry::make(
+                             "/blocks/collector_sink",
+                             "");
+
+    // Split each channel differently so the block has to line them up.
+    std::vector<Pothos::Proxy> feederSources;
+    for(size_t chan = 0; chan < NumChannels; ++chan)
+    {
+        feederSources.emplace_back(Pothos::BlockRegistry::make(
+                                       "/blocks/feeder_source",
+                                       "complex_float64"));
+
+        const size_t split = 100 + (chan * 700);
+        const auto& channel = channels[chan];
+        feederSources.back().call(
+            "feedBuffer",
+            GPUTests::stdVectorToBufferChunk(std::vector<ComplexType>(channel.begin(), channel.begin() + split)));
+        feederSources.back().call(
+            "feedBuffer",
+            GPUTests::stdVectorToBufferChunk(std::vector<ComplexType>(channel.begin() + split, channel.end())));
+    }
+
+    {
+        Pothos::Topology topology;
+        for(size_t chan = 0; chan < NumChannels; ++chan)
+        {
+            topology.connect(feederSources[chan], 0, covarianceMatrix, chan);
+        }
+        topology.connect(covarianceMatrix, 0, collectorSink, 0);
+
+        topology.commit();
+        POTHOS_TEST_TRUE(topology.waitInactive(0.05));
+    }
+
+    const auto packets = collectorSink.call<std::vector<Pothos::Packet>>("getPackets");
+    POTHOS_TEST_EQUAL(NumSamples / NumSnapshots, packets.size());
+
+    for(size_t packetIndex = 0; packetIndex < packets.size(); ++packetIndex)
+    {
+        const auto& packet = packets[packetIndex];
+        POTHOS_TEST_EQUAL(NumChannels, packet.metadata.at("numChannels").convert<size_t>());
+        POTHOS_TEST_EQUAL(NumSnapshots, packet.metadata.at("numSnapshots").convert<size_t>());
+
+        const auto expectedMatrix = getExpectedMatrix(channels, packetIndex * NumSnapshots);
+        const auto matrix = bufferChunkToMatrix(packet.payload);
+        for(size_t i = 0; i < matrix.size(); ++i)
+        {
+            POTHOS_TEST_CLOSE(expectedMatrix[i].real(), matrix[i].real(), 1e-9);
+            POTHOS_TEST_CLOSE(expectedMatrix[i].imag(), matrix[i].imag(), 1e-9);
+        }
+
+        if(!eigenDecomposition)
+        {
+            POTHOS_TEST_EQUAL(0, packet.metadata.count("eigenvalues"));
+            continue;
+        }
+
+        const auto eigenvalues = packet.metadata.at("eigenvalues").convert<std::vector<double>>();
+        const auto eigenvectors = bufferChunkToMatrix(packet.metadata.at("eigenvectors").convert<Pothos::BufferChunk>());
+        POTHOS_TEST_EQUAL(NumChannels, eigenvalues.size());
+
+        // Check R v = lambda v for each pair.
+        for(size_t col = 0; col < NumChannels; ++col)
+        {
+            if(col > 0) POTHOS_TEST_TRUE(eigenvalues[col-1] >= eigenvalues[col]);
+
+            for(size_t row = 0; row < NumChannels; ++row)
+            {
+                ComplexType product(0.0, 0.0);
+                for(size_t k = 0; k < NumChannels; ++k)
+                {
+                    product += expectedMatrix[(k * NumChannels) + row] * eigenvectors[(col * NumChannels) + k];
+                }
+
+                const ComplexType expected = eigenvalues[col] * eigenvectors[(col * NumChannels) + row];
+                POTHOS_TEST_CLOSE(expected.real(), product.real(), 1e-6);
+                POTHOS_TEST_CLOSE(expected.imag(), product.imag(), 1e-6);
+            }
+        }
+
+        POTHOS_TEST_EQUAL(eigenvalues, covarianceMatrix.call<std::vector<double>>("lastEigenvalues"));
+    }
+
+    const auto lastMatrix = covarianceMatrix.call<std::vector<ComplexType>>("lastMatrix");
+    POTHOS_TEST_EQUAL(bufferChunkToMatrix(packets.back().payload), lastMatrix);
+}
+
+POTHOS_TEST_BLOCK("/gpu/tests", test_covariance_matrix)
+{
+    GPUTests::setupTestEnv();
+
+    testCovarianceMatrix(false);
+    if(af::isLAPACKAvailable()) testCovarianceMatrix(true);
+    else std::cout << " * Skipping eigendecomposition, since LAPACK is unavailable" << std::endl;
+
+    POTHOS_TEST_THROWS(
+        Pothos::BlockRegistry::make(
+            "/gpu/statistics/covariance_matrix",
+            "Auto",
+            "complex_float64",
+            1,
+            NumSnapshots),
+        Pothos::ProxyExceptionMessage);
+}
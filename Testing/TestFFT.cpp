@@ -7,6 +7,8 @@
 #include <Pothos/Proxy.hpp>
 #include <Pothos/Testing.hpp>
 
+#include <algorithm>
+#include <cmath>
 #include <complex>
 #include <iostream>
 #include <random>
@@ -91,6 +93,8 @@ namespace
                        norm,
                        testParams.inverse);
         POTHOS_TEST_EQUAL(norm, fft.call<double>("normalizationFactor"));
+        POTHOS_TEST_EQUAL("complex", fft.call<std::string>("outputMode"));
+        POTHOS_TEST_FALSE(fft.call<bool>("fftShift"));
 
         {
             Pothos::Topology topology;
@@ -104,6 +108,13 @@ namespace
             topology.commit();
             POTHOS_TEST_TRUE(topology.waitInactive());
         }
+
+        // The forward FFT's plan is built on activation, and every
+        // buffer is the same size, so work() should never need a new plan.
+        if(!testParams.inverse)
+        {
+            POTHOS_TEST_LE(fft.call<unsigned long long>("planCacheMisses"), 1);
+        }
     }
 }
 
@@ -127,3 +138,174 @@ POTHOS_TEST_BLOCK("/gpu/tests", test_fft)
         testFFT(testParams);
     }
 }
+
+POTHOS_TEST_BLOCK("/gpu/tests", test_fft_output_modes)
+{
+    GPUTests::setupTestEnv();
+
+    static constexpr size_t modeNumBins = 1024;
+    const std::string type = "complex_float64";
+
+    auto inputs = getFFTInputs<std::complex<double>>();
+    inputs.resize(modeNumBins);
+
+    auto runFFT = [&](const std::string& outputMode, bool fftShift)
+    {
+        auto feederSource = Pothos::BlockRegistry::make(
+                                "/blocks/feeder_source",
+                                type);
+        feederSource.call("feedBuffer", GPUTests::stdVectorToBufferChunk(inputs));
+
+        auto fft = Pothos::BlockRegistry::make(
+                       "/gpu/signal/fft",
+                       "Auto",
+                       type,
+                       type,
+                       modeNumBins,
+                       1.0,
+                       false);
+        fft.call("setOutputMode", outputMode);
+        fft.call("setFFTShift", fftShift);
+        POTHOS_TEST_EQUAL(outputMode, fft.call<std::string>("outputMode"));
+        POTHOS_TEST_EQUAL(fftShift, fft.call<bool>("fftShift"));
+
+        auto collectorSink = Pothos::BlockRegistry::make(
+                                 "/blocks/collector_sink",
+                                 fft.call("output", 0).call<Pothos::DType>("dtype"));
+
+        {
+            Pothos::Topology topology;
+            topology.connect(feederSource, 0, fft, 0);
+            topology.connect(fft, 0, collectorSink, 0);
+
+            topology.commit();
+            POTHOS_TEST_TRUE(topology.waitInactive());
+        }
+
+        return collectorSink.call<Pothos::BufferChunk>("getBuffer");
+    };
+
+    const auto spectrum = GPUTests::bufferChunkToStdVector<std::complex<double>>(runFFT("complex", false));
+    POTHOS_TEST_EQUAL(modeNumBins, spectrum.size());
+
+    for(const std::string& outputMode: {"magnitude", "power", "dB"})
+    {
+        for(bool fftShift: {false, true})
+        {
+            std::cout << " * Testing " << outputMode << " (shift: " << std::boolalpha << fftShift << ")" << std::endl;
+
+            const auto output = GPUTests::bufferChunkToStdVector<float>(runFFT(outputMode, fftShift));
+            POTHOS_TEST_EQUAL(modeNumBins, output.size());
+
+            for(size_t bin = 0; bin < modeNumBins; ++bin)
+            {
+                const size_t inputBin = fftShift ? ((bin + (modeNumBins / 2)) % modeNumBins) : bin;
+                const double power = std::norm(spectrum[inputBin]);
+
+                double expected = 0.0;
+                if("magnitude" == outputMode)  expected = std::sqrt(power);
+                else if("power" == outputMode) expected = power;
+                else                           expected = 10.0 * std::log10(power);
+
+                POTHOS_TEST_CLOSE(expected, output[bin], 1e-4 * std::max(1.0, std::abs(expected)));
+            }
+        }
+    }
+
+    // Real outputs need a forward FFT with a complex output.
+    auto inverseFFT = Pothos::BlockRegistry::make(
+                          "/gpu/signal/fft",
+                          "Auto",
+                          type,
+                          type,
+                          modeNumBins,
+                          1.0,
+                          true);
+    POTHOS_TEST_THROWS(
+        inverseFFT.call("setOutputMode", "dB"),
+        Pothos::ProxyExceptionMessage);
+    POTHOS_TEST_THROWS(
+        inverseFFT.call("setFFTShift", true),
+        Pothos::ProxyExceptionMessage);
+
+    // Shifting needs a complex-to-complex FFT.
+    auto realInputFFT = Pothos::BlockRegistry::make(
+                            "/gpu/signal/fft",
+                            "Auto",
+                            "float32",
+                            "complex_float32",
+                            modeNumBins,
+                            1.0,
+                            false);
+    POTHOS_TEST_THROWS(
+        realInputFFT.call("setFFTShift", true),
+        Pothos::ProxyExceptionMessage);
+
+    // The output type follows the mode.
+    realInputFFT.call("setOutputMode", "power");
+    POTHOS_TEST_EQUAL(
+        "float32",
+        realInputFFT.call("output", 0).call<Pothos::DType>("dtype").name());
+}
+
+// Plans used by other blocks on the same device count against the same
+// cache, so a plan another block evicted should count as a miss.
+POTHOS_TEST_BLOCK("/gpu/tests", test_fft_plan_cache_eviction)
+{
+    constexpr size_t fftSize = 1024;
+    constexpr size_t psdFrameSize = 256;
+
+    const auto originalCacheSize = GPUTests::getAndCallPlugin<size_t>("/gpu/config/fft_plan_cache_size");
+    GPUTests::getAndCallPlugin<Pothos::Object>("/gpu/config/set_fft_plan_cache_size", size_t(1));
+
+    const auto inputs = GPUTests::stdVectorToBufferChunk(std::vector<std::complex<float>>(fftSize));
+
+    auto fft = Pothos::BlockRegistry::make(
+                   "/gpu/signal/fft",
+                   "Auto",
+                   "complex_float32",
+                   "complex_float32",
+                   fftSize,
+                   1.0,
+                   false);
+    auto psd = Pothos::BlockRegistry::make(
+                   "/gpu/signal/psd",
+                   "Auto",
+                   "complex_float32",
+                   psdFrameSize,
+                   psdFrameSize,
+                   "hann",
+                   1);
+
+    const auto runBlock = [&inputs](const Pothos::Proxy& block, const std::string& outputType)
+    {
+        auto feederSource = Pothos::BlockRegistry::make(
+                                "/blocks/feeder_source",
+                                "complex_float32");
+        feederSource.call("feedBuffer", inputs);
+
+        auto collectorSink = Pothos::BlockRegistry::make(
+                                 "/blocks/collector_sink",
+                                 outputType);
+
+        Pothos::Topology topology;
+        topology.connect(feederSource, 0, block, 0);
+        topology.connect(block, 0, collectorSink, 0);
+
+        topology.commit();
+        POTHOS_TEST_TRUE(topology.waitInactive());
+    };
+
+    std::cout << " * Running FFT" << std::endl;
+    runBlock(fft, "complex_float32");
+    const auto initialMisses = fft.call<unsigned long long>("planCacheMisses");
+
+    std::cout << " * Running PSD, evicting the FFT's plan" << std::endl;
+    runBlock(psd, "float32");
+
+    std::cout << " * Running FFT again" << std::endl;
+    runBlock(fft, "complex_float32");
+    POTHOS_TEST_EQUAL(initialMisses + 1, fft.call<unsigned long long>("planCacheMisses"));
+
+    GPUTests::getAndCallPlugin<Pothos::Object>("/gpu/config/set_fft_plan_cache_size", originalCacheSize);
+}
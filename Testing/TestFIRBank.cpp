@@ -0,0 +1,110 @@
+// Copyright (c) 2021 Nicholas Corgan
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "TestUtility.hpp"
+
+#include <Pothos/Framework.hpp>
+#include <Pothos/Proxy.hpp>
+#include <Pothos/Testing.hpp>
+
+#include <complex>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using Complex = std::complex<double>;
+
+// Direct convolution, truncated to the input length
+static std::vector<Complex> referenceFIR(
+    const std::vector<Complex>& taps,
+    const std::vector<Complex>& inputs)
+{
+    std::vector<Complex> outputs(inputs.size());
+    for(size_t n = 0; n < inputs.size(); ++n)
+    {
+        for(size_t k = 0; (k < taps.size()) && (k <= n); ++k)
+        {
+            outputs[n] += taps[k] * inputs[n - k];
+        }
+    }
+
+    return outputs;
+}
+
+POTHOS_TEST_BLOCK("/gpu/tests", test_fir_bank)
+{
+    GPUTests::setupTestEnv();
+
+    const Pothos::DType dtype("complex_float64");
+
+    // Different lengths make sure shorter filters are padded correctly.
+    const std::vector<std::vector<Complex>> taps =
+    {
+        GPUTests::toComplexVector(GPUTests::linspace<double>(-1.0, 1.0, 2 * 5)),
+        GPUTests::toComplexVector(GPUTests::linspace<double>(0.5, 2.0, 2 * 17)),
+        {Complex(1.0)},
+    };
+
+    const auto inputs = GPUTests::toComplexVector(GPUTests::linspace<double>(-10.0, 10.0, 2 * 1000));
+
+    auto feederSource = Pothos::BlockRegistry::make(
+                            "/blocks/feeder_source",
+                            dtype);
+
+    // Uneven buffers make sure the history is carried over.
+    const size_t splitIndex = 333;
+    feederSource.call(
+        "feedBuffer",
+        GPUTests::stdVectorToBufferChunk(std::vector<Complex>(inputs.begin(), inputs.begin() + splitIndex)));
+    feederSource.call(
+        "feedBuffer",
+        GPUTests::stdVectorToBufferChunk(std::vector<Complex>(inputs.begin() + splitIndex, inputs.end())));
+
+    auto firBank = Pothos::BlockRegistry::make(
+                       "/gpu/signal/fir_bank",
+                       "Auto",
+                       dtype,
+                       taps.size());
+    firBank.call("setTaps", taps);
+    POTHOS_TEST_EQUAL(taps.size(), firBank.call<size_t>("numFilters"));
+
+    std::vector<Pothos::Proxy> collectorSinks;
+    for(size_t filter = 0; filter < taps.size(); ++filter)
+    {
+        collectorSinks.emplace_back(Pothos::BlockRegistry::make(
+                                        "/blocks/collector_sink",
+                                        dtype));
+    }
+
+    {
+        Pothos::Topology topology;
+        topology.connect(feederSource, 0, firBank, 0);
+        for(size_t filter = 0; filter < taps.size(); ++filter)
+        {
+            topology.connect(firBank, std::to_string(filter), collectorSinks[filter], 0);
+        }
+
+        topology.commit();
+        POTHOS_TEST_TRUE(topology.waitInactive(0.05));
+    }
+
+    for(size_t filter = 0; filter < taps.size(); ++filter)
+    {
+        std::cout << " * Testing filter " << filter << std::endl;
+
+        const auto expectedOutputs = referenceFIR(taps[filter], inputs);
+        const auto outputs = GPUTests::bufferChunkToStdVector<Complex>(
+                                 collectorSinks[filter].call<Pothos::BufferChunk>("getBuffer"));
+        POTHOS_TEST_EQUAL(expectedOutputs.size(), outputs.size());
+        for(size_t i = 0; i < outputs.size(); ++i)
+        {
+            POTHOS_TEST_CLOSE(expectedOutputs[i].real(), outputs[i].real(), 1e-6);
+            POTHOS_TEST_CLOSE(expectedOutputs[i].imag(), outputs[i].imag(), 1e-6);
+        }
+    }
+
+    // The number of tap sets must match the number of filters.
+    POTHOS_TEST_THROWS(
+        firBank.call("setTaps", std::vector<std::vector<Complex>>(1, {Complex(1.0)})),
+        Pothos::ProxyExceptionMessage);
+}
@@ -0,0 +1,86 @@
+// Copyright (c) 2021 Nicholas Corgan
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "TestUtility.hpp"
+
+#include <Pothos/Framework.hpp>
+#include <Pothos/Proxy.hpp>
+#include <Pothos/Testing.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+POTHOS_TEST_BLOCK("/gpu/tests", test_fir_tap_crossfade)
+{
+    GPUTests::setupTestEnv();
+
+    static constexpr size_t NumSamples = 1024;
+    static constexpr size_t CrossfadeLength = 300;
+
+    // Single taps make each output a scaled input, so the expected
+    // output doesn't depend on where buffers are split.
+    const std::vector<double> oldTaps = {1.0};
+    const std::vector<double> newTaps = {3.0};
+
+    const auto inputs = GPUTests::linspace<double>(-10.0, 10.0, NumSamples);
+
+    auto feederSource = Pothos::BlockRegistry::make(
+                            "/blocks/feeder_source",
+                            "float64");
+
+    auto fir = Pothos::BlockRegistry::make(
+                   "/gpu/signal/fir_filter",
+                   "Auto",
+                   "float64");
+    fir.call("setTaps", oldTaps);
+    fir.call("setCrossfadeLength", CrossfadeLength);
+    POTHOS_TEST_EQUAL(CrossfadeLength, fir.call<size_t>("crossfadeLength"));
+
+    auto collectorSink = Pothos::BlockRegistry::make(
+                             "/blocks/collector_sink",
+                             "float64");
+
+    {
+        Pothos::Topology topology;
+        topology.connect(feederSource, 0, fir, 0);
+        topology.connect(fir, 0, collectorSink, 0);
+        topology.commit();
+
+        feederSource.call("feedBuffer", GPUTests::stdVectorToBufferChunk(inputs));
+        POTHOS_TEST_TRUE(topology.waitInactive(0.05));
+
+        // The new taps are uploaded in the background and swapped in with
+        // the first buffer after the upload finishes.
+        fir.call("setTaps", newTaps);
+        POTHOS_TEST_EQUAL(newTaps, fir.call<std::vector<double>>("taps"));
+        while(fir.call<bool>("uploadingTaps"))
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        feederSource.call("feedBuffer", GPUTests::stdVectorToBufferChunk(inputs));
+        POTHOS_TEST_TRUE(topology.waitInactive(0.05));
+    }
+
+    const auto outputs = GPUTests::bufferChunkToStdVector<double>(
+                             collectorSink.call<Pothos::BufferChunk>("getBuffer"));
+    POTHOS_TEST_EQUAL(2*NumSamples, outputs.size());
+
+    for(size_t i = 0; i < NumSamples; ++i)
+    {
+        POTHOS_TEST_CLOSE(oldTaps[0] * inputs[i], outputs[i], 1e-6);
+    }
+
+    for(size_t i = 0; i < NumSamples; ++i)
+    {
+        const double weight = std::min(1.0, double(i+1) / double(CrossfadeLength));
+        const double expected = ((1.0 - weight) * oldTaps[0] * inputs[i])
+                              + (weight * newTaps[0] * inputs[i]);
+
+        POTHOS_TEST_CLOSE(expected, outputs[NumSamples + i], 1e-4);
+    }
+}
@@ -1,4 +1,4 @@
-// Copyright (c) 2019-2020 Nicholas Corgan
+// Copyright (c) 2019-2021 Nicholas Corgan
 // SPDX-License-Identifier: BSD-3-Clause
 
 #include "DeviceCache.hpp"
@@ -9,8 +9,13 @@
 #include <Pothos/Object.hpp>
 #include <Pothos/Testing.hpp>
 
+#include <Poco/File.h>
+#include <Poco/Path.h>
+
 #include <arrayfire.h>
 
+#include <cmath>
+#include <string>
 #include <typeinfo>
 
 POTHOS_TEST_BLOCK("/gpu/tests", test_pothosgpu_config)
@@ -45,3 +50,89 @@ POTHOS_TEST_BLOCK("/gpu/tests", test_pothosgpu_config)
             abs.call<std::string>("device"));
     }
 }
+
+POTHOS_TEST_BLOCK("/gpu/tests", test_prewarm_kernels)
+{
+    GPUTests::setupTestEnv();
+
+    const std::string type = "float64";
+    const auto inputs = GPUTests::getTestInputs(type);
+
+    auto feederSource = Pothos::BlockRegistry::make(
+                            "/blocks/feeder_source",
+                            type);
+    feederSource.call("feedBuffer", inputs);
+
+    auto abs = Pothos::BlockRegistry::make(
+                   "/gpu/arith/abs",
+                   "Auto",
+                   type);
+    POTHOS_TEST_FALSE(abs.call<bool>("prewarm"));
+    POTHOS_TEST_EQUAL(0, abs.call<size_t>("prewarmElements"));
+
+    abs.call("setPrewarm", true);
+    abs.call("setPrewarmElements", inputs.elements());
+    POTHOS_TEST_TRUE(abs.call<bool>("prewarm"));
+    POTHOS_TEST_EQUAL(inputs.elements(), abs.call<size_t>("prewarmElements"));
+
+    auto collectorSink = Pothos::BlockRegistry::make(
+                             "/blocks/collector_sink",
+                             type);
+
+    {
+        Pothos::Topology topology;
+        topology.connect(feederSource, 0, abs, 0);
+        topology.connect(abs, 0, collectorSink, 0);
+
+        topology.commit();
+        POTHOS_TEST_TRUE(topology.waitInactive());
+    }
+
+    // Prewarming should have no effect on the output.
+    auto output = collectorSink.call<Pothos::BufferChunk>("getBuffer");
+    POTHOS_TEST_EQUAL(inputs.elements(), output.elements());
+
+    const double* inputBuf = inputs;
+    const double* outputBuf = output;
+    for(size_t elem = 0; elem < inputs.elements(); ++elem)
+    {
+        POTHOS_TEST_CLOSE(std::abs(inputBuf[elem]), outputBuf[elem], 1e-6);
+    }
+}
+
+POTHOS_TEST_BLOCK("/gpu/tests", test_fft_plan_cache_size)
+{
+    const auto originalSize = GPUTests::getAndCallPlugin<size_t>("/gpu/config/fft_plan_cache_size");
+
+    GPUTests::getAndCallPlugin<Pothos::Object>("/gpu/config/set_fft_plan_cache_size", size_t(10));
+    POTHOS_TEST_EQUAL(10, GPUTests::getAndCallPlugin<size_t>("/gpu/config/fft_plan_cache_size"));
+
+    POTHOS_TEST_THROWS(
+        GPUTests::getAndCallPlugin<Pothos::Object>("/gpu/config/set_fft_plan_cache_size", size_t(0)),
+        Pothos::InvalidArgumentException);
+
+    GPUTests::getAndCallPlugin<Pothos::Object>("/gpu/config/set_fft_plan_cache_size", originalSize);
+}
+
+#if AF_API_VERSION >= 38
+POTHOS_TEST_BLOCK("/gpu/tests", test_kernel_cache_dir)
+{
+    const auto originalDir = GPUTests::getAndCallPlugin<std::string>("/gpu/config/kernel_cache_dir");
+
+    const auto tempDir = Poco::Path::forDirectory(Poco::Path::temp())
+                             .pushDirectory("PothosGPUKernelCache")
+                             .toString();
+    GPUTests::getAndCallPlugin<Pothos::Object>("/gpu/config/set_kernel_cache_dir", tempDir);
+    POTHOS_TEST_TRUE(Poco::File(tempDir).exists());
+
+    auto cacheDir = GPUTests::getAndCallPlugin<std::string>("/gpu/config/kernel_cache_dir");
+    POTHOS_TEST_EQUAL(
+        Poco::Path::forDirectory(tempDir).toString(),
+        Poco::Path::forDirectory(cacheDir).toString());
+
+    if(!originalDir.empty())
+    {
+        GPUTests::getAndCallPlugin<Pothos::Object>("/gpu/config/set_kernel_cache_dir", originalDir);
+    }
+}
+#endif
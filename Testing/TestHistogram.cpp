@@ -0,0 +1,190 @@
+// Copyright (c) 2021 Nicholas Corgan
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "TestUtility.hpp"
+
+#include <Pothos/Framework.hpp>
+#include <Pothos/Proxy.hpp>
+#include <Pothos/Testing.hpp>
+
+#include <algorithm>
+#include <iostream>
+#include <numeric>
+#include <string>
+#include <vector>
+
+static constexpr size_t NumBins = 10;
+static constexpr size_t EmitInterval = 1000;
+
+// Buffers straddle the emission boundaries.
+static const std::vector<size_t> Splits = {37, 1200, 1};
+
+static std::vector<unsigned long long> getPacketCounts(const Pothos::Packet& packet)
+{
+    POTHOS_TEST_EQUAL(NumBins, packet.payload.elements());
+
+    const auto* begin = packet.payload.as<const unsigned long long*>();
+    return std::vector<unsigned long long>(begin, begin + NumBins);
+}
+
+static void testFixedRange(const std::string& outputMode)
+{
+    std::cout << " * Testing fixed range, " << outputMode << " output" << std::endl;
+
+    // Each input is in the middle of a bin, so every bin gets a tenth.
+    static constexpr size_t NumSamples = 2500;
+    std::vector<double> inputs;
+    for(size_t i = 0; i < NumSamples; ++i) inputs.emplace_back(double(i % NumBins) + 0.5);
+
+    auto feederSource = Pothos::BlockRegistry::make(
+                            "/blocks/feeder_source",
+                            "float64");
+    GPUTests::feedUnevenBuffers(feederSource, inputs, Splits);
+
+    auto histogram = Pothos::BlockRegistry::make(
+                         "/gpu/statistics/histogram",
+                         "Auto",
+                         "float64",
+                         NumBins,
+                         EmitInterval);
+    histogram.call("setRangeMode", "fixed");
+    histogram.call("setRange", 0.0, double(NumBins));
+    histogram.call("setOutputMode", outputMode);
+
+    auto collectorSink = Pothos::BlockRegistry::make(
+                             "/blocks/collector_sink",
+                             "");
+
+    {
+        Pothos::Topology topology;
+        topology.connect(feederSource, 0, histogram, 0);
+        topology.connect(histogram, 0, collectorSink, 0);
+
+        topology.commit();
+        POTHOS_TEST_TRUE(topology.waitInactive(0.05));
+    }
+
+    const bool isDelta = ("delta" == outputMode);
+
+    const auto packets = collectorSink.call<std::vector<Pothos::Packet>>("getPackets");
+    POTHOS_TEST_EQUAL(NumSamples / EmitInterval, packets.size());
+    for(size_t packetIndex = 0; packetIndex < packets.size(); ++packetIndex)
+    {
+        const auto& packet = packets[packetIndex];
+        POTHOS_TEST_EQUAL(0.0, packet.metadata.at("minValue").convert<double>());
+        POTHOS_TEST_EQUAL(double(NumBins), packet.metadata.at("maxValue").convert<double>());
+        POTHOS_TEST_EQUAL(EmitInterval, packet.metadata.at("numSamples").convert<size_t>());
+        POTHOS_TEST_EQUAL(
+            (packetIndex + 1) * EmitInterval,
+            packet.metadata.at("totalSamples").convert<size_t>());
+
+        const unsigned long long expectedCount = isDelta ? (EmitInterval / NumBins)
+                                                         : ((packetIndex + 1) * EmitInterval / NumBins);
+        for(auto count: getPacketCounts(packet))
+        {
+            POTHOS_TEST_EQUAL(expectedCount, count);
+        }
+    }
+
+    // The rest haven't been emitted yet.
+    const unsigned long long expectedCount = isDelta ? ((NumSamples % EmitInterval) / NumBins)
+                                                     : (NumSamples / NumBins);
+    for(auto count: histogram.call<std::vector<unsigned long long>>("counts"))
+    {
+        POTHOS_TEST_EQUAL(expectedCount, count);
+    }
+
+    histogram.call("resetState");
+    for(auto count: histogram.call<std::vector<unsigned long long>>("counts"))
+    {
+        POTHOS_TEST_EQUAL(0ULL, count);
+    }
+}
+
+static void testAutoRange()
+{
+    std::cout << " * Testing auto range" << std::endl;
+
+    // The first buffer spans a narrow range, so the bins must grow to
+    // fit the rest.
+    static constexpr size_t NumSamples = 3000;
+    auto inputs = GPUTests::linspace<double>(0.0, 1.0, 37);
+    const auto laterInputs = GPUTests::linspace<double>(-20.0, 50.0, NumSamples - inputs.size());
+    inputs.insert(inputs.end(), laterInputs.begin(), laterInputs.end());
+
+    auto feederSource = Pothos::BlockRegistry::make(
+                            "/blocks/feeder_source",
+                            "float64");
+    GPUTests::feedUnevenBuffers(feederSource, inputs, Splits);
+
+    auto histogram = Pothos::BlockRegistry::make(
+                         "/gpu/statistics/histogram",
+                         "Auto",
+                         "float64",
+                         NumBins,
+                         EmitInterval);
+    POTHOS_TEST_EQUAL("auto", histogram.call<std::string>("rangeMode"));
+    POTHOS_TEST_EQUAL("accumulated", histogram.call<std::string>("outputMode"));
+
+    auto collectorSink = Pothos::BlockRegistry::make(
+                             "/blocks/collector_sink",
+                             "");
+
+    {
+        Pothos::Topology topology;
+        topology.connect(feederSource, 0, histogram, 0);
+        topology.connect(histogram, 0, collectorSink, 0);
+
+        topology.commit();
+        POTHOS_TEST_TRUE(topology.waitInactive(0.05));
+    }
+
+    const auto packets = collectorSink.call<std::vector<Pothos::Packet>>("getPackets");
+    POTHOS_TEST_EQUAL(NumSamples / EmitInterval, packets.size());
+
+    // No counts should be lost when the range grows.
+    const auto& lastPacket = packets.back();
+    const auto counts = getPacketCounts(lastPacket);
+    POTHOS_TEST_EQUAL(
+        NumSamples,
+        size_t(std::accumulate(counts.begin(), counts.end(), 0ULL)));
+
+    const auto minMax = std::minmax_element(inputs.begin(), inputs.end());
+    POTHOS_TEST_TRUE(lastPacket.metadata.at("minValue").convert<double>() <= *minMax.first);
+    POTHOS_TEST_TRUE(lastPacket.metadata.at("maxValue").convert<double>() >= *minMax.second);
+    POTHOS_TEST_EQUAL(
+        lastPacket.metadata.at("minValue").convert<double>(),
+        histogram.call<double>("minValue"));
+}
+
+POTHOS_TEST_BLOCK("/gpu/tests", test_histogram)
+{
+    GPUTests::setupTestEnv();
+
+    testFixedRange("accumulated");
+    testFixedRange("delta");
+    testAutoRange();
+
+    // Only growing the range needs an even number of bins.
+    auto oddHistogram = Pothos::BlockRegistry::make(
+                            "/gpu/statistics/histogram",
+                            "Auto",
+                            "float64",
+                            3,
+                            EmitInterval);
+    oddHistogram.call("setRangeMode", "fixed");
+    POTHOS_TEST_EQUAL(size_t(3), oddHistogram.call<std::vector<unsigned long long>>("counts").size());
+    POTHOS_TEST_THROWS(
+        oddHistogram.call("setRangeMode", "auto"),
+        Pothos::ProxyExceptionMessage);
+    POTHOS_TEST_EQUAL("fixed", oddHistogram.call<std::string>("rangeMode"));
+
+    POTHOS_TEST_THROWS(
+        Pothos::BlockRegistry::make(
+            "/gpu/statistics/histogram",
+            "Auto",
+            "float64",
+            0,
+            EmitInterval),
+        Pothos::ProxyExceptionMessage);
+}
@@ -0,0 +1,123 @@
+// Copyright (c) 2021 Nicholas Corgan
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "TestUtility.hpp"
+
+#include <Pothos/Framework.hpp>
+#include <Pothos/Proxy.hpp>
+#include <Pothos/Testing.hpp>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Direct form, for comparing against the whole stream at once
+static std::vector<double> referenceIIR(
+    const std::vector<double>& feedForwardCoeffs,
+    const std::vector<double>& feedbackCoeffs,
+    const std::vector<double>& inputs,
+    size_t numChans,
+    size_t chan)
+{
+    const size_t numSamples = inputs.size() / numChans;
+    std::vector<double> outputs(numSamples);
+
+    for(size_t n = 0; n < numSamples; ++n)
+    {
+        double accum = 0.0;
+        for(size_t k = 0; (k < feedForwardCoeffs.size()) && (k <= n); ++k)
+        {
+            accum += feedForwardCoeffs[k] * inputs[((n-k) * numChans) + chan];
+        }
+        for(size_t k = 1; (k < feedbackCoeffs.size()) && (k <= n); ++k)
+        {
+            accum -= feedbackCoeffs[k] * outputs[n-k];
+        }
+
+        outputs[n] = accum / feedbackCoeffs[0];
+    }
+
+    return outputs;
+}
+
+static void testStatefulIIR(size_t numChans)
+{
+    std::cout << "Testing " << numChans << " channel(s)" << std::endl;
+
+    const Pothos::DType dtype("float64", numChans);
+
+    const std::vector<double> feedForwardCoeffs = {0.0676, 0.135, 0.0676};
+    const std::vector<double> feedbackCoeffs = {2.0, -2.284, 0.824};
+
+    // Feed the input in uneven buffers, some shorter than the filter state.
+    const std::vector<size_t> bufferLengths = {1, 2, 5, 256, 3, 757};
+    size_t totalLength = 0;
+    for(size_t bufferLength: bufferLengths) totalLength += bufferLength;
+
+    const auto inputs = GPUTests::linspace<double>(-10.0, 10.0, totalLength * numChans);
+
+    auto feederSource = Pothos::BlockRegistry::make(
+                            "/blocks/feeder_source",
+                            dtype);
+    size_t offset = 0;
+    for(size_t bufferLength: bufferLengths)
+    {
+        Pothos::BufferChunk bufferChunk(dtype, bufferLength);
+        std::memcpy(
+            bufferChunk.as<void*>(),
+            inputs.data() + (offset * numChans),
+            bufferChunk.length);
+        feederSource.call("feedBuffer", bufferChunk);
+
+        offset += bufferLength;
+    }
+
+    auto iir = Pothos::BlockRegistry::make(
+                   "/gpu/signal/iir_filter",
+                   "Auto",
+                   dtype);
+    iir.call("setFeedForwardCoeffs", feedForwardCoeffs);
+    iir.call("setFeedbackCoeffs", feedbackCoeffs);
+
+    auto collectorSink = Pothos::BlockRegistry::make(
+                             "/blocks/collector_sink",
+                             dtype);
+
+    {
+        Pothos::Topology topology;
+        topology.connect(feederSource, 0, iir, 0);
+        topology.connect(iir, 0, collectorSink, 0);
+
+        topology.commit();
+        POTHOS_TEST_TRUE(topology.waitInactive(0.05));
+    }
+
+    const auto output = collectorSink.call<Pothos::BufferChunk>("getBuffer");
+    POTHOS_TEST_EQUAL(totalLength, output.elements());
+
+    const auto* outputValues = output.as<const double*>();
+    for(size_t chan = 0; chan < numChans; ++chan)
+    {
+        const auto expected = referenceIIR(
+                                  feedForwardCoeffs,
+                                  feedbackCoeffs,
+                                  inputs,
+                                  numChans,
+                                  chan);
+        for(size_t n = 0; n < totalLength; ++n)
+        {
+            POTHOS_TEST_CLOSE(
+                expected[n],
+                outputValues[(n * numChans) + chan],
+                1e-6);
+        }
+    }
+}
+
+POTHOS_TEST_BLOCK("/gpu/tests", test_stateful_iir_filter)
+{
+    GPUTests::setupTestEnv();
+
+    testStatefulIIR(1);
+    testStatefulIIR(4);
+}
@@ -0,0 +1,120 @@
+// Copyright (c) 2021 Nicholas Corgan
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "LatencyHistogram.hpp"
+#include "TestUtility.hpp"
+
+#include <Pothos/Framework.hpp>
+#include <Pothos/Proxy.hpp>
+#include <Pothos/Testing.hpp>
+
+#include <json.hpp>
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+
+using json = nlohmann::json;
+
+POTHOS_TEST_BLOCK("/gpu/tests", test_latency_histogram)
+{
+    // Every value must fall within its bucket's bounds.
+    for(uint64_t value: {0ULL, 1ULL, 15ULL, 16ULL, 17ULL, 1000ULL, 123456789ULL, ~0ULL})
+    {
+        const auto index = LatencyHistogram::bucketIndex(value);
+        POTHOS_TEST_LT(index, LatencyHistogram::NumBuckets);
+        POTHOS_TEST_LE(LatencyHistogram::bucketLowerBound(index), value);
+        POTHOS_TEST_GE(LatencyHistogram::bucketUpperBound(index), value);
+    }
+
+    LatencyHistogram histogram;
+    POTHOS_TEST_EQUAL(0, histogram.count());
+    POTHOS_TEST_EQUAL(0.0, histogram.percentile(50.0));
+
+    // 1-1000us
+    for(uint64_t us = 1; us <= 1000; ++us)
+    {
+        histogram.record(us * 1000);
+    }
+    POTHOS_TEST_EQUAL(1000, histogram.count());
+    POTHOS_TEST_EQUAL(1000, histogram.minimum());
+    POTHOS_TEST_EQUAL(1000000, histogram.maximum());
+    POTHOS_TEST_CLOSE(500500.0, histogram.mean(), 1e-6);
+
+    // Buckets are accurate to 12.5%.
+    POTHOS_TEST_CLOSE(500000.0, histogram.percentile(50.0), 62500.0);
+    POTHOS_TEST_CLOSE(990000.0, histogram.percentile(99.0), 123750.0);
+    POTHOS_TEST_LE(histogram.percentile(99.9), 1000000.0);
+    POTHOS_TEST_EQUAL(1000.0, histogram.percentile(0.0));
+
+    histogram.reset();
+    POTHOS_TEST_EQUAL(0, histogram.count());
+    POTHOS_TEST_EQUAL(0, histogram.maximum());
+}
+
+POTHOS_TEST_BLOCK("/gpu/tests", test_block_latency_stats)
+{
+    GPUTests::setupTestEnv();
+
+    const std::string type = "float64";
+
+    auto feederSource = Pothos::BlockRegistry::make(
+                            "/blocks/feeder_source",
+                            type);
+    feederSource.call("feedBuffer", GPUTests::getTestInputs(type));
+
+    auto abs = Pothos::BlockRegistry::make(
+                   "/gpu/arith/abs",
+                   "Auto",
+                   type);
+
+    auto collectorSink = Pothos::BlockRegistry::make(
+                             "/blocks/collector_sink",
+                             type);
+
+    {
+        Pothos::Topology topology;
+        topology.connect(feederSource, 0, abs, 0);
+        topology.connect(abs, 0, collectorSink, 0);
+
+        topology.commit();
+        POTHOS_TEST_TRUE(topology.waitInactive());
+    }
+
+    auto stats = json::parse(abs.call<std::string>("latencyStats"));
+    for(const std::string& phase: {"work", "upload", "compute", "download"})
+    {
+        std::cout << " * Testing " << phase << std::endl;
+
+        const auto& phaseStats = stats["phases"][phase];
+        POTHOS_TEST_GT(phaseStats["count"].get<size_t>(), 0);
+        POTHOS_TEST_LE(phaseStats["minUs"].get<double>(), phaseStats["p50Us"].get<double>());
+        POTHOS_TEST_LE(phaseStats["p50Us"].get<double>(), phaseStats["p99Us"].get<double>());
+        POTHOS_TEST_LE(phaseStats["p99Us"].get<double>(), phaseStats["p999Us"].get<double>());
+        POTHOS_TEST_LE(phaseStats["p999Us"].get<double>(), phaseStats["maxUs"].get<double>());
+
+        POTHOS_TEST_CLOSE(
+            phaseStats["p99Us"].get<double>(),
+            abs.call<double>("latencyPercentile", phase, 99.0),
+            1e-6);
+    }
+
+    // Make sure the block shows up in the module-wide dump.
+    const auto blockName = stats["name"].get<std::string>();
+    auto allStats = json::parse(GPUTests::getAndCallPlugin<std::string>("/devices/gpu/latency_stats"));
+    POTHOS_TEST_TRUE(std::any_of(
+        allStats.begin(),
+        allStats.end(),
+        [&blockName](const json& entry){return (entry["name"].get<std::string>() == blockName);}));
+
+    abs.call("resetLatencyStats");
+    stats = json::parse(abs.call<std::string>("latencyStats"));
+    POTHOS_TEST_EQUAL(0, stats["phases"]["work"]["count"].get<size_t>());
+
+    POTHOS_TEST_THROWS(
+        abs.call("latencyPercentile", "invalid", 50.0),
+        Pothos::ProxyExceptionMessage);
+    POTHOS_TEST_THROWS(
+        abs.call("latencyPercentile", "work", 101.0),
+        Pothos::ProxyExceptionMessage);
+}
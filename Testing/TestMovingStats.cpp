@@ -0,0 +1,167 @@
+// Copyright (c) 2021 Nicholas Corgan
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "TestUtility.hpp"
+
+#include <Pothos/Framework.hpp>
+#include <Pothos/Proxy.hpp>
+#include <Pothos/Testing.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Until the window fills, each output is over every input so far.
+static std::vector<double> getExpectedOutputs(
+    const std::string& stat,
+    const std::vector<double>& inputs,
+    size_t windowSize)
+{
+    std::vector<double> outputs;
+    for(size_t i = 0; i < inputs.size(); ++i)
+    {
+        const size_t start = (i >= windowSize) ? (i - windowSize + 1) : 0;
+        const double count = double(i - start + 1);
+
+        double sum = 0.0;
+        double sumSquares = 0.0;
+        for(size_t j = start; j <= i; ++j)
+        {
+            sum += inputs[j];
+            sumSquares += inputs[j] * inputs[j];
+        }
+
+        const double mean = sum / count;
+        if("mean" == stat)     outputs.emplace_back(mean);
+        else if("rms" == stat) outputs.emplace_back(std::sqrt(sumSquares / count));
+        else                   outputs.emplace_back((sumSquares / count) - (mean * mean));
+    }
+
+    return outputs;
+}
+
+static void testMovingStat(const std::string& stat)
+{
+    std::cout << " * Testing moving_" << stat << std::endl;
+
+    static constexpr size_t WindowSize = 100;
+    static constexpr size_t NumSamples = 4096;
+
+    std::mt19937 gen(WindowSize);
+    std::normal_distribution<double> dist(3.0, 2.0);
+
+    std::vector<double> inputs(NumSamples);
+    for(auto& input: inputs) input = dist(gen);
+
+    auto feederSource = Pothos::BlockRegistry::make(
+                            "/blocks/feeder_source",
+                            "float64");
+
+    // Split the inputs unevenly so the window crosses buffers.
+    GPUTests::feedUnevenBuffers(feederSource, inputs, {37, 500, 1, 1500});
+
+    auto movingStat = Pothos::BlockRegistry::make(
+                          "/gpu/statistics/moving_"+stat,
+                          "Auto",
+                          "float64",
+                          WindowSize);
+    POTHOS_TEST_EQUAL(WindowSize, movingStat.call<size_t>("windowSize"));
+
+    auto collectorSink = Pothos::BlockRegistry::make(
+                             "/blocks/collector_sink",
+                             "float64");
+
+    {
+        Pothos::Topology topology;
+        topology.connect(feederSource, 0, movingStat, 0);
+        topology.connect(movingStat, 0, collectorSink, 0);
+
+        topology.commit();
+        POTHOS_TEST_TRUE(topology.waitInactive(0.05));
+    }
+
+    const auto expectedOutputs = getExpectedOutputs(stat, inputs, WindowSize);
+    const auto outputs = GPUTests::bufferChunkToStdVector<double>(
+                             collectorSink.call<Pothos::BufferChunk>("getBuffer"));
+    POTHOS_TEST_EQUAL(expectedOutputs.size(), outputs.size());
+    for(size_t i = 0; i < outputs.size(); ++i)
+    {
+        POTHOS_TEST_CLOSE(expectedOutputs[i], outputs[i], 1e-6);
+    }
+}
+
+// A large offset relative to the spread, over a long buffer, would cancel
+// away the variance if the prefix sums were in single precision.
+static void testFloat32Variance()
+{
+    std::cout << " * Testing moving_var precision with float32" << std::endl;
+
+    static constexpr size_t WindowSize = 100;
+    static constexpr size_t NumSamples = 65536;
+
+    std::mt19937 gen(WindowSize);
+    std::normal_distribution<float> dist(1000.0f, 1.0f);
+
+    std::vector<float> inputs(NumSamples);
+    for(auto& input: inputs) input = dist(gen);
+
+    auto feederSource = Pothos::BlockRegistry::make(
+                            "/blocks/feeder_source",
+                            "float32");
+    feederSource.call("feedBuffer", GPUTests::stdVectorToBufferChunk(inputs));
+
+    auto movingVar = Pothos::BlockRegistry::make(
+                         "/gpu/statistics/moving_var",
+                         "Auto",
+                         "float32",
+                         WindowSize);
+
+    auto collectorSink = Pothos::BlockRegistry::make(
+                             "/blocks/collector_sink",
+                             "float32");
+
+    {
+        Pothos::Topology topology;
+        topology.connect(feederSource, 0, movingVar, 0);
+        topology.connect(movingVar, 0, collectorSink, 0);
+
+        topology.commit();
+        POTHOS_TEST_TRUE(topology.waitInactive(0.05));
+    }
+
+    const auto expectedOutputs = getExpectedOutputs(
+                                     "var",
+                                     std::vector<double>(inputs.begin(), inputs.end()),
+                                     WindowSize);
+    const auto outputs = GPUTests::bufferChunkToStdVector<float>(
+                             collectorSink.call<Pothos::BufferChunk>("getBuffer"));
+    POTHOS_TEST_EQUAL(expectedOutputs.size(), outputs.size());
+
+    // Only check full windows, where the variance is near 1.
+    for(size_t i = WindowSize; i < outputs.size(); ++i)
+    {
+        POTHOS_TEST_CLOSE(expectedOutputs[i], double(outputs[i]), 1e-3);
+    }
+}
+
+POTHOS_TEST_BLOCK("/gpu/tests", test_moving_stats)
+{
+    GPUTests::setupTestEnv();
+
+    for(const std::string& stat: {"mean", "rms", "var"})
+    {
+        testMovingStat(stat);
+    }
+    testFloat32Variance();
+
+    POTHOS_TEST_THROWS(
+        Pothos::BlockRegistry::make(
+            "/gpu/statistics/moving_mean",
+            "Auto",
+            "float64",
+            0),
+        Pothos::ProxyExceptionMessage);
+}
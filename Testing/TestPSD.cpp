@@ -0,0 +1,125 @@
+// Copyright (c) 2021 Nicholas Corgan
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "TestUtility.hpp"
+
+#include <Pothos/Framework.hpp>
+#include <Pothos/Proxy.hpp>
+#include <Pothos/Testing.hpp>
+
+#include <cmath>
+#include <complex>
+#include <iostream>
+#include <string>
+#include <vector>
+
+static std::vector<double> referenceWelch(
+    const std::vector<double>& inputs,
+    size_t frameSize,
+    size_t hop,
+    size_t averageCount)
+{
+    // Periodic Hann
+    std::vector<double> window(frameSize);
+    double windowPower = 0.0;
+    for(size_t n = 0; n < frameSize; ++n)
+    {
+        window[n] = 0.5 - (0.5 * std::cos(2.0 * M_PI * double(n) / double(frameSize)));
+        windowPower += window[n] * window[n];
+    }
+
+    const size_t numFrames = ((inputs.size() - frameSize) / hop) + 1;
+    const size_t numSpectra = numFrames / averageCount;
+
+    std::vector<double> spectra(numSpectra * frameSize, 0.0);
+    for(size_t frame = 0; frame < (numSpectra * averageCount); ++frame)
+    {
+        const size_t spectrum = frame / averageCount;
+        for(size_t bin = 0; bin < frameSize; ++bin)
+        {
+            std::complex<double> accum;
+            for(size_t n = 0; n < frameSize; ++n)
+            {
+                accum += inputs[(frame * hop) + n] * window[n]
+                       * std::polar(1.0, -2.0 * M_PI * double(bin * n) / double(frameSize));
+            }
+
+            spectra[(spectrum * frameSize) + bin] += std::norm(accum) / (windowPower * double(averageCount));
+        }
+    }
+
+    return spectra;
+}
+
+POTHOS_TEST_BLOCK("/gpu/tests", test_psd)
+{
+    GPUTests::setupTestEnv();
+
+    constexpr size_t FrameSize = 16;
+    constexpr size_t Hop = 8;
+    constexpr size_t AverageCount = 3;
+    constexpr size_t NumSamples = 1024;
+
+    std::vector<double> inputs(NumSamples);
+    for(size_t i = 0; i < NumSamples; ++i)
+    {
+        inputs[i] = std::sin(0.3 * double(i)) + (0.1 * std::cos(1.7 * double(i)));
+    }
+
+    auto feederSource = Pothos::BlockRegistry::make(
+                            "/blocks/feeder_source",
+                            "float64");
+
+    // Feed the input in uneven buffers, some shorter than a frame.
+    GPUTests::feedUnevenBuffers(feederSource, inputs, {1, 2, 5, 256, 3});
+
+    auto psd = Pothos::BlockRegistry::make(
+                   "/gpu/signal/psd",
+                   "Auto",
+                   "float64",
+                   FrameSize,
+                   Hop,
+                   "hann",
+                   AverageCount);
+    POTHOS_TEST_EQUAL("hann", psd.call<std::string>("window"));
+    POTHOS_TEST_EQUAL(AverageCount, psd.call<size_t>("averageCount"));
+
+    auto collectorSink = Pothos::BlockRegistry::make(
+                             "/blocks/collector_sink",
+                             "float64");
+
+    {
+        Pothos::Topology topology;
+        topology.connect(feederSource, 0, psd, 0);
+        topology.connect(psd, 0, collectorSink, 0);
+
+        topology.commit();
+        POTHOS_TEST_TRUE(topology.waitInactive(0.05));
+    }
+
+    const auto expected = referenceWelch(inputs, FrameSize, Hop, AverageCount);
+    const auto output = GPUTests::bufferChunkToStdVector<double>(
+                            collectorSink.call<Pothos::BufferChunk>("getBuffer"));
+    POTHOS_TEST_EQUAL(expected.size(), output.size());
+    for(size_t i = 0; i < expected.size(); ++i)
+    {
+        POTHOS_TEST_CLOSE(expected[i], output[i], 1e-6);
+    }
+
+    POTHOS_TEST_THROWS(
+        psd.call("setWindow", "invalid"),
+        Pothos::ProxyExceptionMessage);
+    POTHOS_TEST_THROWS(
+        psd.call("setAverageCount", 0),
+        Pothos::ProxyExceptionMessage);
+    POTHOS_TEST_THROWS(
+        Pothos::BlockRegistry::make(
+            "/gpu/signal/psd",
+            "Auto",
+            "float64",
+            FrameSize,
+            FrameSize+1,
+            "hann",
+            AverageCount),
+        Pothos::ProxyExceptionMessage);
+}
@@ -0,0 +1,107 @@
+// Copyright (c) 2021 Nicholas Corgan
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "TestUtility.hpp"
+
+#include <Pothos/Framework.hpp>
+#include <Pothos/Proxy.hpp>
+#include <Pothos/Testing.hpp>
+
+#include <complex>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using Complex = std::complex<double>;
+
+// Direct convolution, truncated to the input length
+static std::vector<Complex> referenceConvolve(
+    const std::vector<Complex>& taps,
+    const std::vector<Complex>& inputs)
+{
+    std::vector<Complex> outputs(inputs.size());
+    for(size_t n = 0; n < inputs.size(); ++n)
+    {
+        for(size_t k = 0; (k < taps.size()) && (k <= n); ++k)
+        {
+            outputs[n] += taps[k] * inputs[n - k];
+        }
+    }
+
+    return outputs;
+}
+
+static void testPartitionedConvolve(size_t numTaps)
+{
+    static constexpr size_t BlockSize = 64;
+    static constexpr size_t NumBlocks = 50;
+
+    std::cout << " * Testing " << numTaps << " taps" << std::endl;
+
+    std::mt19937 gen(numTaps);
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+
+    std::vector<Complex> taps(numTaps);
+    for(auto& tap: taps) tap = Complex(dist(gen), dist(gen));
+
+    std::vector<Complex> inputs(BlockSize * NumBlocks);
+    for(auto& input: inputs) input = Complex(dist(gen), dist(gen));
+
+    auto feederSource = Pothos::BlockRegistry::make(
+                            "/blocks/feeder_source",
+                            "complex_float64");
+
+    // Uneven buffers make sure the delay line is carried over.
+    const size_t splitIndex = (BlockSize * 3) + 17;
+    feederSource.call(
+        "feedBuffer",
+        GPUTests::stdVectorToBufferChunk(std::vector<Complex>(inputs.begin(), inputs.begin() + splitIndex)));
+    feederSource.call(
+        "feedBuffer",
+        GPUTests::stdVectorToBufferChunk(std::vector<Complex>(inputs.begin() + splitIndex, inputs.end())));
+
+    auto convolve = Pothos::BlockRegistry::make(
+                        "/gpu/signal/partitioned_convolve",
+                        "Auto",
+                        "complex_float64",
+                        BlockSize);
+    convolve.call("setTaps", taps);
+    POTHOS_TEST_EQUAL(BlockSize, convolve.call<size_t>("blockSize"));
+    POTHOS_TEST_EQUAL(
+        (numTaps + BlockSize - 1) / BlockSize,
+        convolve.call<size_t>("numPartitions"));
+
+    auto collectorSink = Pothos::BlockRegistry::make(
+                             "/blocks/collector_sink",
+                             "complex_float64");
+
+    {
+        Pothos::Topology topology;
+        topology.connect(feederSource, 0, convolve, 0);
+        topology.connect(convolve, 0, collectorSink, 0);
+
+        topology.commit();
+        POTHOS_TEST_TRUE(topology.waitInactive(0.05));
+    }
+
+    const auto expectedOutputs = referenceConvolve(taps, inputs);
+    const auto outputs = GPUTests::bufferChunkToStdVector<Complex>(
+                             collectorSink.call<Pothos::BufferChunk>("getBuffer"));
+    POTHOS_TEST_EQUAL(expectedOutputs.size(), outputs.size());
+    for(size_t i = 0; i < outputs.size(); ++i)
+    {
+        POTHOS_TEST_CLOSE(expectedOutputs[i].real(), outputs[i].real(), 1e-6);
+        POTHOS_TEST_CLOSE(expectedOutputs[i].imag(), outputs[i].imag(), 1e-6);
+    }
+}
+
+POTHOS_TEST_BLOCK("/gpu/tests", test_partitioned_convolve)
+{
+    GPUTests::setupTestEnv();
+
+    // Fewer taps than a block, an exact multiple, and a partial partition
+    testPartitionedConvolve(10);
+    testPartitionedConvolve(64 * 4);
+    testPartitionedConvolve(1000);
+}
@@ -0,0 +1,186 @@
+// Copyright (c) 2021 Nicholas Corgan
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "TestUtility.hpp"
+
+#include <Pothos/Framework.hpp>
+#include <Pothos/Proxy.hpp>
+#include <Pothos/Testing.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+static double getExactQuantile(
+    std::vector<double> sortedValues,
+    double q)
+{
+    const double position = q * double(sortedValues.size() - 1);
+    const size_t index = size_t(position);
+    if((index + 1) >= sortedValues.size()) return sortedValues.back();
+
+    const double fraction = position - double(index);
+    return sortedValues[index] + fraction * (sortedValues[index+1] - sortedValues[index]);
+}
+
+static void testCumulative()
+{
+    std::cout << " * Testing cumulative mode" << std::endl;
+
+    std::mt19937 gen(1234);
+    std::uniform_real_distribution<double> uniformDist(0.0, 1.0);
+    std::normal_distribution<double> normalDist(5.0, 3.0);
+
+    // The first buffer spans a narrow range, so the bins must grow to
+    // fit the rest.
+    std::vector<double> firstInputs(37);
+    for(auto& input: firstInputs) input = uniformDist(gen);
+
+    std::vector<double> laterInputs(20000);
+    for(auto& input: laterInputs) input = normalDist(gen);
+
+    auto feederSource = Pothos::BlockRegistry::make(
+                            "/blocks/feeder_source",
+                            "float64");
+    feederSource.call("feedBuffer", GPUTests::stdVectorToBufferChunk(firstInputs));
+
+    GPUTests::feedUnevenBuffers(feederSource, laterInputs, {1, 500, 4000});
+
+    auto quantileSketch = Pothos::BlockRegistry::make(
+                              "/gpu/statistics/quantile_sketch",
+                              "Auto",
+                              "float64",
+                              1024);
+    POTHOS_TEST_EQUAL(1024, quantileSketch.call<size_t>("numBins"));
+    POTHOS_TEST_EQUAL("cumulative", quantileSketch.call<std::string>("mode"));
+
+    auto collectorSink = Pothos::BlockRegistry::make(
+                             "/blocks/collector_sink",
+                             "float64");
+
+    {
+        Pothos::Topology topology;
+        topology.connect(feederSource, 0, quantileSketch, 0);
+        topology.connect(quantileSketch, 0, collectorSink, 0);
+
+        topology.commit();
+        POTHOS_TEST_TRUE(topology.waitInactive(0.05));
+    }
+
+    auto allInputs = firstInputs;
+    allInputs.insert(allInputs.end(), laterInputs.begin(), laterInputs.end());
+
+    // The inputs should pass through unchanged.
+    GPUTests::testBufferChunk(
+        GPUTests::stdVectorToBufferChunk(allInputs),
+        collectorSink.call<Pothos::BufferChunk>("getBuffer"));
+
+    POTHOS_TEST_EQUAL(double(allInputs.size()), quantileSketch.call<double>("count"));
+
+    auto sortedInputs = allInputs;
+    std::sort(sortedInputs.begin(), sortedInputs.end());
+
+    const double tolerance = 2.0 * quantileSketch.call<double>("binWidth");
+
+    const std::vector<double> qs = {0.01, 0.1, 0.25, 0.5, 0.75, 0.9, 0.99};
+    const auto quantiles = quantileSketch.call<std::vector<double>>("quantiles", qs);
+    POTHOS_TEST_EQUAL(qs.size(), quantiles.size());
+    for(size_t i = 0; i < qs.size(); ++i)
+    {
+        POTHOS_TEST_CLOSE(getExactQuantile(sortedInputs, qs[i]), quantiles[i], tolerance);
+        POTHOS_TEST_EQUAL(quantiles[i], quantileSketch.call<double>("quantile", qs[i]));
+    }
+
+    const double median = getExactQuantile(sortedInputs, 0.5);
+    POTHOS_TEST_CLOSE(median, quantileSketch.call<double>("median"), tolerance);
+
+    std::vector<double> absDevs;
+    for(double input: allInputs) absDevs.emplace_back(std::abs(input - median));
+    std::sort(absDevs.begin(), absDevs.end());
+    POTHOS_TEST_CLOSE(
+        getExactQuantile(absDevs, 0.5),
+        quantileSketch.call<double>("medAbsDev"),
+        tolerance);
+
+    POTHOS_TEST_THROWS(
+        quantileSketch.call("quantile", 1.5),
+        Pothos::ProxyExceptionMessage);
+
+    quantileSketch.call("resetState");
+    POTHOS_TEST_EQUAL(0.0, quantileSketch.call<double>("count"));
+    POTHOS_TEST_TRUE(std::isnan(quantileSketch.call<double>("median")));
+}
+
+static void testExponential()
+{
+    std::cout << " * Testing exponential mode" << std::endl;
+
+    static constexpr size_t BufferSize = 100;
+
+    std::mt19937 gen(5678);
+    std::normal_distribution<double> oldDist(0.0, 1.0);
+    std::normal_distribution<double> newDist(10.0, 1.0);
+
+    std::vector<double> oldInputs(20000);
+    for(auto& input: oldInputs) input = oldDist(gen);
+
+    std::vector<double> newInputs(BufferSize * 20);
+    for(auto& input: newInputs) input = newDist(gen);
+
+    auto feederSource = Pothos::BlockRegistry::make(
+                            "/blocks/feeder_source",
+                            "float64");
+    feederSource.call("feedBuffer", GPUTests::stdVectorToBufferChunk(oldInputs));
+    for(size_t i = 0; i < newInputs.size(); i += BufferSize)
+    {
+        feederSource.call(
+            "feedBuffer",
+            GPUTests::stdVectorToBufferChunk(std::vector<double>(
+                newInputs.begin() + i,
+                newInputs.begin() + i + BufferSize)));
+    }
+
+    auto quantileSketch = Pothos::BlockRegistry::make(
+                              "/gpu/statistics/quantile_sketch",
+                              "Auto",
+                              "float64",
+                              1024);
+    quantileSketch.call("setMode", "exponential");
+    quantileSketch.call("setAlpha", 0.01);
+
+    auto collectorSink = Pothos::BlockRegistry::make(
+                             "/blocks/collector_sink",
+                             "float64");
+
+    {
+        Pothos::Topology topology;
+        topology.connect(feederSource, 0, quantileSketch, 0);
+        topology.connect(quantileSketch, 0, collectorSink, 0);
+
+        topology.commit();
+        POTHOS_TEST_TRUE(topology.waitInactive(0.05));
+    }
+
+    // The old inputs should have decayed away.
+    POTHOS_TEST_TRUE(quantileSketch.call<double>("count") < 200.0);
+    POTHOS_TEST_CLOSE(10.0, quantileSketch.call<double>("median"), 0.5);
+}
+
+POTHOS_TEST_BLOCK("/gpu/tests", test_quantile_sketch)
+{
+    GPUTests::setupTestEnv();
+
+    testCumulative();
+    testExponential();
+
+    POTHOS_TEST_THROWS(
+        Pothos::BlockRegistry::make(
+            "/gpu/statistics/quantile_sketch",
+            "Auto",
+            "float64",
+            3),
+        Pothos::ProxyExceptionMessage);
+}
@@ -0,0 +1,133 @@
+// Copyright (c) 2021 Nicholas Corgan
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "TestUtility.hpp"
+
+#include <Pothos/Framework.hpp>
+#include <Pothos/Proxy.hpp>
+#include <Pothos/Testing.hpp>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Zero-stuff, filter, and decimate the whole stream at once.
+static std::vector<double> referenceResample(
+    const std::vector<double>& taps,
+    size_t interpolation,
+    size_t decimation,
+    const std::vector<double>& inputs)
+{
+    std::vector<double> upsampled(inputs.size() * interpolation, 0.0);
+    for(size_t i = 0; i < inputs.size(); ++i)
+    {
+        upsampled[i * interpolation] = inputs[i];
+    }
+
+    const size_t numOutputs = (upsampled.size() + decimation - 1) / decimation;
+    std::vector<double> outputs(numOutputs, 0.0);
+    for(size_t m = 0; m < numOutputs; ++m)
+    {
+        const size_t position = m * decimation;
+        for(size_t k = 0; (k < taps.size()) && (k <= position); ++k)
+        {
+            outputs[m] += taps[k] * upsampled[position - k];
+        }
+    }
+
+    return outputs;
+}
+
+static void testResampler(
+    size_t interpolation,
+    size_t decimation)
+{
+    std::cout << "Testing " << interpolation << "/" << decimation << std::endl;
+
+    const Pothos::DType dtype("float64");
+
+    const auto taps = GPUTests::linspace<double>(0.1, 1.0, 23);
+
+    // Feed the input in uneven buffers, some shorter than each phase's taps.
+    const std::vector<size_t> bufferLengths = {1, 2, 5, 256, 3, 757};
+    size_t totalLength = 0;
+    for(size_t bufferLength: bufferLengths) totalLength += bufferLength;
+
+    const auto inputs = GPUTests::linspace<double>(-10.0, 10.0, totalLength);
+
+    auto feederSource = Pothos::BlockRegistry::make(
+                            "/blocks/feeder_source",
+                            dtype);
+    size_t offset = 0;
+    for(size_t bufferLength: bufferLengths)
+    {
+        feederSource.call(
+            "feedBuffer",
+            GPUTests::stdVectorToBufferChunk(std::vector<double>(
+                inputs.begin() + offset,
+                inputs.begin() + offset + bufferLength)));
+
+        offset += bufferLength;
+    }
+
+    auto resampler = Pothos::BlockRegistry::make(
+                         "/gpu/signal/resampler",
+                         "Auto",
+                         dtype,
+                         interpolation,
+                         decimation);
+    resampler.call("setTaps", taps);
+
+    auto collectorSink = Pothos::BlockRegistry::make(
+                             "/blocks/collector_sink",
+                             dtype);
+
+    {
+        Pothos::Topology topology;
+        topology.connect(feederSource, 0, resampler, 0);
+        topology.connect(resampler, 0, collectorSink, 0);
+
+        topology.commit();
+        POTHOS_TEST_TRUE(topology.waitInactive(0.05));
+    }
+
+    const auto expected = referenceResample(taps, interpolation, decimation, inputs);
+    const auto output = GPUTests::bufferChunkToStdVector<double>(
+                            collectorSink.call<Pothos::BufferChunk>("getBuffer"));
+    POTHOS_TEST_EQUAL(expected.size(), output.size());
+    for(size_t i = 0; i < expected.size(); ++i)
+    {
+        POTHOS_TEST_CLOSE(expected[i], output[i], 1e-6);
+    }
+}
+
+POTHOS_TEST_BLOCK("/gpu/tests", test_resampler)
+{
+    GPUTests::setupTestEnv();
+
+    testResampler(1, 1);
+    testResampler(3, 2);
+    testResampler(2, 3);
+    testResampler(1, 5);
+    testResampler(7, 1);
+    testResampler(5, 7);
+
+    // The ratio should be reduced.
+    auto resampler = Pothos::BlockRegistry::make(
+                         "/gpu/signal/resampler",
+                         "Auto",
+                         "float32",
+                         4,
+                         6);
+    POTHOS_TEST_EQUAL(2, resampler.call<size_t>("interpolation"));
+    POTHOS_TEST_EQUAL(3, resampler.call<size_t>("decimation"));
+
+    POTHOS_TEST_THROWS(
+        Pothos::BlockRegistry::make(
+            "/gpu/signal/resampler",
+            "Auto",
+            "float32",
+            0,
+            1),
+        Pothos::ProxyExceptionMessage);
+}
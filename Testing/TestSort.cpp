@@ -0,0 +1,155 @@
+// Copyright (c) 2021 Nicholas Corgan
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "TestUtility.hpp"
+
+#include <Pothos/Framework.hpp>
+#include <Pothos/Proxy.hpp>
+#include <Pothos/Testing.hpp>
+
+#include <algorithm>
+#include <complex>
+#include <functional>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <vector>
+
+static constexpr size_t WindowSize = 100;
+static constexpr size_t NumSamples = 1050;
+
+// Only complete windows are output.
+static constexpr size_t NumOutputs = (NumSamples / WindowSize) * WindowSize;
+
+static const std::vector<size_t> Splits = {37, 250, 1, 500};
+
+static std::vector<double> getShuffledInputs()
+{
+    std::vector<double> inputs(NumSamples);
+    std::iota(inputs.begin(), inputs.end(), 0.0);
+    std::shuffle(inputs.begin(), inputs.end(), std::mt19937(NumSamples));
+
+    return inputs;
+}
+
+static std::vector<double> getExpectedOutputs(
+    const std::vector<double>& inputs,
+    bool isAscending)
+{
+    auto outputs = inputs;
+    outputs.resize(NumOutputs);
+    for(size_t window = 0; window < (NumOutputs / WindowSize); ++window)
+    {
+        auto begin = outputs.begin() + (window * WindowSize);
+        if(isAscending) std::sort(begin, begin + WindowSize);
+        else            std::sort(begin, begin + WindowSize, std::greater<double>());
+    }
+
+    return outputs;
+}
+
+static void testWindowedSort(bool isAscending)
+{
+    std::cout << " * Testing windowed sort (ascending: " << isAscending << ")" << std::endl;
+
+    const auto inputs = getShuffledInputs();
+
+    auto feederSource = Pothos::BlockRegistry::make(
+                            "/blocks/feeder_source",
+                            "float64");
+    GPUTests::feedUnevenBuffers(feederSource, inputs, Splits);
+
+    auto sort = Pothos::BlockRegistry::make(
+                    "/gpu/algorithm/sort",
+                    "Auto",
+                    "float64");
+    sort.call("setIsAscending", isAscending);
+    sort.call("setWindowSize", WindowSize);
+    POTHOS_TEST_EQUAL(WindowSize, sort.call<size_t>("windowSize"));
+
+    auto collectorSink = Pothos::BlockRegistry::make(
+                             "/blocks/collector_sink",
+                             "float64");
+
+    {
+        Pothos::Topology topology;
+        topology.connect(feederSource, 0, sort, 0);
+        topology.connect(sort, 0, collectorSink, 0);
+
+        topology.commit();
+        POTHOS_TEST_TRUE(topology.waitInactive(0.05));
+    }
+
+    GPUTests::testBufferChunk(
+        GPUTests::stdVectorToBufferChunk(getExpectedOutputs(inputs, isAscending)),
+        collectorSink.call<Pothos::BufferChunk>("getBuffer"));
+}
+
+static void testWindowedSortByKey()
+{
+    std::cout << " * Testing windowed sort by key" << std::endl;
+
+    using ComplexType = std::complex<float>;
+
+    // Each value encodes its key, so it can be checked after sorting.
+    const auto keys = getShuffledInputs();
+    std::vector<ComplexType> values;
+    for(double key: keys) values.emplace_back(float(key), -float(key));
+
+    auto keySource = Pothos::BlockRegistry::make(
+                         "/blocks/feeder_source",
+                         "float64");
+    GPUTests::feedUnevenBuffers(keySource, keys, Splits);
+
+    auto valueSource = Pothos::BlockRegistry::make(
+                           "/blocks/feeder_source",
+                           "complex_float32");
+    valueSource.call("feedBuffer", GPUTests::stdVectorToBufferChunk(values));
+
+    auto sortByKey = Pothos::BlockRegistry::make(
+                         "/gpu/algorithm/sort_by_key",
+                         "Auto",
+                         "float64",
+                         "complex_float32");
+    sortByKey.call("setWindowSize", WindowSize);
+
+    auto keySink = Pothos::BlockRegistry::make(
+                       "/blocks/collector_sink",
+                       "float64");
+    auto valueSink = Pothos::BlockRegistry::make(
+                         "/blocks/collector_sink",
+                         "complex_float32");
+
+    {
+        Pothos::Topology topology;
+        topology.connect(keySource, 0, sortByKey, "key");
+        topology.connect(valueSource, 0, sortByKey, "value");
+        topology.connect(sortByKey, "key", keySink, 0);
+        topology.connect(sortByKey, "value", valueSink, 0);
+
+        topology.commit();
+        POTHOS_TEST_TRUE(topology.waitInactive(0.05));
+    }
+
+    const auto expectedKeys = getExpectedOutputs(keys, true);
+    GPUTests::testBufferChunk(
+        GPUTests::stdVectorToBufferChunk(expectedKeys),
+        keySink.call<Pothos::BufferChunk>("getBuffer"));
+
+    const auto sortedValues = GPUTests::bufferChunkToStdVector<ComplexType>(
+                                  valueSink.call<Pothos::BufferChunk>("getBuffer"));
+    POTHOS_TEST_EQUAL(NumOutputs, sortedValues.size());
+    for(size_t i = 0; i < NumOutputs; ++i)
+    {
+        POTHOS_TEST_EQUAL(ComplexType(float(expectedKeys[i]), -float(expectedKeys[i])), sortedValues[i]);
+    }
+}
+
+POTHOS_TEST_BLOCK("/gpu/tests", test_sort)
+{
+    GPUTests::setupTestEnv();
+
+    testWindowedSort(true);
+    testWindowedSort(false);
+    testWindowedSortByKey();
+}
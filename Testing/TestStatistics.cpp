@@ -15,6 +15,8 @@
 #include <iostream>
 #include <numeric>
 #include <random>
+#include <string>
+#include <utility>
 #include <vector>
 
 //
@@ -271,3 +273,148 @@ POTHOS_TEST_BLOCK("/gpu/tests", test_statistics)
             isStdOrVar ? 1.0 : 1e-6);
     }
 }
+
+//
+// Streaming modes
+//
+
+// Weighted mean and M2/weight, where the newest input has a weight of 1
+static std::pair<double, double> exponentialMoments(
+    const std::vector<double>& inputs,
+    double alpha)
+{
+    double weight = 0.0;
+    double weightedSum = 0.0;
+    for(size_t i = 0; i < inputs.size(); ++i)
+    {
+        const double inputWeight = std::pow(1.0 - alpha, double(inputs.size() - 1 - i));
+        weight += inputWeight;
+        weightedSum += inputWeight * inputs[i];
+    }
+
+    const double weightedMean = weightedSum / weight;
+    double weightedM2 = 0.0;
+    for(size_t i = 0; i < inputs.size(); ++i)
+    {
+        const double inputWeight = std::pow(1.0 - alpha, double(inputs.size() - 1 - i));
+        weightedM2 += inputWeight * std::pow(inputs[i] - weightedMean, 2.0);
+    }
+
+    return std::make_pair(weightedMean, weightedM2 / weight);
+}
+
+static double streamingValue(
+    const std::string& blockName,
+    const std::string& mode,
+    const std::vector<double>& inputs)
+{
+    static constexpr double Alpha = 0.05;
+    static constexpr size_t WindowSize = 100;
+
+    auto block = ("/gpu/statistics/var" == blockName)
+               ? Pothos::BlockRegistry::make(blockName, "Auto", "float64", false)
+               : Pothos::BlockRegistry::make(blockName, "Auto", "float64");
+    block.call("setMode", mode);
+    block.call("setAlpha", Alpha);
+    block.call("setWindowSize", WindowSize);
+    POTHOS_TEST_EQUAL(mode, block.call<std::string>("mode"));
+
+    auto feederSource = Pothos::BlockRegistry::make(
+                            "/blocks/feeder_source",
+                            "float64");
+
+    // Uneven buffers make sure the result doesn't depend on them.
+    const std::vector<size_t> bufferLengths = {1, 37, 250, 3, 512, 247};
+    size_t offset = 0;
+    for(size_t bufferLength: bufferLengths)
+    {
+        feederSource.call(
+            "feedBuffer",
+            GPUTests::stdVectorToBufferChunk(std::vector<double>(
+                inputs.begin() + offset,
+                inputs.begin() + offset + bufferLength)));
+        offset += bufferLength;
+    }
+    POTHOS_TEST_EQUAL(inputs.size(), offset);
+
+    auto collectorSink = Pothos::BlockRegistry::make(
+                             "/blocks/collector_sink",
+                             "float64");
+
+    {
+        Pothos::Topology topology;
+        topology.connect(feederSource, 0, block, 0);
+        topology.connect(block, 0, collectorSink, 0);
+
+        topology.commit();
+        POTHOS_TEST_TRUE(topology.waitInactive(0.05));
+    }
+
+    // The input should still be forwarded.
+    GPUTests::testBufferChunk(
+        collectorSink.call<Pothos::BufferChunk>("getBuffer"),
+        GPUTests::stdVectorToBufferChunk(inputs));
+
+    if("fixed" == mode)
+    {
+        POTHOS_TEST_EQUAL(double(WindowSize), block.call<double>("count"));
+    }
+    else if("cumulative" == mode)
+    {
+        POTHOS_TEST_EQUAL(double(inputs.size()), block.call<double>("count"));
+    }
+
+    return block.call<double>("lastValue");
+}
+
+POTHOS_TEST_BLOCK("/gpu/tests", test_streaming_statistics)
+{
+    GPUTests::setupTestEnv();
+
+    std::random_device rd;
+    std::mt19937 g(rd());
+
+    std::vector<double> inputs = GPUTests::linspace<double>(-10, 10, 1050);
+    std::shuffle(inputs.begin(), inputs.end(), g);
+
+    // The last complete window of 100 samples
+    const std::vector<double> lastWindow(inputs.begin() + 900, inputs.begin() + 1000);
+    const auto exponential = exponentialMoments(inputs, 0.05);
+
+    const std::vector<std::string> blockNames =
+    {
+        "/gpu/statistics/mean",
+        "/gpu/statistics/var",
+        "/gpu/statistics/stdev"
+    };
+    for(const auto& blockName: blockNames)
+    {
+        std::cout << "Testing " << blockName << "..." << std::endl;
+
+        double cumulativeValue = 0.0;
+        double exponentialValue = 0.0;
+        double fixedValue = 0.0;
+        if("/gpu/statistics/mean" == blockName)
+        {
+            cumulativeValue = mean(inputs);
+            exponentialValue = exponential.first;
+            fixedValue = mean(lastWindow);
+        }
+        else if("/gpu/statistics/var" == blockName)
+        {
+            cumulativeValue = variance(inputs);
+            exponentialValue = exponential.second;
+            fixedValue = variance(lastWindow);
+        }
+        else
+        {
+            cumulativeValue = stddev(inputs);
+            exponentialValue = std::sqrt(exponential.second);
+            fixedValue = stddev(lastWindow);
+        }
+
+        POTHOS_TEST_CLOSE(cumulativeValue, streamingValue(blockName, "cumulative", inputs), 1e-6);
+        POTHOS_TEST_CLOSE(exponentialValue, streamingValue(blockName, "exponential", inputs), 1e-6);
+        POTHOS_TEST_CLOSE(fixedValue, streamingValue(blockName, "fixed", inputs), 1e-6);
+    }
+}
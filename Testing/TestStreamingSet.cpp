@@ -0,0 +1,256 @@
+// Copyright (c) 2021 Nicholas Corgan
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "TestUtility.hpp"
+
+#include <Pothos/Framework.hpp>
+#include <Pothos/Proxy.hpp>
+#include <Pothos/Testing.hpp>
+
+#include <algorithm>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <set>
+#include <vector>
+
+static constexpr size_t NumSamples = 4096;
+static constexpr int MaxValue = 500;
+
+static std::vector<int> getRandomInputs(unsigned seed)
+{
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<int> dist(-MaxValue, MaxValue);
+
+    std::vector<int> inputs(NumSamples);
+    for(auto& input: inputs) input = dist(gen);
+
+    return inputs;
+}
+
+// How the buffers are grouped into work calls varies, so check that every
+// distinct value was output exactly once.
+static void testOutputs(
+    const std::set<int>& expectedValues,
+    const Pothos::Proxy& streamingSet,
+    const Pothos::Proxy& collectorSink)
+{
+    const std::vector<int> expected(expectedValues.begin(), expectedValues.end());
+
+    auto outputs = GPUTests::bufferChunkToStdVector<int>(
+                       collectorSink.call<Pothos::BufferChunk>("getBuffer"));
+    std::sort(outputs.begin(), outputs.end());
+    POTHOS_TEST_EQUAL(expected, outputs);
+
+    POTHOS_TEST_EQUAL(expected.size(), streamingSet.call<size_t>("size"));
+    POTHOS_TEST_EQUAL(expected, streamingSet.call<std::vector<int>>("values"));
+}
+
+static void testStreamingSetUnique()
+{
+    std::cout << " * Testing /gpu/algorithm/streaming_set_unique" << std::endl;
+
+    const auto inputs = getRandomInputs(NumSamples);
+
+    auto feederSource = Pothos::BlockRegistry::make(
+                            "/blocks/feeder_source",
+                            "int32");
+    GPUTests::feedUnevenBuffers(feederSource, inputs);
+
+    auto streamingSet = Pothos::BlockRegistry::make(
+                            "/gpu/algorithm/streaming_set_unique",
+                            "Auto",
+                            "int32");
+
+    auto collectorSink = Pothos::BlockRegistry::make(
+                             "/blocks/collector_sink",
+                             "int32");
+
+    {
+        Pothos::Topology topology;
+        topology.connect(feederSource, 0, streamingSet, 0);
+        topology.connect(streamingSet, 0, collectorSink, 0);
+
+        topology.commit();
+        POTHOS_TEST_TRUE(topology.waitInactive(0.05));
+    }
+
+    testOutputs(
+        std::set<int>(inputs.begin(), inputs.end()),
+        streamingSet,
+        collectorSink);
+
+    streamingSet.call("resetState");
+    POTHOS_TEST_EQUAL(0, streamingSet.call<size_t>("size"));
+}
+
+static void testStreamingSetUnion()
+{
+    std::cout << " * Testing /gpu/algorithm/streaming_set_union" << std::endl;
+
+    constexpr size_t NumInputs = 3;
+
+    auto streamingSet = Pothos::BlockRegistry::make(
+                            "/gpu/algorithm/streaming_set_union",
+                            "Auto",
+                            "int32",
+                            NumInputs);
+
+    auto collectorSink = Pothos::BlockRegistry::make(
+                             "/blocks/collector_sink",
+                             "int32");
+
+    std::set<int> expectedValues;
+    std::vector<Pothos::Proxy> feederSources;
+    for(size_t input = 0; input < NumInputs; ++input)
+    {
+        // Give each input a different range so the union is bigger than
+        // any one of them.
+        auto inputs = getRandomInputs(unsigned(input));
+        for(auto& value: inputs) value += int(input) * MaxValue;
+        expectedValues.insert(inputs.begin(), inputs.end());
+
+        feederSources.emplace_back(Pothos::BlockRegistry::make(
+                                       "/blocks/feeder_source",
+                                       "int32"));
+        GPUTests::feedUnevenBuffers(feederSources.back(), inputs);
+    }
+
+    {
+        Pothos::Topology topology;
+        for(size_t input = 0; input < NumInputs; ++input)
+        {
+            topology.connect(feederSources[input], 0, streamingSet, input);
+        }
+        topology.connect(streamingSet, 0, collectorSink, 0);
+
+        topology.commit();
+        POTHOS_TEST_TRUE(topology.waitInactive(0.05));
+    }
+
+    testOutputs(expectedValues, streamingSet, collectorSink);
+}
+
+static void testCapacity()
+{
+    std::cout << " * Testing capacity" << std::endl;
+
+    constexpr size_t Capacity = 100;
+
+    const auto inputs = getRandomInputs(Capacity);
+
+    auto feederSource = Pothos::BlockRegistry::make(
+                            "/blocks/feeder_source",
+                            "int32");
+    GPUTests::feedUnevenBuffers(feederSource, inputs);
+
+    auto streamingSet = Pothos::BlockRegistry::make(
+                            "/gpu/algorithm/streaming_set_unique",
+                            "Auto",
+                            "int32");
+    streamingSet.call("setCapacity", Capacity);
+    POTHOS_TEST_EQUAL(Capacity, streamingSet.call<size_t>("capacity"));
+
+    auto collectorSink = Pothos::BlockRegistry::make(
+                             "/blocks/collector_sink",
+                             "int32");
+
+    {
+        Pothos::Topology topology;
+        topology.connect(feederSource, 0, streamingSet, 0);
+        topology.connect(streamingSet, 0, collectorSink, 0);
+
+        topology.commit();
+        POTHOS_TEST_TRUE(topology.waitInactive(0.05));
+    }
+
+    POTHOS_TEST_EQUAL(Capacity, streamingSet.call<size_t>("size"));
+
+    // The set must still be sorted and made up of inputs.
+    const std::set<int> inputSet(inputs.begin(), inputs.end());
+    const auto values = streamingSet.call<std::vector<int>>("values");
+    POTHOS_TEST_TRUE(std::is_sorted(values.begin(), values.end()));
+    for(int value: values) POTHOS_TEST_EQUAL(1, inputSet.count(value));
+
+    // Evicted values are output again when they come back, so every
+    // distinct value is output at least once.
+    auto outputs = GPUTests::bufferChunkToStdVector<int>(
+                       collectorSink.call<Pothos::BufferChunk>("getBuffer"));
+    POTHOS_TEST_TRUE(outputs.size() >= inputSet.size());
+
+    std::sort(outputs.begin(), outputs.end());
+    outputs.erase(std::unique(outputs.begin(), outputs.end()), outputs.end());
+    POTHOS_TEST_EQUAL(std::vector<int>(inputSet.begin(), inputSet.end()), outputs);
+}
+
+static void testMaxAge()
+{
+    std::cout << " * Testing max age" << std::endl;
+
+    constexpr unsigned long long MaxAge = 100;
+
+    // Each buffer is processed before the next is fed, so the ages are
+    // deterministic.
+    std::vector<int> oldInputs(MaxAge);
+    std::iota(oldInputs.begin(), oldInputs.end(), 0);
+    std::vector<int> newInputs(2 * MaxAge);
+    std::iota(newInputs.begin(), newInputs.end(), 1000);
+
+    auto feederSource = Pothos::BlockRegistry::make(
+                            "/blocks/feeder_source",
+                            "int32");
+
+    auto streamingSet = Pothos::BlockRegistry::make(
+                            "/gpu/algorithm/streaming_set_unique",
+                            "Auto",
+                            "int32");
+    streamingSet.call("setMaxAge", MaxAge);
+    POTHOS_TEST_EQUAL(MaxAge, streamingSet.call<unsigned long long>("maxAge"));
+
+    auto collectorSink = Pothos::BlockRegistry::make(
+                             "/blocks/collector_sink",
+                             "int32");
+
+    {
+        Pothos::Topology topology;
+        topology.connect(feederSource, 0, streamingSet, 0);
+        topology.connect(streamingSet, 0, collectorSink, 0);
+        topology.commit();
+
+        feederSource.call("feedBuffer", GPUTests::stdVectorToBufferChunk(oldInputs));
+        POTHOS_TEST_TRUE(topology.waitInactive(0.05));
+        POTHOS_TEST_EQUAL(oldInputs, streamingSet.call<std::vector<int>>("values"));
+
+        // The old values were last seen more than MaxAge samples ago.
+        feederSource.call("feedBuffer", GPUTests::stdVectorToBufferChunk(newInputs));
+        POTHOS_TEST_TRUE(topology.waitInactive(0.05));
+        POTHOS_TEST_EQUAL(newInputs, streamingSet.call<std::vector<int>>("values"));
+
+        // Values that aged out count as new when they come back.
+        feederSource.call("feedBuffer", GPUTests::stdVectorToBufferChunk(oldInputs));
+        POTHOS_TEST_TRUE(topology.waitInactive(0.05));
+    }
+
+    std::vector<int> expectedOutputs(oldInputs);
+    expectedOutputs.insert(expectedOutputs.end(), newInputs.begin(), newInputs.end());
+    expectedOutputs.insert(expectedOutputs.end(), oldInputs.begin(), oldInputs.end());
+    POTHOS_TEST_EQUAL(
+        expectedOutputs,
+        GPUTests::bufferChunkToStdVector<int>(collectorSink.call<Pothos::BufferChunk>("getBuffer")));
+
+    // The new values were seen exactly MaxAge samples ago, which is still
+    // in range.
+    std::vector<int> expectedValues(oldInputs);
+    expectedValues.insert(expectedValues.end(), newInputs.begin(), newInputs.end());
+    POTHOS_TEST_EQUAL(expectedValues, streamingSet.call<std::vector<int>>("values"));
+}
+
+POTHOS_TEST_BLOCK("/gpu/tests", test_streaming_set)
+{
+    GPUTests::setupTestEnv();
+
+    testStreamingSetUnique();
+    testStreamingSetUnion();
+    testCapacity();
+    testMaxAge();
+}
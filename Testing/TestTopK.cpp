@@ -0,0 +1,123 @@
+// Copyright (c) 2021 Nicholas Corgan
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "TestUtility.hpp"
+
+#include <Pothos/Framework.hpp>
+#include <Pothos/Proxy.hpp>
+#include <Pothos/Testing.hpp>
+
+#include <algorithm>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+static constexpr size_t K = 5;
+static constexpr size_t NumSamples = 5000;
+static constexpr size_t EmitInterval = 1000;
+static constexpr size_t WindowSize = 1500;
+
+// The largest K of inputs[begin, end), largest first
+static std::vector<size_t> getExpectedIndices(
+    const std::vector<double>& inputs,
+    size_t begin,
+    size_t end)
+{
+    std::vector<size_t> indices(end - begin);
+    std::iota(indices.begin(), indices.end(), begin);
+    std::partial_sort(
+        indices.begin(),
+        indices.begin() + K,
+        indices.end(),
+        [&inputs](size_t lhs, size_t rhs){return inputs[lhs] > inputs[rhs];});
+    indices.resize(K);
+
+    return indices;
+}
+
+static void testStreamingTopK(const std::string& mode)
+{
+    std::cout << " * Testing " << mode << " mode" << std::endl;
+
+    // Every value is unique, so the expected indices are too.
+    std::vector<double> inputs(NumSamples);
+    std::iota(inputs.begin(), inputs.end(), 0.0);
+    std::shuffle(inputs.begin(), inputs.end(), std::mt19937(NumSamples));
+
+    auto feederSource = Pothos::BlockRegistry::make(
+                            "/blocks/feeder_source",
+                            "float64");
+
+    GPUTests::feedUnevenBuffers(feederSource, inputs);
+
+    auto topK = Pothos::BlockRegistry::make(
+                    "/gpu/statistics/topk",
+                    "Auto",
+                    "float64");
+    topK.call("setK", K);
+    topK.call("setMode", mode);
+    topK.call("setWindowSize", WindowSize);
+    topK.call("setEmitInterval", EmitInterval);
+    POTHOS_TEST_EQUAL(mode, topK.call<std::string>("mode"));
+
+    auto streamSink = Pothos::BlockRegistry::make(
+                          "/blocks/collector_sink",
+                          "float64");
+    auto topKSink = Pothos::BlockRegistry::make(
+                        "/blocks/collector_sink",
+                        "");
+
+    {
+        Pothos::Topology topology;
+        topology.connect(feederSource, 0, topK, 0);
+        topology.connect(topK, 0, streamSink, 0);
+        topology.connect(topK, "topk", topKSink, 0);
+
+        topology.commit();
+        POTHOS_TEST_TRUE(topology.waitInactive(0.05));
+    }
+
+    // The inputs should pass through unchanged.
+    GPUTests::testBufferChunk(
+        GPUTests::stdVectorToBufferChunk(inputs),
+        streamSink.call<Pothos::BufferChunk>("getBuffer"));
+
+    const auto packets = topKSink.call<std::vector<Pothos::Packet>>("getPackets");
+    POTHOS_TEST_EQUAL(NumSamples / EmitInterval, packets.size());
+
+    for(size_t packetIndex = 0; packetIndex < packets.size(); ++packetIndex)
+    {
+        const auto& packet = packets[packetIndex];
+
+        const size_t end = (packetIndex + 1) * EmitInterval;
+        const size_t begin = ("window" == mode) ? ((end > WindowSize) ? (end - WindowSize) : 0) : 0;
+        const auto expectedIndices = getExpectedIndices(inputs, begin, end);
+
+        POTHOS_TEST_EQUAL(end, packet.metadata.at("totalSamples").convert<size_t>());
+
+        const auto values = GPUTests::bufferChunkToStdVector<double>(packet.payload);
+        const auto indices = packet.metadata.at("indices").convert<std::vector<unsigned long long>>();
+        POTHOS_TEST_EQUAL(K, values.size());
+        POTHOS_TEST_EQUAL(K, indices.size());
+
+        for(size_t i = 0; i < K; ++i)
+        {
+            POTHOS_TEST_EQUAL(expectedIndices[i], size_t(indices[i]));
+            POTHOS_TEST_EQUAL(inputs[expectedIndices[i]], values[i]);
+        }
+    }
+
+    POTHOS_TEST_EQUAL(
+        packets.back().metadata.at("indices").convert<std::vector<unsigned long long>>(),
+        topK.call<std::vector<unsigned long long>>("lastIndices"));
+}
+
+POTHOS_TEST_BLOCK("/gpu/tests", test_topk_streaming)
+{
+    GPUTests::setupTestEnv();
+
+    testStreamingTopK("cumulative");
+    testStreamingTopK("window");
+}
@@ -0,0 +1,96 @@
+// Copyright (c) 2021 Nicholas Corgan
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "TestUtility.hpp"
+
+#include <Pothos/Framework.hpp>
+#include <Pothos/Proxy.hpp>
+#include <Pothos/Testing.hpp>
+
+#include <Poco/File.h>
+#include <Poco/Path.h>
+#include <Poco/TemporaryFile.h>
+
+#include <json.hpp>
+
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <string>
+
+using json = nlohmann::json;
+
+POTHOS_TEST_BLOCK("/gpu/tests", test_chrome_trace)
+{
+    GPUTests::setupTestEnv();
+
+    const std::string type = "float32";
+
+    const auto traceFilepath = Poco::Path::temp() + "pothosgpu_trace.json";
+    Poco::TemporaryFile::registerForDeletion(traceFilepath);
+
+    GPUTests::getAndCallPlugin<Pothos::Object>("/gpu/config/clear_trace");
+    GPUTests::getAndCallPlugin<Pothos::Object>("/gpu/config/set_trace_file", traceFilepath);
+    GPUTests::getAndCallPlugin<Pothos::Object>("/gpu/config/set_tracing_enabled", true);
+    POTHOS_TEST_TRUE(GPUTests::getAndCallPlugin<bool>("/gpu/config/tracing_enabled"));
+
+    auto feederSource = Pothos::BlockRegistry::make(
+                            "/blocks/feeder_source",
+                            type);
+    feederSource.call("feedBuffer", GPUTests::getTestInputs(type));
+
+    auto abs = Pothos::BlockRegistry::make(
+                   "/gpu/arith/abs",
+                   "Auto",
+                   type);
+    abs.call("setName", "TraceAbs");
+
+    auto collectorSink = Pothos::BlockRegistry::make(
+                             "/blocks/collector_sink",
+                             type);
+
+    {
+        Pothos::Topology topology;
+        topology.connect(feederSource, 0, abs, 0);
+        topology.connect(abs, 0, collectorSink, 0);
+
+        topology.commit();
+        POTHOS_TEST_TRUE(topology.waitInactive());
+    }
+
+    GPUTests::getAndCallPlugin<Pothos::Object>("/gpu/config/set_tracing_enabled", false);
+    GPUTests::getAndCallPlugin<Pothos::Object>("/gpu/config/set_trace_file", std::string());
+
+    // The file is written once the last block deactivates, so it should
+    // match a dump.
+    POTHOS_TEST_TRUE(Poco::File(traceFilepath).exists());
+    std::ifstream ifile(traceFilepath);
+    const auto fileTrace = json::parse(ifile);
+    const auto trace = json::parse(GPUTests::getAndCallPlugin<std::string>("/gpu/config/dump_trace"));
+    POTHOS_TEST_EQUAL(fileTrace.dump(), trace.dump());
+
+    std::set<std::string> phases;
+    for(const auto& event: trace["traceEvents"])
+    {
+        if("X" != event["ph"].get<std::string>()) continue;
+
+        const auto& args = event["args"];
+        const auto blockName = args["block"].get<std::string>();
+        if(0 != blockName.find("TraceAbs")) continue;
+
+        POTHOS_TEST_GE(event["dur"].get<double>(), 0.0);
+        POTHOS_TEST_FALSE(args["device"].get<std::string>().empty());
+
+        const auto& name = event["name"].get<std::string>();
+        phases.emplace(name.substr(name.rfind(' ')+1));
+    }
+    for(const std::string& phase: {"work", "upload", "compute", "download"})
+    {
+        std::cout << " * Testing " << phase << std::endl;
+        POTHOS_TEST_EQUAL(1, phases.count(phase));
+    }
+
+    GPUTests::getAndCallPlugin<Pothos::Object>("/gpu/config/clear_trace");
+    const auto clearedTrace = json::parse(GPUTests::getAndCallPlugin<std::string>("/gpu/config/dump_trace"));
+    POTHOS_TEST_TRUE(clearedTrace["traceEvents"].empty());
+}
@@ -138,6 +138,27 @@ static std::vector<T> linspace(T a, T b, size_t N)
     return xs;
 }
 
+// Feeds the inputs in buffers of the given sizes, followed by whatever is
+// left, so blocks see values split across uneven buffer boundaries.
+template <typename T>
+static void feedUnevenBuffers(
+    Pothos::Proxy& feederSource,
+    const std::vector<T>& inputs,
+    const std::vector<size_t>& splits = {37, 1200, 1, 2000})
+{
+    auto beginIter = inputs.begin();
+    for(size_t split: splits)
+    {
+        feederSource.call(
+            "feedBuffer",
+            stdVectorToBufferChunk(std::vector<T>(beginIter, beginIter + split)));
+        beginIter += split;
+    }
+    feederSource.call(
+        "feedBuffer",
+        stdVectorToBufferChunk(std::vector<T>(beginIter, inputs.end())));
+}
+
 template <typename ReturnType, typename... ArgsType>
 ReturnType getAndCallPlugin(
     const std::string& proxyPath,
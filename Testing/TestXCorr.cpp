@@ -0,0 +1,159 @@
+// Copyright (c) 2021 Nicholas Corgan
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "TestUtility.hpp"
+
+#include <Pothos/Framework.hpp>
+#include <Pothos/Proxy.hpp>
+#include <Pothos/Testing.hpp>
+
+#include <complex>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using Complex = std::complex<double>;
+
+static constexpr size_t FrameSize = 64;
+static constexpr size_t MaxLag = 10;
+static constexpr size_t NumFrames = 40;
+
+// Direct evaluation of each frame's lags, with zeros before the stream
+static std::vector<Complex> referenceXCorr(
+    const std::vector<Complex>& x,
+    const std::vector<Complex>& y)
+{
+    const long long maxLag = static_cast<long long>(MaxLag);
+    auto at = [](const std::vector<Complex>& vec, long long index)
+    {
+        return (index >= 0) ? vec[static_cast<size_t>(index)] : Complex(0.0);
+    };
+
+    std::vector<Complex> outputs;
+    for(size_t frame = 0; frame < (x.size() / FrameSize); ++frame)
+    {
+        for(long long lag = -maxLag; lag <= maxLag; ++lag)
+        {
+            Complex sum(0.0);
+            for(size_t i = 0; i < FrameSize; ++i)
+            {
+                const long long n = static_cast<long long>((frame * FrameSize) + i);
+                sum += (lag >= 0) ? (at(x, n) * std::conj(at(y, n - lag)))
+                                  : (at(x, n + lag) * std::conj(at(y, n)));
+            }
+            outputs.emplace_back(sum);
+        }
+    }
+
+    return outputs;
+}
+
+// Feed in uneven buffers to make sure the history is carried over.
+static Pothos::Proxy makeFeederSource(const std::vector<Complex>& inputs)
+{
+    auto feederSource = Pothos::BlockRegistry::make(
+                            "/blocks/feeder_source",
+                            "complex_float64");
+
+    const size_t splitIndex = (FrameSize * 7) + 13;
+    feederSource.call(
+        "feedBuffer",
+        GPUTests::stdVectorToBufferChunk(std::vector<Complex>(inputs.begin(), inputs.begin() + splitIndex)));
+    feederSource.call(
+        "feedBuffer",
+        GPUTests::stdVectorToBufferChunk(std::vector<Complex>(inputs.begin() + splitIndex, inputs.end())));
+
+    return feederSource;
+}
+
+static void testXCorr(const std::string& mode)
+{
+    std::cout << " * Testing " << mode << std::endl;
+
+    static constexpr long long Delay = 3;
+    const bool isCross = ("cross" == mode);
+
+    // Input 0 is input 1 delayed. Use noise so the correlation peak is
+    // unambiguous.
+    std::mt19937 gen(12345);
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+
+    std::vector<Complex> y(FrameSize * NumFrames);
+    for(auto& value: y) value = Complex(dist(gen), dist(gen));
+
+    auto x = y;
+    if(isCross)
+    {
+        x.insert(x.begin(), static_cast<size_t>(Delay), Complex(0.0));
+        x.resize(y.size());
+    }
+
+    auto xcorr = Pothos::BlockRegistry::make(
+                     "/gpu/signal/xcorr",
+                     "Auto",
+                     "complex_float64",
+                     mode,
+                     FrameSize,
+                     MaxLag);
+    POTHOS_TEST_EQUAL(FrameSize, xcorr.call<size_t>("frameSize"));
+    POTHOS_TEST_EQUAL(MaxLag, xcorr.call<size_t>("maxLag"));
+
+    auto feederSource0 = makeFeederSource(x);
+    auto feederSource1 = makeFeederSource(y);
+
+    auto collectorSink = Pothos::BlockRegistry::make(
+                             "/blocks/collector_sink",
+                             "complex_float64");
+
+    {
+        Pothos::Topology topology;
+        topology.connect(feederSource0, 0, xcorr, 0);
+        if(isCross) topology.connect(feederSource1, 0, xcorr, 1);
+        topology.connect(xcorr, 0, collectorSink, 0);
+
+        topology.commit();
+        POTHOS_TEST_TRUE(topology.waitInactive(0.05));
+    }
+
+    const auto expectedOutputs = referenceXCorr(x, isCross ? y : x);
+    const auto outputs = GPUTests::bufferChunkToStdVector<Complex>(
+                             collectorSink.call<Pothos::BufferChunk>("getBuffer"));
+    POTHOS_TEST_EQUAL(expectedOutputs.size(), outputs.size());
+    for(size_t i = 0; i < outputs.size(); ++i)
+    {
+        POTHOS_TEST_CLOSE(expectedOutputs[i].real(), outputs[i].real(), 1e-6);
+        POTHOS_TEST_CLOSE(expectedOutputs[i].imag(), outputs[i].imag(), 1e-6);
+    }
+
+    POTHOS_TEST_EQUAL(
+        (isCross ? Delay : 0LL),
+        xcorr.call<long long>("peakLag"));
+}
+
+POTHOS_TEST_BLOCK("/gpu/tests", test_xcorr)
+{
+    GPUTests::setupTestEnv();
+
+    testXCorr("cross");
+    testXCorr("auto");
+
+    POTHOS_TEST_THROWS(
+        Pothos::BlockRegistry::make(
+            "/gpu/signal/xcorr",
+            "Auto",
+            "complex_float64",
+            "cross",
+            0,
+            MaxLag),
+        Pothos::ProxyExceptionMessage);
+    POTHOS_TEST_THROWS(
+        Pothos::BlockRegistry::make(
+            "/gpu/signal/xcorr",
+            "Auto",
+            "complex_float64",
+            "invalid",
+            FrameSize,
+            MaxLag),
+        Pothos::ProxyExceptionMessage);
+}